@@ -1,6 +1,9 @@
 #include "bmc.h"
+#include "mtd_flash.h"
 #include <string>
 #include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
 #include <cstdio>
 #include <fstream>
 #include <gtest/gtest.h>
@@ -32,21 +35,6 @@ class SystemMock : public System {
   MOCK_METHOD1(get_fru_id, uint8_t(string &name));
   MOCK_METHOD2(set_update_ongoing, void(uint8_t fruid, int timeo));
   MOCK_METHOD1(lock_file, string(string name));
-
-  int copy_file(string cmd) {
-    size_t pos = cmd.find("flashcp -v ");
-    if (pos == string::npos) {
-      return -1;
-    }
-    string params = cmd.substr(pos + strlen("flashcp -v "));
-    pos = params.find(" ");
-    string filesrc = params.substr(0, pos);
-    string filedst = params.substr(pos + 1);
-    ofstream dst(filedst);
-    dst << file_contents(filesrc);
-    dst.close();
-    return 0;
-  }
 };
 
 // TEST1: Verify that if the BMC component is created without a version flash
@@ -125,17 +113,17 @@ class BmcComponentMock : public BmcComponent {
 
 // TEST1: Check if image validation fails, update will fail with the correct error message.
 // TEST2: Check if the above test succeeds, but get_mtd_name fails, update will fail with the correct error message.
-// TEST3: Check if the above tests succeeds, but runcmd fails update will fail.
-// TEST4: Check if the above tests succeeds, bmc is flashed to the correct MTD device (Correct call to flashcp)
+// TEST3: Check if the above tests succeeds, but the device cannot be opened update will fail.
+// TEST4: Check if the above tests succeeds, bmc is flashed to the correct MTD device
 TEST(BmcComponentTest, MTDFlash) {
   stringstream out, err;
   SystemMock mock(out, err);
+  TmpFile image("0123456789");
+  TmpFile mtd_dev("abcdefghijkl");
   string dummy_dev("/dev/mtdblah");
   string dummy_mtd("flash123");
-  string dummy_image("blahimage");
   string name("fbtp");
   string version = name + "-4.9";
-  string exp_flashcp_call("flashcp -v " + dummy_image + " " + dummy_dev);
 
   EXPECT_CALL(mock, version())
     .Times(1)
@@ -145,20 +133,15 @@ TEST(BmcComponentTest, MTDFlash) {
     .Times(3)
     .WillOnce(Return(false))
     .WillOnce(DoAll(SetArgReferee<1>(dummy_dev), Return(true)))
-    .WillOnce(DoAll(SetArgReferee<1>(dummy_dev), Return(true)));
-
-  EXPECT_CALL(mock, runcmd(string(exp_flashcp_call)))
-    .Times(2)
-    .WillOnce(Return(-1))
-    .WillOnce(Return(0));
+    .WillOnce(DoAll(SetArgReferee<1>(mtd_dev.name), Return(true)));
 
   BmcComponentMock b("bmc_test", "bmc_test", mock, dummy_mtd);
 
-  EXPECT_CALL(b, update(dummy_image))
+  EXPECT_CALL(b, update(image.name))
     .Times(4)
     .WillRepeatedly(Invoke(&b, &BmcComponentMock::real_update));
 
-  EXPECT_CALL(b, is_valid(dummy_image))
+  EXPECT_CALL(b, is_valid(image.name))
     .Times(4)
     .WillOnce(Return(false))
     .WillOnce(Return(true))
@@ -166,41 +149,37 @@ TEST(BmcComponentTest, MTDFlash) {
     .WillOnce(Return(true));
 
   // First call is_valid will return false. Check error
-  EXPECT_EQ(FW_STATUS_FAILURE, b.update(dummy_image));
-  EXPECT_EQ(err.str(), dummy_image + " is not a valid BMC image for " + name + "\n");
+  EXPECT_EQ(FW_STATUS_FAILURE, b.update(image.name));
+  EXPECT_EQ(err.str(), image.name + " is not a valid BMC image for " + name + "\n");
   err.str("");
 
   // Second call is_valid() will return true, but get_mtd_name will return false.
   // check error.
-  EXPECT_EQ(FW_STATUS_FAILURE, b.update(dummy_image));
+  EXPECT_EQ(FW_STATUS_FAILURE, b.update(image.name));
   EXPECT_EQ(err.str(), "Failed to get device for " + dummy_mtd + "\n");
   err.str("");
 
-  EXPECT_EQ(FW_STATUS_FAILURE, b.update(dummy_image));
+  EXPECT_EQ(FW_STATUS_FAILURE, b.update(image.name));
+  EXPECT_EQ(err.str(), "Cannot open " + dummy_dev + " for writing\n");
 
-  // Both succeeds. Check if we are calling flashcp correctly.
-  EXPECT_EQ(0, b.update(dummy_image));
+  // Both succeeds. The image is written at the start of the device.
+  EXPECT_EQ(0, b.update(image.name));
+  EXPECT_EQ("0123456789kl", mtd_dev.read());
 }
 
 // Test1: Test offseted flash used for verified boot works as expected.
 TEST(BmcComponentTest, MTDOffsetFlash) {
   TmpFile image("1234567890"); // 10 byte image.
   TmpFile mtd_dev("abcdef"); // 6 byte mtd
-  string exp_image_name = image.name + "-tmp";
 
   stringstream out;
   SystemMock mock(out, cerr);
   string dummy_mtd("flash123");
-  string exp_flashcp_call("flashcp -v " + exp_image_name + " " + mtd_dev.name);
 
   EXPECT_CALL(mock, get_mtd_name(dummy_mtd, _))
     .Times(1)
     .WillRepeatedly(DoAll(SetArgReferee<1>(mtd_dev.name), Return(true)));
 
-  EXPECT_CALL(mock, runcmd(string(exp_flashcp_call)))
-    .Times(1)
-    .WillRepeatedly(Invoke(&mock, &SystemMock::copy_file));
-
   // We are skipping the first 4 bytes. Copying the next 4 from mtd
   // and replacing our own.
   BmcComponentMock b("bmc_test", "bmc_test", mock, dummy_mtd, "", 4, 8);
@@ -215,7 +194,94 @@ TEST(BmcComponentTest, MTDOffsetFlash) {
 
   EXPECT_EQ(0, b.update(image.name));
   // From 1234567890, we cut and throw away the first 4 bytes. So we have 567890.
-  // Then we copy 8-4=4 bytes from mtd (abcd) replacing our first 8-4=4 bytes.
+  // Then we keep 8-4=4 bytes from mtd (abcd) in place of our first 8-4=4 bytes.
   // Hence we should expect the MTD to contain abcd90.
   EXPECT_EQ("abcd90", mtd_dev.read());
 }
+
+// Test1: Erase blocks which already hold the image are not rewritten.
+// Test2: An interrupted update resumes after the blocks in the journal.
+TEST(BmcComponentTest, MTDFlashSkipResume) {
+  const size_t bs = MTD_FLASH_FILE_ERASE_SIZE;
+  string blocks = string(bs, 'a') + string(bs, 'b') + string(bs, 'c');
+  TmpFile image(blocks);
+  TmpFile mtd_dev(string(bs, 'a') + string(bs, 'x') + string(bs, 'c'));
+  TmpFile journal("");
+  stringstream err;
+  size_t skipped = 0;
+
+  MtdFlash flash(mtd_dev.name, journal.name, err);
+  EXPECT_EQ(0, flash.write(image.name, 0, 0,
+    [&](size_t done, size_t skip, size_t total) {
+      EXPECT_EQ(3, total);
+      skipped = skip;
+    }));
+  EXPECT_EQ(2, skipped);
+  EXPECT_EQ(blocks, mtd_dev.read());
+  EXPECT_EQ(err.str(), "");
+
+  // A journal left by an interrupted update of this image which got
+  // through the first two blocks.
+  struct stat st;
+  stat(image.name.c_str(), &st);
+  {
+    ofstream j(journal.name);
+    j << mtd_dev.name << " " << st.st_size << " " << st.st_mtime << " "
+      << st.st_ino << " 0 0 " << bs << "\n2\n";
+  }
+  {
+    ofstream dev(mtd_dev.name);
+    dev << string(bs, 'x') + string(bs, 'x') + string(bs, 'x');
+  }
+  size_t first = 0;
+  EXPECT_EQ(0, flash.write(image.name, 0, 0,
+    [&](size_t done, size_t skip, size_t total) {
+      if (first == 0) {
+        first = done;
+      }
+    }));
+  EXPECT_EQ(2, first);
+  EXPECT_EQ(string(bs, 'x') + string(bs, 'x') + string(bs, 'c'), mtd_dev.read());
+  // Done, the journal is gone.
+  EXPECT_NE(0, access(journal.name.c_str(), F_OK));
+}
+
+// Test1: Bytes of partly covered blocks outside of the image are kept.
+// Test2: A partly covered block erased by an interrupted update is rebuilt
+//        from the copy saved before the erase, not from the erased block.
+TEST(BmcComponentTest, MTDFlashPartialBlockResume) {
+  const size_t bs = MTD_FLASH_FILE_ERASE_SIZE;
+  string want = string(bs / 2, 'p') + string(bs, 'i') + string(bs / 2, 'q');
+  TmpFile image(string(bs, 'i'));
+  TmpFile mtd_dev(string(bs, 'p') + string(bs, 'q'));
+  TmpFile journal("");
+  stringstream err;
+
+  MtdFlash flash(mtd_dev.name, journal.name, err);
+  EXPECT_EQ(0, flash.write(image.name, 0, bs / 2));
+  EXPECT_EQ(want, mtd_dev.read());
+  EXPECT_EQ(err.str(), "");
+  EXPECT_NE(0, access((journal.name + ".blk").c_str(), F_OK));
+
+  // Power was lost right after the second block was erased.
+  struct stat st;
+  stat(image.name.c_str(), &st);
+  stringstream key;
+  key << mtd_dev.name << " " << st.st_size << " " << st.st_mtime << " "
+      << st.st_ino << " 0 " << bs / 2 << " " << bs;
+  {
+    ofstream j(journal.name);
+    j << key.str() << "\n1\n";
+    ofstream blk(journal.name + ".blk", ios::binary);
+    blk << key.str() << "\n1\n" << string(bs / 2, 'i') << string(bs / 2, 'q');
+  }
+  {
+    ofstream dev(mtd_dev.name);
+    dev << string(bs / 2, 'p') + string(bs / 2, 'i') + string(bs, '\xff');
+  }
+  EXPECT_EQ(0, flash.write(image.name, 0, bs / 2));
+  EXPECT_EQ(want, mtd_dev.read());
+  EXPECT_EQ(err.str(), "");
+  EXPECT_NE(0, access(journal.name.c_str(), F_OK));
+  EXPECT_NE(0, access((journal.name + ".blk").c_str(), F_OK));
+}
@@ -8,6 +8,7 @@
 #include <algorithm>
 #include <sys/mman.h>
 #include "bmc.h"
+#include "mtd_flash.h"
 
 using namespace std;
 
@@ -17,8 +18,6 @@ int BmcComponent::update(string image_path)
 {
   string dev;
   int ret;
-  string flash_image = image_path;
-  stringstream cmd_str;
   if (_mtd_name == "") {
     // Upgrade not supported
     return FW_STATUS_NOT_SUPPORTED;
@@ -34,70 +33,21 @@ int BmcComponent::update(string image_path)
     return FW_STATUS_FAILURE;
   }
   system.output << "Flashing to device: " << dev << endl;
-  if (_skip_offset > 0 || _writable_offset > 0) {
-    flash_image = image_path + "-tmp";
-    // Ensure that we are not overwriting an existing file.
-    while (access( flash_image.c_str(), F_OK  ) != -1) {
-      flash_image.append("_");
-    }
-    // Open input image and seek skipping to the writable offset.
-    int fd_r = open(image_path.c_str(), O_RDONLY);
-    if (fd_r < 0) {
-      system.error << "Cannot open " << image_path << " for reading" << endl;
-      return FW_STATUS_FAILURE;
-    }
-    if (lseek(fd_r, _skip_offset, SEEK_SET) != (off_t)_skip_offset) {
-      close(fd_r);
-      system.error << "Cannot seek " << image_path << endl;
-      return FW_STATUS_FAILURE;
-    }
-    // create tmp file for writing.
-    int fd_w = open(flash_image.c_str(), O_WRONLY | O_CREAT, 0666);
-    if (fd_w < 0) {
-      system.error << "Cannot write to " << flash_image << endl;
-      close(fd_r);
-      return FW_STATUS_FAILURE;
-    }
-    uint8_t buf[1024];
-    size_t r_b;
-
-    if (_skip_offset > _writable_offset) {
-      size_t copy = _skip_offset - _writable_offset;
-      int fd_d = open(dev.c_str(), O_RDONLY);
-      if (fd_d < 0) {
-        close(fd_r);
-        close(fd_w);
-        return FW_STATUS_FAILURE;
-      }
-      while (copy > 0) {
-        size_t to_copy = copy > sizeof(buf) ? sizeof(buf) : copy;
-        r_b = read(fd_d, buf, to_copy);
-        if (r_b != to_copy) {
-          close(fd_r);
-          close(fd_d);
-          close(fd_d);
-          return FW_STATUS_FAILURE;
-        }
-        write(fd_w, buf, to_copy);
-        copy -= to_copy;
-      }
-      close(fd_d);
-    }
-
-    // Copy from r to w.
-    while ((r_b = read(fd_r, buf, 1024)) > 0) {
-      write(fd_w, buf, r_b);
-    }
-    close(fd_r);
-    close(fd_w);
-  }
-  cmd_str << "flashcp -v " << flash_image << " " << dev;
-  ret = system.runcmd(cmd_str.str());
-  if (_writable_offset > 0) {
-    // this is a temp. file, remove it.
-    remove(flash_image.c_str());
+  // The image below _skip_offset is not written, the device keeps
+  // what it has there.
+  size_t dev_offset = 0;
+  if (_skip_offset > _writable_offset) {
+    dev_offset = _skip_offset - _writable_offset;
   }
-  return ret;
+  MtdFlash flash(dev, system.flash_journal(dev), system.error);
+  ret = flash.write(image_path, _skip_offset, dev_offset,
+    [this](size_t done, size_t skipped, size_t total) {
+      system.output << "\rFlashing: " << (total ? done * 100 / total : 100)
+                    << "% (" << skipped << " of " << total
+                    << " blocks unchanged)" << flush;
+    });
+  system.output << endl;
+  return ret == 0 ? FW_STATUS_SUCCESS : FW_STATUS_FAILURE;
 }
 
 int BmcComponent::print_version()
@@ -1,13 +1,18 @@
 #include <string>
 #include <list>
 #include <iostream>
+#include <cstring>
 #include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 #include <arpa/inet.h>
 #include <jansson.h>
 extern "C" {
   #include <libfdt.h>
 }
 #include <openssl/sha.h>
+#include <openssl/evp.h>
 #include <zlib.h>
 #include "bmc.h"
 
@@ -39,10 +44,53 @@ int __attribute__((weak)) fdt_next_subnode(const void *fdt, int offset)
        node = fdt_next_subnode(fdt, node))
 #endif
 
-#define FLASH_SIZE (32 * 1024 * 1024)
+#define DIGEST_CHUNK_SIZE (256 * 1024)
 
 using namespace std;
 
+/*
+ * Run len bytes of the mapped image through CRC32 and/or SHA256 (either
+ * may be NULL) in a single pass, a chunk at a time. The pages of each
+ * chunk are dropped once digested so that hashing a partition does not
+ * leave the whole of it resident; they are read back from the page cache
+ * should they be needed again.
+ */
+static void digest(const unsigned char *data, size_t len,
+                   uint32_t *crc, unsigned char *sha)
+{
+  const uintptr_t pmask = (uintptr_t)sysconf(_SC_PAGESIZE) - 1;
+  EVP_MD_CTX *ctx = NULL;
+
+  if (crc) {
+    *crc = crc32(0, Z_NULL, 0);
+  }
+  if (sha) {
+    ctx = EVP_MD_CTX_create();
+    EVP_DigestInit_ex(ctx, EVP_sha256(), NULL);
+  }
+  while (len > 0) {
+    size_t n = len < DIGEST_CHUNK_SIZE ? len : DIGEST_CHUNK_SIZE;
+    if (crc) {
+      *crc = crc32(*crc, data, n);
+    }
+    if (ctx) {
+      EVP_DigestUpdate(ctx, data, n);
+    }
+    // Only whole pages of the chunk
+    uintptr_t start = ((uintptr_t)data + pmask) & ~pmask;
+    uintptr_t end = ((uintptr_t)data + n) & ~pmask;
+    if (end > start) {
+      madvise((void *)start, end - start, MADV_DONTNEED);
+    }
+    data += n;
+    len -= n;
+  }
+  if (ctx) {
+    EVP_DigestFinal_ex(ctx, sha, NULL);
+    EVP_MD_CTX_destroy(ctx);
+  }
+}
+
 class Checker {
   protected:
   string name;
@@ -50,7 +98,8 @@ class Checker {
   off_t size;
   public:
   Checker(string n, off_t of, off_t sz) : name(n), offset(of), size(sz) {}
-  virtual bool is_valid(const unsigned char *image) {
+  // image_size bytes of image are mapped, the partition may extend past them
+  virtual bool is_valid(const unsigned char *image, off_t image_size) {
     return true;
   }
 };
@@ -74,12 +123,12 @@ class LegacyChecker : public Checker {
   public:
     LegacyChecker(string n, off_t of, off_t sz) : Checker(n, of, sz) {}
 
-  virtual bool is_valid(const unsigned char *image) {
+  virtual bool is_valid(const unsigned char *image, off_t image_size) {
     uint32_t hcrc, dcrc, hcrc_c, dcrc_c;
     unsigned char hdr[HEADER_SIZE];
     const unsigned char *data;
 
-    if (size <= HEADER_SIZE) {
+    if (size <= HEADER_SIZE || image_size - offset < HEADER_SIZE) {
       return false;
     }
     image = image + offset;
@@ -97,10 +146,10 @@ class LegacyChecker : public Checker {
     dcrc = get_word(hdr, DATA_CRC_OFFSET);
     off_t len  = (off_t)get_word(hdr, SIZE_OFFSET);
     data = image + HEADER_SIZE;
-    if (len + HEADER_SIZE > size) {
+    if (len + HEADER_SIZE > size || offset + HEADER_SIZE + len > image_size) {
       return false;
     }
-    dcrc_c = crc32(0, data, len);
+    digest(data, len, &dcrc_c, NULL);
     if (dcrc != dcrc_c) {
       return false;
     }
@@ -113,8 +162,9 @@ class FITChecker : public Checker {
   public:
   FITChecker(string n, off_t of, off_t sz, int nodes) : Checker(n, of, sz), num_nodes(nodes) {}
 
-  virtual bool is_valid(const unsigned char *image) {
+  virtual bool is_valid(const unsigned char *image, off_t image_size) {
       const void *fdt = (const void *)(image + offset);
+      off_t avail = image_size - offset;
       int nodep, node, hashnode;
       size_t data_size;
       uint32_t data_pos;
@@ -123,7 +173,9 @@ class FITChecker : public Checker {
       int len = 0;
       int valid_nodes = 0;
 
-      if (size < (off_t)FDT_V17_SIZE || fdt_check_header(fdt) != 0) {
+      if (size < (off_t)FDT_V17_SIZE || avail < (off_t)FDT_V17_SIZE ||
+          fdt_check_header(fdt) != 0 ||
+          (off_t)fdt_totalsize(fdt) > avail) {
         return false;
       }
 
@@ -154,6 +206,9 @@ class FITChecker : public Checker {
             return false;
           }
           data_pos = ntohl(*(uint32_t *)data);
+          if ((off_t)data_pos + (off_t)data_size > avail) {
+            return false;
+          }
           data = (const unsigned char *)fdt + data_pos;
         } else {
           data_size = (size_t)len;
@@ -164,7 +219,7 @@ class FITChecker : public Checker {
           //description 
           return false;
         }
-        SHA256(data, data_size, shasum);
+        digest(data, data_size, NULL, shasum);
 
         // Get the sha256 digest stored in the image */
         hashnode = fdt_subnode_offset(fdt, node, "hash@1");
@@ -246,7 +301,13 @@ class PartitionDescriptor
         return false;
       // A valid image might not take up the whole partition.
       // So image_size < offset + size is possible.
-      return checker->is_valid(image);
+      return checker->is_valid(image, image_size);
+    }
+    bool is_uboot(off_t &start, off_t &end)
+    {
+      start = offset;
+      end = offset + size;
+      return name == "uboot";
     }
 };
 
@@ -281,6 +342,14 @@ class ImageDescriptor {
     }
     return true;
   }
+  void uboot_ranges(list<pair<off_t, off_t>> &ranges) {
+    off_t start, end;
+    for (auto it = partitions.begin(); it != partitions.end(); it++) {
+      if ((*it)->is_uboot(start, end)) {
+        ranges.push_back(make_pair(start, end));
+      }
+    }
+  }
   ~ImageDescriptor() {
     partitions.clear();
   }
@@ -321,45 +390,67 @@ class Image {
     return true;
   }
   public:
-  Image(string &file) : image(NULL) {
+  Image(string &file) : image(NULL), fsize(0) {
+    struct stat st;
+    void *map;
+
     fd = open(file.c_str(), O_RDONLY);
     if (fd < 0) {
       throw "Cannot open " + string(file);
     }
-    fsize = lseek(fd, 0, SEEK_END);
-    if (fsize == 0) {
+    if (fstat(fd, &st) < 0 || st.st_size == 0) {
+      close(fd);
       throw "Zero size image file " + string(file);
     }
-    lseek(fd, 0, SEEK_SET);
-    unsigned char *img = (unsigned char *)calloc(FLASH_SIZE, 1);
-    for (int bread = 0; bread < (int)fsize;) {
-      int rc = read(fd, img + bread, fsize - bread);
-      if (rc > 0) {
-        bread += rc;
-      }
+    fsize = st.st_size;
+    // Pages are faulted in as the checks reach them rather than reading
+    // the whole image into memory up front.
+    map = mmap(NULL, fsize, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (map == MAP_FAILED) {
+      close(fd);
+      throw "Cannot map " + string(file);
     }
-    image = (const unsigned char *)img;
+    madvise(map, fsize, MADV_SEQUENTIAL);
+    image = (const unsigned char *)map;
   }
   ~Image() {
     if (image)
-      free((void *)image);
+      munmap((void *)image, fsize);
     if (fd >= 0)
       close(fd);
   }
-  bool supports_machine(string &machine) {
-    // Just dont check in the last 256 bytes of the image. Technically we
-    // need to find this in the uboot section so it should be pretty early on.
-    for (int i = 0; i < (int)fsize - 256; i++) {
-      const char *str = (const char *)&image[i];
-      if (isalnum(image[i]) && match(str, "U-Boot \\d\\d\\d\\d\\.\\d\\d ")) {
+  bool supports_machine(string &machine, off_t start, off_t end) {
+    static const char prefix[] = "U-Boot ";
+    const unsigned char *limit;
+    const char *str;
+
+    // Just dont check in the last 256 bytes of the image, the banner
+    // is followed by more than that in the U-Boot binary.
+    if ((off_t)fsize <= 256) {
+      return false;
+    }
+    if (end > (off_t)fsize - 256) {
+      end = (off_t)fsize - 256;
+    }
+    if (start >= end) {
+      return false;
+    }
+    limit = image + fsize;
+    for (const unsigned char *p = image + start;
+         (p = (const unsigned char *)memmem(p, image + end - p,
+                                            prefix, sizeof(prefix) - 1));
+         p++) {
+      str = (const char *)p;
+      if (match(str, "U-Boot \\d\\d\\d\\d\\.\\d\\d ")) {
         str += 15;
         if (*str == '(') {
           for (int j = 0; j < 32 && *str != ')'; j++, str++);
           if (*(str++) != ')')
             continue;
-          for (; *str == ' '; str++);
+          for (; (const unsigned char *)str < limit && *str == ' '; str++);
         }
-        if (istrncmp(str, machine.c_str(), machine.size()))
+        if ((const unsigned char *)str + machine.size() <= limit &&
+            istrncmp(str, machine.c_str(), machine.size()))
           return true;
       }
     }
@@ -412,6 +503,23 @@ class ImageDescriptorList {
     }
     return false;
   }
+  // The banner lives in U-Boot, so only look where one of the
+  // layouts puts it, or in the whole image if none says.
+  bool supports_machine(Image &image, string &machine)
+  {
+    list<pair<off_t, off_t>> ranges;
+    for (auto it = images.begin(); it != images.end(); it++) {
+      (*it)->uboot_ranges(ranges);
+    }
+    if (ranges.empty()) {
+      return image.supports_machine(machine, 0, image.fsize);
+    }
+    for (auto it = ranges.begin(); it != ranges.end(); it++) {
+      if (image.supports_machine(machine, it->first, it->second))
+        return true;
+    }
+    return false;
+  }
 };
 
 bool BmcComponent::is_valid(string &file)
@@ -420,10 +528,10 @@ bool BmcComponent::is_valid(string &file)
   try {
     Image image(file);
     string machine = system.name();
-    if (!image.supports_machine(machine)) {
+    ImageDescriptorList desc_list(system.partition_conf().c_str());
+    if (!desc_list.supports_machine(image, machine)) {
       return false;
     }
-    ImageDescriptorList desc_list(system.partition_conf().c_str());
     valid = desc_list.is_valid(image);
   } catch(string &ex) {
     cerr << ex << endl;
@@ -77,6 +77,7 @@ class System {
     virtual uint8_t get_fru_id(std::string &name);
     virtual void set_update_ongoing(uint8_t fru_id, int timeo);
     virtual std::string lock_file(std::string &name);
+    virtual std::string flash_journal(std::string &dev);
 };
 
 #endif
@@ -0,0 +1,276 @@
+#include <string>
+#include <sstream>
+#include <fstream>
+#include <cstdio>
+#include <cstring>
+#include <cstdlib>
+#include <cerrno>
+#include <algorithm>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/ioctl.h>
+#include <mtd/mtd-user.h>
+#include "mtd_flash.h"
+
+using namespace std;
+
+MtdFlash::MtdFlash(const string &dev, const string &journal, ostream &error)
+  : _dev(dev), _journal(journal), _error(error), _fd(-1), _is_mtd(false),
+    _dev_size(0), _erase_size(0)
+{
+}
+
+MtdFlash::~MtdFlash()
+{
+  if (_fd >= 0) {
+    close(_fd);
+  }
+}
+
+int MtdFlash::erase(size_t offset, size_t len)
+{
+  struct erase_info_user ei;
+
+  if (!_is_mtd) {
+    // Plain files are simply overwritten.
+    return 0;
+  }
+  ei.start = offset;
+  ei.length = len;
+  if (ioctl(_fd, MEMERASE, &ei) < 0) {
+    _error << "Erasing " << _dev << " at 0x" << hex << offset << dec
+           << " failed: " << strerror(errno) << endl;
+    return -1;
+  }
+  return 0;
+}
+
+int MtdFlash::write_block(size_t offset, const uint8_t *data, uint8_t *verify, size_t len)
+{
+  if (erase(offset, len)) {
+    return -1;
+  }
+  if (pwrite(_fd, data, len, offset) != (ssize_t)len) {
+    _error << "Writing " << _dev << " at 0x" << hex << offset << dec
+           << " failed: " << strerror(errno) << endl;
+    return -1;
+  }
+  if (pread(_fd, verify, len, offset) != (ssize_t)len ||
+      memcmp(data, verify, len) != 0) {
+    _error << "Verifying " << _dev << " at 0x" << hex << offset << dec
+           << " failed" << endl;
+    return -1;
+  }
+  return 0;
+}
+
+// Identifies the update a journal belongs to.
+string MtdFlash::journal_key(const struct stat &st, size_t image_offset, size_t dev_offset)
+{
+  stringstream key;
+  key << _dev << " " << st.st_size << " " << st.st_mtime << " " << st.st_ino
+      << " " << image_offset << " " << dev_offset << " " << _erase_size;
+  return key.str();
+}
+
+// Blocks already written by an interrupted update of the same image.
+size_t MtdFlash::journal_load(const string &key)
+{
+  string line;
+  size_t blocks = 0;
+
+  if (_journal == "") {
+    return 0;
+  }
+  ifstream in(_journal);
+  if (!getline(in, line) || line != key || !(in >> blocks)) {
+    return 0;
+  }
+  return blocks;
+}
+
+void MtdFlash::journal_save(const string &key, size_t blocks)
+{
+  if (_journal == "") {
+    return;
+  }
+  // Replace the journal atomically so it is never seen half written.
+  string tmp = _journal + ".tmp";
+  FILE *fp = fopen(tmp.c_str(), "w");
+  if (!fp) {
+    return;
+  }
+  fprintf(fp, "%s\n%zu\n", key.c_str(), blocks);
+  fflush(fp);
+  fsync(fileno(fp));
+  fclose(fp);
+  rename(tmp.c_str(), _journal.c_str());
+}
+
+// A partly covered block as it was about to be written, saved before
+// the erase.
+bool MtdFlash::block_load(const string &key, size_t block, uint8_t *buf, size_t len)
+{
+  string line;
+  size_t saved;
+
+  if (_journal == "") {
+    return false;
+  }
+  ifstream in(_journal + ".blk", ios::binary);
+  if (!getline(in, line) || line != key || !(in >> saved) || saved != block ||
+      in.get() != '\n') {
+    return false;
+  }
+  in.read((char *)buf, len);
+  return in.gcount() == (streamsize)len;
+}
+
+int MtdFlash::block_save(const string &key, size_t block, const uint8_t *buf, size_t len)
+{
+  if (_journal == "") {
+    return 0;
+  }
+  string path = _journal + ".blk";
+  string tmp = path + ".tmp";
+  FILE *fp = fopen(tmp.c_str(), "w");
+  if (!fp) {
+    _error << "Cannot save block " << block << " of " << _dev << endl;
+    return -1;
+  }
+  fprintf(fp, "%s\n%zu\n", key.c_str(), block);
+  if (fwrite(buf, 1, len, fp) != len || fflush(fp) || fsync(fileno(fp))) {
+    _error << "Cannot save block " << block << " of " << _dev << endl;
+    fclose(fp);
+    remove(tmp.c_str());
+    return -1;
+  }
+  fclose(fp);
+  if (rename(tmp.c_str(), path.c_str())) {
+    _error << "Cannot save block " << block << " of " << _dev << endl;
+    remove(tmp.c_str());
+    return -1;
+  }
+  return 0;
+}
+
+int MtdFlash::write(const string &image, size_t image_offset, size_t dev_offset,
+                    Progress progress)
+{
+  struct mtd_info_user info;
+  struct stat st;
+  uint8_t *cur = NULL, *data = NULL;
+  size_t len, first, last, total, done, skipped = 0;
+  int img_fd, ret = -1;
+
+  img_fd = open(image.c_str(), O_RDONLY);
+  if (img_fd < 0) {
+    _error << "Cannot open " << image << " for reading" << endl;
+    return -1;
+  }
+  if (fstat(img_fd, &st) < 0 || (size_t)st.st_size < image_offset) {
+    _error << "Cannot seek " << image << endl;
+    close(img_fd);
+    return -1;
+  }
+  len = st.st_size - image_offset;
+
+  _fd = open(_dev.c_str(), O_RDWR);
+  if (_fd < 0) {
+    _error << "Cannot open " << _dev << " for writing" << endl;
+    close(img_fd);
+    return -1;
+  }
+  if (ioctl(_fd, MEMGETINFO, &info) == 0) {
+    _is_mtd = true;
+    _dev_size = info.size;
+    _erase_size = info.erasesize;
+  } else {
+    // Not an MTD device, treat it as a file with the usual erase size.
+    struct stat dst;
+    if (fstat(_fd, &dst) < 0) {
+      _error << "Cannot stat " << _dev << endl;
+      goto out;
+    }
+    _dev_size = dst.st_size;
+    _erase_size = MTD_FLASH_FILE_ERASE_SIZE;
+  }
+  if (dev_offset + len > _dev_size) {
+    _error << image << " does not fit in " << _dev << endl;
+    goto out;
+  }
+
+  if (posix_memalign((void **)&cur, getpagesize(), _erase_size) ||
+      posix_memalign((void **)&data, getpagesize(), _erase_size)) {
+    _error << "Out of memory" << endl;
+    goto out;
+  }
+
+  first = dev_offset / _erase_size;
+  last = (dev_offset + len + _erase_size - 1) / _erase_size;
+  total = last - first;
+  {
+    string key = journal_key(st, image_offset, dev_offset);
+    done = journal_load(key);
+    if (done > total) {
+      done = 0;
+    }
+    if (progress) {
+      progress(done, skipped, total);
+    }
+
+    for (size_t b = first + done; b < last; b++) {
+      size_t start = b * _erase_size;
+      size_t blen = min(_erase_size, _dev_size - start);
+      // Part of the block the image covers.
+      size_t from = max(start, dev_offset);
+      size_t to = min(start + blen, dev_offset + len);
+
+      if (pread(_fd, cur, blen, start) != (ssize_t)blen) {
+        _error << "Reading " << _dev << " at 0x" << hex << start << dec
+               << " failed" << endl;
+        goto out;
+      }
+      bool partial = from != start || to != start + blen;
+
+      // The bytes outside of the image come from the saved copy if this
+      // block was being rewritten when the last update stopped.
+      if (!partial || !block_load(key, b, data, blen)) {
+        memcpy(data, cur, blen);
+      }
+      if (pread(img_fd, data + (from - start), to - from,
+                image_offset + (from - dev_offset)) != (ssize_t)(to - from)) {
+        _error << "Reading " << image << " failed" << endl;
+        goto out;
+      }
+
+      if (memcmp(data, cur, blen) == 0) {
+        skipped++;
+      } else if (partial && block_save(key, b, data, blen)) {
+        goto out;
+      } else if (write_block(start, data, cur, blen)) {
+        goto out;
+      }
+      done++;
+      if (done % MTD_FLASH_JOURNAL_INTERVAL == 0 && done < total) {
+        journal_save(key, done);
+      }
+      if (progress) {
+        progress(done, skipped, total);
+      }
+    }
+  }
+  if (_journal != "") {
+    remove(_journal.c_str());
+    remove((_journal + ".blk").c_str());
+  }
+  ret = 0;
+
+out:
+  free(cur);
+  free(data);
+  close(img_fd);
+  close(_fd);
+  _fd = -1;
+  return ret;
+}
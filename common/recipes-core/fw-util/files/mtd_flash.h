@@ -0,0 +1,65 @@
+#ifndef _MTD_FLASH_H_
+#define _MTD_FLASH_H_
+#include <string>
+#include <iostream>
+#include <functional>
+#include <cstdint>
+#include <sys/types.h>
+#include <sys/stat.h>
+
+// Erase blocks between two journal updates.
+#define MTD_FLASH_JOURNAL_INTERVAL  16
+// Erase block size assumed when the device is a plain file.
+#define MTD_FLASH_FILE_ERASE_SIZE   (64 * 1024)
+
+/*
+ * Writes an image to an MTD device one erase block at a time. A block is
+ * read first and only erased and rewritten if its content differs from
+ * the image; every block written is read back and compared. Bytes of the
+ * device outside of the range being written are preserved.
+ *
+ * Progress is recorded in a journal every MTD_FLASH_JOURNAL_INTERVAL
+ * blocks. Flashing the same image file (same size, mtime and inode) with
+ * the same offsets again resumes after the last recorded block. The
+ * journal is removed once the image has been written.
+ *
+ * The first and last blocks may be only partly covered by the image.
+ * Before one of them is erased, the block as it is to be written is saved
+ * next to the journal (journal + ".blk"), so a resumed update rebuilds the
+ * bytes outside of the image from the copy rather than from an erased block.
+ */
+class MtdFlash {
+  public:
+    // Erase blocks done and skipped as identical, out of total.
+    typedef std::function<void(size_t done, size_t skipped, size_t total)> Progress;
+
+  private:
+    std::string _dev;
+    std::string _journal;
+    std::ostream &_error;
+    int _fd;
+    bool _is_mtd;
+    size_t _dev_size;
+    size_t _erase_size;
+
+    int erase(size_t offset, size_t len);
+    int write_block(size_t offset, const uint8_t *data, uint8_t *verify, size_t len);
+    std::string journal_key(const struct stat &st, size_t image_offset, size_t dev_offset);
+    size_t journal_load(const std::string &key);
+    void journal_save(const std::string &key, size_t blocks);
+    bool block_load(const std::string &key, size_t block, uint8_t *buf, size_t len);
+    int block_save(const std::string &key, size_t block, const uint8_t *buf, size_t len);
+
+  public:
+    MtdFlash(const std::string &dev, const std::string &journal, std::ostream &error);
+    ~MtdFlash();
+
+    /*
+     * Write image, starting at image_offset, to the device at dev_offset.
+     * Returns 0 on success, -1 on failure (reported on the error stream).
+     */
+    int write(const std::string &image, size_t image_offset, size_t dev_offset,
+              Progress progress = nullptr);
+};
+
+#endif
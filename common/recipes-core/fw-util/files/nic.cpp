@@ -2,10 +2,11 @@
 #include <string>
 #include <cstring>
 #include <stdio.h>
+#include <openbmc/kv.h>
 #include "fw-util.h"
 
 #define NCSI_DATA_PAYLOAD 64
-#define NIC_FW_VER_PATH "/tmp/cache_store/nic_fw_ver"
+#define NIC_FW_VER_KEY "nic_fw_ver"
 
 using namespace std;
 
@@ -71,16 +72,12 @@ class NicComponent : public Component {
       char vendor[32]={0};
       uint8_t buf[NCSI_DATA_PAYLOAD]={0};
       uint32_t nic_mfg_id=0;
-      FILE *file = NULL;
       bool is_unknown_mfg_id = true;
       int current_nic;
 
-      file = fopen(NIC_FW_VER_PATH, "rb");
-      if (NULL == file) {
+      if (kv_get((char *)NIC_FW_VER_KEY, (char *)buf, NULL, 0)) {
         return FW_STATUS_FAILURE;
       }
-      fread(buf, sizeof(uint8_t), NCSI_DATA_PAYLOAD, file);
-      fclose(file);
       //get the manufcture id
       nic_mfg_id = (buf[35]<<24) + (buf[34]<<16) + (buf[33]<<8) + buf[32];
 
@@ -130,3 +130,10 @@ string System::lock_file(string &name)
 {
   return "/var/run/fw-util-" + name + ".lock";
 }
+
+// Kept on persistent storage so an update cut short by a reboot
+// can also be resumed.
+string System::flash_journal(string &dev)
+{
+  return "/mnt/data/fw-util-" + dev.substr(dev.rfind('/') + 1) + ".journal";
+}
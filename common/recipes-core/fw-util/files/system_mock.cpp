@@ -79,6 +79,11 @@ string System::lock_file(string &name)
   return "./fw-util-" + name + ".lock";
 }
 
+string System::flash_journal(string &dev)
+{
+  return "./fw-util-" + dev.substr(dev.rfind('/') + 1) + ".journal";
+}
+
 void System::set_update_ongoing(uint8_t fru_id, int timeo)
 {
 }
@@ -3,19 +3,19 @@
 #include <unistd.h>
 #include <cstdio>
 #include <cstring>
+#include <openbmc/kv.h>
 
 using namespace std;
 
 #define MAX_LINE_LENGTH 80
 #define TPM_DEV "/sys/class/tpm/tpm0"
 #define TPM_VERSION_LOCATION "/sys/class/tpm/tpm0/device/caps"
-#define TPM_VERSION_LOCATION_TMP "/tmp/cache_store/tpm_version_tmp"
+#define TPM_VERSION_KEY "tpm_fw_version"
 #define TPM_FW_VER_MATCH_STR "Firmware version: "
 
 int
 get_tpm_ver(char *ver) {
   FILE *fp = NULL;
-  FILE *fp_2 = NULL;
   char str[MAX_LINE_LENGTH] = {0};
   char *match = NULL;
 
@@ -25,59 +25,38 @@ get_tpm_ver(char *ver) {
     return FW_STATUS_NOT_SUPPORTED;
   }
 
-  //If TPM_VERSION_LOCATION_TMP has no TPM version cache file, then copy it from TPM driver node
-  //Read TPM version from driver node takes over 10 times longer than read from cached file
+  //Read TPM version from driver node takes over 10 times longer than read from cache
   //That's why we cache the TPM Version at the frist time of the query
-  if(access(TPM_VERSION_LOCATION_TMP, F_OK) == -1) {
-
-    //Open the TPM version node
-    fp = fopen(TPM_VERSION_LOCATION, "r");
-    if (fp == NULL){
-      syslog(LOG_WARNING, "TPM File:%s, Open Fail for Read.", TPM_VERSION_LOCATION);
-      return -1;
-    }
-
-    //Open the TPM version cache file
-    fp_2 = fopen(TPM_VERSION_LOCATION_TMP, "w");
-    if (fp_2 == NULL){
-      syslog(LOG_WARNING, "TPM File:%s, Open Fail for Write.", TPM_VERSION_LOCATION_TMP);
-      return -1;
-    }
-
-    //Copy the TPM version to cache line by line
-    while (fgets(str, sizeof(str), fp) != NULL) {
-      fputs(str, fp_2);
-    }
-    fclose(fp);
-    fclose(fp_2);
+  if (kv_get((char *)TPM_VERSION_KEY, ver, NULL, 0) == 0 && ver[0] != '\0') {
+    return 0;
   }
 
-  fp = fopen(TPM_VERSION_LOCATION_TMP, "r");
+  //Open the TPM version node
+  fp = fopen(TPM_VERSION_LOCATION, "r");
   if (fp == NULL){
-      syslog(LOG_WARNING, "TPM File:%s, Open Fail for Read.", TPM_VERSION_LOCATION_TMP);
-      return -1;
+    syslog(LOG_WARNING, "TPM File:%s, Open Fail for Read.", TPM_VERSION_LOCATION);
+    return -1;
   }
 
-  //Search for "Firmware version" string in TMP version cache file
+  //Search for "Firmware version" string in TPM version node
   while (fgets(str, sizeof(str), fp) != NULL) {
     match = strstr(str, TPM_FW_VER_MATCH_STR);
     if (match != NULL) {
       break;
     }
   }
+  fclose(fp);
 
-  //Doesn't find match for "Firmware version" string in TMP version cache file
-  //The reasone could be TPM version node is containing wrong data, or cache file is empty
-  //Remove the cache file for next query
+  //Doesn't find match for "Firmware version" string, the TPM version node
+  //is containing wrong data; nothing is cached so the next query retries
   if (match == NULL){
-    syslog(LOG_WARNING, "Doesn't find TPM Firmware version at: %s", TPM_VERSION_LOCATION_TMP);
-    remove(TPM_VERSION_LOCATION_TMP);
+    syslog(LOG_WARNING, "Doesn't find TPM Firmware version at: %s", TPM_VERSION_LOCATION);
     return -1;
   }
 
   //Offset "TPM_FW_VER_MATCH_STR" units, only return TPM version number
-  memcpy(ver, (match + strlen(TPM_FW_VER_MATCH_STR)), (strlen(str) - strlen(TPM_FW_VER_MATCH_STR)) );
-  fclose(fp);
+  strncpy(ver, match + strlen(TPM_FW_VER_MATCH_STR), MAX_VALUE_LEN - 1);
+  kv_set((char *)TPM_VERSION_KEY, ver, 0, 0);
 
   return 0;
 }
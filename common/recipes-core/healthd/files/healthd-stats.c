@@ -0,0 +1,156 @@
+/*
+ * Copyright 2018-present Facebook. All Rights Reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include "healthd-stats.h"
+
+#define SAMPLE(s, n) ((s)->samples[(n) % (s)->window])
+
+int
+hstats_init(hstats_t *s, const char *name, unsigned int window) {
+  memset(s, 0, sizeof(*s));
+  if (window == 0) {
+    window = 1;
+  }
+  s->name = name;
+  s->window = window;
+  s->alpha = 2.0 / (window + 1);
+  s->samples = calloc(window, sizeof(float));
+  s->minq.seq = calloc(window, sizeof(uint64_t));
+  s->maxq.seq = calloc(window, sizeof(uint64_t));
+  if (!s->samples || !s->minq.seq || !s->maxq.seq) {
+    free(s->samples);
+    free(s->minq.seq);
+    free(s->maxq.seq);
+    s->samples = NULL;
+    return -1;
+  }
+  return 0;
+}
+
+#define QUEUE_AT(s, q, i) ((q)->seq[((q)->head + (i)) % (s)->window])
+
+/*
+ * Push sample n, dropping the samples it outlives: for the max queue,
+ * those not greater than it; for the min queue, those not less.
+ */
+static void
+queue_push(hstats_t *s, hstats_queue_t *q, uint64_t n, bool max) {
+  float v = SAMPLE(s, n), back;
+
+  while (q->len) {
+    back = SAMPLE(s, QUEUE_AT(s, q, q->len - 1));
+    if (max ? back > v : back < v) {
+      break;
+    }
+    q->len--;
+  }
+  QUEUE_AT(s, q, q->len) = n;
+  q->len++;
+}
+
+/* Drop sample n from the front if it has left the window */
+static void
+queue_expire(hstats_t *s, hstats_queue_t *q, uint64_t n) {
+  if (q->len && QUEUE_AT(s, q, 0) == n) {
+    q->head = (q->head + 1) % s->window;
+    q->len--;
+  }
+}
+
+void
+hstats_add(hstats_t *s, float value) {
+  struct timespec now;
+  uint64_t n = s->count;
+  double dt;
+  unsigned int i;
+
+  if (!s->samples) {
+    return;
+  }
+  clock_gettime(CLOCK_MONOTONIC, &now);
+
+  if (n >= s->window) {
+    /* Sample n - window leaves as n takes its slot */
+    queue_expire(s, &s->minq, n - s->window);
+    queue_expire(s, &s->maxq, n - s->window);
+    s->sum -= SAMPLE(s, n);
+  }
+  SAMPLE(s, n) = value;
+  s->sum += value;
+  queue_push(s, &s->minq, n, false);
+  queue_push(s, &s->maxq, n, true);
+
+  if (n == 0) {
+    s->ewma = value;
+    s->rate = 0;
+  } else {
+    s->ewma += s->alpha * (value - s->ewma);
+    dt = (now.tv_sec - s->last_ts.tv_sec) +
+         (now.tv_nsec - s->last_ts.tv_nsec) / 1e9;
+    s->rate = dt > 0 ? (value - s->last) / dt : 0;
+  }
+  s->last = value;
+  s->last_ts = now;
+  s->count++;
+
+  /* Resum once per window so rounding errors do not pile up */
+  if (s->count % s->window == 0) {
+    s->sum = 0;
+    for (i = 0; i < s->window; i++) {
+      s->sum += s->samples[i];
+    }
+  }
+}
+
+/* True once the window has been filled */
+bool
+hstats_full(const hstats_t *s) {
+  return s->count >= s->window;
+}
+
+float
+hstats_mean(const hstats_t *s) {
+  uint64_t n = s->count < s->window ? s->count : s->window;
+
+  return n ? s->sum / n : 0;
+}
+
+float
+hstats_min(const hstats_t *s) {
+  return s->minq.len ? SAMPLE(s, s->minq.seq[s->minq.head]) : 0;
+}
+
+float
+hstats_max(const hstats_t *s) {
+  return s->maxq.len ? SAMPLE(s, s->maxq.seq[s->maxq.head]) : 0;
+}
+
+json_t *
+hstats_json(const hstats_t *s) {
+  return json_pack("{s:f, s:f, s:f, s:f, s:f, s:f, s:I, s:i}",
+                   "last", (double)s->last,
+                   "mean", (double)hstats_mean(s),
+                   "ewma", (double)s->ewma,
+                   "min", (double)hstats_min(s),
+                   "max", (double)hstats_max(s),
+                   "rate", (double)s->rate,
+                   "samples", (json_int_t)s->count,
+                   "window", (int)s->window);
+}
@@ -0,0 +1,65 @@
+/*
+ * Copyright 2018-present Facebook. All Rights Reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+#ifndef __HEALTHD_STATS_H__
+#define __HEALTHD_STATS_H__
+
+/*
+ * Streaming statistics over a sliding window of samples.
+ *
+ * Adding a sample is O(1): the mean comes from a running sum, the minimum
+ * and maximum from monotonic queues of the samples still in the window
+ * (amortized O(1)). An EWMA and the rate of change between the last two
+ * samples are kept alongside.
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <time.h>
+#include <jansson.h>
+
+typedef struct {
+  uint64_t *seq;          /* Ring of sample numbers, values monotonic */
+  unsigned int head;
+  unsigned int len;
+} hstats_queue_t;
+
+typedef struct {
+  const char *name;
+  unsigned int window;
+  float *samples;         /* Ring of the last window samples */
+  uint64_t count;         /* Samples added so far */
+  double sum;             /* Of the samples in the window */
+  float ewma;
+  float alpha;
+  float last;
+  float rate;             /* Change per second between the last two samples */
+  struct timespec last_ts;
+  hstats_queue_t minq;
+  hstats_queue_t maxq;
+} hstats_t;
+
+int hstats_init(hstats_t *s, const char *name, unsigned int window);
+void hstats_add(hstats_t *s, float value);
+bool hstats_full(const hstats_t *s);
+float hstats_mean(const hstats_t *s);
+float hstats_min(const hstats_t *s);
+float hstats_max(const hstats_t *s);
+json_t *hstats_json(const hstats_t *s);
+
+#endif /* __HEALTHD_STATS_H__ */
@@ -29,6 +29,10 @@
 #include <fcntl.h>
 #include <sys/file.h>
 #include <sys/mman.h>
+#include <sys/epoll.h>
+#include <sys/timerfd.h>
+#include <sys/socket.h>
+#include <time.h>
 #include <pthread.h>
 #include <jansson.h>
 #include <stdbool.h>
@@ -40,7 +44,9 @@
 #include <openbmc/kv.h>
 #include <openbmc/obmc-i2c.h>
 #include <openbmc/vbs.h>
+#include <openbmc/obmc-stats.h>
 #include <signal.h>
+#include "healthd-stats.h"
 
 #define I2C_BUS_NUM            14
 #define AST_I2C_BASE           0x1E78A000  /* I2C */
@@ -59,6 +65,7 @@
 #define DEFAULT_MONITOR_INTERVAL 1
 #define HEALTHD_MAX_RETRY 10
 #define CONFIG_PATH "/etc/healthd-config.json"
+#define HEALTHD_STATS_SOCK "/var/run/healthd_stats.sock"
 
 #define AST_MCR_BASE 0x1e6e0000 // Base Address of SDRAM Memory Controller
 #define INTR_CTRL_STS_OFFSET 0x50 // Interrupt Control/Status Register
@@ -118,6 +125,8 @@ struct threshold_s {
   int log_level;
   bool reboot;
   bool bmc_error_trigger;
+  unsigned int confirm;   /* Samples over the value needed to assert */
+  unsigned int pending;   /* Samples over the value so far */
 };
 
 enum {
@@ -195,6 +204,15 @@ static bool vboot_state_check = false;
 /* BMC time stamp enabled */
 static bool bmc_timestamp_enabled = false;
 
+/* Statistics of the monitored metrics, served on HEALTHD_STATS_SOCK */
+static hstats_t cpu_stats;
+static hstats_t mem_stats;
+static hstats_t recov_ecc_stats;
+static hstats_t unrec_ecc_stats;
+static hstats_t *all_stats[] = {&cpu_stats, &mem_stats, &recov_ecc_stats, &unrec_ecc_stats};
+
+static void reboot_deferred(void);
+
 static void
 initialize_threshold(const char *target, json_t *thres, struct threshold_s *t) {
   json_t *tmp;
@@ -228,6 +246,11 @@ initialize_threshold(const char *target, json_t *thres, struct threshold_s *t) {
   if (tmp && json_is_real(tmp)) {
     t->hysteresis = json_real_value(tmp);
   }
+  t->confirm = 1;
+  tmp = json_object_get(thres, "confirm");
+  if (tmp && json_is_integer(tmp) && json_integer_value(tmp) > 1) {
+    t->confirm = json_integer_value(tmp);
+  }
   tmp = json_object_get(thres, "action");
   if (!tmp || !json_is_array(tmp)) {
     return;
@@ -557,8 +580,14 @@ static void threshold_assert_check(const char *target, float value, struct thres
 
   struct sysinfo info;
 
-  if (!thres->asserted && value >= thres->value) {
+  if (value < thres->value) {
+    thres->pending = 0;
+    return;
+  }
+  /* Only assert once the value stayed over for confirm samples */
+  if (!thres->asserted && ++thres->pending >= thres->confirm) {
     thres->asserted = true;
+    thres->pending = 0;
     if (thres->log) {
       syslog(thres->log_level, "ASSERT: %s (%.2f%%) exceeds the threshold (%.2f%%).\n", target, value, thres->value);
     }
@@ -566,8 +595,9 @@ static void threshold_assert_check(const char *target, float value, struct thres
       sysinfo(&info);
       syslog(thres->log_level, "Rebooting BMC; latest uptime: %ld sec", info.uptime);
 
-      sleep(1);
-      reboot(RB_AUTOBOOT);
+      /* Give syslog a second to get the logs out */
+      reboot_deferred();
+      return;
     }
     if (thres->bmc_error_trigger) {
       pthread_mutex_lock(&global_error_mutex);
@@ -683,18 +713,206 @@ initilize_all_kv() {
   pal_set_def_key_value();
 }
 
-static void *
-hb_handler() {
-  while(1) {
-    /* Turn ON the HB Led*/
-    pal_set_hb_led(1);
-    msleep(hb_interval);
+/*
+ * Monitors run from one epoll loop. Each has a timerfd; all timers count
+ * from the same start time, so monitors with the same interval expire,
+ * and are served, in the same wakeup.
+ */
+struct monitor_s;
+typedef bool (*monitor_fn)(struct monitor_s *m);
+
+struct monitor_s {
+  const char *name;
+  monitor_fn poll;      /* Returns false to stop the monitor */
+  unsigned int interval_ms;
+  int fd;
+  bool listener;        /* fd is a listening socket, not a timerfd */
+};
+
+#define HEALTHD_MAX_EVENTS 16
 
-    /* Turn OFF the HB led */
-    pal_set_hb_led(0);
-    msleep(hb_interval);
+static int epoll_fd = -1;
+static struct timespec monitor_epoch;
+
+static void
+timespec_add_ms(struct timespec *ts, unsigned int ms) {
+  ts->tv_sec += ms / 1000;
+  ts->tv_nsec += (long)(ms % 1000) * 1000000;
+  if (ts->tv_nsec >= 1000000000) {
+    ts->tv_sec++;
+    ts->tv_nsec -= 1000000000;
   }
-  return NULL;
+}
+
+static int
+monitor_arm(struct monitor_s *m, unsigned int interval_ms, bool from_now) {
+  struct itimerspec its;
+
+  if (interval_ms == 0) {
+    interval_ms = 1;
+  }
+  m->interval_ms = interval_ms;
+  if (from_now) {
+    clock_gettime(CLOCK_MONOTONIC, &its.it_value);
+    timespec_add_ms(&its.it_value, interval_ms);
+  } else {
+    /* First run right away, as the monitor threads used to */
+    its.it_value = monitor_epoch;
+  }
+  its.it_interval.tv_sec = interval_ms / 1000;
+  its.it_interval.tv_nsec = (long)(interval_ms % 1000) * 1000000;
+
+  return timerfd_settime(m->fd, TFD_TIMER_ABSTIME, &its, NULL);
+}
+
+static void
+monitor_stop(struct monitor_s *m) {
+  epoll_ctl(epoll_fd, EPOLL_CTL_DEL, m->fd, NULL);
+  close(m->fd);
+  m->fd = -1;
+}
+
+/* Add the monitor to the loop, with its timer not armed yet */
+static int
+monitor_add(struct monitor_s *m) {
+  struct epoll_event ev;
+
+  if (!m->listener) {
+    m->fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+  }
+  if (m->fd < 0) {
+    syslog(LOG_WARNING, "%s: no fd for %s, errno=%d", __func__, m->name, errno);
+    return -1;
+  }
+  ev.events = EPOLLIN;
+  ev.data.ptr = m;
+  if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, m->fd, &ev) < 0) {
+    syslog(LOG_WARNING, "%s: adding %s failed, errno=%d", __func__, m->name, errno);
+    close(m->fd);
+    m->fd = -1;
+    return -1;
+  }
+  return 0;
+}
+
+static int
+monitor_start(struct monitor_s *m) {
+  if (monitor_add(m) < 0) {
+    return -1;
+  }
+  if (monitor_arm(m, m->interval_ms, false) < 0) {
+    syslog(LOG_WARNING, "%s: arming %s failed, errno=%d", __func__, m->name, errno);
+    monitor_stop(m);
+    return -1;
+  }
+  return 0;
+}
+
+static void
+monitor_loop(void) {
+  struct epoll_event events[HEALTHD_MAX_EVENTS];
+  struct monitor_s *m;
+  uint64_t expired;
+  int i, n;
+
+  while (1) {
+    n = epoll_wait(epoll_fd, events, HEALTHD_MAX_EVENTS, -1);
+    if (n < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      syslog(LOG_CRIT, "%s: epoll_wait failed, errno=%d", __func__, errno);
+      return;
+    }
+    for (i = 0; i < n; i++) {
+      m = (struct monitor_s *)events[i].data.ptr;
+      /* Ticks missed while busy are not made up for */
+      if (!m->listener &&
+          read(m->fd, &expired, sizeof(expired)) != sizeof(expired)) {
+        continue;
+      }
+      if (!m->poll(m)) {
+        monitor_stop(m);
+      }
+    }
+  }
+}
+
+static bool
+reboot_poll(struct monitor_s *m) {
+  reboot(RB_AUTOBOOT);
+  return false;
+}
+
+/* Reboot from the loop a second from now, without blocking it */
+static void
+reboot_deferred(void) {
+  static struct monitor_s reboot_mon = {"reboot", reboot_poll, 0, -1};
+
+  if (reboot_mon.fd >= 0) {
+    /* Already on its way */
+    return;
+  }
+  if (monitor_add(&reboot_mon) < 0 ||
+      monitor_arm(&reboot_mon, 1000, true) < 0) {
+    sleep(1);
+    reboot(RB_AUTOBOOT);
+  }
+}
+
+/* Send a JSON snapshot of the current statistics to a client */
+static bool
+stats_poll(struct monitor_s *m) {
+  json_t *snap, *metrics;
+  struct sysinfo info;
+  char *str;
+  size_t i;
+  int cli;
+
+  if ((cli = obmc_stats_accept(m->fd)) < 0) {
+    return true;
+  }
+
+  sysinfo(&info);
+  snap = json_object();
+  metrics = json_object();
+  for (i = 0; i < sizeof(all_stats) / sizeof(all_stats[0]); i++) {
+    if (all_stats[i]->samples) {
+      json_object_set_new(metrics, all_stats[i]->name, hstats_json(all_stats[i]));
+    }
+  }
+  json_object_set_new(snap, "uptime", json_integer(info.uptime));
+  json_object_set_new(snap, "bmc_health", json_integer(bmc_health));
+  json_object_set_new(snap, "metrics", metrics);
+
+  str = json_dumps(snap, JSON_INDENT(2));
+  json_decref(snap);
+  if (str) {
+    obmc_stats_send(cli, str, strlen(str));
+    free(str);
+  } else {
+    close(cli);
+  }
+  return true;
+}
+
+static int
+stats_listen(struct monitor_s *m) {
+  m->fd = obmc_stats_listen(HEALTHD_STATS_SOCK, SOCK_NONBLOCK);
+  if (m->fd < 0) {
+    return -1;
+  }
+  return monitor_add(m);
+}
+
+static bool
+hb_poll(struct monitor_s *m) {
+  static int led = 0;
+
+  /* Toggle the HB Led */
+  led = !led;
+  pal_set_hb_led(led);
+  return true;
 }
 
 static void *
@@ -722,168 +940,168 @@ watchdog_handler() {
   return NULL;
 }
 
-static void *
-i2c_mon_handler() {
-  char i2c_bus_device[16];
-  int dev;
-  int bus_status = 0;
-  int asserted_flag[I2C_BUS_NUM] = {};
+static void
+i2c_bus_check(int i, int bus_status, int *asserted_flag) {
   bool assert_handle = 0;
+
+  if (bus_status == 0) {
+    /* Bus status is normal */
+    if (*asserted_flag != 0) {
+      *asserted_flag = 0;
+      syslog(LOG_CRIT, "DEASSERT: I2C(%d) Bus recoveried. (I2C bus index base 0)", i);
+      pal_i2c_crash_deassert_handle(i);
+    }
+    return;
+  }
+
+  /* Check each case */
+  if (GETBIT(bus_status, BUS_LOCK_RECOVER_ERROR)
+      && !GETBIT(*asserted_flag, BUS_LOCK_RECOVER_ERROR)) {
+    *asserted_flag = SETBIT(*asserted_flag, BUS_LOCK_RECOVER_ERROR);
+    syslog(LOG_CRIT, "ASSERT: I2C(%d) bus is locked (Master Lock or Slave Clock Stretch). "
+                     "Recovery error. (I2C bus index base 0)", i);
+    assert_handle = 1;
+  }
+  bus_status = CLEARBIT(bus_status, BUS_LOCK_RECOVER_ERROR);
+  if (GETBIT(bus_status, BUS_LOCK_RECOVER_TIMEOUT)
+      && !GETBIT(*asserted_flag, BUS_LOCK_RECOVER_TIMEOUT)) {
+    *asserted_flag = SETBIT(*asserted_flag, BUS_LOCK_RECOVER_TIMEOUT);
+    syslog(LOG_CRIT, "ASSERT: I2C(%d) bus is locked (Master Lock or Slave Clock Stretch). "
+                     "Recovery timed out. (I2C bus index base 0)", i);
+    assert_handle = 1;
+  }
+  bus_status = CLEARBIT(bus_status, BUS_LOCK_RECOVER_TIMEOUT);
+  if (GETBIT(bus_status, BUS_LOCK_RECOVER_SUCCESS)) {
+    syslog(LOG_CRIT, "I2C(%d) bus had been locked (Master Lock or Slave Clock Stretch) "
+                     "and has been recoveried successfully. (I2C bus index base 0)", i);
+  }
+  bus_status = CLEARBIT(bus_status, BUS_LOCK_RECOVER_SUCCESS);
+  if (GETBIT(bus_status, SLAVE_DEAD_RECOVER_ERROR)
+      && !GETBIT(*asserted_flag, SLAVE_DEAD_RECOVER_ERROR)) {
+    *asserted_flag = SETBIT(*asserted_flag, SLAVE_DEAD_RECOVER_ERROR);
+    syslog(LOG_CRIT, "ASSERT: I2C(%d) Slave is dead (SDA keeps low). "
+                     "Bus recovery error. (I2C bus index base 0)", i);
+    assert_handle = 1;
+  }
+  bus_status = CLEARBIT(bus_status, SLAVE_DEAD_RECOVER_ERROR);
+  if (GETBIT(bus_status, SLAVE_DEAD_RECOVER_TIMEOUT)
+      && !GETBIT(*asserted_flag, SLAVE_DEAD_RECOVER_TIMEOUT)) {
+    *asserted_flag = SETBIT(*asserted_flag, SLAVE_DEAD_RECOVER_TIMEOUT);
+    syslog(LOG_CRIT, "ASSERT: I2C(%d) Slave is dead (SDAs keep low). "
+                     "Bus recovery timed out. (I2C bus index base 0)", i);
+    assert_handle = 1;
+  }
+  bus_status = CLEARBIT(bus_status, SLAVE_DEAD_RECOVER_TIMEOUT);
+  if (GETBIT(bus_status, SLAVE_DEAD_RECOVER_SUCCESS)) {
+    syslog(LOG_CRIT, "I2C(%d) Slave was dead. and bus has been recoveried successfully. "
+                     "(I2C bus index base 0)", i);
+  }
+  bus_status = CLEARBIT(bus_status, SLAVE_DEAD_RECOVER_SUCCESS);
+  /* Check if any undefined bit remain in bus_status */
+  if ((bus_status != 0) && !GETBIT(*asserted_flag, UNDEFINED_CASE)) {
+    *asserted_flag = SETBIT(*asserted_flag, 8);
+    syslog(LOG_CRIT, "ASSERT: I2C(%d) Undefined case. (I2C bus index base 0)", i);
+    assert_handle = 1;
+  }
+
+  if (assert_handle) {
+    pal_i2c_crash_assert_handle(i);
+  }
+}
+
+static bool
+i2c_mon_poll(struct monitor_s *m) {
+  static int i2c_fd[I2C_BUS_NUM] = {[0 ... I2C_BUS_NUM - 1] = -1};
+  static int asserted_flag[I2C_BUS_NUM] = {};
+  char i2c_bus_device[16];
   int i;
 
-  while (1) {
-    for (i = 0; i < I2C_BUS_NUM; i++) {
-      if (!ast_i2c_dev_offset[i].enabled) {
-        continue;
-      }
+  for (i = 0; i < I2C_BUS_NUM; i++) {
+    if (!ast_i2c_dev_offset[i].enabled) {
+      continue;
+    }
+    /* Bus devices stay open between checks */
+    if (i2c_fd[i] < 0) {
       sprintf(i2c_bus_device, "/dev/i2c-%d", i);
-      dev = open(i2c_bus_device, O_RDWR);
-      if (dev < 0) {
+      i2c_fd[i] = open(i2c_bus_device, O_RDWR | O_CLOEXEC);
+      if (i2c_fd[i] < 0) {
         syslog(LOG_DEBUG, "%s(): open() failed", __func__);
         continue;
       }
-      bus_status = i2c_smbus_status(dev);
-      close(dev);
-
-      assert_handle = 0;
-      if (bus_status == 0) {
-        /* Bus status is normal */
-        if (asserted_flag[i] != 0) {
-          asserted_flag[i] = 0;
-          syslog(LOG_CRIT, "DEASSERT: I2C(%d) Bus recoveried. (I2C bus index base 0)", i);
-          pal_i2c_crash_deassert_handle(i);
-        }
-      } else {
-        /* Check each case */
-        if (GETBIT(bus_status, BUS_LOCK_RECOVER_ERROR)
-            && !GETBIT(asserted_flag[i], BUS_LOCK_RECOVER_ERROR)) {
-          asserted_flag[i] = SETBIT(asserted_flag[i], BUS_LOCK_RECOVER_ERROR);
-          syslog(LOG_CRIT, "ASSERT: I2C(%d) bus is locked (Master Lock or Slave Clock Stretch). "
-                           "Recovery error. (I2C bus index base 0)", i);
-          assert_handle = 1;
-        }
-        bus_status = CLEARBIT(bus_status, BUS_LOCK_RECOVER_ERROR);
-        if (GETBIT(bus_status, BUS_LOCK_RECOVER_TIMEOUT)
-            && !GETBIT(asserted_flag[i], BUS_LOCK_RECOVER_TIMEOUT)) {
-          asserted_flag[i] = SETBIT(asserted_flag[i], BUS_LOCK_RECOVER_TIMEOUT);
-          syslog(LOG_CRIT, "ASSERT: I2C(%d) bus is locked (Master Lock or Slave Clock Stretch). "
-                           "Recovery timed out. (I2C bus index base 0)", i);
-          assert_handle = 1;
-        }
-        bus_status = CLEARBIT(bus_status, BUS_LOCK_RECOVER_TIMEOUT);
-        if (GETBIT(bus_status, BUS_LOCK_RECOVER_SUCCESS)) {
-          syslog(LOG_CRIT, "I2C(%d) bus had been locked (Master Lock or Slave Clock Stretch) "
-                           "and has been recoveried successfully. (I2C bus index base 0)", i);
-        }
-        bus_status = CLEARBIT(bus_status, BUS_LOCK_RECOVER_SUCCESS);
-        if (GETBIT(bus_status, SLAVE_DEAD_RECOVER_ERROR)
-            && !GETBIT(asserted_flag[i], SLAVE_DEAD_RECOVER_ERROR)) {
-          asserted_flag[i] = SETBIT(asserted_flag[i], SLAVE_DEAD_RECOVER_ERROR);
-          syslog(LOG_CRIT, "ASSERT: I2C(%d) Slave is dead (SDA keeps low). "
-                           "Bus recovery error. (I2C bus index base 0)", i);
-          assert_handle = 1;
-        }
-        bus_status = CLEARBIT(bus_status, SLAVE_DEAD_RECOVER_ERROR);
-        if (GETBIT(bus_status, SLAVE_DEAD_RECOVER_TIMEOUT)
-            && !GETBIT(asserted_flag[i], SLAVE_DEAD_RECOVER_TIMEOUT)) {
-          asserted_flag[i] = SETBIT(asserted_flag[i], SLAVE_DEAD_RECOVER_TIMEOUT);
-          syslog(LOG_CRIT, "ASSERT: I2C(%d) Slave is dead (SDAs keep low). "
-                           "Bus recovery timed out. (I2C bus index base 0)", i);
-          assert_handle = 1;
-        }
-        bus_status = CLEARBIT(bus_status, SLAVE_DEAD_RECOVER_TIMEOUT);
-        if (GETBIT(bus_status, SLAVE_DEAD_RECOVER_SUCCESS)) {
-          syslog(LOG_CRIT, "I2C(%d) Slave was dead. and bus has been recoveried successfully. "
-                           "(I2C bus index base 0)", i);
-        }
-        bus_status = CLEARBIT(bus_status, SLAVE_DEAD_RECOVER_SUCCESS);
-        /* Check if any undefined bit remain in bus_status */
-        if ((bus_status != 0) && !GETBIT(asserted_flag[i], UNDEFINED_CASE)) {
-          asserted_flag[i] = SETBIT(asserted_flag[i], 8);
-          syslog(LOG_CRIT, "ASSERT: I2C(%d) Undefined case. (I2C bus index base 0)", i);
-          assert_handle = 1;
-        }
+    }
+    i2c_bus_check(i, i2c_smbus_status(i2c_fd[i]), &asserted_flag[i]);
+  }
+  return true;
+}
 
-        if (assert_handle) {
-          pal_i2c_crash_assert_handle(i);
-        }
-      }
+/* Read a /proc file from the start through an fd kept open */
+static int
+proc_read(int *fd, const char *path, char *buf, size_t size) {
+  ssize_t n;
+
+  if (*fd < 0) {
+    *fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (*fd < 0) {
+      return -1;
     }
-    sleep(30);
   }
-  return NULL;
+  n = pread(*fd, buf, size - 1, 0);
+  if (n <= 0) {
+    close(*fd);
+    *fd = -1;
+    return -1;
+  }
+  buf[n] = '\0';
+  return 0;
 }
 
-static void *
-CPU_usage_monitor() {
+static bool
+CPU_usage_poll(struct monitor_s *m) {
+  static int fd = -1;
+  static unsigned long long pre_total = 0, pre_idle = 0;
+  static int retry = 0;
   unsigned long long user, nice, system, idle, iowait, irq, softirq, steal, guest, guest_nice;
-  unsigned long long total_diff, idle_diff, non_idle, idle_time = 0, total = 0, pre_total = 0, pre_idle = 0;
+  unsigned long long total_diff, idle_diff, non_idle, idle_time = 0, total = 0;
   char cpu[CPU_NAME_LENGTH] = {0};
-  int i, ready_flag = 0, timer = 0, retry = 0;
-  float cpu_util_avg, cpu_util_total;
-  float cpu_utilization[cpu_window_size];
-  FILE *fp;
-
-  memset(cpu_utilization, 0, sizeof(float) * cpu_window_size);
-
-  while (1) {
-
-    if (retry > HEALTHD_MAX_RETRY) {
+  char buf[256];
+
+  // Get CPU statistics. Time unit: jiffies
+  if (proc_read(&fd, CPU_INFO_PATH, buf, sizeof(buf)) ||
+      sscanf(buf, "%9s %llu %llu %llu %llu %llu %llu %llu %llu %llu %llu",
+             cpu, &user, &nice, &system, &idle, &iowait, &irq, &softirq,
+             &steal, &guest, &guest_nice) != 11) {
+    syslog(LOG_WARNING, "Failed to get CPU statistics.\n");
+    if (++retry > HEALTHD_MAX_RETRY) {
       syslog(LOG_CRIT, "Cannot get CPU statistics. Stop %s\n", __func__);
-      return NULL;
+      return false;
     }
+    return true;
+  }
+  retry = 0;
 
-    // Get CPU statistics. Time unit: jiffies
-    fp = fopen(CPU_INFO_PATH, "r");
-    if(!fp) {
-      syslog(LOG_WARNING, "Failed to get CPU statistics.\n");
-      retry++;
-      continue;
-    }
-    retry = 0;
-
-    fscanf(fp, "%s %llu %llu %llu %llu %llu %llu %llu %llu %llu %llu",
-                cpu, &user, &nice, &system, &idle, &iowait, &irq, &softirq, &steal, &guest, &guest_nice);
-
-    fclose(fp);
-
-    timer %= cpu_window_size;
-
-    // Need more data to cacluate the avg. utilization. We average 60 records here.
-    if (timer == (cpu_window_size-1) && !ready_flag)
-      ready_flag = 1;
-
-
-    // guset and guest_nice are already accounted in user and nice so they are not included in total caculation
-    idle_time = idle + iowait;
-    non_idle = user + nice + system + irq + softirq + steal;
-    total = idle_time + non_idle;
-
-    // For runtime caculation, we need to take into account previous value.
-    total_diff = total - pre_total;
-    idle_diff = idle_time - pre_idle;
+  // guset and guest_nice are already accounted in user and nice so they are not included in total caculation
+  idle_time = idle + iowait;
+  non_idle = user + nice + system + irq + softirq + steal;
+  total = idle_time + non_idle;
 
-    // These records are used to caculate the avg. utilization.
-    cpu_utilization[timer] = (float) (total_diff - idle_diff)/total_diff;
+  // For runtime caculation, we need to take into account previous value.
+  total_diff = total - pre_total;
+  idle_diff = idle_time - pre_idle;
 
-    // Start to average the cpu utilization
-    if (ready_flag) {
-      cpu_util_total = 0;
-      for (i=0; i<cpu_window_size; i++) {
-        cpu_util_total += cpu_utilization[i];
-      }
-      cpu_util_avg = (cpu_util_total/cpu_window_size) * 100.0;
-      threshold_check(cpu_monitor_name, cpu_util_avg, cpu_threshold, cpu_threshold_num);
-    }
+  // Record current value for next caculation
+  pre_total = total;
+  pre_idle  = idle_time;
 
-    // Record current value for next caculation
-    pre_total = total;
-    pre_idle  = idle_time;
+  if (total_diff == 0) {
+    return true;
+  }
+  hstats_add(&cpu_stats, (float)(total_diff - idle_diff) * 100.0 / total_diff);
 
-    timer++;
-    sleep(cpu_monitor_interval);
+  // Need a full window of records to check the avg. utilization
+  if (hstats_full(&cpu_stats)) {
+    threshold_check(cpu_monitor_name, hstats_mean(&cpu_stats), cpu_threshold, cpu_threshold_num);
   }
-  return NULL;
+  return true;
 }
 
 static int set_panic_on_oom(void) {
@@ -920,165 +1138,136 @@ static int set_panic_on_oom(void) {
   return 0;
 }
 
-static void *
-memory_usage_monitor() {
+static bool
+memory_usage_poll(struct monitor_s *m) {
+  static int retry = 0;
   struct sysinfo s_info;
-  int i, error, timer = 0, ready_flag = 0, retry = 0;
-  float mem_util_avg, mem_util_total;
-  float mem_utilization[mem_window_size];
-
-  memset(mem_utilization, 0, sizeof(float) * mem_window_size);
+  int error;
 
-  if (mem_enable_panic) {
-    set_panic_on_oom();
-  }
-
-  while (1) {
-
-    if (retry > HEALTHD_MAX_RETRY) {
+  // Get sys info
+  error = sysinfo(&s_info);
+  if (error) {
+    syslog(LOG_WARNING, "%s Failed to get sys info. Error: %d\n", __func__, error);
+    if (++retry > HEALTHD_MAX_RETRY) {
       syslog(LOG_CRIT, "Cannot get sysinfo. Stop the %s\n", __func__);
-      return NULL;
-    }
-
-    timer %= mem_window_size;
-
-    // Need more data to cacluate the avg. utilization. We average 60 records here.
-    if (timer == (mem_window_size-1) && !ready_flag)
-      ready_flag = 1;
-
-    // Get sys info
-    error = sysinfo(&s_info);
-    if (error) {
-      syslog(LOG_WARNING, "%s Failed to get sys info. Error: %d\n", __func__, error);
-      retry++;
-      continue;
+      return false;
     }
-    retry = 0;
-
-    // These records are used to caculate the avg. utilization.
-    mem_utilization[timer] = (float) (s_info.totalram - s_info.freeram)/s_info.totalram;
-
-    // Start to average the memory utilization
-    if (ready_flag) {
-      mem_util_total = 0;
-      for (i=0; i<mem_window_size; i++)
-        mem_util_total += mem_utilization[i];
-
-      mem_util_avg = (mem_util_total/mem_window_size) * 100.0;
+    return true;
+  }
+  retry = 0;
 
-      threshold_check(mem_monitor_name, mem_util_avg, mem_threshold, mem_threshold_num);
-    }
+  hstats_add(&mem_stats, (float)(s_info.totalram - s_info.freeram) * 100.0 / s_info.totalram);
 
-    timer++;
-    sleep(mem_monitor_interval);
+  // Need a full window of records to check the avg. utilization
+  if (hstats_full(&mem_stats)) {
+    threshold_check(mem_monitor_name, hstats_mean(&mem_stats), mem_threshold, mem_threshold_num);
   }
-  return NULL;
+  return true;
 }
 
-// Thread to monitor the ECC counter
-static void *
-ecc_mon_handler() {
-  uint32_t mcr_fd = 0;
+// Monitor the ECC counter; the memory controller stays mapped
+static bool
+ecc_mon_poll(struct monitor_s *m) {
+  static void *mcr_base_addr = NULL;
+  static int retry_err = 0;
   uint32_t ecc_status = 0;
   uint32_t unrecover_ecc_err_addr = 0;
   uint32_t recover_ecc_err_addr = 0;
   uint16_t ecc_recoverable_error_counter = 0;
   uint8_t ecc_unrecoverable_error_counter = 0;
-  void *mcr_base_addr;
   void *mcr50_addr;
   void *mcr58_addr;
   void *mcr5c_addr;
-  int retry_err = 0;
-
-  while (1) {
-    mcr_fd = open("/dev/mem", O_RDWR | O_SYNC );
-    if (mcr_fd < 0) {
-      // In case of error opening the file, sleep for 2 sec and retry.
-      // During continuous failures, log the error every 20 minutes.
-      sleep(2);
+  int mcr_fd;
+
+  if (!mcr_base_addr) {
+    mcr_fd = open("/dev/mem", O_RDWR | O_SYNC | O_CLOEXEC);
+    if (mcr_fd >= 0) {
+      mcr_base_addr = mmap(NULL, PAGE_SIZE, PROT_READ|PROT_WRITE, MAP_SHARED, mcr_fd,
+          AST_MCR_BASE);
+      close(mcr_fd);
+      if (mcr_base_addr == MAP_FAILED) {
+        mcr_base_addr = NULL;
+      }
+    }
+    if (!mcr_base_addr) {
+      // During continuous failures, log the error every 600 attempts.
       if (++retry_err >= 600) {
-        syslog(LOG_ERR, "%s - cannot open /dev/mem", __func__);
+        syslog(LOG_ERR, "%s - cannot map /dev/mem", __func__);
         retry_err = 0;
       }
-      continue;
+      return true;
     }
-
     retry_err = 0;
+  }
 
-    mcr_base_addr = mmap(NULL, PAGE_SIZE, PROT_READ|PROT_WRITE, MAP_SHARED, mcr_fd,
-        AST_MCR_BASE);
-    mcr50_addr = (char*)mcr_base_addr + INTR_CTRL_STS_OFFSET;
-    ecc_status = *(volatile uint32_t*) mcr50_addr;
-    if (ecc_addr_log) {
-      mcr58_addr = (char*)mcr_base_addr + ADDR_FIRST_UNRECOVER_ECC_OFFSET;
-      unrecover_ecc_err_addr = *(volatile uint32_t*) mcr58_addr;
-      mcr5c_addr = (char*)mcr_base_addr + ADDR_LAST_RECOVER_ECC_OFFSET;
-      recover_ecc_err_addr = *(volatile uint32_t*) mcr5c_addr;
-    }
-    munmap(mcr_base_addr, PAGE_SIZE);
-    close(mcr_fd);
+  mcr50_addr = (char*)mcr_base_addr + INTR_CTRL_STS_OFFSET;
+  ecc_status = *(volatile uint32_t*) mcr50_addr;
+  if (ecc_addr_log) {
+    mcr58_addr = (char*)mcr_base_addr + ADDR_FIRST_UNRECOVER_ECC_OFFSET;
+    unrecover_ecc_err_addr = *(volatile uint32_t*) mcr58_addr;
+    mcr5c_addr = (char*)mcr_base_addr + ADDR_LAST_RECOVER_ECC_OFFSET;
+    recover_ecc_err_addr = *(volatile uint32_t*) mcr5c_addr;
+  }
 
-    ecc_recoverable_error_counter = (ecc_status >> 16) & 0xFF;
-    ecc_unrecoverable_error_counter = (ecc_status >> 12) & 0xF;
+  ecc_recoverable_error_counter = (ecc_status >> 16) & 0xFF;
+  ecc_unrecoverable_error_counter = (ecc_status >> 12) & 0xF;
+  hstats_add(&recov_ecc_stats, ecc_recoverable_error_counter);
+  hstats_add(&unrec_ecc_stats, ecc_unrecoverable_error_counter);
 
-    // Check ECC recoverable error counter
-    ecc_threshold_check(recoverable_ecc_name, ecc_recoverable_error_counter,
-                        recov_ecc_threshold, recov_ecc_threshold_num, recover_ecc_err_addr);
+  // Check ECC recoverable error counter
+  ecc_threshold_check(recoverable_ecc_name, ecc_recoverable_error_counter,
+                      recov_ecc_threshold, recov_ecc_threshold_num, recover_ecc_err_addr);
 
-    // Check ECC un-recoverable error counter
-    ecc_threshold_check(unrecoverable_ecc_name, ecc_unrecoverable_error_counter,
-                        unrec_ecc_threshold, unrec_ecc_threshold_num, unrecover_ecc_err_addr);
+  // Check ECC un-recoverable error counter
+  ecc_threshold_check(unrecoverable_ecc_name, ecc_unrecoverable_error_counter,
+                      unrec_ecc_threshold, unrec_ecc_threshold_num, unrecover_ecc_err_addr);
 
-    sleep(ecc_monitor_interval);
-  }
-  return NULL;
+  return true;
 }
 
-static void *
-bmc_health_monitor()
+static bool
+bmc_health_poll(struct monitor_s *m)
 {
-  int bmc_health_last_state = 1;
+  static int bmc_health_last_state = 1;
+  static int relog_counter = 0;
   int bmc_health_kv_state = 1;
   char tmp_health[MAX_VALUE_LEN];
-  int relog_counter = 0;
   int relog_counter_criteria = regen_interval / bmc_health_monitor_interval;
   size_t i;
   int ret = 0;
 
-  while(1) {
-    // get current health status from kv_store
-    memset(tmp_health, 0, MAX_VALUE_LEN);
-    ret = pal_get_key_value(BMC_HEALTH_FILE, tmp_health);
-    if (ret){
-      syslog(LOG_ERR, " %s - kv get bmc_health status failed", __func__);
-    }
-    bmc_health_kv_state = atoi(tmp_health);
-
-    // If log-util clear all fru, cleaning CPU/MEM/ECC error status
-    // After doing it, daemon will regenerate asserted log
-    // Generage a syslog every regen_interval loop counter
-    if ((relog_counter >= relog_counter_criteria) ||
-        ((bmc_health_last_state == 0) && (bmc_health_kv_state == 1))) {
-
-      for(i = 0; i < cpu_threshold_num; i++)
-        cpu_threshold[i].asserted = false;
-      for(i = 0; i < mem_threshold_num; i++)
-        mem_threshold[i].asserted = false;
-      for(i = 0; i < recov_ecc_threshold_num; i++)
-        recov_ecc_threshold[i].asserted = false;
-      for(i = 0; i < unrec_ecc_threshold_num; i++)
-        unrec_ecc_threshold[i].asserted = false;
-
-      pthread_mutex_lock(&global_error_mutex);
-      bmc_health = 0;
-      pthread_mutex_unlock(&global_error_mutex);
-      relog_counter = 0;
-    }
-    bmc_health_last_state = bmc_health_kv_state;
-    relog_counter++;
-    sleep(bmc_health_monitor_interval);
-  }
-  return NULL;
+  // get current health status from kv_store
+  memset(tmp_health, 0, MAX_VALUE_LEN);
+  ret = pal_get_key_value(BMC_HEALTH_FILE, tmp_health);
+  if (ret){
+    syslog(LOG_ERR, " %s - kv get bmc_health status failed", __func__);
+  }
+  bmc_health_kv_state = atoi(tmp_health);
+
+  // If log-util clear all fru, cleaning CPU/MEM/ECC error status
+  // After doing it, daemon will regenerate asserted log
+  // Generage a syslog every regen_interval loop counter
+  if ((relog_counter >= relog_counter_criteria) ||
+      ((bmc_health_last_state == 0) && (bmc_health_kv_state == 1))) {
+
+    for(i = 0; i < cpu_threshold_num; i++)
+      cpu_threshold[i].asserted = false;
+    for(i = 0; i < mem_threshold_num; i++)
+      mem_threshold[i].asserted = false;
+    for(i = 0; i < recov_ecc_threshold_num; i++)
+      recov_ecc_threshold[i].asserted = false;
+    for(i = 0; i < unrec_ecc_threshold_num; i++)
+      unrec_ecc_threshold[i].asserted = false;
+
+    pthread_mutex_lock(&global_error_mutex);
+    bmc_health = 0;
+    pthread_mutex_unlock(&global_error_mutex);
+    relog_counter = 0;
+  }
+  bmc_health_last_state = bmc_health_kv_state;
+  relog_counter++;
+  return true;
 }
 
 void check_nm_selftest_result(uint8_t fru, int result)
@@ -1154,8 +1343,8 @@ void check_nm_selftest_result(uint8_t fru, int result)
   }
 }
 
-static void *
-nm_monitor()
+static bool
+nm_monitor_poll(struct monitor_s *m)
 {
   int fru;
   int ret;
@@ -1163,36 +1352,31 @@ nm_monitor()
   const uint8_t normal_status[2] = {0x55, 0x00}; // If the selftest result is 55 00, the status of the controller is okay
   uint8_t data[2]={0x0};
 
-  while (1)
+  for ( fru = 1; fru <= MAX_NUM_FRUS; fru++)
   {
-    for ( fru = 1; fru <= MAX_NUM_FRUS; fru++)
+    if ( pal_is_slot_server(fru) )
     {
-      if ( pal_is_slot_server(fru) )
+      if ( pal_is_fw_update_ongoing(fru) )
       {
-        if ( pal_is_fw_update_ongoing(fru) )
-        {
-          continue;
-        }
+        continue;
+      }
 
-        ret = pal_get_nm_selftest_result(fru, data);
-        if ( PAL_EOK == ret )
-        {
-          //if nm has the response, check the status
-          result = memcmp(data, normal_status, sizeof(normal_status));
-        }
-        else
-        {
-          //if nm has no response, suppose it is in the not support state
-          result = PAL_ENOTSUP;
-        }
-        check_nm_selftest_result(fru, result);
+      ret = pal_get_nm_selftest_result(fru, data);
+      if ( PAL_EOK == ret )
+      {
+        //if nm has the response, check the status
+        result = memcmp(data, normal_status, sizeof(normal_status));
+      }
+      else
+      {
+        //if nm has no response, suppose it is in the not support state
+        result = PAL_ENOTSUP;
       }
+      check_nm_selftest_result(fru, result);
     }
-
-    sleep(nm_monitor_interval);
   }
 
-  return NULL;
+  return true;
 }
 
 void
@@ -1219,54 +1403,63 @@ crit_proc_ongoing_handle(bool is_crit_proc_updating)
 }
 
 //Block reboot and shutdown commands in BMC during any FW updating
-static void *
-crit_proc_monitor() {
+static bool
+crit_proc_poll(struct monitor_s *m) {
 
   bool is_fw_updating = false;
   bool is_crashdump_ongoing = false;
   bool is_cplddump_ongoing = false;
 
-  while(1) 
-  {
-    //if is_fw_updating == true, means BMC is Updating a Device FW
-    is_fw_updating = pal_is_fw_update_ongoing_system();
-    
-    //if is_autodump_ongoing == true, modify the permission
-    is_crashdump_ongoing = pal_is_crashdump_ongoing_system();
+  //if is_fw_updating == true, means BMC is Updating a Device FW
+  is_fw_updating = pal_is_fw_update_ongoing_system();
 
-    //if is_cplddump_ongoing == true, modify the permission
-    is_cplddump_ongoing = pal_is_cplddump_ongoing_system();
+  //if is_autodump_ongoing == true, modify the permission
+  is_crashdump_ongoing = pal_is_crashdump_ongoing_system();
 
-    if ( (true == is_fw_updating) || (true == is_crashdump_ongoing) || (true == is_cplddump_ongoing) ) 
-    {
-      crit_proc_ongoing_handle(true);
-    }
-    
-    if ( (false == is_fw_updating) && (false == is_crashdump_ongoing) && (false == is_cplddump_ongoing) )
-    {
-      crit_proc_ongoing_handle(false);
-    }
+  //if is_cplddump_ongoing == true, modify the permission
+  is_cplddump_ongoing = pal_is_cplddump_ongoing_system();
 
-    sleep(1);
+  if ( (true == is_fw_updating) || (true == is_crashdump_ongoing) || (true == is_cplddump_ongoing) ) 
+  {
+    crit_proc_ongoing_handle(true);
   }
-  return NULL;
+
+  if ( (false == is_fw_updating) && (false == is_crashdump_ongoing) && (false == is_cplddump_ongoing) )
+  {
+    crit_proc_ongoing_handle(false);
+  }
+
+  return true;
 }
 
-static int log_count(const char *str)
+/*
+ * Count the lines of the persistent log holding each of strs, in a single
+ * pass over the log files.
+ */
+static void log_count(const char **strs, int *counts, int num)
 {
-  char cmd[512];
+  const char *files[] = {"/mnt/data/logfile", "/mnt/data/logfile.0"};
+  char *line = NULL;
+  size_t cap = 0;
   FILE *fp;
-  int ret;
-  snprintf(cmd, sizeof(cmd), "grep \"%s\" /mnt/data/logfile /mnt/data/logfile.0 2> /dev/null | wc -l", str);
-  fp = popen(cmd, "r");
-  if (!fp) {
-    return 0;
-  }
-  if (fscanf(fp, "%d", &ret) != 1) {
-    ret = 0;
+  int f, i;
+
+  memset(counts, 0, num * sizeof(int));
+  for (f = 0; f < sizeof(files) / sizeof(files[0]); f++) {
+    fp = fopen(files[f], "r");
+    if (!fp) {
+      continue;
+    }
+    while (getline(&line, &cap, fp) > 0) {
+      for (i = 0; i < num; i++) {
+        if (strstr(line, strs[i])) {
+          counts[i]++;
+        }
+      }
+    }
+    fclose(fp);
   }
-  pclose(fp);
-  return ret;
+  free(line);
 }
 
 static int get_curr_version(char *vers)
@@ -1332,19 +1525,19 @@ static void store_curr_version(void)
  * because of verified boot failure */
 static void check_vboot_recovery(uint8_t error_type, uint8_t error_code)
 {
-  char log[512];
+  char assert_log[128], deassert_log[128];
+  const char *logs[2] = {assert_log, deassert_log};
   char curr_err[MAX_VALUE_LEN] = {0};
-  int assert_count, deassert_count;
+  int counts[2];
 
   /* Technically we can get this from the kv store vboot_error. But
    * we cannot trust it since it could be compromised. Hence try to
    * infer this by counting ASSERT and DEASSERT logs from the persistent
    * log file */
-  snprintf(log, sizeof(log), " ASSERT: Verified boot failure (%d,%d)", error_type, error_code);
-  assert_count = log_count(log);
-  snprintf(log, sizeof(log), " DEASSERT: Verified boot failure (%d,%d)", error_type, error_code);
-  deassert_count = log_count(log);
-  if (assert_count <= deassert_count) {
+  snprintf(assert_log, sizeof(assert_log), " ASSERT: Verified boot failure (%d,%d)", error_type, error_code);
+  snprintf(deassert_log, sizeof(deassert_log), " DEASSERT: Verified boot failure (%d,%d)", error_type, error_code);
+  log_count(logs, counts, 2);
+  if (counts[0] <= counts[1]) {
     /* This is the first time we are seeing this error. Log it */
     syslog(LOG_CRIT, "ASSERT: Verified boot failure (%d,%d)", error_type, error_code);
     syslog(LOG_CRIT, "Verified boot failure reason: %s", vboot_error(error_code));
@@ -1399,29 +1592,23 @@ static void check_vboot_state(void)
   }
 }
 
-// Thread to monitor SLED Cycles by using time stamp
-static void *
-timestamp_handler() {
-  int count = 0;
+// Detect the cause of the last BMC reboot or SLED power cycle
+static void
+timestamp_init(long *time_sled_off) {
   int mem_fd;
-  struct timespec ts;
-  struct timespec mts;
   char tstr[64] = {0};
   char buf[128] = {0};
-  uint8_t time_init = 0;
   uint8_t *bmc_reboot_base;
   uint32_t kern_panic_flag = 0;
   uint32_t reboot_detected_flag = 0;
-  long time_sled_on;
-  long time_sled_off;
 
   // Read the last timestamp from KV storage
   pal_get_key_value("timestamp_sled", tstr);
-  time_sled_off = (long) strtoul(tstr, NULL, 10);
+  *time_sled_off = (long) strtoul(tstr, NULL, 10);
 
   // If this reset is due to Power-On-Reset, we detected SLED power OFF event
   if (pal_is_bmc_por()) {
-    ctime_r(&time_sled_off, buf);
+    ctime_r(time_sled_off, buf);
     syslog(LOG_CRIT, "SLED Powered OFF at %s", buf);
     pal_add_cri_sel("BMC AC lost");
 
@@ -1485,47 +1672,63 @@ timestamp_handler() {
     }
   }
 
-  while (1) {
+}
 
-    // Make sure the time is initialized properly
-    // Since there is no battery backup, the time could be reset to build time
-    // wait 100s at most, to prevent infinite waiting
-    if ( time_init < SLED_TS_TIMEOUT ) {
-      // Read current time
-      clock_gettime(CLOCK_REALTIME, &ts);
+// Monitor SLED Cycles by using time stamp
+static bool
+timestamp_poll(struct monitor_s *m) {
+  static bool ready = false;
+  static long time_sled_off;
+  static int count = 0;
+  static uint8_t time_init = 0;
+  struct timespec ts;
+  struct timespec mts;
+  char buf[128] = {0};
+  long time_sled_on;
 
-      if ( (ts.tv_sec < time_sled_off) && (++time_init < SLED_TS_TIMEOUT) ) {
-        sleep(1);
-        continue;
-      }
-      
-      // If get the correct time or time sync timeout
-      time_init = SLED_TS_TIMEOUT;
-
-      // Need to log SLED ON event, if this is Power-On-Reset
-      if (pal_is_bmc_por()) {
-        // Get uptime
-        clock_gettime(CLOCK_MONOTONIC, &mts);
-        // To find out when SLED was on, subtract the uptime from current time
-        time_sled_on = ts.tv_sec - mts.tv_sec;
-
-        ctime_r(&time_sled_on, buf);
-        // Log an event if this is Power-On-Reset
-        syslog(LOG_CRIT, "SLED Powered ON at %s", buf);
-      }
-      pal_update_ts_sled();
+  if (!ready) {
+    timestamp_init(&time_sled_off);
+    ready = true;
+  }
+
+  // Make sure the time is initialized properly
+  // Since there is no battery backup, the time could be reset to build time
+  // wait 100s at most, to prevent infinite waiting
+  if ( time_init < SLED_TS_TIMEOUT ) {
+    // Read current time
+    clock_gettime(CLOCK_REALTIME, &ts);
+
+    if ( (ts.tv_sec < time_sled_off) && (++time_init < SLED_TS_TIMEOUT) ) {
+      return true;
     }
 
-    // Store timestamp every one hour to keep track of SLED power
-    if (count++ == HB_TIMESTAMP_COUNT) {
-      pal_update_ts_sled();
-      count = 0;
+    // If get the correct time or time sync timeout
+    time_init = SLED_TS_TIMEOUT;
+
+    // Need to log SLED ON event, if this is Power-On-Reset
+    if (pal_is_bmc_por()) {
+      // Get uptime
+      clock_gettime(CLOCK_MONOTONIC, &mts);
+      // To find out when SLED was on, subtract the uptime from current time
+      time_sled_on = ts.tv_sec - mts.tv_sec;
+
+      ctime_r(&time_sled_on, buf);
+      // Log an event if this is Power-On-Reset
+      syslog(LOG_CRIT, "SLED Powered ON at %s", buf);
     }
+    pal_update_ts_sled();
 
-    sleep(HB_SLEEP_TIME);
+    // From now on only the hourly update is left
+    monitor_arm(m, HB_SLEEP_TIME * 1000, true);
   }
-  
-  return NULL;
+
+  // Store timestamp every one hour to keep track of SLED power
+  if (count++ == HB_TIMESTAMP_COUNT) {
+    pal_update_ts_sled();
+    count = 0;
+  }
+
+  return true;
 }
 
 void sig_handler(int signo) {
@@ -1536,17 +1739,25 @@ void sig_handler(int signo) {
 
 int
 main(int argc, char **argv) {
+  static struct monitor_s hb_mon = {"heartbeat", hb_poll};
+  static struct monitor_s i2c_mon = {"I2C", i2c_mon_poll};
+  static struct monitor_s cpu_mon = {"CPU usage", CPU_usage_poll};
+  static struct monitor_s mem_mon = {"memory usage", memory_usage_poll};
+  static struct monitor_s ecc_mon = {"ECC", ecc_mon_poll};
+  static struct monitor_s bmc_health_mon = {"BMC health", bmc_health_poll};
+  static struct monitor_s nm_mon = {"NM", nm_monitor_poll};
+  static struct monitor_s crit_proc_mon = {"FW update", crit_proc_poll};
+  static struct monitor_s timestamp_mon = {"time stamp", timestamp_poll};
+  static struct monitor_s stats_mon = {"statistics", stats_poll, 0, -1, true};
   pthread_t tid_watchdog;
-  pthread_t tid_hb_led;
-  pthread_t tid_i2c_mon;
-  pthread_t tid_cpu_monitor;
-  pthread_t tid_mem_monitor;
-  pthread_t tid_crit_proc_monitor;
-  pthread_t tid_ecc_monitor;
-  pthread_t tid_bmc_health_monitor;
-  pthread_t tid_nm_monitor;
-  pthread_t tid_timestamp_handler;
 
+  if ((argc == 2) && !strcmp(argv[1], "--stats")) {
+    if (obmc_stats_print(HEALTHD_STATS_SOCK, "healthd")) {
+      return 1;
+    }
+    printf("\n");
+    return 0;
+  }
   if (argc > 1) {
     exit(1);
   }
@@ -1575,100 +1786,85 @@ main(int argc, char **argv) {
     exit(1);
   }
 
-  if (pthread_create(&tid_hb_led, NULL, hb_handler, NULL) < 0) {
-    syslog(LOG_WARNING, "pthread_create for heartbeat error\n");
+  epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+  if (epoll_fd < 0) {
+    syslog(LOG_WARNING, "epoll_create1 failed, errno=%d\n", errno);
+    exit(1);
+  }
+  clock_gettime(CLOCK_MONOTONIC, &monitor_epoch);
+
+  hb_mon.interval_ms = hb_interval;
+  if (monitor_start(&hb_mon) < 0) {
     exit(1);
   }
 
   if (cpu_monitor_enabled) {
-    if (pthread_create(&tid_cpu_monitor, NULL, CPU_usage_monitor, NULL) < 0) {
-      syslog(LOG_WARNING, "pthread_create for monitor CPU usage\n");
+    hstats_init(&cpu_stats, cpu_monitor_name, cpu_window_size);
+    cpu_mon.interval_ms = cpu_monitor_interval * 1000;
+    if (monitor_start(&cpu_mon) < 0) {
       exit(1);
     }
   }
 
   if (mem_monitor_enabled) {
-    if (pthread_create(&tid_mem_monitor, NULL, memory_usage_monitor, NULL) < 0) {
-      syslog(LOG_WARNING, "pthread_create for monitor memory usage\n");
+    if (mem_enable_panic) {
+      set_panic_on_oom();
+    }
+    hstats_init(&mem_stats, mem_monitor_name, mem_window_size);
+    mem_mon.interval_ms = mem_monitor_interval * 1000;
+    if (monitor_start(&mem_mon) < 0) {
       exit(1);
     }
   }
 
   if (i2c_monitor_enabled) {
-    // Add a thread for monitoring all I2C buses crash or not
-    if (pthread_create(&tid_i2c_mon, NULL, i2c_mon_handler, NULL) < 0) {
-      syslog(LOG_WARNING, "pthread_create for I2C errorr\n");
+    // Monitor all I2C buses crash or not
+    i2c_mon.interval_ms = 30 * 1000;
+    if (monitor_start(&i2c_mon) < 0) {
       exit(1);
     }
   }
 
   if (ecc_monitor_enabled) {
-    if (pthread_create(&tid_ecc_monitor, NULL, ecc_mon_handler, NULL) < 0) {
-      syslog(LOG_WARNING, "pthread_create for ECC monitoring errorr\n");
+    hstats_init(&recov_ecc_stats, recoverable_ecc_name, DEFAULT_WINDOW_SIZE);
+    hstats_init(&unrec_ecc_stats, unrecoverable_ecc_name, DEFAULT_WINDOW_SIZE);
+    ecc_mon.interval_ms = ecc_monitor_interval * 1000;
+    if (monitor_start(&ecc_mon) < 0) {
       exit(1);
     }
   }
 
   if (regen_log_enabled) {
-    if (pthread_create(&tid_bmc_health_monitor, NULL, bmc_health_monitor, NULL) < 0) {
-      syslog(LOG_WARNING, "pthread_create for BMC Health monitoring errorr\n");
+    bmc_health_mon.interval_ms = bmc_health_monitor_interval * 1000;
+    if (monitor_start(&bmc_health_mon) < 0) {
       exit(1);
     }
   }
 
   if (nm_monitor_enabled) {
-    if (pthread_create(&tid_nm_monitor, NULL, nm_monitor, NULL) < 0) {
-      syslog(LOG_WARNING, "pthread_create for nm monitor error\n");
+    nm_mon.interval_ms = nm_monitor_interval * 1000;
+    if (monitor_start(&nm_mon) < 0) {
       exit(1);
     }
   }
 
-  if (pthread_create(&tid_crit_proc_monitor, NULL, crit_proc_monitor, NULL) < 0) {
-    syslog(LOG_WARNING, "pthread_create for FW Update Monitor error\n");
+  crit_proc_mon.interval_ms = 1000;
+  if (monitor_start(&crit_proc_mon) < 0) {
     exit(1);
   }
 
   if (bmc_timestamp_enabled) {
-    if (pthread_create(&tid_timestamp_handler, NULL, timestamp_handler, NULL) < 0) {
-      syslog(LOG_WARNING, "pthread_create for time stamp handler error\n");
+    // Every second until the time is known
+    timestamp_mon.interval_ms = 1000;
+    if (monitor_start(&timestamp_mon) < 0) {
       exit(1);
     }
   }
-  
-
-  pthread_join(tid_watchdog, NULL);
-
-  pthread_join(tid_hb_led, NULL);
-
-  if (i2c_monitor_enabled) {
-    pthread_join(tid_i2c_mon, NULL);
-  }
-  if (cpu_monitor_enabled) {
-    pthread_join(tid_cpu_monitor, NULL);
-  }
 
-  if (mem_monitor_enabled) {
-    pthread_join(tid_mem_monitor, NULL);
-  }
+  // Not fatal; only the statistics snapshot is lost
+  stats_listen(&stats_mon);
 
-  if (ecc_monitor_enabled) {
-    pthread_join(tid_ecc_monitor, NULL);
-  }
+  monitor_loop();
 
-  if (regen_log_enabled) {
-    pthread_join(tid_bmc_health_monitor, NULL);
-  }
-
-  if (nm_monitor_enabled) {
-    pthread_join(tid_nm_monitor, NULL);
-  }
-
-  pthread_join(tid_crit_proc_monitor, NULL);
-
-  if (bmc_timestamp_enabled) {
-    pthread_join(tid_timestamp_handler, NULL);
-  }
-
-  return 0;
+  return 1;
 }
-
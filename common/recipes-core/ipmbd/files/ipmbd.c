@@ -59,11 +59,15 @@
 #include <sys/un.h>
 #include <unistd.h>
 #include <stdint.h>
+#include <stddef.h>
+#include <time.h>
 #include <mqueue.h>
-#include <semaphore.h>
-#include <poll.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/timerfd.h>
 #include <openbmc/obmc-i2c.h>
 #include <openbmc/obmc-pal.h>
+#include <openbmc/obmc-stats.h>
 #include "openbmc/ipmi.h"
 #include "openbmc/ipmb.h"
 
@@ -72,44 +76,136 @@
 #define MAX_BYTES 300
 
 #define MQ_IPMB_REQ "/mq_ipmb_req"
-#define MQ_IPMB_RES "/mq_ipmb_res"
 #define MQ_MAX_MSG_SIZE MAX_BYTES
 #define MQ_MAX_NUM_MSGS 256
 
 #define SEQ_NUM_MAX 64
 
 #define I2C_RETRIES_MAX 15
+#define I2C_RETRY_US    20000
 
 #define IPMB_PKT_MIN_SIZE 6
 
-// Structure for i2c file descriptor and socket
-typedef struct _ipmb_sfd_t {
-  int fd;
-  int sock;
-} ipmb_sfd_t;
+#define IPMB_TXQ_MAX      128   // Transmit entries queued or in flight
+#define IPMB_TX_BATCH     8     // i2c writes before the slave is checked again
+#define IPMB_RX_BATCH     32    // Slave reads before the queue is served again
+#define IPMB_MAX_EVENTS   16
+#define IPMB_RX_POLL_MS   10
+#define IPMB_LAT_BUCKETS  24    // Latency histogram, log2 of microseconds
 
-// Structure for sequence number and buffer
-typedef struct _seq_buf_t {
-  bool in_use; // seq# is being used
-  uint8_t len; // buffer size
-  uint8_t *p_buf; // pointer to buffer
-  sem_t s_seq; // semaphore for thread sync.
-} seq_buf_t;
+#define IPMBD_STATS_SOCK  "/var/run/ipmbd_stats_%d.sock"
 
-// Structure for holding currently used sequence number and
-// array of all possible sequence number
-typedef struct _ipmb_sbuf_t {
-  uint8_t curr_seq; // currently used seq#
-  seq_buf_t seq[SEQ_NUM_MAX]; //array of all possible seq# struct.
-} ipmb_sbuf_t;
-
-// Global storage for holding IPMB sequence number and buffer
-ipmb_sbuf_t g_seq;
+/*
+ * Transaction engine
+ *
+ * One thread per bus owns the i2c master and slave, the library sockets
+ * and every transaction in flight, and waits in epoll on
+ *  - the i2c slave device, drained when it reports a message and at
+ *    least every IPMB_RX_POLL_MS, as not every driver supports poll
+ *  - the plain and multiplexed library sockets and their clients
+ *  - an eventfd through which ipmb_req_handler queues its responses
+ *  - a timerfd armed for the earliest sequence timeout or i2c retry
+ * Writes go out of a bounded transmit queue in priority order: responses
+ * to the bridge first, then library requests, with firmware and image
+ * transfers last so they can not hold up sensor polling. A failed write is
+ * retried from the timer instead of sleeping, so the slave side keeps being
+ * served meanwhile. Requests from the bridge are still handed to
+ * ipmb_req_handler, as answering them may block on ipmid.
+ */
 
-// mutex to protect global data access
-pthread_mutex_t m_seq;
+// Transmit priorities, lowest value goes first
+enum {
+  IPMB_PRIO_RES = 0,    // Responses to requests from the bridge
+  IPMB_PRIO_NORMAL,     // Library requests, e.g. sensor reads
+  IPMB_PRIO_BULK,       // Firmware and image transfers
+  IPMB_PRIOS,
+};
+
+// Kind of file descriptor behind an epoll event
+enum {
+  SRC_SLAVE = 0,
+  SRC_EVENT,
+  SRC_TIMER,
+  SRC_LISTEN,
+  SRC_LISTEN_MUX,
+  SRC_STATS,
+  SRC_CLIENT,
+};
+
+typedef struct _ipmb_src_t {
+  int type;
+  int fd;
+} ipmb_src_t;
+
+// Library client connection
+typedef struct _ipmb_client_t {
+  ipmb_src_t src;
+  bool mux;       // Tagged SOCK_SEQPACKET client, else one request only
+  bool closed;
+  int refs;       // Transactions in flight, plus one while the socket is open
+} ipmb_client_t;
+
+// Transmit queue entry
+typedef struct _ipmb_tx_t {
+  struct _ipmb_tx_t *next;
+  uint8_t prio;
+  uint8_t retries;
+  bool sent;
+  int8_t seq;     // Sequence number of a library request, -1 for responses
+  uint16_t len;
+  uint8_t buf[MAX_BYTES];
+} ipmb_tx_t;
+
+// Library request waiting for its response
+typedef struct _seq_buf_t {
+  bool in_use;
+  ipmb_tx_t *tx;
+  ipmb_client_t *client;
+  uint8_t tag;        // Client tag on multiplexed connections
+  uint64_t start;     // Submission time, us
+  uint64_t deadline;  // Timeout, us
+} seq_buf_t;
 
-pthread_mutex_t m_i2c;
+typedef struct _ipmb_stats_t {
+  uint64_t start;
+  uint64_t requests;      // Library requests answered by the bridge
+  uint64_t timeouts;
+  uint64_t rejected;      // No sequence number or transmit entry free
+  uint64_t responses;     // Responses sent for requests from the bridge
+  uint64_t rx_requests;
+  uint64_t rx_responses;
+  uint64_t rx_unmatched;  // Late or unknown responses
+  uint64_t rx_errors;     // Bad size or checksum
+  uint64_t rx_dropped;    // Request queue full
+  uint64_t i2c_retries;
+  uint64_t i2c_errors;
+  uint64_t lat_sum;       // us
+  uint64_t lat_max;
+  uint64_t lat_hist[IPMB_LAT_BUCKETS];
+  uint32_t txq_depth;
+  uint32_t txq_peak;
+} ipmb_stats_t;
+
+// Owned by the engine thread
+static seq_buf_t g_seq[SEQ_NUM_MAX];
+static uint8_t g_curr_seq;
+static ipmb_tx_t *g_tx_cur;     // Being written, or waiting for a retry
+static uint64_t g_retry_at;     // Next write attempt, 0 if not backing off
+static ipmb_stats_t g_stats;
+static int g_epfd = -1;
+static int g_evfd = -1;
+static int g_tfd = -1;
+static int g_i2c_fd = -1;
+static int g_slave_fd = -1;
+static mqd_t g_mq_req = (mqd_t)-1;
+static ipmb_src_t g_src[SRC_CLIENT];
+
+// Transmit pool and queues, shared with ipmb_req_handler
+static ipmb_tx_t g_tx_pool[IPMB_TXQ_MAX];
+static ipmb_tx_t *g_tx_free;
+static ipmb_tx_t *g_txq_head[IPMB_PRIOS];
+static ipmb_tx_t *g_txq_tail[IPMB_PRIOS];
+static pthread_mutex_t m_txq = PTHREAD_MUTEX_INITIALIZER;
 
 static int g_bus_id = 0; // store the i2c bus ID for debug print
 static int g_payload_id = 1; // Store the payload ID we need to use
@@ -131,82 +227,6 @@ calc_cksum(uint8_t *buf, uint8_t len) {
   return (ZERO_CKSUM_CONST - cksum);
 }
 
-static void seq_init() {
-  // Initialize mutex to access global structure
-  pthread_mutex_init(&m_seq, NULL);
-  // Initialize g_seq structure
-  int i;
-  g_seq.curr_seq = 0;
-  for (i = 0; i < SEQ_NUM_MAX; i++) {
-    g_seq.seq[i].in_use = false;
-    sem_init(&g_seq.seq[i].s_seq, 0, 0);
-    g_seq.seq[i].len = 0;
-    g_seq.seq[i].p_buf = NULL;
-  }
-}
-
-static int seq_put(uint8_t seq, uint8_t *buf, uint8_t len)
-{
-  seq_buf_t *s;
-  int rc = -1;
-
-  if (seq >= SEQ_NUM_MAX) {
-    return -1;
-  }
-  // Check if the response is being waited for
-  pthread_mutex_lock(&m_seq);
-  s = &g_seq.seq[seq];
-  if (s->in_use && s->p_buf) {
-    // Copy the response to the requester's buffer
-    memcpy(s->p_buf, buf, len);
-    s->len = len;
-
-    // Wake up the worker thread to receive the response
-    sem_post(&s->s_seq);
-    rc = 0;
-  }
-  pthread_mutex_unlock(&m_seq);
-  return rc;
-}
-
-// Returns an unused seq# from all possible seq#
-static int8_t
-seq_get_new(unsigned char *resp) {
-  int8_t ret = -1;
-  uint8_t index;
-
-  pthread_mutex_lock(&m_seq);
-
-  // Search for unused sequence number
-  index = g_seq.curr_seq;
-  do {
-    if (g_seq.seq[index].in_use == false) {
-      // Found it!
-      ret = index;
-      g_seq.seq[index].in_use = true;
-      g_seq.seq[index].len = 0;
-      g_seq.seq[index].p_buf = resp;
-      break;
-    }
-
-    if (++index == SEQ_NUM_MAX) {
-      index = 0;
-    }
-  } while (index != g_seq.curr_seq);
-
-  // Update the current seq num
-  if (ret >= 0) {
-    if (++index == SEQ_NUM_MAX) {
-      index = 0;
-    }
-    g_seq.curr_seq = index;
-  }
-
-  pthread_mutex_unlock(&m_seq);
-
-  return ret;
-}
-
 static int
 i2c_open(uint8_t bus_num) {
   int fd;
@@ -230,46 +250,6 @@ i2c_open(uint8_t bus_num) {
   return fd;
 }
 
-static int
-i2c_write(int fd, uint8_t *buf, uint16_t len) {
-  struct i2c_rdwr_ioctl_data data;
-  struct i2c_msg msg;
-  int rc;
-  int i;
-
-  memset(&msg, 0, sizeof(msg));
-
-  msg.addr = buf[0] >> 1;
-  msg.flags = 0;
-  msg.len = len - 1; // 1st byte in addr
-  msg.buf = &buf[1];
-
-  data.msgs = &msg;
-  data.nmsgs = 1;
-
-  pthread_mutex_lock(&m_i2c);
-
-  for (i = 0; i < I2C_RETRIES_MAX; i++) {
-    rc = ioctl(fd, I2C_RDWR, &data);
-    if (rc < 0) {
-      msleep(20);
-      continue;
-    } else {
-      break;
-    }
-  }
-
-  if (rc < 0) {
-    syslog(LOG_WARNING, "bus: %d, Failed to do raw io", g_bus_id);
-    pthread_mutex_unlock(&m_i2c);
-    return -1;
-  }
-
-  pthread_mutex_unlock(&m_i2c);
-
-  return 0;
-}
-
 static int
 i2c_slave_open(uint8_t bus_num) {
   int fd;
@@ -332,224 +312,410 @@ i2c_slave_read(int fd, uint8_t *buf, uint8_t *len) {
   return 0;
 }
 
-// Thread to handle new requests
-static void*
-ipmb_req_handler(void *bus_num) {
-  uint8_t *bnum = (uint8_t*) bus_num;
-  mqd_t mq;
-  int fd;
-  int i;
+static uint64_t
+now_us(void) {
+  struct timespec ts;
 
-  //Buffers for IPMB transport
-  uint8_t rxbuf[MQ_MAX_MSG_SIZE] = {0};
-  uint8_t txbuf[MQ_MAX_MSG_SIZE] = {0};
-  ipmb_req_t *p_ipmb_req;
-  ipmb_res_t *p_ipmb_res;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
 
-  p_ipmb_req = (ipmb_req_t*) rxbuf;
-  p_ipmb_res = (ipmb_res_t*) txbuf;
+// One attempt; retries are scheduled by the engine
+static int
+i2c_write(int fd, uint8_t *buf, uint16_t len) {
+  struct i2c_rdwr_ioctl_data data;
+  struct i2c_msg msg;
 
-  //Buffers for IPMI Stack
-  uint8_t rbuf[MQ_MAX_MSG_SIZE] = {0};
-  uint8_t tbuf[MQ_MAX_MSG_SIZE] = {0};
-  ipmi_mn_req_t *p_ipmi_mn_req;
-  ipmi_res_t *p_ipmi_res;
+  memset(&msg, 0, sizeof(msg));
 
-  p_ipmi_mn_req = (ipmi_mn_req_t*) rbuf;
-  p_ipmi_res = (ipmi_res_t*) tbuf;
+  msg.addr = buf[0] >> 1;
+  msg.flags = 0;
+  msg.len = len - 1; // 1st byte in addr
+  msg.buf = &buf[1];
 
-  uint8_t rlen = 0;
-  uint16_t tlen = 0;
+  data.msgs = &msg;
+  data.nmsgs = 1;
 
-  char mq_ipmb_req[64] = {0};
+  return (ioctl(fd, I2C_RDWR, &data) < 0) ? -1 : 0;
+}
 
-  sprintf(mq_ipmb_req, "%s_%d", MQ_IPMB_REQ, *bnum);
+static void
+tx_init(void) {
+  int i;
 
-  // Open Queue to receive requests
-  mq = mq_open(mq_ipmb_req, O_RDONLY);
-  if (mq == (mqd_t) -1) {
-    return NULL;
+  for (i = 0; i < IPMB_TXQ_MAX; i++) {
+    g_tx_pool[i].next = g_tx_free;
+    g_tx_free = &g_tx_pool[i];
   }
+}
 
-  // Open the i2c bus for sending response
-  fd = i2c_open(*bnum);
-  if (fd < 0) {
-    syslog(LOG_WARNING, "i2c_open failure\n");
-    mq_close(mq);
-    return NULL;
+// Caller holds m_txq
+static ipmb_tx_t *
+tx_alloc(void) {
+  ipmb_tx_t *tx = g_tx_free;
+
+  if (tx != NULL) {
+    g_tx_free = tx->next;
+    memset(tx, 0, offsetof(ipmb_tx_t, buf));
+    tx->seq = -1;
   }
+  return tx;
+}
 
-  // Loop to process incoming requests
-  while (1) {
-    if ((rlen = mq_receive(mq, (char *)rxbuf, MQ_MAX_MSG_SIZE, NULL)) <= 0) {
-      sleep(1);
-      continue;
-    }
+static void
+tx_free(ipmb_tx_t *tx) {
+  pthread_mutex_lock(&m_txq);
+  tx->next = g_tx_free;
+  g_tx_free = tx;
+  pthread_mutex_unlock(&m_txq);
+}
 
-    pal_ipmb_processing(g_bus_id, rxbuf, rlen);
+// Caller holds m_txq
+static void
+tx_push(ipmb_tx_t *tx) {
+  tx->next = NULL;
+  if (g_txq_tail[tx->prio]) {
+    g_txq_tail[tx->prio]->next = tx;
+  } else {
+    g_txq_head[tx->prio] = tx;
+  }
+  g_txq_tail[tx->prio] = tx;
 
-#ifdef DEBUG
-    syslog(LOG_WARNING, "Received Request of %d bytes\n", rlen);
-    for (i = 0; i < rlen; i++) {
-      syslog(LOG_WARNING, "0x%X", rxbuf[i]);
+  if (++g_stats.txq_depth > g_stats.txq_peak) {
+    g_stats.txq_peak = g_stats.txq_depth;
+  }
+}
+
+static ipmb_tx_t *
+tx_pop(void) {
+  ipmb_tx_t *tx = NULL;
+  int prio;
+
+  pthread_mutex_lock(&m_txq);
+  for (prio = 0; prio < IPMB_PRIOS; prio++) {
+    if ((tx = g_txq_head[prio]) != NULL) {
+      g_txq_head[prio] = tx->next;
+      if (g_txq_head[prio] == NULL) {
+        g_txq_tail[prio] = NULL;
+      }
+      g_stats.txq_depth--;
+      break;
     }
-#endif
+  }
+  pthread_mutex_unlock(&m_txq);
 
-    // Create IPMI request from IPMB data
-    p_ipmi_mn_req->payload_id = g_payload_id;
-    p_ipmi_mn_req->netfn_lun = p_ipmb_req->netfn_lun;
-    p_ipmi_mn_req->cmd = p_ipmb_req->cmd;
+  return tx;
+}
 
-    memcpy(p_ipmi_mn_req->data, p_ipmb_req->data, rlen - IPMB_HDR_SIZE - IPMI_REQ_HDR_SIZE);
+/*
+ * Queue a response to a request from the bridge; called by
+ * ipmb_req_handler. Returns -1 if the transmit queue is full.
+ */
+static int
+ipmb_submit_res(uint8_t *buf, uint16_t len) {
+  ipmb_tx_t *tx;
+  uint64_t one = 1;
 
-    // Send to IPMI stack and get response
-    // Additional byte as we are adding and passing payload ID for MN support
-    lib_ipmi_handle(rbuf, rlen - IPMB_HDR_SIZE + 1, tbuf, &tlen);
+  if (len > MAX_BYTES) {
+    return -1;
+  }
 
-    // Populate IPMB response data from IPMB request
-    p_ipmb_res->req_slave_addr = p_ipmb_req->req_slave_addr;
-    p_ipmb_res->res_slave_addr = p_ipmb_req->res_slave_addr;
-    p_ipmb_res->cmd = p_ipmb_req->cmd;
-    p_ipmb_res->seq_lun = p_ipmb_req->seq_lun;
+  pthread_mutex_lock(&m_txq);
+  tx = tx_alloc();
+  if (tx != NULL) {
+    tx->prio = IPMB_PRIO_RES;
+    tx->len = len;
+    memcpy(tx->buf, buf, len);
+    tx_push(tx);
+  }
+  pthread_mutex_unlock(&m_txq);
 
-    // Add IPMI response data
-    p_ipmb_res->netfn_lun = p_ipmi_res->netfn_lun;
-    p_ipmb_res->cc = p_ipmi_res->cc;
+  if (tx == NULL) {
+    return -1;
+  }
 
-    memcpy(p_ipmb_res->data, p_ipmi_res->data, tlen - IPMI_RESP_HDR_SIZE);
+  if (write(g_evfd, &one, sizeof(one)) < 0) {
+    syslog(LOG_WARNING, "bus: %d, eventfd write failed\n", g_bus_id);
+  }
+  return 0;
+}
 
-    // Calculate Header Checksum
-    p_ipmb_res->hdr_cksum = p_ipmb_res->req_slave_addr +
-                           p_ipmb_res->netfn_lun;
-    p_ipmb_res->hdr_cksum = ZERO_CKSUM_CONST - p_ipmb_res->hdr_cksum;
+static uint8_t
+ipmb_tx_prio(ipmb_req_t *req) {
+  // Bulk transfers to the bridge go behind everything else
+  if ((req->netfn_lun >> LUN_OFFSET) == NETFN_OEM_1S_REQ) {
+    switch (req->cmd) {
+      case CMD_OEM_1S_UPDATE_FW:
+      case CMD_OEM_1S_GET_FW_CKSUM:
+      case CMD_OEM_1S_READ_FW_IMAGE:
+        return IPMB_PRIO_BULK;
+      default:
+        break;
+    }
+  }
+  return IPMB_PRIO_NORMAL;
+}
 
-    // Calculate Data Checksum
-    p_ipmb_res->data[tlen-IPMI_RESP_HDR_SIZE] = p_ipmb_res->res_slave_addr +
-                            p_ipmb_res->seq_lun +
-                            p_ipmb_res->cmd +
-                            p_ipmb_res->cc;
+// Returns an unused seq# from all possible seq#
+static int8_t
+seq_get_new(void) {
+  uint8_t index = g_curr_seq;
 
-    for (i = 0; i < tlen-IPMI_RESP_HDR_SIZE; i++) {
-      p_ipmb_res->data[tlen-IPMI_RESP_HDR_SIZE] += p_ipmb_res->data[i];
+  // Search for unused sequence number
+  do {
+    if (g_seq[index].in_use == false) {
+      g_seq[index].in_use = true;
+      g_curr_seq = (index + 1) % SEQ_NUM_MAX;
+      return index;
     }
+    index = (index + 1) % SEQ_NUM_MAX;
+  } while (index != g_curr_seq);
 
-    p_ipmb_res->data[tlen-IPMI_RESP_HDR_SIZE] = ZERO_CKSUM_CONST -
-                                      p_ipmb_res->data[tlen-IPMI_RESP_HDR_SIZE];
+  return -1;
+}
+
+static void
+client_put(ipmb_client_t *client) {
+  if (--client->refs == 0) {
+    free(client);
+  }
+}
+
+static void
+client_close(ipmb_client_t *client) {
+  if (client->closed) {
+    return;
+  }
+  // Closing the socket also drops it from the epoll set
+  close(client->src.fd);
+  client->closed = true;
+  client_put(client);
+}
+
+static void
+client_reply(ipmb_client_t *client, uint8_t tag, uint8_t *buf, uint8_t len) {
+  uint8_t tbuf[MAX_IPMB_RES_LEN + 1];
 
+  if (client->closed) {
+    return;
+  }
+
+  if (client->mux) {
+    // Tag byte is echoed back even if there is no response to go with it
+    tbuf[0] = tag;
+    memcpy(&tbuf[1], buf, len);
+    if (send(client->src.fd, tbuf, len + 1, MSG_DONTWAIT | MSG_NOSIGNAL) < 0) {
 #ifdef DEBUG
-    syslog(LOG_WARNING, "Sending Response of %d bytes\n", tlen+IPMB_HDR_SIZE-1);
-    for (i = 0; i < tlen+IPMB_HDR_SIZE; i++) {
-      syslog(LOG_WARNING, "0x%X:", txbuf[i]);
+      syslog(LOG_WARNING, "ipmbd: send() failed\n");
+#endif
     }
+    return;
+  }
+
+  // Plain clients send one request and get an empty reply on failure
+  if (len && send(client->src.fd, buf, len, MSG_DONTWAIT | MSG_NOSIGNAL) < 0) {
+#ifdef DEBUG
+    syslog(LOG_WARNING, "ipmbd: send() failed\n");
 #endif
+  }
+  client_close(client);
+}
+
+// Finish a library request with the response from the bridge, if any
+static void
+seq_complete(uint8_t seq, uint8_t *buf, uint8_t len) {
+  seq_buf_t *s = &g_seq[seq];
+  uint64_t lat;
+  int bucket;
+
+  client_reply(s->client, s->tag, buf, len);
+  pal_ipmb_finished(g_bus_id, s->tx->buf, len);
+
+  if (len) {
+    lat = now_us() - s->start;
+    for (bucket = 0; bucket < IPMB_LAT_BUCKETS - 1 && (lat >> (bucket + 1)); bucket++)
+      ;
+    g_stats.lat_hist[bucket]++;
+    g_stats.lat_sum += lat;
+    if (lat > g_stats.lat_max) {
+      g_stats.lat_max = lat;
+    }
+    g_stats.requests++;
+  }
 
-     // Send response back
-     i2c_write(fd, txbuf, tlen+IPMB_HDR_SIZE);
+  client_put(s->client);
 
-     pal_ipmb_finished(g_bus_id, txbuf, tlen+IPMB_HDR_SIZE);
+  // An unsent request is still queued; the queue drops it when it comes up
+  if (s->tx->sent) {
+    tx_free(s->tx);
   }
+  s->tx = NULL;
+  s->client = NULL;
+  s->in_use = false;
 }
 
-// Thread to handle the incoming responses
-static void*
-ipmb_res_handler(void *bus_num) {
-  uint8_t *bnum = (uint8_t*) bus_num;
-  uint8_t buf[MQ_MAX_MSG_SIZE] = { 0 };
-  uint8_t len = 0;
-  mqd_t mq;
-  ipmb_res_t *p_res;
-  uint8_t index;
-  char mq_ipmb_res[64] = {0};
+// Take a request from a library client and queue it for the bridge
+static void
+lib_submit(ipmb_client_t *client, uint8_t tag, uint8_t *buf, int len) {
+  ipmb_req_t *req;
+  ipmb_tx_t *tx = NULL;
+  int8_t seq;
+  int i;
 
-  sprintf(mq_ipmb_res, "%s_%d", MQ_IPMB_RES, *bnum);
+  if (len < MIN_IPMB_REQ_LEN || len > MAX_BYTES) {
+    client_reply(client, tag, NULL, 0);
+    return;
+  }
 
-  // Open the message queue
-  mq = mq_open(mq_ipmb_res, O_RDONLY);
-  if (mq == (mqd_t) -1) {
-    syslog(LOG_WARNING, "mq_open fails\n");
-    return NULL;
+  if (bic_up_flag) {
+    if (!((buf[1] == 0xe0) && (buf[5] == CMD_OEM_1S_ENABLE_BIC_UPDATE))) {
+      client_reply(client, tag, NULL, 0);
+      return;
+    }
   }
 
-  // Loop to wait for incomng response messages
-  while (1) {
-    if ((len = mq_receive(mq, (char *)buf, MQ_MAX_MSG_SIZE, NULL)) <= 0) {
-      sleep(1);
-      continue;
+  // Allocate right sequence Number
+  seq = seq_get_new();
+  if (seq >= 0) {
+    pthread_mutex_lock(&m_txq);
+    tx = tx_alloc();
+    pthread_mutex_unlock(&m_txq);
+    if (tx == NULL) {
+      g_seq[seq].in_use = false;
     }
+  }
+  if (tx == NULL) {
+    g_stats.rejected++;
+    client_reply(client, tag, NULL, 0);
+    return;
+  }
+
+  memcpy(tx->buf, buf, len);
+  tx->len = len;
+  tx->seq = seq;
+  req = (ipmb_req_t *) tx->buf;
+
+  req->seq_lun = seq << LUN_OFFSET;
+  req->req_slave_addr = BMC_SLAVE_ADDR << 1;
+
+  // Calculate/update header Cksum
+  req->hdr_cksum = req->res_slave_addr +
+                   req->netfn_lun;
+  req->hdr_cksum = ZERO_CKSUM_CONST - req->hdr_cksum;
 
-    p_res = (ipmb_res_t *) buf;
+  // Calculate/update dataCksum
+  // Note: dataCkSum byte is last byte
+  tx->buf[len-1] = 0;
+  for (i = IPMB_DATA_OFFSET; i < len-1; i++) {
+    tx->buf[len-1] += tx->buf[i];
+  }
+  tx->buf[len-1] = ZERO_CKSUM_CONST - tx->buf[len-1];
+
+  g_seq[seq].tx = tx;
+  g_seq[seq].client = client;
+  g_seq[seq].tag = tag;
+  g_seq[seq].start = now_us();
+  g_seq[seq].deadline = g_seq[seq].start + TIMEOUT_IPMB * 1000000ULL;
+  client->refs++;
+
+  if (pal_ipmb_processing(g_bus_id, tx->buf, len)) {
+    tx->sent = true;
+    seq_complete(seq, NULL, 0);
+    return;
+  }
+
+  tx->prio = ipmb_tx_prio(req);
+  pthread_mutex_lock(&m_txq);
+  tx_push(tx);
+  pthread_mutex_unlock(&m_txq);
+}
+
+// A request whose sequence number timed out before it went out
+static bool
+tx_stale(ipmb_tx_t *tx) {
+  return tx->seq >= 0 && g_seq[tx->seq].tx != tx;
+}
 
+/*
+ * Write queued messages to the bus, highest priority first.
+ * Returns true if messages are left that can be sent right away.
+ */
+static bool
+tx_kick(void) {
+  ipmb_tx_t *tx;
+  int n;
+
+  for (n = 0; n < IPMB_TX_BATCH; n++) {
+    if (g_retry_at) {
+      if (now_us() < g_retry_at) {
+        return false;
+      }
+      g_retry_at = 0;
+    }
+
+    if (g_tx_cur == NULL && (g_tx_cur = tx_pop()) == NULL) {
+      return false;
+    }
+    tx = g_tx_cur;
 
-    // Check the seq# of response
-    index = p_res->seq_lun >> LUN_OFFSET;
+    if (tx_stale(tx)) {
+      g_tx_cur = NULL;
+      tx_free(tx);
+      continue;
+    }
 
-    if (seq_put(index, buf, len)) {
-      // Either the IPMB packet is corrupted or arrived late after client exits
-      syslog(LOG_WARNING, "bus: %d, WRONG packet received with seq#%d\n", g_bus_id, index);
+    if (i2c_write(g_i2c_fd, tx->buf, tx->len)) {
+      g_stats.i2c_retries++;
+      if (++tx->retries < I2C_RETRIES_MAX) {
+        g_retry_at = now_us() + I2C_RETRY_US;
+        return false;
+      }
+      syslog(LOG_WARNING, "bus: %d, Failed to do raw io", g_bus_id);
+      g_stats.i2c_errors++;
+      g_tx_cur = NULL;
+      tx->sent = true;
+      if (tx->seq >= 0) {
+        seq_complete(tx->seq, NULL, 0);
+      } else {
+        pal_ipmb_finished(g_bus_id, tx->buf, tx->len);
+        tx_free(tx);
+      }
+      continue;
     }
 
-#ifdef DEBUG
-    syslog(LOG_WARNING, "Received Response of %d bytes\n", len);
-    int i;
-    for (i = 0; i < len; i++) {
-      syslog(LOG_WARNING, "0x%X:", buf[i]);
+    g_tx_cur = NULL;
+    tx->sent = true;
+    if (tx->seq < 0) {
+      g_stats.responses++;
+      pal_ipmb_finished(g_bus_id, tx->buf, tx->len);
+      tx_free(tx);
     }
-#endif
   }
+
+  return true;
 }
 
-// Thread to receive the IPMB messages over i2c bus as a slave
-static void*
-ipmb_rx_handler(void *bus_num) {
-  uint8_t *bnum = (uint8_t*) bus_num;
-  int fd;
+/*
+ * Read what the slave device has buffered. Responses complete their
+ * library request right here, requests go to ipmb_req_handler.
+ * Returns true if the batch limit was hit and more may be waiting.
+ */
+static bool
+rx_drain(void) {
   uint8_t len;
   uint8_t tlun;
   uint8_t buf[MAX_BYTES] = { 0 };
-  mqd_t mq_req = (mqd_t)-1, mq_res, tmq;
-  ipmb_req_t *p_req;
-  struct timespec req;
-  char mq_ipmb_req[64] = {0};
-  char mq_ipmb_res[64] = {0};
   uint8_t tbuf[MAX_BYTES] = { 0 };
   uint8_t fbyte;
+  uint8_t seq;
+  ipmb_req_t *p_req;
+  ipmb_res_t *p_res;
+  int n;
 
-  // Setup wait time
-  req.tv_sec = 0;
-  req.tv_nsec = 10000000;//10mSec
-
-  // Open the i2c bus as a slave
-  fd = i2c_slave_open(*bnum);
-  if (fd < 0) {
-    syslog(LOG_WARNING, "i2c_slave_open fails\n");
-    goto cleanup;
-  }
-
-  sprintf(mq_ipmb_req, "%s_%d", MQ_IPMB_REQ, *bnum);
-  sprintf(mq_ipmb_res, "%s_%d", MQ_IPMB_RES, *bnum);
-
-  // Open the message queues for post processing
-  mq_req = mq_open(mq_ipmb_req, O_WRONLY);
-  if (mq_req == (mqd_t) -1) {
-    syslog(LOG_WARNING, "mq_open req fails\n");
-    goto cleanup;
-  }
-
-  mq_res = mq_open(mq_ipmb_res, O_WRONLY);
-  if (mq_res == (mqd_t) -1) {
-    syslog(LOG_WARNING, "mq_open res fails\n");
-    goto cleanup;
-  }
-
-  struct pollfd ufds[1];
-  ufds[0].fd= fd;
-  ufds[0].events = POLLIN;
-  // Loop that retrieves messages
-  while (1) {
+  for (n = 0; n < IPMB_RX_BATCH; n++) {
     // Read messages from i2c driver
-     if (i2c_slave_read(fd, buf, &len) < 0) {
-      poll(ufds, 1, 10);
-      continue;
+    if (i2c_slave_read(g_slave_fd, buf, &len) < 0) {
+      return false;
     }
 
     // TODO: HACK: Due to i2cdriver issues, we are seeing two different type of packet corruptions
@@ -561,6 +727,7 @@ ipmb_rx_handler(void *bus_num) {
 
     if (len < IPMB_PKT_MIN_SIZE) {
       syslog(LOG_WARNING, "bus: %d, IPMB Packet invalid size %d", g_bus_id, len);
+      g_stats.rx_errors++;
       continue;
     }
 
@@ -587,11 +754,13 @@ ipmb_rx_handler(void *bus_num) {
           // Check if the above hacks corrected the header
           if (buf[2] != calc_cksum(buf,2)) {
             syslog(LOG_WARNING, "bus: %d, IPMB Header cksum error after correcting slave address\n", g_bus_id);
+            g_stats.rx_errors++;
             continue;
           }
         }
       } else {
           syslog(LOG_WARNING, "bus: %d, IPMB Header cksum does not match\n", g_bus_id);
+          g_stats.rx_errors++;
           continue;
       }
     }
@@ -599,255 +768,462 @@ ipmb_rx_handler(void *bus_num) {
     // Verify the IPMB data cksum: data starts from 4-th byte
     if (buf[len-1] != calc_cksum(&buf[3], len-4)) {
       syslog(LOG_WARNING, "bus: %d, IPMB Data cksum does not match\n", g_bus_id);
+      g_stats.rx_errors++;
       continue;
     }
-
     // Check if the messages is request or response
     // Even NetFn: Request, Odd NetFn: Response
     p_req = (ipmb_req_t*) buf;
     tlun = p_req->netfn_lun >> LUN_OFFSET;
     if (tlun%2) {
-      tmq = mq_res;
+      g_stats.rx_responses++;
+      p_res = (ipmb_res_t *) buf;
+      seq = p_res->seq_lun >> LUN_OFFSET;
+      if (seq < SEQ_NUM_MAX && g_seq[seq].in_use && g_seq[seq].tx->sent) {
+        seq_complete(seq, buf, len);
+      } else {
+        // Either the IPMB packet is corrupted or arrived late after client exits
+        syslog(LOG_WARNING, "bus: %d, WRONG packet received with seq#%d\n", g_bus_id, seq);
+        g_stats.rx_unmatched++;
+      }
     } else {
-      tmq = mq_req;
-    }
-    // Post message to approriate Queue for further processing
-    if (mq_timedsend(tmq, (char *)buf, len, 0, &req)) {
-      //syslog(LOG_WARNING, "mq_send failed for queue %d\n", tmq);
-      msleep(10);
-      continue;
+      g_stats.rx_requests++;
+      if (mq_send(g_mq_req, (char *)buf, len, 0)) {
+        g_stats.rx_dropped++;
+      }
     }
   }
 
-cleanup:
-  if (fd > 0) {
-    close (fd);
-  }
+  return true;
+}
 
-  if (mq_req > 0) {
-    mq_close(mq_req);
-  }
+static void
+check_timeouts(void) {
+  uint64_t now = now_us();
+  int i;
 
-  if (mq_res > 0) {
-    mq_close(mq_req);
+  for (i = 0; i < SEQ_NUM_MAX; i++) {
+    if (g_seq[i].in_use && g_seq[i].deadline <= now) {
+      syslog(LOG_DEBUG, "bus: %d, No response for sequence number: %d\n", g_bus_id, i);
+      g_stats.timeouts++;
+      seq_complete(i, NULL, 0);
+    }
   }
-  return NULL;
 }
 
-/*
- * Function to handle all IPMB requests
- */
+// Arm the timer for the earliest sequence timeout or write retry
 static void
-ipmb_handle (int fd, unsigned char *request, unsigned short req_len,
-       unsigned char *response, unsigned char *res_len)
-{
-  ipmb_req_t *req = (ipmb_req_t *) request;
+arm_timer(void) {
+  struct itimerspec its;
+  uint64_t next = g_retry_at;
+  int i;
 
-  int8_t index;
-  struct timespec ts;
+  for (i = 0; i < SEQ_NUM_MAX; i++) {
+    if (g_seq[i].in_use && (next == 0 || g_seq[i].deadline < next)) {
+      next = g_seq[i].deadline;
+    }
+  }
 
-  // Allocate right sequence Number
-  index = seq_get_new(response);
-  if (index < 0) {
-    *res_len = 0;
-    return ;
+  memset(&its, 0, sizeof(its));
+  if (next) {
+    its.it_value.tv_sec = next / 1000000;
+    its.it_value.tv_nsec = (next % 1000000) * 1000;
+    if (its.it_value.tv_sec == 0 && its.it_value.tv_nsec == 0) {
+      its.it_value.tv_nsec = 1;
+    }
   }
+  timerfd_settime(g_tfd, TFD_TIMER_ABSTIME, &its, NULL);
+}
 
-  req->seq_lun = index << LUN_OFFSET;
-  req->req_slave_addr = BMC_SLAVE_ADDR << 1;
+static int
+add_fd(int fd, ipmb_src_t *src) {
+  struct epoll_event ev;
 
-  // Calculate/update header Cksum
-  req->hdr_cksum = req->res_slave_addr +
-                   req->netfn_lun;
-  req->hdr_cksum = ZERO_CKSUM_CONST - req->hdr_cksum;
+  ev.events = EPOLLIN;
+  ev.data.ptr = src;
+  return epoll_ctl(g_epfd, EPOLL_CTL_ADD, fd, &ev);
+}
 
-  // Calculate/update dataCksum
-  // Note: dataCkSum byte is last byte
-  int i;
-  request[req_len-1] = 0;
-  for (i = IPMB_DATA_OFFSET; i < req_len-1; i++) {
-    request[req_len-1] += request[i];
-  }
+static int
+listen_sock(const char *path, int type) {
+  struct sockaddr_un local;
+  int s;
 
-  request[req_len-1] = ZERO_CKSUM_CONST - request[req_len-1];
+  if ((s = socket(AF_UNIX, type | SOCK_NONBLOCK | SOCK_CLOEXEC, 0)) == -1) {
+    syslog(LOG_WARNING, "ipmbd: socket() failed\n");
+    return -1;
+  }
 
-  if (pal_ipmb_processing(g_bus_id, request, req_len)) {
-    goto ipmb_handle_out;
+  memset(&local, 0, sizeof(local));
+  local.sun_family = AF_UNIX;
+  snprintf(local.sun_path, sizeof(local.sun_path), "%s", path);
+  unlink(local.sun_path);
+  if (bind(s, (struct sockaddr *) &local, sizeof(local)) == -1 ||
+      listen(s, 16) == -1) {
+    syslog(LOG_WARNING, "ipmbd: bind()/listen() failed for %s\n", path);
+    close(s);
+    return -1;
   }
 
-  // Send request over i2c bus
-  if (i2c_write(fd, request, req_len)) {
-    goto ipmb_handle_out;
+  return s;
+}
+
+static void
+client_accept(ipmb_src_t *lsrc) {
+  ipmb_client_t *client;
+  int s;
+
+  while ((s = accept(lsrc->fd, NULL, NULL)) >= 0) {
+    client = calloc(1, sizeof(ipmb_client_t));
+    if (client == NULL) {
+      close(s);
+      continue;
+    }
+    client->src.type = SRC_CLIENT;
+    client->src.fd = s;
+    client->mux = (lsrc->type == SRC_LISTEN_MUX);
+    client->refs = 1;
+    if (add_fd(s, &client->src)) {
+      close(s);
+      free(client);
+    }
   }
+}
 
-  // Wait on semaphore for that sequence Number
-  clock_gettime(CLOCK_REALTIME, &ts);
+static void
+client_read(ipmb_client_t *client) {
+  uint8_t buf[MAX_IPMB_RES_LEN + 1];
+  int n;
 
-  ts.tv_sec += TIMEOUT_IPMB;
+  n = recv(client->src.fd, buf, sizeof(buf), MSG_DONTWAIT);
+  if (n < 0 && (errno == EAGAIN || errno == EINTR)) {
+    return;
+  }
+  if (n <= 0 || (client->mux && n < 2)) {
+    // Client closed its connection
+    client_close(client);
+    return;
+  }
 
-  int ret;
-  ret = sem_timedwait(&g_seq.seq[index].s_seq, &ts);
-  if (ret == -1) {
-    syslog(LOG_DEBUG, "bus: %d, No response for sequence number: %d\n", g_bus_id, index);
-    *res_len = 0;
+  if (client->mux) {
+    lib_submit(client, buf[0], &buf[1], n - 1);
+    return;
   }
 
-ipmb_handle_out:
-  // Reply to user with data
-  pthread_mutex_lock(&m_seq);
-  *res_len = g_seq.seq[index].len;
+  // Plain clients send exactly one request; just wait to reply now
+  epoll_ctl(g_epfd, EPOLL_CTL_DEL, client->src.fd, NULL);
+  lib_submit(client, 0, buf, n);
+}
 
-  g_seq.seq[index].in_use = false;
-  g_seq.seq[index].p_buf = NULL;
-  pthread_mutex_unlock(&m_seq);
+static void
+stats_serve(int s) {
+  char buf[2048];
+  uint64_t total = 0, sum = 0, up;
+  uint64_t p50 = 0, p99 = 0;
+  int cli, len, i;
+
+  if ((cli = obmc_stats_accept(s)) < 0) {
+    return;
+  }
 
-  pal_ipmb_finished(g_bus_id, request, *res_len);
+  for (i = 0; i < IPMB_LAT_BUCKETS; i++) {
+    total += g_stats.lat_hist[i];
+  }
+  // Upper bound of the histogram bucket holding the percentile
+  for (i = 0; i < IPMB_LAT_BUCKETS && total; i++) {
+    sum += g_stats.lat_hist[i];
+    if (!p50 && sum * 100 >= total * 50) {
+      p50 = 2ULL << i;
+    }
+    if (!p99 && sum * 100 >= total * 99) {
+      p99 = 2ULL << i;
+    }
+  }
 
-  return;
+  up = (now_us() - g_stats.start) / 1000000;
+  len = snprintf(buf, sizeof(buf),
+      "bus: %d, uptime: %llu s\n"
+      "requests:     %llu (%.1f/s), timeouts: %llu, rejected: %llu\n"
+      "latency (us): avg %llu, p50 < %llu, p99 < %llu, max %llu\n"
+      "responses:    %llu\n"
+      "rx:           requests %llu, responses %llu, unmatched %llu, errors %llu, dropped %llu\n"
+      "i2c:          retries %llu, errors %llu\n"
+      "tx queue:     depth %u, peak %u of %d\n",
+      g_bus_id, (unsigned long long)up,
+      (unsigned long long)g_stats.requests,
+      up ? (double)g_stats.requests / up : 0.0,
+      (unsigned long long)g_stats.timeouts, (unsigned long long)g_stats.rejected,
+      (unsigned long long)(g_stats.requests ? g_stats.lat_sum / g_stats.requests : 0),
+      (unsigned long long)p50, (unsigned long long)p99,
+      (unsigned long long)g_stats.lat_max,
+      (unsigned long long)g_stats.responses,
+      (unsigned long long)g_stats.rx_requests, (unsigned long long)g_stats.rx_responses,
+      (unsigned long long)g_stats.rx_unmatched, (unsigned long long)g_stats.rx_errors,
+      (unsigned long long)g_stats.rx_dropped,
+      (unsigned long long)g_stats.i2c_retries, (unsigned long long)g_stats.i2c_errors,
+      g_stats.txq_depth, g_stats.txq_peak, IPMB_TXQ_MAX);
+
+  obmc_stats_send(cli, buf, len);
 }
 
-void
-*conn_handler(void *sfd) {
-  ipmb_sfd_t *p_sfd = (ipmb_sfd_t *) sfd;
+static int
+print_stats(uint8_t bus) {
+  char path[64], name[32];
 
-  int sock = p_sfd->sock;
-  int fd = p_sfd->fd;
-  int n;
-  unsigned char req_buf[MAX_IPMB_RES_LEN];
-  unsigned char res_buf[MAX_IPMB_RES_LEN];
-  unsigned char res_len = 0;
-  struct timeval tv;
+  snprintf(path, sizeof(path), IPMBD_STATS_SOCK, bus);
+  snprintf(name, sizeof(name), "ipmbd for bus %d", bus);
+  return obmc_stats_print(path, name);
+}
 
-  // setup timeout for receving on socket
-  tv.tv_sec = TIMEOUT_IPMB;
-  tv.tv_usec = 0;
+static int
+engine_init(uint8_t bus) {
+  char path[64];
+  int i;
 
-  setsockopt(sock, SOL_SOCKET, SO_RCVTIMEO, (char *)&tv,sizeof(struct timeval));
+  tx_init();
+  g_stats.start = now_us();
 
-  n = recv(sock, req_buf, sizeof(req_buf), 0);
-  if (n <= 0) {
-      syslog(LOG_WARNING, "ipmbd: recv() failed with %d\n", n);
-      goto conn_cleanup;
+  // Open the i2c bus for sending requests and responses
+  g_i2c_fd = i2c_open(bus);
+  if (g_i2c_fd < 0) {
+    syslog(LOG_WARNING, "i2c_open failure\n");
+    return -1;
   }
 
-  if(bic_up_flag){
-      if(!((req_buf[1] == 0xe0) && (req_buf[5] == CMD_OEM_1S_ENABLE_BIC_UPDATE))){
-          goto conn_cleanup;
-	}
+  // Open the i2c bus as a slave
+  g_slave_fd = i2c_slave_open(bus);
+  if (g_slave_fd < 0) {
+    syslog(LOG_WARNING, "i2c_slave_open fails\n");
+    return -1;
   }
 
-  ipmb_handle(fd, req_buf, n, res_buf, &res_len);
+  snprintf(path, sizeof(path), "%s_%d", MQ_IPMB_REQ, bus);
+  g_mq_req = mq_open(path, O_WRONLY | O_NONBLOCK);
+  if (g_mq_req == (mqd_t) -1) {
+    syslog(LOG_WARNING, "mq_open req fails\n");
+    return -1;
+  }
 
-  if (send(sock, res_buf, res_len, MSG_NOSIGNAL) < 0) {
-#ifdef DEBUG
-    syslog(LOG_WARNING, "ipmbd: send() failed\n");
-#endif
+  g_epfd = epoll_create1(EPOLL_CLOEXEC);
+  g_evfd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+  g_tfd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+  if (g_epfd < 0 || g_evfd < 0 || g_tfd < 0) {
+    syslog(LOG_WARNING, "ipmbd: engine setup failed, errno: %d\n", errno);
+    return -1;
+  }
+
+  g_src[SRC_SLAVE].fd = g_slave_fd;
+  g_src[SRC_EVENT].fd = g_evfd;
+  g_src[SRC_TIMER].fd = g_tfd;
+
+  snprintf(path, sizeof(path), "%s_%d", SOCK_PATH_IPMB, bus);
+  g_src[SRC_LISTEN].fd = listen_sock(path, SOCK_STREAM);
+  snprintf(path, sizeof(path), "%s_%d", SOCK_PATH_IPMB_MUX, bus);
+  g_src[SRC_LISTEN_MUX].fd = listen_sock(path, SOCK_SEQPACKET);
+  snprintf(path, sizeof(path), IPMBD_STATS_SOCK, bus);
+  g_src[SRC_STATS].fd = obmc_stats_listen(path, SOCK_NONBLOCK);
+  if (g_src[SRC_LISTEN].fd < 0) {
+    return -1;
   }
 
-conn_cleanup:
-  close(sock);
-  free(p_sfd);
+  for (i = 0; i < SRC_CLIENT; i++) {
+    g_src[i].type = i;
+    if (g_src[i].fd < 0 || add_fd(g_src[i].fd, &g_src[i]) == 0) {
+      continue;
+    }
+    // Without poll support the slave is only read every IPMB_RX_POLL_MS
+    if (i != SRC_SLAVE) {
+      syslog(LOG_WARNING, "ipmbd: epoll_ctl failed, errno: %d\n", errno);
+      return -1;
+    }
+  }
 
-  pthread_exit(NULL);
   return 0;
 }
 
-// Thread to receive the IPMB lib messages from various apps
+// Thread running the transaction engine of the bus
 static void*
-ipmb_lib_handler(void *bus_num) {
-  int s, s2, len;
-  size_t t;
-  struct sockaddr_un local, remote;
-  pthread_t tid;
-  ipmb_sfd_t *sfd;
-  int fd;
+ipmb_engine(void *bus_num) {
   uint8_t *bnum = (uint8_t*) bus_num;
-  char sock_path[24] = {0};
-  int rc = 0;
-  pthread_attr_t attr;
+  struct epoll_event events[IPMB_MAX_EVENTS];
+  ipmb_src_t *src;
+  bool rx_more, tx_more = false;
+  uint64_t cnt;
+  int i, n;
 
-  // Open the i2c bus for sending request
-  fd = i2c_open(*bnum);
-  if (fd < 0) {
-    syslog(LOG_WARNING, "i2c_open failure\n");
+  if (engine_init(*bnum)) {
     return NULL;
   }
 
+  while (1) {
+    // The slave driver may not signal readiness, so look at it periodically
+    n = epoll_wait(g_epfd, events, IPMB_MAX_EVENTS,
+                   (rx_more || tx_more) ? 0 : IPMB_RX_POLL_MS);
+    if (n < 0 && errno != EINTR) {
+      syslog(LOG_WARNING, "ipmbd: epoll_wait failed, errno: %d\n", errno);
+    }
 
-  pthread_attr_init(&attr);
-  pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+    for (i = 0; i < n; i++) {
+      src = (ipmb_src_t *) events[i].data.ptr;
+      switch (src->type) {
+        case SRC_SLAVE:
+          // Drained below
+          break;
+        case SRC_EVENT:
+        case SRC_TIMER:
+          if (read(src->fd, &cnt, sizeof(cnt)) < 0) {
+            // Spurious wakeup
+          }
+          break;
+        case SRC_LISTEN:
+        case SRC_LISTEN_MUX:
+          client_accept(src);
+          break;
+        case SRC_STATS:
+          stats_serve(src->fd);
+          break;
+        case SRC_CLIENT:
+          client_read((ipmb_client_t *) src);
+          break;
+      }
+    }
 
-  if ((s = socket (AF_UNIX, SOCK_STREAM, 0)) == -1)
-  {
-    syslog(LOG_WARNING, "ipmbd: socket() failed\n");
-    exit (1);
+    rx_more = rx_drain();
+    check_timeouts();
+    tx_more = tx_kick();
+    arm_timer();
   }
 
-  snprintf(sock_path, sizeof(sock_path), "%s_%d", SOCK_PATH_IPMB, *bnum);
+  return NULL;
+}
 
-  local.sun_family = AF_UNIX;
-  strcpy (local.sun_path, sock_path);
-  unlink (local.sun_path);
-  len = strlen (local.sun_path) + sizeof (local.sun_family);
-  if (bind (s, (struct sockaddr *) &local, len) == -1)
-  {
-    syslog(LOG_WARNING, "ipmbd: bind() failed\n");
-    exit (1);
-  }
-
-  if (listen (s, 5) == -1)
-  {
-    syslog(LOG_WARNING, "ipmbd: listen() failed\n");
-    exit (1);
-  }
-
-  while(1) {
-    t = sizeof (remote);
-    // TODO: Seen accept() call failure and need further debug
-    if ((s2 = accept (s, (struct sockaddr *) &remote, &t)) < 0) {
-      rc = errno;
-      syslog(LOG_WARNING, "ipmbd: accept() failed with ret: %x, errno: %x\n", s2, rc);
-      sleep(5);
+// Thread to handle new requests
+static void*
+ipmb_req_handler(void *bus_num) {
+  uint8_t *bnum = (uint8_t*) bus_num;
+  mqd_t mq;
+  int i;
+
+  //Buffers for IPMB transport
+  uint8_t rxbuf[MQ_MAX_MSG_SIZE] = {0};
+  uint8_t txbuf[MQ_MAX_MSG_SIZE] = {0};
+  ipmb_req_t *p_ipmb_req;
+  ipmb_res_t *p_ipmb_res;
+
+  p_ipmb_req = (ipmb_req_t*) rxbuf;
+  p_ipmb_res = (ipmb_res_t*) txbuf;
+
+  //Buffers for IPMI Stack
+  uint8_t rbuf[MQ_MAX_MSG_SIZE] = {0};
+  uint8_t tbuf[MQ_MAX_MSG_SIZE] = {0};
+  ipmi_mn_req_t *p_ipmi_mn_req;
+  ipmi_res_t *p_ipmi_res;
+
+  p_ipmi_mn_req = (ipmi_mn_req_t*) rbuf;
+  p_ipmi_res = (ipmi_res_t*) tbuf;
+
+  uint8_t rlen = 0;
+  uint16_t tlen = 0;
+
+  char mq_ipmb_req[64] = {0};
+
+  sprintf(mq_ipmb_req, "%s_%d", MQ_IPMB_REQ, *bnum);
+
+  // Open Queue to receive requests
+  mq = mq_open(mq_ipmb_req, O_RDONLY);
+  if (mq == (mqd_t) -1) {
+    return NULL;
+  }
+
+  // Loop to process incoming requests
+  while (1) {
+    if ((rlen = mq_receive(mq, (char *)rxbuf, MQ_MAX_MSG_SIZE, NULL)) <= 0) {
+      sleep(1);
       continue;
     }
 
-    // Creating a worker thread to handle the request
-    // TODO: Need to monitor the server performance with higher load and
-    // see if we need to create pre-defined number of workers and schedule
-    // the requests among them.
-    sfd = (ipmb_sfd_t *) malloc(sizeof(ipmb_sfd_t));
-    sfd->fd = fd;
-    sfd->sock = s2;
-    if (pthread_create(&tid, &attr, conn_handler, (void*) sfd) < 0) {
-        syslog(LOG_WARNING, "ipmbd: pthread_create failed\n");
-        close(s2);
-        continue;
+    pal_ipmb_processing(g_bus_id, rxbuf, rlen);
+
+#ifdef DEBUG
+    syslog(LOG_WARNING, "Received Request of %d bytes\n", rlen);
+    for (i = 0; i < rlen; i++) {
+      syslog(LOG_WARNING, "0x%X", rxbuf[i]);
     }
+#endif
 
-  }
+    // Create IPMI request from IPMB data
+    p_ipmi_mn_req->payload_id = g_payload_id;
+    p_ipmi_mn_req->netfn_lun = p_ipmb_req->netfn_lun;
+    p_ipmi_mn_req->cmd = p_ipmb_req->cmd;
 
-  close(s);
-  pthread_mutex_destroy(&m_seq);
-  pthread_attr_destroy(&attr);
+    memcpy(p_ipmi_mn_req->data, p_ipmb_req->data, rlen - IPMB_HDR_SIZE - IPMI_REQ_HDR_SIZE);
 
-  return 0;
+    // Send to IPMI stack and get response
+    // Additional byte as we are adding and passing payload ID for MN support
+    lib_ipmi_handle(rbuf, rlen - IPMB_HDR_SIZE + 1, tbuf, &tlen);
+
+    // Populate IPMB response data from IPMB request
+    p_ipmb_res->req_slave_addr = p_ipmb_req->req_slave_addr;
+    p_ipmb_res->res_slave_addr = p_ipmb_req->res_slave_addr;
+    p_ipmb_res->cmd = p_ipmb_req->cmd;
+    p_ipmb_res->seq_lun = p_ipmb_req->seq_lun;
+
+    // Add IPMI response data
+    p_ipmb_res->netfn_lun = p_ipmi_res->netfn_lun;
+    p_ipmb_res->cc = p_ipmi_res->cc;
+
+    memcpy(p_ipmb_res->data, p_ipmi_res->data, tlen - IPMI_RESP_HDR_SIZE);
+
+    // Calculate Header Checksum
+    p_ipmb_res->hdr_cksum = p_ipmb_res->req_slave_addr +
+                           p_ipmb_res->netfn_lun;
+    p_ipmb_res->hdr_cksum = ZERO_CKSUM_CONST - p_ipmb_res->hdr_cksum;
+
+    // Calculate Data Checksum
+    p_ipmb_res->data[tlen-IPMI_RESP_HDR_SIZE] = p_ipmb_res->res_slave_addr +
+                            p_ipmb_res->seq_lun +
+                            p_ipmb_res->cmd +
+                            p_ipmb_res->cc;
+
+    for (i = 0; i < tlen-IPMI_RESP_HDR_SIZE; i++) {
+      p_ipmb_res->data[tlen-IPMI_RESP_HDR_SIZE] += p_ipmb_res->data[i];
+    }
+
+    p_ipmb_res->data[tlen-IPMI_RESP_HDR_SIZE] = ZERO_CKSUM_CONST -
+                                      p_ipmb_res->data[tlen-IPMI_RESP_HDR_SIZE];
+
+#ifdef DEBUG
+    syslog(LOG_WARNING, "Sending Response of %d bytes\n", tlen+IPMB_HDR_SIZE-1);
+    for (i = 0; i < tlen+IPMB_HDR_SIZE; i++) {
+      syslog(LOG_WARNING, "0x%X:", txbuf[i]);
+    }
+#endif
+
+    // Queue response for the engine to send back
+    if (ipmb_submit_res(txbuf, tlen+IPMB_HDR_SIZE)) {
+      syslog(LOG_WARNING, "bus: %d, transmit queue full, response dropped\n", g_bus_id);
+      pal_ipmb_finished(g_bus_id, txbuf, tlen+IPMB_HDR_SIZE);
+    }
+  }
 }
 
 int
 main(int argc, char * const argv[]) {
-  pthread_t tid_ipmb_rx;
-  pthread_t tid_req_handler;
-  pthread_t tid_res_handler;
-  pthread_t tid_lib_handler;
+  pthread_t tid_req_handler = 0;
+  pthread_t tid_engine = 0;
   uint8_t ipmb_bus_num;
-  mqd_t mqd_req = (mqd_t)-1, mqd_res = (mqd_t)-1;
+  mqd_t mqd_req = (mqd_t)-1;
   struct mq_attr attr;
   char mq_ipmb_req[64] = {0};
-  char mq_ipmb_res[64] = {0};
   int rc = 0;
 
+  if ((argc == 3) && !strcmp(argv[1], "--stats")) {
+    return print_stats((uint8_t)strtoul(argv[2], NULL, 0)) ? 1 : 0;
+  }
+
   if (argc < 3) {
     syslog(LOG_WARNING, "ipmbd: Usage: ipmbd <bus#> <payload#> [bicup = allow bic updates]");
+    syslog(LOG_WARNING, "ipmbd: Usage: ipmbd --stats <bus#>");
     exit(1);
   }
 
@@ -864,16 +1240,13 @@ main(int argc, char * const argv[]) {
     bic_up_flag = 0;
   }
 
-  pthread_mutex_init(&m_i2c, NULL);
-
-  // Create Message Queues for Request Messages and Response Messages
+  // Create Message Queue for Request Messages
   attr.mq_flags = 0;
   attr.mq_maxmsg = MQ_MAX_NUM_MSGS;
   attr.mq_msgsize = MQ_MAX_MSG_SIZE;
   attr.mq_curmsgs = 0;
 
   sprintf(mq_ipmb_req, "%s_%d", MQ_IPMB_REQ, ipmb_bus_num);
-  sprintf(mq_ipmb_res, "%s_%d", MQ_IPMB_RES, ipmb_bus_num);
 
   // Remove the MQ if exists
   mq_unlink(mq_ipmb_req);
@@ -885,70 +1258,31 @@ main(int argc, char * const argv[]) {
     goto cleanup;
   }
 
-  // Remove the MQ if exists
-  mq_unlink(mq_ipmb_res);
-
-  mqd_res = mq_open(mq_ipmb_res, O_RDONLY | O_CREAT, S_IRUSR | S_IWUSR | S_IRGRP | S_IROTH, &attr);
-  if (mqd_res == (mqd_t) -1) {
-    rc = errno;
-    syslog(LOG_WARNING, "ipmbd: mq_open response failed errno: %d\n", rc);
-    goto cleanup;
-  }
-
-  seq_init();
-
   // Create thread to handle IPMB Requests
   if (pthread_create(&tid_req_handler, NULL, ipmb_req_handler, (void*) &ipmb_bus_num) < 0) {
     syslog(LOG_WARNING, "ipmbd: pthread_create failed\n");
     goto cleanup;
   }
 
-  // Create thread to handle IPMB Responses
-  if (pthread_create(&tid_res_handler, NULL, ipmb_res_handler, (void*) &ipmb_bus_num) < 0) {
-    syslog(LOG_WARNING, "ipmbd: pthread_create failed\n");
-    goto cleanup;
-  }
-
-  // Create thread to retrieve ipmb traffic from i2c bus as slave
-  if (pthread_create(&tid_ipmb_rx, NULL, ipmb_rx_handler, (void*) &ipmb_bus_num) < 0) {
-    syslog(LOG_WARNING, "ipmbd: pthread_create failed\n");
-    goto cleanup;
-  }
-
-  // Create thread to receive ipmb library requests from apps
-  if (pthread_create(&tid_lib_handler, NULL, ipmb_lib_handler, (void*) &ipmb_bus_num) < 0) {
+  // Create thread to run the transaction engine
+  if (pthread_create(&tid_engine, NULL, ipmb_engine, (void*) &ipmb_bus_num) < 0) {
     syslog(LOG_WARNING, "ipmbd: pthread_create failed\n");
     goto cleanup;
   }
 
 cleanup:
-  if (tid_ipmb_rx > 0) {
-    pthread_join(tid_ipmb_rx, NULL);
+  if (tid_engine > 0) {
+    pthread_join(tid_engine, NULL);
   }
 
   if (tid_req_handler > 0) {
     pthread_join(tid_req_handler, NULL);
   }
 
-  if (tid_res_handler > 0) {
-    pthread_join(tid_res_handler, NULL);
-  }
-
-  if (tid_lib_handler > 0) {
-    pthread_join(tid_lib_handler, NULL);
-  }
-
-  if (mqd_res > 0) {
-    mq_close(mqd_res);
-    mq_unlink(mq_ipmb_res);
-  }
-
   if (mqd_req > 0) {
     mq_close(mqd_req);
     mq_unlink(mq_ipmb_req);
   }
 
-  pthread_mutex_destroy(&m_i2c);
-
   return 0;
 }
@@ -0,0 +1,500 @@
+/*
+ *
+ * Copyright 2018-present Facebook. All Rights Reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+/*
+ * Load generator for the ipmid request sockets.
+ *
+ * ipmid-bench [-c clients] [-n requests] [-p payload] [-o | -s [-d depth]]
+ *             [-R restart-cmd] [netfn:cmd[:data..]]..
+ *
+ * Every client thread sends the request mix round-robin over one persistent
+ * connection, or over a new connection per request with -o as the legacy
+ * lib_ipmi_handle does, and latency is reported per NetFn. Values are hex.
+ * The default mix is read-only: Get Device ID, Get SEL Info, Get SDR Info
+ * and OEM Get Board ID.
+ *
+ * With -s the clients go through ipmi_client on the packet socket instead,
+ * keeping up to depth requests in flight, and every response is checked
+ * against the command of the oldest request still due. The mix should not
+ * repeat a command back to back for the check to see reordering.
+ *
+ * -R checks that one ipmi_client carries on across an ipmid restart: a
+ * pipelined round of the mix, restart-cmd run through the shell, then
+ * another round on the same client once ipmid answers again.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <time.h>
+#include <pthread.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <openbmc/ipmi.h>
+
+#define MAX_MIX       16
+#define MAX_CLIENTS   64
+#define RESTART_WAIT  30          // Seconds for ipmid to come back
+
+typedef struct {
+  uint8_t netfn;
+  uint8_t cmd;
+  uint8_t data[MAX_IPMI_MSG_SIZE];
+  int len;
+} bench_req_t;
+
+typedef struct {
+  pthread_t tid;
+  int nreq;
+  uint32_t *lat[MAX_MIX];     // Microseconds, one array per mix entry
+  int cnt[MAX_MIX];
+  int err[MAX_MIX];
+  int order;                  // Responses to some other request
+} bench_client_t;
+
+static bench_req_t g_mix[MAX_MIX];
+static int g_nmix;
+static int g_oneshot;
+static int g_seq;
+static int g_depth = 4;
+static uint8_t g_payload = 1;
+
+static uint64_t
+now_us(void)
+{
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+static int
+bench_connect(void)
+{
+  struct sockaddr_un remote;
+  struct timeval tv;
+  int s;
+
+  if ((s = socket(AF_UNIX, SOCK_STREAM, 0)) < 0) {
+    return -1;
+  }
+
+  tv.tv_sec = TIMEOUT_IPMI + 1;
+  tv.tv_usec = 0;
+  setsockopt(s, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+
+  memset(&remote, 0, sizeof(remote));
+  remote.sun_family = AF_UNIX;
+  strcpy(remote.sun_path, SOCK_PATH_IPMI);
+  if (connect(s, (struct sockaddr *)&remote, sizeof(remote)) < 0) {
+    close(s);
+    return -1;
+  }
+
+  return s;
+}
+
+static int
+bench_xfer(int s, bench_req_t *req)
+{
+  uint8_t tbuf[MAX_IPMI_MSG_SIZE];
+  uint8_t rbuf[MAX_IPMI_MSG_SIZE];
+  int n;
+
+  tbuf[0] = g_payload;
+  tbuf[1] = req->netfn << 2;
+  tbuf[2] = req->cmd;
+  memcpy(&tbuf[3], req->data, req->len);
+
+  if (send(s, tbuf, req->len + 3, MSG_NOSIGNAL) < 0) {
+    return -1;
+  }
+
+  n = recv(s, rbuf, sizeof(rbuf), 0);
+  if (n < 3 || rbuf[1] != req->cmd) {
+    return -1;
+  }
+
+  return 0;
+}
+
+static int
+bench_send(ipmi_client_t *client, bench_req_t *req)
+{
+  uint8_t tbuf[MAX_IPMI_MSG_SIZE];
+
+  tbuf[0] = g_payload;
+  tbuf[1] = req->netfn << 2;
+  tbuf[2] = req->cmd;
+  memcpy(&tbuf[3], req->data, req->len);
+
+  return ipmi_client_send(client, tbuf, req->len + 3);
+}
+
+/* -1 if the connection failed, -2 if the response is not to req */
+static int
+bench_recv(ipmi_client_t *client, bench_req_t *req)
+{
+  uint8_t rbuf[MAX_IPMI_MSG_SIZE];
+  unsigned short rlen;
+
+  if (ipmi_client_recv(client, rbuf, &rlen) < 0) {
+    return -1;
+  }
+  if (rlen < 3 || rbuf[1] != req->cmd) {
+    return -2;
+  }
+
+  return 0;
+}
+
+/* Pipelined requests over one ipmi_client, answered in order */
+static void *
+bench_client_seq(void *arg)
+{
+  bench_client_t *cl = (bench_client_t *)arg;
+  ipmi_client_t *client;
+  uint64_t start[IPMI_CLIENT_MAX_PENDING];
+  int mix[IPMI_CLIENT_MAX_PENDING];
+  int head = 0, inflight = 0, sent = 0;
+  int m, ret;
+
+  if ((client = ipmi_client_open()) == NULL) {
+    for (sent = 0; sent < cl->nreq; sent++) {
+      cl->err[sent % g_nmix]++;
+    }
+    return NULL;
+  }
+
+  while (sent < cl->nreq || inflight > 0) {
+    if (sent < cl->nreq && inflight < g_depth) {
+      m = sent++ % g_nmix;
+      if (bench_send(client, &g_mix[m]) < 0) {
+        cl->err[m]++;
+        // A failed send drops the connection with the responses due
+        if (ipmi_client_pending(client) != inflight) {
+          for (; inflight > 0; inflight--, head = (head + 1) % g_depth) {
+            cl->err[mix[head]]++;
+          }
+        }
+        continue;
+      }
+      start[(head + inflight) % g_depth] = now_us();
+      mix[(head + inflight) % g_depth] = m;
+      inflight++;
+      continue;
+    }
+
+    m = mix[head];
+    ret = bench_recv(client, &g_mix[m]);
+    if (ret == -1) {
+      // The connection is gone and with it all the responses due
+      for (; inflight > 0; inflight--, head = (head + 1) % g_depth) {
+        cl->err[mix[head]]++;
+      }
+      continue;
+    }
+    if (ret == -2) {
+      cl->err[m]++;
+      cl->order++;
+    } else {
+      cl->lat[m][cl->cnt[m]++] = now_us() - start[head];
+    }
+    head = (head + 1) % g_depth;
+    inflight--;
+  }
+
+  ipmi_client_close(client);
+  return NULL;
+}
+
+/* One pipelined pass of the mix, returns the number of failed requests */
+static int
+bench_round(ipmi_client_t *client, const char *phase)
+{
+  int n = g_nmix < IPMI_CLIENT_MAX_PENDING ? g_nmix : IPMI_CLIENT_MAX_PENDING;
+  int i, sent, ret, fail = 0;
+
+  for (sent = 0; sent < n && bench_send(client, &g_mix[sent]) == 0; sent++)
+    ;
+  fail += n - sent;
+  for (i = 0; i < sent; i++) {
+    ret = bench_recv(client, &g_mix[i]);
+    if (ret < 0) {
+      printf("%s: request %d (%02x:%02x) %s\n", phase, i, g_mix[i].netfn,
+             g_mix[i].cmd, ret == -1 ? "got no response" : "answered out of order");
+      fail++;
+    }
+    if (ret == -1) {
+      fail += sent - i - 1;
+      break;
+    }
+  }
+
+  return fail;
+}
+
+static int
+bench_restart(const char *cmd)
+{
+  ipmi_client_t *client;
+  uint64_t deadline;
+  int fail;
+
+  if ((client = ipmi_client_open()) == NULL) {
+    printf("Out of memory\n");
+    return -1;
+  }
+
+  fail = bench_round(client, "before restart");
+  if (fail == 0) {
+    printf("Restarting ipmid: %s\n", cmd);
+    if (system(cmd) != 0) {
+      printf("%s failed\n", cmd);
+      fail = -1;
+    }
+  }
+
+  if (fail == 0) {
+    // The first requests fail until ipmid listens again
+    deadline = now_us() + RESTART_WAIT * 1000000ULL;
+    while ((fail = bench_round(client, "after restart")) > 0 &&
+           now_us() < deadline) {
+      usleep(100000);
+    }
+  }
+
+  ipmi_client_close(client);
+  printf("restart: %s\n", fail ? "FAIL" : "PASS");
+  return fail ? -1 : 0;
+}
+
+static void *
+bench_client(void *arg)
+{
+  bench_client_t *cl = (bench_client_t *)arg;
+  uint64_t start;
+  int i, m, s = -1;
+
+  for (i = 0; i < cl->nreq; i++) {
+    m = i % g_nmix;
+    start = now_us();
+
+    if (s < 0 && (s = bench_connect()) < 0) {
+      cl->err[m]++;
+      continue;
+    }
+    if (bench_xfer(s, &g_mix[m]) < 0) {
+      cl->err[m]++;
+      close(s);
+      s = -1;
+      continue;
+    }
+    if (g_oneshot) {
+      close(s);
+      s = -1;
+    }
+
+    cl->lat[m][cl->cnt[m]++] = now_us() - start;
+  }
+
+  if (s >= 0) {
+    close(s);
+  }
+  return NULL;
+}
+
+static int
+cmp_u32(const void *a, const void *b)
+{
+  uint32_t x = *(const uint32_t *)a, y = *(const uint32_t *)b;
+
+  return (x > y) - (x < y);
+}
+
+static int
+parse_req(char *str, bench_req_t *req)
+{
+  char *tok, *save = NULL;
+  int i = 0;
+
+  memset(req, 0, sizeof(*req));
+  for (tok = strtok_r(str, ":", &save); tok; tok = strtok_r(NULL, ":", &save), i++) {
+    if (i == 0) {
+      req->netfn = strtoul(tok, NULL, 16);
+    } else if (i == 1) {
+      req->cmd = strtoul(tok, NULL, 16);
+    } else if (req->len < MAX_IPMI_MSG_SIZE - 3) {
+      req->data[req->len++] = strtoul(tok, NULL, 16);
+    }
+  }
+
+  return (i >= 2) ? 0 : -1;
+}
+
+static void
+print_usage(const char *prog)
+{
+  printf("Usage: %s [-c clients] [-n requests] [-p payload] [-o | -s [-d depth]] "
+         "[-R restart-cmd] [netfn:cmd[:data..]]..\n", prog);
+  printf("       -o: open a new connection for every request\n");
+  printf("       -s: pipeline up to depth requests on the packet socket\n");
+  printf("       -R: check a client reconnects across restart-cmd\n");
+}
+
+int
+main(int argc, char *argv[])
+{
+  static bench_client_t clients[MAX_CLIENTS];
+  uint8_t nfs[MAX_MIX];
+  uint32_t *all;
+  char *restart = NULL;
+  int nclients = 4, nreq = 10000;
+  int opt, i, c, m, k, total, errs, order = 0, nnf = 0;
+  uint64_t start, elapsed;
+
+  while ((opt = getopt(argc, argv, "c:n:p:osd:R:")) != -1) {
+    switch (opt) {
+      case 'c':
+        nclients = atoi(optarg);
+        break;
+      case 'n':
+        nreq = atoi(optarg);
+        break;
+      case 'p':
+        g_payload = atoi(optarg);
+        break;
+      case 'o':
+        g_oneshot = 1;
+        break;
+      case 's':
+        g_seq = 1;
+        break;
+      case 'd':
+        g_depth = atoi(optarg);
+        break;
+      case 'R':
+        restart = optarg;
+        break;
+      default:
+        print_usage(argv[0]);
+        return -1;
+    }
+  }
+
+  for (i = optind; i < argc && g_nmix < MAX_MIX; i++) {
+    if (parse_req(argv[i], &g_mix[g_nmix++]) < 0) {
+      print_usage(argv[0]);
+      return -1;
+    }
+  }
+  if (g_nmix == 0) {
+    g_mix[g_nmix++] = (bench_req_t){NETFN_APP_REQ, CMD_APP_GET_DEVICE_ID};
+    g_mix[g_nmix++] = (bench_req_t){NETFN_STORAGE_REQ, CMD_STORAGE_GET_SEL_INFO};
+    g_mix[g_nmix++] = (bench_req_t){NETFN_STORAGE_REQ, CMD_STORAGE_GET_SDR_INFO};
+    g_mix[g_nmix++] = (bench_req_t){NETFN_OEM_REQ, CMD_OEM_GET_BOARD_ID};
+  }
+
+  if (nclients <= 0 || nclients > MAX_CLIENTS || nreq <= 0 ||
+      (g_oneshot && g_seq) || g_depth <= 0 || g_depth > IPMI_CLIENT_MAX_PENDING) {
+    print_usage(argv[0]);
+    return -1;
+  }
+
+  if (restart) {
+    return bench_restart(restart);
+  }
+
+  for (c = 0; c < nclients; c++) {
+    clients[c].nreq = nreq;
+    for (m = 0; m < g_nmix; m++) {
+      clients[c].lat[m] = calloc(nreq / g_nmix + 1, sizeof(uint32_t));
+      if (!clients[c].lat[m]) {
+        printf("Out of memory\n");
+        return -1;
+      }
+    }
+  }
+
+  start = now_us();
+  for (c = 0; c < nclients; c++) {
+    pthread_create(&clients[c].tid, NULL, g_seq ? bench_client_seq : bench_client,
+                   &clients[c]);
+  }
+  for (c = 0; c < nclients; c++) {
+    pthread_join(clients[c].tid, NULL);
+  }
+  elapsed = now_us() - start;
+
+  // Several mix entries may share a NetFn
+  for (m = 0; m < g_nmix; m++) {
+    for (k = 0; k < nnf && nfs[k] != g_mix[m].netfn; k++)
+      ;
+    if (k == nnf) {
+      nfs[nnf++] = g_mix[m].netfn;
+    }
+  }
+
+  all = calloc((size_t)nclients * nreq, sizeof(uint32_t));
+  if (!all) {
+    printf("Out of memory\n");
+    return -1;
+  }
+
+  printf("%d clients x %d requests, %s connections, %.0f req/s\n",
+         nclients, nreq, g_oneshot ? "one-shot" : g_seq ? "pipelined" : "persistent",
+         (double)nclients * nreq * 1000000 / elapsed);
+  printf("%-6s %8s %6s %10s %10s %10s\n", "NetFn", "count", "errors",
+         "p50(us)", "p99(us)", "max(us)");
+
+  for (k = 0; k < nnf; k++) {
+    total = errs = 0;
+    for (c = 0; c < nclients; c++) {
+      for (m = 0; m < g_nmix; m++) {
+        if (g_mix[m].netfn != nfs[k])
+          continue;
+        memcpy(&all[total], clients[c].lat[m], clients[c].cnt[m] * sizeof(uint32_t));
+        total += clients[c].cnt[m];
+        errs += clients[c].err[m];
+      }
+    }
+
+    if (total == 0) {
+      printf("0x%02x   %8d %6d %10s %10s %10s\n", nfs[k], 0, errs, "-", "-", "-");
+      continue;
+    }
+    qsort(all, total, sizeof(uint32_t), cmp_u32);
+    printf("0x%02x   %8d %6d %10u %10u %10u\n", nfs[k], total, errs,
+           all[(total - 1) * 50 / 100], all[(total - 1) * 99 / 100],
+           all[total - 1]);
+  }
+
+  for (c = 0; c < nclients; c++) {
+    order += clients[c].order;
+  }
+  if (order) {
+    printf("%d responses out of order\n", order);
+    return -1;
+  }
+
+  return 0;
+}
@@ -33,6 +33,8 @@
 #include <sys/types.h>
 #include <sys/socket.h>
 #include <sys/un.h>
+#include <sys/epoll.h>
+#include <time.h>
 #include <openbmc/ipmi.h>
 #include <openbmc/pal.h>
 #include <sys/reboot.h>
@@ -45,6 +47,9 @@
 #define SIZE_IANA_ID 3
 #define SIZE_GUID 16
 
+// SEL records per OEM Get SEL Range response; keeps it within 255 bytes
+#define SEL_RANGE_MAX 14
+
 //declare for clearing BIOS flag
 #define BIOS_Timeout 600
 // Boot valid flag
@@ -145,16 +150,19 @@ static char *drive_info_key[] =
   "wwn"
 };
 
-// TODO: Based on performance testing results, might need fine grained locks
-// Since the global data is specific to a NetFunction, adding locs at NetFn level
+// Most global data is specific to a NetFunction, so those are locked at
+// NetFn level. The busy NetFns lock the resource a command touches instead:
+// SEL and SDR lock inside sel.c/sdr.c, OEM commands lock per command (a
+// Get shares the lock of its Set) and OEM 1S locks per payload, so that
+// unrelated requests from different hosts do not queue behind each other.
 static pthread_mutex_t m_chassis;
 static pthread_mutex_t m_sensor;
 static pthread_mutex_t m_app;
-static pthread_mutex_t m_storage;
+static pthread_mutex_t m_fruid;
 static pthread_mutex_t m_transport;
-static pthread_mutex_t m_oem;
+static pthread_mutex_t m_oem[256];
 static pthread_mutex_t m_oem_storage;
-static pthread_mutex_t m_oem_1s;
+static pthread_mutex_t m_oem_1s[MAX_NODES+1];
 static pthread_mutex_t m_oem_usb_dbg;
 static pthread_mutex_t m_oem_q;
 
@@ -1285,8 +1293,13 @@ storage_get_sel_info (unsigned char *request, unsigned char *response,
   // Use platform APIs to get SEL information
   num_entries = sel_num_entries (req->payload_id);
   free_space = sel_free_space (req->payload_id);
-  sel_ts_recent_add (req->payload_id, &ts_recent_add);
-  sel_ts_recent_erase (req->payload_id, &ts_recent_erase);
+  if (num_entries < 0 || free_space < 0 ||
+      sel_ts_recent_add (req->payload_id, &ts_recent_add) ||
+      sel_ts_recent_erase (req->payload_id, &ts_recent_erase))
+  {
+    res->cc = CC_PARAM_OUT_OF_RANGE;
+    return;
+  }
 
   res->cc = CC_SUCCESS;
 
@@ -1322,7 +1335,7 @@ storage_rsv_sel (unsigned char * request, unsigned char *response,
   rsv_id = sel_rsv_id (req->payload_id);
   if (rsv_id < 0)
   {
-      res->cc = CC_SEL_ERASE_PROG;
+      res->cc = CC_PARAM_OUT_OF_RANGE;
       return;
   }
 
@@ -1509,14 +1522,17 @@ ipmi_handle_storage (unsigned char *request, unsigned char req_len,
   res->cc = CC_SUCCESS;
   *res_len = 0;
 
-  pthread_mutex_lock(&m_storage);
   switch (cmd)
   {
     case CMD_STORAGE_GET_FRUID_INFO:
+      pthread_mutex_lock(&m_fruid);
       storage_get_fruid_info (request, response, res_len);
+      pthread_mutex_unlock(&m_fruid);
       break;
     case CMD_STORAGE_READ_FRUID_DATA:
+      pthread_mutex_lock(&m_fruid);
       storage_get_fruid_data (request, response, res_len);
+      pthread_mutex_unlock(&m_fruid);
       break;
     case CMD_STORAGE_GET_SEL_INFO:
       storage_get_sel_info (request, response, res_len);
@@ -1557,7 +1573,6 @@ ipmi_handle_storage (unsigned char *request, unsigned char req_len,
       break;
   }
 
-  pthread_mutex_unlock(&m_storage);
   return;
 }
 
@@ -2970,6 +2985,100 @@ oem_stor_add_string_sel(unsigned char *request, unsigned char req_len,
   return;
 }
 
+static void
+oem_stor_get_sel_range(unsigned char *request, unsigned char req_len,
+                       unsigned char *response, unsigned char *res_len)
+{
+  // Request:
+  // Byte0:1      Reserved
+  // Byte2:3      Record ID to start at, 0000h for the first record
+  // Byte4        Maximum number of records
+  // Byte5:8      Optional, start at the first record logged at or after
+  //              this time stamp instead (LSB first)
+  // Response:
+  // Byte0:1      Next record ID, FFFFh once the end of the log is reached
+  // Byte2        Number of records returned
+  // Byte3~ByteN  Records, 16 bytes each
+  ipmi_mn_req_t *req = (ipmi_mn_req_t *) request;
+  ipmi_res_t *res = (ipmi_res_t *) response;
+  unsigned char *data = &res->data[0];
+  sel_msg_t entries[SEL_RANGE_MAX];
+  int data_len = req_len - IPMI_MN_REQ_HDR_SIZE;
+  int read_rec_id, next_rec_id = 0xFFFF;
+  int max, num, cnt = 0;
+  uint32_t ts;
+
+  *res_len = 0;
+
+  if (data_len != 5 && data_len != 9) {
+    res->cc = CC_INVALID_LENGTH;
+    return;
+  }
+
+  num = sel_num_entries(req->payload_id);
+  if (num < 0) {
+    res->cc = CC_PARAM_OUT_OF_RANGE;
+    return;
+  }
+
+  read_rec_id = (req->data[3] << 8) | req->data[2];
+  max = req->data[4];
+  if (max == 0 || max > SEL_RANGE_MAX) {
+    max = SEL_RANGE_MAX;
+  }
+
+  if (data_len == 9) {
+    ts = req->data[5] | (req->data[6] << 8) | (req->data[7] << 16) |
+         ((uint32_t)req->data[8] << 24);
+    read_rec_id = sel_find_ts(req->payload_id, ts);
+  }
+
+  if (read_rec_id >= 0 && num) {
+    cnt = sel_get_entries(req->payload_id, read_rec_id, entries, max, &next_rec_id);
+    if (cnt < 0) {
+      res->cc = CC_PARAM_OUT_OF_RANGE;
+      return;
+    }
+  }
+
+  res->cc = CC_SUCCESS;
+  *data++ = next_rec_id & 0xFF;
+  *data++ = (next_rec_id >> 8) & 0xFF;
+  *data++ = cnt;
+
+  memcpy(data, entries, cnt * sizeof(sel_msg_t));
+  data += cnt * sizeof(sel_msg_t);
+
+  *res_len = data - &res->data[0];
+}
+
+// Lock for an OEM command; commands sharing state share a lock
+static pthread_mutex_t *
+oem_cmd_lock (unsigned char cmd)
+{
+  switch (cmd)
+  {
+    case CMD_OEM_GET_PROC_INFO:
+      return &m_oem[CMD_OEM_SET_PROC_INFO];
+    case CMD_OEM_GET_DIMM_INFO:
+      return &m_oem[CMD_OEM_SET_DIMM_INFO];
+    case CMD_OEM_GET_BOOT_ORDER:
+      return &m_oem[CMD_OEM_SET_BOOT_ORDER];
+    case CMD_OEM_GET_PPR:
+    case CMD_OEM_LEGACY_SET_PPR:
+    case CMD_OEM_LEGACY_GET_PPR:
+      return &m_oem[CMD_OEM_SET_PPR];
+    case CMD_OEM_SET_POST_END:
+      return &m_oem[CMD_OEM_SET_POST_START];
+    case CMD_OEM_GET_BIOS_FLASH_INFO:
+      return &m_oem[CMD_OEM_SET_BIOS_FLASH_INFO];
+    case CMD_OEM_GET_PCIE_PORT_CONFIG:
+      return &m_oem[CMD_OEM_SET_PCIE_PORT_CONFIG];
+    default:
+      return &m_oem[cmd];
+  }
+}
+
 static void
 ipmi_handle_oem (unsigned char *request, unsigned char req_len,
      unsigned char *response, unsigned char *res_len)
@@ -2978,8 +3087,9 @@ ipmi_handle_oem (unsigned char *request, unsigned char req_len,
   ipmi_res_t *res = (ipmi_res_t *) response;
 
   unsigned char cmd = req->cmd;
+  pthread_mutex_t *lock = oem_cmd_lock(cmd);
 
-  pthread_mutex_lock(&m_oem);
+  pthread_mutex_lock(lock);
   switch (cmd)
   {
     case CMD_OEM_ADD_RAS_SEL:
@@ -3079,7 +3189,7 @@ ipmi_handle_oem (unsigned char *request, unsigned char req_len,
       res->cc = CC_INVALID_CMD;
       break;
   }
-  pthread_mutex_unlock(&m_oem);
+  pthread_mutex_unlock(lock);
 }
 
 static void
@@ -3097,6 +3207,9 @@ ipmi_handle_oem_storage (unsigned char *request, unsigned char req_len,
     case CMD_OEM_STOR_ADD_STRING_SEL:
       oem_stor_add_string_sel (request, req_len, response, res_len);
       break;
+    case CMD_OEM_STOR_GET_SEL_RANGE:
+      oem_stor_get_sel_range (request, req_len, response, res_len);
+      break;
     default:
       res->cc = CC_INVALID_CMD;
       break;
@@ -3225,19 +3338,23 @@ ipmi_handle_oem_1s(unsigned char *request, unsigned char req_len,
   int i;
 
   unsigned char cmd = req->cmd;
+  pthread_mutex_t *lock;
+
+  // Requests for different payloads do not share any state
+  lock = &m_oem_1s[(req->payload_id <= MAX_NODES) ? req->payload_id : 0];
 
-  pthread_mutex_lock(&m_oem_1s);
+  pthread_mutex_lock(lock);
   switch (cmd)
   {
     case CMD_OEM_1S_MSG_IN:
       // Add unlock-lock mechanism whenever BIC send second NetFn 0x38 to BMC.
       // Avoid deadlock of the same NetFn.
       if (req->data[4] == (NETFN_OEM_1S_REQ << 2)) {
-        pthread_mutex_unlock(&m_oem_1s);
+        pthread_mutex_unlock(lock);
       }
       oem_1s_handle_ipmb_req(request, req_len, response, res_len);
       if (req->data[4] == (NETFN_OEM_1S_REQ << 2)) {
-        pthread_mutex_lock(&m_oem_1s);
+        pthread_mutex_lock(lock);
       }
       break;
     case CMD_OEM_1S_INTR:
@@ -3333,7 +3450,7 @@ ipmi_handle_oem_1s(unsigned char *request, unsigned char req_len,
       *res_len = 3;
       break;
   }
-  pthread_mutex_unlock(&m_oem_1s);
+  pthread_mutex_unlock(lock);
 }
 
 static void
@@ -3631,42 +3748,344 @@ ipmi_handle (unsigned char *request, unsigned char req_len,
   return;
 }
 
-void
-*conn_handler(void *socket_desc) {
-  int *p_sock = (int*)socket_desc;
-  int sock = *p_sock;
-  int n;
-  unsigned char req_buf[MAX_IPMI_MSG_SIZE];
+/*
+ * Request dispatcher
+ *
+ * The main thread waits on the listening socket and all client connections
+ * with epoll and hands every readable connection to a fixed pool of
+ * workers. A connection is armed one-shot, so exactly one worker owns it
+ * while a request is in flight, and is re-armed once the response is sent.
+ * Clients may keep their connection open for any number of requests; the
+ * legacy one request per connection clients keep working unchanged.
+ *
+ * A second, SOCK_SEQPACKET socket keeps the boundaries of every message,
+ * so its clients may send several requests without waiting; they are
+ * answered one at a time in the order they were sent.
+ *
+ * Commands which may go out to the hardware, a bridge IC or the PAL can
+ * take seconds. Workers hand those to a separate pool, so they can never
+ * occupy every worker and stall SEL, SDR and FRU clients. The slow pool
+ * starts small and adds a thread whenever a command would otherwise wait
+ * behind busy ones, so one hung BIC does not hold up the other slots.
+ */
+#define IPMI_WORKERS        8
+#define IPMI_SLOW_WORKERS   2     // Started up front
+#define IPMI_SLOW_WORKERS_MAX 16  // Grown to on demand
+#define IPMI_MAX_CONNS      256
+#define IPMI_MAX_EVENTS     32
+#define IPMI_IDLE_TIMEOUT   60    // Seconds an idle client is kept open
+
+typedef struct {
+  int fd;
+  int busy;                       // Owned by a worker
+  time_t last;                    // Last activity, monotonic seconds
+  int req_len;                    // Request being served
+  unsigned char req[MAX_IPMI_MSG_SIZE];
+} ipmi_conn_t;
+
+// Connections waiting for a worker; each is queued at most once across
+// all queues, so a queue never overflows
+typedef struct {
+  ipmi_conn_t *conns[IPMI_MAX_CONNS];
+  int head, cnt;
+  int idle;                       // Workers waiting on the queue
+  pthread_mutex_t mutex;
+  pthread_cond_t cond;
+} ipmi_queue_t;
+
+static int g_epfd = -1;
+static int g_listen_seq = -1;     // Its address marks it in the epoll set
+static ipmi_conn_t g_conns[IPMI_MAX_CONNS];
+static pthread_mutex_t m_conns = PTHREAD_MUTEX_INITIALIZER;
+
+static ipmi_queue_t g_ready = {
+  .mutex = PTHREAD_MUTEX_INITIALIZER,
+  .cond = PTHREAD_COND_INITIALIZER,
+};
+static ipmi_queue_t g_slow = {
+  .mutex = PTHREAD_MUTEX_INITIALIZER,
+  .cond = PTHREAD_COND_INITIALIZER,
+};
+static int g_slow_workers;        // Protected by g_slow.mutex
+
+static time_t
+conn_now(void)
+{
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec;
+}
+
+// Caller holds m_conns
+static void
+conn_close(ipmi_conn_t *conn)
+{
+  // Closing the only reference also drops it from the epoll set
+  close(conn->fd);
+  conn->fd = -1;
+  conn->busy = 0;
+}
+
+static void
+conn_open(int fd)
+{
+  struct epoll_event ev;
+  int i;
+
+  pthread_mutex_lock(&m_conns);
+  for (i = 0; i < IPMI_MAX_CONNS; i++) {
+    if (g_conns[i].fd < 0)
+      break;
+  }
+  if (i == IPMI_MAX_CONNS) {
+    pthread_mutex_unlock(&m_conns);
+    syslog(LOG_WARNING, "ipmid: too many clients, dropping connection\n");
+    close(fd);
+    return;
+  }
+
+  g_conns[i].fd = fd;
+  g_conns[i].busy = 0;
+  g_conns[i].last = conn_now();
+
+  ev.events = EPOLLIN | EPOLLONESHOT;
+  ev.data.ptr = &g_conns[i];
+  if (epoll_ctl(g_epfd, EPOLL_CTL_ADD, fd, &ev) < 0) {
+    syslog(LOG_WARNING, "ipmid: epoll_ctl() failed, errno: %d\n", errno);
+    conn_close(&g_conns[i]);
+  }
+  pthread_mutex_unlock(&m_conns);
+}
+
+// Give a connection back to the event loop once its request is answered
+static void
+conn_rearm(ipmi_conn_t *conn)
+{
+  struct epoll_event ev;
+
+  pthread_mutex_lock(&m_conns);
+  conn->busy = 0;
+  conn->last = conn_now();
+  ev.events = EPOLLIN | EPOLLONESHOT;
+  ev.data.ptr = conn;
+  if (epoll_ctl(g_epfd, EPOLL_CTL_MOD, conn->fd, &ev) < 0) {
+    syslog(LOG_WARNING, "ipmid: epoll_ctl() failed, errno: %d\n", errno);
+    conn_close(conn);
+  }
+  pthread_mutex_unlock(&m_conns);
+}
+
+static void
+conn_release(ipmi_conn_t *conn)
+{
+  pthread_mutex_lock(&m_conns);
+  conn_close(conn);
+  pthread_mutex_unlock(&m_conns);
+}
+
+// Close persistent clients that went quiet without closing their end
+static void
+conn_reap_idle(void)
+{
+  time_t now = conn_now();
+  int i;
+
+  pthread_mutex_lock(&m_conns);
+  for (i = 0; i < IPMI_MAX_CONNS; i++) {
+    if (g_conns[i].fd >= 0 && !g_conns[i].busy &&
+        now - g_conns[i].last > IPMI_IDLE_TIMEOUT) {
+      conn_close(&g_conns[i]);
+    }
+  }
+  pthread_mutex_unlock(&m_conns);
+}
+
+static void
+queue_push(ipmi_queue_t *q, ipmi_conn_t *conn)
+{
+  pthread_mutex_lock(&q->mutex);
+  q->conns[(q->head + q->cnt) % IPMI_MAX_CONNS] = conn;
+  q->cnt++;
+  pthread_cond_signal(&q->cond);
+  pthread_mutex_unlock(&q->mutex);
+}
+
+static ipmi_conn_t *
+queue_pop(ipmi_queue_t *q)
+{
+  ipmi_conn_t *conn;
+
+  pthread_mutex_lock(&q->mutex);
+  q->idle++;
+  while (q->cnt == 0) {
+    pthread_cond_wait(&q->cond, &q->mutex);
+  }
+  q->idle--;
+  conn = q->conns[q->head];
+  q->head = (q->head + 1) % IPMI_MAX_CONNS;
+  q->cnt--;
+  pthread_mutex_unlock(&q->mutex);
+
+  return conn;
+}
+
+// Commands which go out to a GPIO, an I2C device, the ME or a BIC and may
+// block for seconds; everything else is answered from ipmid's own state
+static int
+ipmi_is_slow(unsigned char *request, int req_len)
+{
+  ipmi_mn_req_t *req = (ipmi_mn_req_t *) request;
+
+  if (req_len < 3)
+    return 0;
+
+  switch (req->netfn_lun >> 2) {
+    case NETFN_APP_REQ:
+      return req->cmd == CMD_APP_MASTER_WRITE_READ;
+    case NETFN_CHASSIS_REQ:
+      return req->cmd == CMD_CHASSIS_GET_STATUS ||
+             req->cmd == CMD_CHASSIS_IDENTIFY;
+    case NETFN_DCMI_REQ:
+      return 1;
+    case NETFN_OEM_REQ:
+      switch (req->cmd) {
+        case CMD_OEM_SLED_AC_CYCLE:
+        case CMD_OEM_BYPASS_CMD:
+        case CMD_OEM_GET_BOARD_ID:
+        case CMD_OEM_GET_80PORT_RECORD:
+        case CMD_OEM_GET_FW_INFO:
+        case CMD_OEM_BBV_POWER_CYCLE:
+          return 1;
+        default:
+          return 0;
+      }
+    case NETFN_OEM_1S_REQ:
+      switch (req->cmd) {
+        case CMD_OEM_1S_MSG_IN:
+        case CMD_OEM_1S_INTR:
+        case CMD_OEM_1S_BIC_UPDATE_MODE:
+        case CMD_OEM_1S_ASD_MSG_IN:
+        case CMD_OEM_1S_RAS_DUMP_IN:
+          return 1;
+        default:
+          return 0;
+      }
+    default:
+      return 0;
+  }
+}
+
+static void
+ipmi_respond(ipmi_conn_t *conn)
+{
   unsigned char res_buf[MAX_IPMI_MSG_SIZE];
   unsigned short res_len = 0;
-  struct timeval tv;
-  int rc = 0;
 
-  // setup timeout for receving on socket
-  tv.tv_sec = TIMEOUT_IPMI;
-  tv.tv_usec = 0;
+  ipmi_handle(conn->req, conn->req_len, res_buf, (unsigned char*)&res_len);
+
+  if (send(conn->fd, res_buf, res_len, MSG_NOSIGNAL) < 0) {
+    syslog(LOG_WARNING, "ipmid: send() failed\n");
+    conn_release(conn);
+    return;
+  }
+
+  conn_rearm(conn);
+}
 
-  setsockopt(sock, SOL_SOCKET, SO_RCVTIMEO, (char *)&tv,sizeof(struct timeval));
+static void *
+ipmi_slow_worker(void *arg)
+{
+  ipmi_conn_t *conn;
 
-  n = recv (sock, req_buf, sizeof(req_buf), 0);
-  rc = errno;
-  if (n <= 0) {
-      syslog(LOG_WARNING, "ipmid: recv() failed with %d, errno: %d\n", n, rc);
-      goto conn_cleanup;
+  while (1) {
+    conn = queue_pop(&g_slow);
+    ipmi_respond(conn);
   }
 
-  ipmi_handle(req_buf, n, res_buf, (unsigned char*)&res_len);
+  pthread_exit(NULL);
+}
 
-  if (send (sock, res_buf, res_len, 0) < 0) {
-    syslog(LOG_WARNING, "ipmid: send() failed\n");
+// Queue a slow command, first adding a worker if none is free to take it
+static void
+slow_push(ipmi_conn_t *conn)
+{
+  pthread_t tid;
+  int grow;
+
+  pthread_mutex_lock(&g_slow.mutex);
+  grow = g_slow.cnt >= g_slow.idle && g_slow_workers < IPMI_SLOW_WORKERS_MAX;
+  if (grow)
+    g_slow_workers++;
+  pthread_mutex_unlock(&g_slow.mutex);
+
+  if (grow) {
+    if (pthread_create(&tid, NULL, ipmi_slow_worker, NULL) == 0) {
+      pthread_detach(tid);
+    } else {
+      syslog(LOG_WARNING, "ipmid: pthread_create failed for a slow worker\n");
+      pthread_mutex_lock(&g_slow.mutex);
+      g_slow_workers--;
+      pthread_mutex_unlock(&g_slow.mutex);
+    }
   }
 
-conn_cleanup:
-  close(sock);
-  free(p_sock);
+  queue_push(&g_slow, conn);
+}
+
+static void *
+ipmi_worker(void *arg)
+{
+  ipmi_conn_t *conn;
+  int n;
+
+  while (1) {
+    conn = queue_pop(&g_ready);
+
+    n = recv(conn->fd, conn->req, sizeof(conn->req), MSG_DONTWAIT);
+    if (n == 0) {
+      // Client is done with the connection
+      conn_release(conn);
+      continue;
+    }
+    if (n < 0) {
+      if (errno == EAGAIN || errno == EINTR) {
+        conn_rearm(conn);
+      } else {
+        syslog(LOG_WARNING, "ipmid: recv() failed with %d, errno: %d\n", n, errno);
+        conn_release(conn);
+      }
+      continue;
+    }
+
+    conn->req_len = n;
+    if (ipmi_is_slow(conn->req, n)) {
+      // The connection stays busy, so nothing else is read from it
+      slow_push(conn);
+      continue;
+    }
+
+    ipmi_respond(conn);
+  }
 
   pthread_exit(NULL);
-  return 0;
+}
+
+static void
+ipmi_accept(int s)
+{
+  int s2;
+
+  while (1) {
+    s2 = accept(s, NULL, NULL);
+    if (s2 < 0) {
+      if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR) {
+        syslog(LOG_WARNING, "ipmid: accept() failed, errno: %d\n", errno);
+      }
+      return;
+    }
+    conn_open(s2);
+  }
 }
 
 void *
@@ -3756,14 +4175,46 @@ wdt_timer (void *arg) {
   pthread_exit(NULL);
 }
 
+static int
+ipmi_listen(const char *path, int type)
+{
+  int s, len;
+  struct sockaddr_un local;
+
+  if ((s = socket (AF_UNIX, type | SOCK_NONBLOCK | SOCK_CLOEXEC, 0)) == -1)
+  {
+    syslog(LOG_WARNING, "ipmid: socket() failed\n");
+    return -1;
+  }
+
+  local.sun_family = AF_UNIX;
+  strcpy (local.sun_path, path);
+  unlink (local.sun_path);
+  len = strlen (local.sun_path) + sizeof (local.sun_family);
+  if (bind (s, (struct sockaddr *) &local, len) == -1)
+  {
+    syslog(LOG_WARNING, "ipmid: bind() failed\n");
+    close(s);
+    return -1;
+  }
+
+  if (listen (s, 64) == -1)
+  {
+    syslog(LOG_WARNING, "ipmid: listen() failed\n");
+    close(s);
+    return -1;
+  }
+
+  return s;
+}
+
 int
 main (void)
 {
-  int s, s2, fru, len;
-  struct sockaddr_un local, remote;
+  int s, fru;
+  struct epoll_event ev, events[IPMI_MAX_EVENTS];
   pthread_t tid;
-  int *p_s2;
-  int rc = 0;
+  int i, n;
   uint8_t max_slot_num = 0;
 
   //daemon(1, 1);
@@ -3774,15 +4225,24 @@ main (void)
   plat_lan_init(&g_lan_config);
 
   sdr_init();
-  sel_init();
+  // SEL commands for nodes that failed to load are rejected, the rest of
+  // ipmid keeps serving
+  if (sel_init()) {
+    syslog(LOG_CRIT, "ipmid: SEL init failed, SEL is unavailable for some nodes\n");
+  }
 
   pthread_mutex_init(&m_chassis, NULL);
   pthread_mutex_init(&m_sensor, NULL);
   pthread_mutex_init(&m_app, NULL);
-  pthread_mutex_init(&m_storage, NULL);
+  pthread_mutex_init(&m_fruid, NULL);
   pthread_mutex_init(&m_transport, NULL);
-  pthread_mutex_init(&m_oem, NULL);
-  pthread_mutex_init(&m_oem_1s, NULL);
+  for (i = 0; i < 256; i++) {
+    pthread_mutex_init(&m_oem[i], NULL);
+  }
+  pthread_mutex_init(&m_oem_storage, NULL);
+  for (i = 0; i <= MAX_NODES; i++) {
+    pthread_mutex_init(&m_oem_1s[i], NULL);
+  }
   pthread_mutex_init(&m_oem_usb_dbg, NULL);
   pthread_mutex_init(&m_oem_q, NULL);
 
@@ -3807,62 +4267,102 @@ main (void)
     fru++;
   }
 
-  if ((s = socket (AF_UNIX, SOCK_STREAM, 0)) == -1)
+  if ((s = ipmi_listen(SOCK_PATH_IPMI, SOCK_STREAM)) == -1)
   {
-    syslog(LOG_WARNING, "ipmid: socket() failed\n");
     exit (1);
   }
 
-  local.sun_family = AF_UNIX;
-  strcpy (local.sun_path, SOCK_PATH_IPMI);
-  unlink (local.sun_path);
-  len = strlen (local.sun_path) + sizeof (local.sun_family);
-  if (bind (s, (struct sockaddr *) &local, len) == -1)
+  // Clients fall back to the stream socket without this one
+  g_listen_seq = ipmi_listen(SOCK_PATH_IPMI_SEQ, SOCK_SEQPACKET);
+
+  if ((g_epfd = epoll_create1(EPOLL_CLOEXEC)) < 0)
   {
-    syslog(LOG_WARNING, "ipmid: bind() failed\n");
+    syslog(LOG_WARNING, "ipmid: epoll_create1() failed\n");
     exit (1);
   }
 
-  if (listen (s, 5) == -1)
+  // A NULL pointer marks the listening socket
+  ev.events = EPOLLIN;
+  ev.data.ptr = NULL;
+  if (epoll_ctl(g_epfd, EPOLL_CTL_ADD, s, &ev) < 0)
   {
-    syslog(LOG_WARNING, "ipmid: listen() failed\n");
+    syslog(LOG_WARNING, "ipmid: epoll_ctl() failed\n");
     exit (1);
   }
 
+  if (g_listen_seq >= 0)
+  {
+    ev.events = EPOLLIN;
+    ev.data.ptr = &g_listen_seq;
+    if (epoll_ctl(g_epfd, EPOLL_CTL_ADD, g_listen_seq, &ev) < 0)
+    {
+      syslog(LOG_WARNING, "ipmid: epoll_ctl() failed\n");
+      exit (1);
+    }
+  }
+
+  for (i = 0; i < IPMI_MAX_CONNS; i++) {
+    g_conns[i].fd = -1;
+  }
+
+  g_slow_workers = IPMI_SLOW_WORKERS;
+  for (i = 0; i < IPMI_WORKERS + IPMI_SLOW_WORKERS; i++) {
+    if (pthread_create(&tid, NULL, (i < IPMI_WORKERS) ? ipmi_worker : ipmi_slow_worker,
+                       NULL) != 0) {
+      syslog(LOG_WARNING, "ipmid: pthread_create failed\n");
+      exit (1);
+    }
+    pthread_detach(tid);
+  }
+
   while(1) {
-    size_t t = sizeof (remote);
-    // TODO: seen accept() call fails and need further debug
-    if ((s2 = accept (s, (struct sockaddr *) &remote, &t)) < 0) {
-      rc = errno;
-      syslog(LOG_WARNING, "ipmid: accept() failed with ret: %x, errno: %x\n", s2, rc);
-      sleep(5);
+    n = epoll_wait(g_epfd, events, IPMI_MAX_EVENTS, 1000);
+    if (n < 0) {
+      if (errno != EINTR) {
+        syslog(LOG_WARNING, "ipmid: epoll_wait() failed, errno: %d\n", errno);
+        sleep(1);
+      }
       continue;
     }
 
-    // Creating a worker thread to handle the request
-    // TODO: Need to monitor the server performance with higher load and
-    // see if we need to create pre-defined number of workers and schedule
-    // the requests among them.
-    p_s2 = malloc(sizeof(int));
-    *p_s2 = s2;
-    if (pthread_create(&tid, NULL, conn_handler, (void*) p_s2) < 0) {
-        syslog(LOG_WARNING, "ipmid: pthread_create failed\n");
-        close(s2);
+    for (i = 0; i < n; i++) {
+      ipmi_conn_t *conn = events[i].data.ptr;
+
+      if (conn == NULL) {
+        ipmi_accept(s);
         continue;
+      }
+      if ((void *)conn == &g_listen_seq) {
+        ipmi_accept(g_listen_seq);
+        continue;
+      }
+
+      pthread_mutex_lock(&m_conns);
+      conn->busy = 1;
+      pthread_mutex_unlock(&m_conns);
+      queue_push(&g_ready, conn);
     }
 
-    pthread_detach(tid);
+    conn_reap_idle();
   }
 
+  close(g_epfd);
   close(s);
+  if (g_listen_seq >= 0)
+    close(g_listen_seq);
 
   pthread_mutex_destroy(&m_chassis);
   pthread_mutex_destroy(&m_sensor);
   pthread_mutex_destroy(&m_app);
-  pthread_mutex_destroy(&m_storage);
+  pthread_mutex_destroy(&m_fruid);
   pthread_mutex_destroy(&m_transport);
-  pthread_mutex_destroy(&m_oem);
-  pthread_mutex_destroy(&m_oem_1s);
+  for (i = 0; i < 256; i++) {
+    pthread_mutex_destroy(&m_oem[i]);
+  }
+  pthread_mutex_destroy(&m_oem_storage);
+  for (i = 0; i <= MAX_NODES; i++) {
+    pthread_mutex_destroy(&m_oem_1s[i]);
+  }
   pthread_mutex_destroy(&m_oem_usb_dbg);
   pthread_mutex_destroy(&m_oem_q);
 
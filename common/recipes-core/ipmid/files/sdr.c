@@ -29,6 +29,7 @@
 #include <errno.h>
 #include <syslog.h>
 #include <string.h>
+#include <pthread.h>
 #include <openbmc/ipmi.h>
 #include <openbmc/pal.h>
 
@@ -84,6 +85,9 @@ static int g_rsv_id[MAX_NODES+1];
 static sdr_hdr_t g_sdr_hdr;
 static sdr_rec_t g_sdr_data[SDR_RECORDS_MAX];
 
+// The repository is read-only after init; this only guards reservations
+static pthread_mutex_t g_sdr_lock = PTHREAD_MUTEX_INITIALIZER;
+
 // Add a new SDR entry
 static int
 sdr_add_entry(sdr_rec_t *rec, int *rec_id) {
@@ -306,12 +310,17 @@ sdr_free_space(void) {
 // IPMI/Section 33.11
 int
 sdr_rsv_id(int node) {
+  int rsv_id;
+
+  pthread_mutex_lock(&g_sdr_lock);
   // Increment the current reservation ID and return
   if (g_rsv_id[node]++ == SDR_RSVID_MAX) {
     g_rsv_id[node] = SDR_RSVID_MIN;
   }
+  rsv_id = g_rsv_id[node];
+  pthread_mutex_unlock(&g_sdr_lock);
 
-  return g_rsv_id[node];
+  return rsv_id;
 }
 
 // Get the SDR entry for a given record ID
@@ -323,7 +332,10 @@ sdr_get_entry(int node, int rsv_id, int read_rec_id, sdr_rec_t *rec,
   int index;
 
   // Make sure the rsv_id matches
-  if (rsv_id != g_rsv_id[node]) {
+  pthread_mutex_lock(&g_sdr_lock);
+  index = g_rsv_id[node];
+  pthread_mutex_unlock(&g_sdr_lock);
+  if (rsv_id != index) {
     syslog(LOG_WARNING, "sdr_get_entry: Reservation ID mismatch\n");
     return -1;
   }
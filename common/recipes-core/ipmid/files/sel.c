@@ -5,8 +5,9 @@
  * This file represents platform specific implementation for storing
  * SEL logs and acts as back-end for IPMI stack
  *
- * TODO: Optimize the file handling to keep file open always instead of
- * current open/seek/close
+ * The SEL file of every node is read in to memory; adds and erases only
+ * update the copy in memory and a background thread writes it back every
+ * few seconds. jffs2 has no shared writable mmap, so this is pwrite based.
  *
  *
  * This program is free software; you can redistribute it and/or modify
@@ -23,7 +24,7 @@
  * along with this program; if not, write to the Free Software
  * Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
  */
-#define _XOPEN_SOURCE
+#define _XOPEN_SOURCE 500
 #include "sel.h"
 #include "timestamp.h"
 #include <stdio.h>
@@ -35,17 +36,25 @@
 #include <stdint.h>
 #include <sys/types.h>
 #include <time.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <fcntl.h>
+#include <sys/stat.h>
 #include <openbmc/pal.h>
 
 // SEL File.
 #define SEL_LOG_FILE  "/mnt/data/sel%d.bin"
 #define SIZE_PATH_MAX 32
 
+const char *sel_log_file = SEL_LOG_FILE;
+
 // SEL Header magic number
 #define SEL_HDR_MAGIC 0xFBFBFBFB
 
-// SEL Header version number
-#define SEL_HDR_VERSION 0x01
+// SEL Header version number; version 2 adds the header checksum
+#define SEL_HDR_VERSION 0x02
+#define SEL_HDR_VERSION_1 0x01
 
 // SEL Data offset from file beginning
 #define SEL_DATA_OFFSET 0x100
@@ -58,6 +67,12 @@
 #define SEL_RECORDS_MAX 128 // TODO: Based on need we can make it bigger
 #define SEL_ELEMS_MAX (SEL_RECORDS_MAX+1)
 
+// Size of the SEL file
+#define SEL_FILE_SIZE (SEL_DATA_OFFSET + SEL_ELEMS_MAX * sizeof(sel_msg_t))
+
+// Dirty SEL files are flushed to flash at most this often
+#define SEL_SYNC_SEC 5
+
 // Index for circular array
 #define SEL_INDEX_MIN 0x00
 #define SEL_INDEX_MAX SEL_RECORDS_MAX
@@ -78,132 +93,161 @@ typedef struct {
   int end; // index to end of the log
   time_stamp_t ts_add; // last addition time stamp
   time_stamp_t ts_erase; // last erase time stamp
+  uint32_t cksum; // checksum of the fields above, version 2 onwards
 } sel_hdr_t;
 
 // Keep track of last Reservation ID
 static int g_rsv_id[MAX_NODES+1];
 
-// Cached version of SEL Header and data
-static sel_hdr_t g_sel_hdr[MAX_NODES+1];
-static sel_msg_t g_sel_data[MAX_NODES+1][SEL_ELEMS_MAX];
+// SEL Header and data, the in memory copy of the SEL file
+static sel_hdr_t *g_sel_hdr[MAX_NODES+1];
+static sel_msg_t *g_sel_data[MAX_NODES+1];
 
-// Local helper functions to interact with file system
-static int
-file_get_sel_hdr(int node) {
-  FILE *fp;
-  char fpath[SIZE_PATH_MAX] = {0};
+// SEL file of each node, kept open for the write back
+static int g_sel_fd[MAX_NODES+1];
 
-  sprintf(fpath, SEL_LOG_FILE, node);
+// Set when the copy in memory has changes not yet flushed to flash
+static bool g_sel_dirty[MAX_NODES+1];
 
-  fp = fopen(fpath, "r");
-  if (fp == NULL) {
-    return -1;
-  }
+// Time stamp of every slot, and the slots in use ordered by time stamp
+static uint32_t g_sel_ts[MAX_NODES+1][SEL_ELEMS_MAX];
+static uint8_t g_sel_ts_idx[MAX_NODES+1][SEL_ELEMS_MAX];
+static int g_sel_ts_cnt[MAX_NODES+1];
 
-  if (fread(&g_sel_hdr[node], sizeof(sel_hdr_t), 1, fp) <= 0) {
-    syslog(LOG_WARNING, "file_get_sel_hdr: fread\n");
-    fclose (fp);
-    return -1;
+// Per node lock; requests for different nodes never wait on each other
+static pthread_mutex_t g_sel_lock[MAX_NODES+1];
+
+static uint32_t
+sel_hdr_cksum(sel_hdr_t *hdr) {
+  uint8_t *p = (uint8_t *) hdr;
+  uint32_t sum = 0;
+  int i;
+
+  for (i = 0; i < offsetof(sel_hdr_t, cksum); i++) {
+    sum = (sum << 1 | sum >> 31) + p[i];
   }
 
-  fclose(fp);
-  return 0;
+  return ~sum;
 }
 
-static int
-file_get_sel_data(int node) {
-  FILE *fp;
-  int i, j;
-  char fpath[SIZE_PATH_MAX] = {0};
-
-  sprintf(fpath, SEL_LOG_FILE, node);
+// Seal the header after changing it; caller holds g_sel_lock[node]
+static void
+sel_hdr_update(int node) {
+  g_sel_hdr[node]->cksum = sel_hdr_cksum(g_sel_hdr[node]);
+  g_sel_dirty[node] = true;
+}
 
-  fp = fopen(fpath, "r");
-  if (fp == NULL) {
-    syslog(LOG_WARNING, "file_get_sel_data: fopen\n");
-    return -1;
+static bool
+sel_hdr_valid(sel_hdr_t *hdr) {
+  if (hdr->magic != SEL_HDR_MAGIC) {
+    return false;
   }
 
-  if (fseek(fp, SEL_DATA_OFFSET, SEEK_SET)) {
-    syslog(LOG_WARNING, "file_get_sel_data: fseek\n");
-    fclose(fp);
-    return -1;
+  if (hdr->begin < SEL_INDEX_MIN || hdr->begin > SEL_INDEX_MAX ||
+      hdr->end < SEL_INDEX_MIN || hdr->end > SEL_INDEX_MAX) {
+    return false;
   }
 
-  unsigned char buf[SEL_ELEMS_MAX * 16];
-  if (fread(buf, 1, SEL_ELEMS_MAX * sizeof(sel_msg_t), fp) <= 0) {
-    syslog(LOG_WARNING, "file_get_sel_data: fread\n");
-    fclose(fp);
-    return -1;
+  if (hdr->version == SEL_HDR_VERSION) {
+    return hdr->cksum == sel_hdr_cksum(hdr);
   }
 
-  fclose(fp);
+  return hdr->version == SEL_HDR_VERSION_1;
+}
+
+// Time stamp of the record in slot index; untimestamped OEM records take
+// the one of the record before them
+static uint32_t
+sel_slot_ts(int node, int index, uint32_t prev) {
+  uint8_t *sel = g_sel_data[node][index].msg;
 
-  for (i = 0; i < SEL_ELEMS_MAX; i++) {
-    for (j = 0; j < sizeof(sel_msg_t);j++) {
-      g_sel_data[node][i].msg[j] = buf[i*16 + j];
-    }
+  if (sel[2] >= 0xE0) {
+    return prev;
   }
 
-  return 0;
+  return sel[3] | (sel[4] << 8) | (sel[5] << 16) | ((uint32_t)sel[6] << 24);
 }
 
-static int
-file_store_sel_hdr(int node) {
-  FILE *fp;
-  char fpath[SIZE_PATH_MAX] = {0};
-
-  sprintf(fpath, SEL_LOG_FILE, node);
-
-  fp = fopen(fpath, "r+");
-  if (fp == NULL) {
-    syslog(LOG_WARNING, "file_store_sel_hdr: fopen\n");
-    return -1;
+// Insert slot index in to the time stamp index, after any equal time stamp
+static void
+sel_ts_insert(int node, int index, uint32_t ts) {
+  uint8_t *idx = g_sel_ts_idx[node];
+  int lo = 0, hi = g_sel_ts_cnt[node], mid;
+
+  while (lo < hi) {
+    mid = (lo + hi) / 2;
+    if (g_sel_ts[node][idx[mid]] <= ts) {
+      lo = mid + 1;
+    } else {
+      hi = mid;
+    }
   }
 
-  if (fwrite(&g_sel_hdr[node], sizeof(sel_hdr_t), 1, fp) <= 0) {
-    syslog(LOG_WARNING, "file_store_sel_hdr: fwrite\n");
-    fclose(fp);
-    return -1;
-  }
+  memmove(&idx[lo + 1], &idx[lo], g_sel_ts_cnt[node] - lo);
+  idx[lo] = index;
+  g_sel_ts[node][index] = ts;
+  g_sel_ts_cnt[node]++;
+}
 
-  fclose(fp);
+static void
+sel_ts_remove(int node, int index) {
+  uint8_t *idx = g_sel_ts_idx[node];
+  int i;
 
-  return 0;
+  for (i = 0; i < g_sel_ts_cnt[node]; i++) {
+    if (idx[i] == index) {
+      memmove(&idx[i], &idx[i + 1], g_sel_ts_cnt[node] - i - 1);
+      g_sel_ts_cnt[node]--;
+      return;
+    }
+  }
 }
 
-static int
-file_store_sel_data(int node, int recId, sel_msg_t *data) {
-  FILE *fp;
+static void
+sel_ts_rebuild(int node) {
+  uint32_t ts = 0;
   int index;
-  char fpath[SIZE_PATH_MAX] = {0};
 
-  sprintf(fpath, SEL_LOG_FILE, node);
+  g_sel_ts_cnt[node] = 0;
+  for (index = g_sel_hdr[node]->begin; index != g_sel_hdr[node]->end;
+       index = (index == SEL_INDEX_MAX) ? SEL_INDEX_MIN : index + 1) {
+    ts = sel_slot_ts(node, index, ts);
+    sel_ts_insert(node, index, ts);
+  }
+}
 
-  fp = fopen(fpath, "r+");
-  if (fp == NULL) {
-    syslog(LOG_WARNING, "file_store_sel_data: fopen\n");
+// Write the copy in memory back to the SEL file and flush it to flash;
+// caller holds g_sel_lock[node]
+static int
+sel_flush(int node) {
+  if (pwrite(g_sel_fd[node], g_sel_hdr[node], SEL_FILE_SIZE, 0) != SEL_FILE_SIZE ||
+      fdatasync(g_sel_fd[node])) {
+    syslog(LOG_WARNING, "sel_flush: write back failed for node %d, errno %d\n", node, errno);
     return -1;
   }
 
-  // Records are stored using zero-based index
-  index = (recId-1) * sizeof(sel_msg_t);
+  g_sel_dirty[node] = false;
+  return 0;
+}
 
-  if (fseek(fp, SEL_DATA_OFFSET+index, SEEK_SET)) {
-    syslog(LOG_WARNING, "file_store_sel_data: fseek\n");
-    fclose(fp);
-    return -1;
-  }
+// Flush dirty SEL files to flash periodically
+static void *
+sel_sync_thread(void *arg) {
+  int node;
 
-  if (fwrite(data->msg, sizeof(sel_msg_t), 1, fp) <= 0) {
-    syslog(LOG_WARNING, "file_store_sel_data: fwrite\n");
-    fclose(fp);
-    return -1;
-  }
+  while (1) {
+    sleep(SEL_SYNC_SEC);
 
-  fclose(fp);
+    for (node = 1; node < MAX_NODES+1; node++) {
+      pthread_mutex_lock(&g_sel_lock[node]);
+      if (g_sel_dirty[node] && g_sel_hdr[node] != NULL) {
+        sel_flush(node);
+      }
+      pthread_mutex_unlock(&g_sel_lock[node]);
+    }
+  }
 
-  return 0;
+  return NULL;
 }
 
 static void
@@ -363,26 +407,69 @@ parse_sel(uint8_t fru, sel_msg_t *data) {
 }
 
 // Platform specific SEL API entry points
+// Nodes whose SEL file failed to load are rejected like out of range ones
+static bool
+sel_node_valid(int node) {
+  if (node < 1 || node > MAX_NODES || g_sel_hdr[node] == NULL) {
+    syslog(LOG_WARNING, "sel: invalid node %d\n", node);
+    return false;
+  }
+
+  return true;
+}
+
+// Number of entries; caller holds g_sel_lock[node]
+static int
+sel_count(int node) {
+  if (g_sel_hdr[node]->begin <= g_sel_hdr[node]->end) {
+      return (g_sel_hdr[node]->end - g_sel_hdr[node]->begin);
+  } else {
+    return (g_sel_hdr[node]->end + (SEL_INDEX_MAX - g_sel_hdr[node]->begin + 1));
+  }
+}
+
 // Retrieve time stamp for recent add operation
-void
+int
 sel_ts_recent_add(int node, time_stamp_t *ts) {
-  memcpy(ts->ts, g_sel_hdr[node].ts_add.ts, 0x04);
+  if (!sel_node_valid(node)) {
+    return -1;
+  }
+
+  pthread_mutex_lock(&g_sel_lock[node]);
+  memcpy(ts->ts, g_sel_hdr[node]->ts_add.ts, 0x04);
+  pthread_mutex_unlock(&g_sel_lock[node]);
+
+  return 0;
 }
 
 // Retrieve time stamp for recent erase operation
-void
+int
 sel_ts_recent_erase(int node, time_stamp_t *ts) {
-  memcpy(ts->ts, g_sel_hdr[node].ts_erase.ts, 0x04);
+  if (!sel_node_valid(node)) {
+    return -1;
+  }
+
+  pthread_mutex_lock(&g_sel_lock[node]);
+  memcpy(ts->ts, g_sel_hdr[node]->ts_erase.ts, 0x04);
+  pthread_mutex_unlock(&g_sel_lock[node]);
+
+  return 0;
 }
 
 // Retrieve total number of entries in SEL log
 int
 sel_num_entries(int node) {
-  if (g_sel_hdr[node].begin <= g_sel_hdr[node].end) {
-      return (g_sel_hdr[node].end - g_sel_hdr[node].begin);
-  } else {
-    return (g_sel_hdr[node].end + (SEL_INDEX_MAX - g_sel_hdr[node].begin + 1));
+  int num;
+
+  if (!sel_node_valid(node)) {
+    return -1;
   }
+
+  pthread_mutex_lock(&g_sel_lock[node]);
+  num = sel_count(node);
+  pthread_mutex_unlock(&g_sel_lock[node]);
+
+  return num;
 }
 
 // Retrieve total free space available in SEL log
@@ -390,9 +477,14 @@ int
 sel_free_space(int node) {
   int total_space;
   int used_space;
+  int num;
+
+  if ((num = sel_num_entries(node)) < 0) {
+    return -1;
+  }
 
   total_space = SEL_RECORDS_MAX * sizeof(sel_msg_t);
-  used_space = sel_num_entries(node) * sizeof(sel_msg_t);
+  used_space = num * sizeof(sel_msg_t);
 
   return (total_space - used_space);
 }
@@ -401,76 +493,167 @@ sel_free_space(int node) {
 // IPMI/Section 31.4
 int
 sel_rsv_id(int node) {
+  int rsv_id;
+
+  if (!sel_node_valid(node)) {
+    return -1;
+  }
+
+  pthread_mutex_lock(&g_sel_lock[node]);
   // Increment the current reservation ID and return
   if (g_rsv_id[node]++ == SEL_RSVID_MAX) {
     g_rsv_id[node] = SEL_RSVID_MIN;
   }
+  rsv_id = g_rsv_id[node];
+  pthread_mutex_unlock(&g_sel_lock[node]);
 
-  return g_rsv_id[node];
+  return rsv_id;
 }
 
-// Get the SEL entry for a given record ID
-// IPMI/Section 31.5
-int
-sel_get_entry(int node, int read_rec_id, sel_msg_t *msg, int *next_rec_id) {
+// Check that index holds a record; caller holds g_sel_lock[node]
+static bool
+sel_index_valid(int node, int index) {
+  // Check for boundary conditions
+  if ((index < SEL_INDEX_MIN) || (index > SEL_INDEX_MAX)) {
+    return false;
+  }
+
+  // If begin < end, check to make sure the given id falls between
+  if (g_sel_hdr[node]->begin < g_sel_hdr[node]->end) {
+    if (index < g_sel_hdr[node]->begin || index >= g_sel_hdr[node]->end) {
+      return false;
+    }
+  }
+
+  // If end < begin, check to make sure the given id is valid
+  if (g_sel_hdr[node]->begin > g_sel_hdr[node]->end) {
+    if (index >= g_sel_hdr[node]->end && index < g_sel_hdr[node]->begin) {
+      return false;
+    }
+  }
+
+  return true;
+}
+
+static int
+sel_get_entry_locked(int node, int read_rec_id, sel_msg_t *msg, int *next_rec_id) {
 
   int index;
 
-  // Find the index in to array based on given index
+  // If the log is empty return error
+  if (sel_count(node) == 0) {
+    syslog(LOG_WARNING, "sel_get_entry: No entries\n");
+    return -1;
+  }
+
+  // Find the index in to array based on given record ID; record IDs are
+  // the index plus one, as returned by sel_add_entry
   if (read_rec_id == SEL_RECID_FIRST) {
-    index = g_sel_hdr[node].begin;
+    index = g_sel_hdr[node]->begin;
   } else if (read_rec_id == SEL_RECID_LAST) {
-    if (g_sel_hdr[node].end) {
-      index = g_sel_hdr[node].end - 1;
+    if (g_sel_hdr[node]->end) {
+      index = g_sel_hdr[node]->end - 1;
     } else {
       index = SEL_INDEX_MAX;
     }
   } else {
-    index = read_rec_id;
+    index = read_rec_id - 1;
   }
 
-  // If the log is empty return error
-  if (sel_num_entries(node) == 0) {
-    syslog(LOG_WARNING, "sel_get_entry: No entries\n");
+  if (!sel_index_valid(node, index)) {
+    syslog(LOG_WARNING, "sel_get_entry: Wrong Record ID %d\n", read_rec_id);
     return -1;
   }
 
-  // Check for boundary conditions
-  if ((index < SEL_INDEX_MIN) || (index > SEL_INDEX_MAX)) {
-    syslog(LOG_WARNING, "sel_get_entry: Invalid Record ID %d\n", read_rec_id);
+  memcpy(msg->msg, g_sel_data[node][index].msg, sizeof(sel_msg_t));
+
+  // Return the next record ID in the log
+  if (++index > SEL_INDEX_MAX) {
+    index = SEL_INDEX_MIN;
+  }
+
+  // If this is the last entry in the log, return 0xFFFF
+  if (index == g_sel_hdr[node]->end) {
+    *next_rec_id = SEL_RECID_LAST;
+  } else {
+    *next_rec_id = index + 1;
+  }
+
+  return 0;
+}
+
+// Get the SEL entry for a given record ID
+// IPMI/Section 31.5
+int
+sel_get_entry(int node, int read_rec_id, sel_msg_t *msg, int *next_rec_id) {
+  int ret;
+
+  if (!sel_node_valid(node)) {
     return -1;
   }
 
-  // If begin < end, check to make sure the given id falls between
-  if (g_sel_hdr[node].begin < g_sel_hdr[node].end) {
-    if (index < g_sel_hdr[node].begin || index >= g_sel_hdr[node].end) {
-      syslog(LOG_WARNING, "sel_get_entry: Wrong Record ID %d\n", read_rec_id);
-      return -1;
-    }
+  pthread_mutex_lock(&g_sel_lock[node]);
+  ret = sel_get_entry_locked(node, read_rec_id, msg, next_rec_id);
+  pthread_mutex_unlock(&g_sel_lock[node]);
+
+  return ret;
+}
+
+// Get up to max consecutive SEL entries starting at a given record ID
+int
+sel_get_entries(int node, int read_rec_id, sel_msg_t *msgs, int max, int *next_rec_id) {
+  int cnt = 0;
+
+  if (!sel_node_valid(node)) {
+    return -1;
   }
 
-  // If end < begin, check to make sure the given id is valid
-  if (g_sel_hdr[node].begin > g_sel_hdr[node].end) {
-    if (index >= g_sel_hdr[node].end && index < g_sel_hdr[node].begin) {
-      syslog(LOG_WARNING, "sel_get_entry: Wrong Record ID2 %d\n", read_rec_id);
-      return -1;
+  pthread_mutex_lock(&g_sel_lock[node]);
+  while (cnt < max) {
+    if (sel_get_entry_locked(node, read_rec_id, &msgs[cnt], next_rec_id)) {
+      break;
+    }
+    cnt++;
+
+    if (*next_rec_id == SEL_RECID_LAST) {
+      break;
     }
+    read_rec_id = *next_rec_id;
   }
+  pthread_mutex_unlock(&g_sel_lock[node]);
 
-  memcpy(msg->msg, g_sel_data[node][index].msg, sizeof(sel_msg_t));
+  return cnt ? cnt : -1;
+}
 
-  // Return the next record ID in the log
-  *next_rec_id = ++read_rec_id;
-  if (*next_rec_id > SEL_INDEX_MAX) {
-    *next_rec_id = SEL_INDEX_MIN;
+// Record ID of the oldest entry logged at or after the given time stamp
+int
+sel_find_ts(int node, uint32_t ts) {
+  uint8_t *idx;
+  int lo, hi, mid;
+  int rec_id = -1;
+
+  if (!sel_node_valid(node)) {
+    return -1;
   }
 
-  // If this is the last entry in the log, return 0xFFFF
-  if (*next_rec_id == g_sel_hdr[node].end) {
-    *next_rec_id = SEL_RECID_LAST;
+  idx = g_sel_ts_idx[node];
+  pthread_mutex_lock(&g_sel_lock[node]);
+  lo = 0;
+  hi = g_sel_ts_cnt[node];
+  while (lo < hi) {
+    mid = (lo + hi) / 2;
+    if (g_sel_ts[node][idx[mid]] < ts) {
+      lo = mid + 1;
+    } else {
+      hi = mid;
+    }
   }
+  if (lo < g_sel_ts_cnt[node]) {
+    rec_id = idx[lo] + 1;
+  }
+  pthread_mutex_unlock(&g_sel_lock[node]);
 
-  return 0;
+  return rec_id;
 }
 
 // Add a new entry in to SEL log for RAS SEL
@@ -486,16 +669,18 @@ ras_sel_add_entry(int node, ras_sel_msg_t *msg) {
   return 0;
 }
 
-// Add a new entry in to SEL log
-// IPMI/Section 31.6
-int
-sel_add_entry(int node, sel_msg_t *msg, int *rec_id) {
+static int
+sel_add_entry_locked(int node, sel_msg_t *msg, int *rec_id) {
+  uint32_t prev_ts = 0;
+  int prev;
+
   // If the SEL if full, roll over. To keep track of empty condition, use
   // one empty location less than the max records.
-  if (sel_num_entries(node) == SEL_RECORDS_MAX) {
+  if (sel_count(node) == SEL_RECORDS_MAX) {
       syslog(LOG_WARNING, "sel_add_entry: SEL rollover\n");
-    if (++g_sel_hdr[node].begin > SEL_INDEX_MAX) {
-      g_sel_hdr[node].begin = SEL_INDEX_MIN;
+    sel_ts_remove(node, g_sel_hdr[node]->begin);
+    if (++g_sel_hdr[node]->begin > SEL_INDEX_MAX) {
+      g_sel_hdr[node]->begin = SEL_INDEX_MIN;
     }
   }
 
@@ -504,10 +689,10 @@ sel_add_entry(int node, sel_msg_t *msg, int *rec_id) {
     time_stamp_fill(&msg->msg[3]);
 
   // Add the enry at end
-  memcpy(g_sel_data[node][g_sel_hdr[node].end].msg, msg->msg, sizeof(sel_msg_t));
+  memcpy(g_sel_data[node][g_sel_hdr[node]->end].msg, msg->msg, sizeof(sel_msg_t));
 
   // Return the newly added record ID
-  *rec_id = g_sel_hdr[node].end+1;
+  *rec_id = g_sel_hdr[node]->end+1;
 
   // Print the data in syslog
   dump_sel_syslog(node, msg);
@@ -515,26 +700,43 @@ sel_add_entry(int node, sel_msg_t *msg, int *rec_id) {
   // Parse the SEL message
   parse_sel((uint8_t) node, msg);
 
-  if (file_store_sel_data(node, *rec_id, msg)) {
-    syslog(LOG_WARNING, "sel_add_entry: file_store_sel_data\n");
-    return -1;
+  // Index the entry by time stamp
+  if (sel_count(node)) {
+    prev = g_sel_hdr[node]->end ? g_sel_hdr[node]->end - 1 : SEL_INDEX_MAX;
+    prev_ts = g_sel_ts[node][prev];
   }
+  sel_ts_insert(node, g_sel_hdr[node]->end,
+                sel_slot_ts(node, g_sel_hdr[node]->end, prev_ts));
 
   // Increment the end pointer
-  if (++g_sel_hdr[node].end > SEL_INDEX_MAX) {
-    g_sel_hdr[node].end = SEL_INDEX_MIN;
+  if (++g_sel_hdr[node]->end > SEL_INDEX_MAX) {
+    g_sel_hdr[node]->end = SEL_INDEX_MIN;
   }
 
   // Update timestamp for add in header
-  time_stamp_fill(g_sel_hdr[node].ts_add.ts);
+  time_stamp_fill(g_sel_hdr[node]->ts_add.ts);
+
+  // Flushed to flash by sel_sync_thread
+  sel_hdr_update(node);
+
+  return 0;
+}
 
-  // Store the structure persistently
-  if (file_store_sel_hdr(node)) {
-    syslog(LOG_WARNING, "sel_add_entry: file_store_sel_hdr\n");
+// Add a new entry in to SEL log
+// IPMI/Section 31.6
+int
+sel_add_entry(int node, sel_msg_t *msg, int *rec_id) {
+  int ret;
+
+  if (!sel_node_valid(node)) {
     return -1;
   }
 
-  return 0;
+  pthread_mutex_lock(&g_sel_lock[node]);
+  ret = sel_add_entry_locked(node, msg, rec_id);
+  pthread_mutex_unlock(&g_sel_lock[node]);
+
+  return ret;
 }
 
 // Erase the SEL completely
@@ -542,24 +744,33 @@ sel_add_entry(int node, sel_msg_t *msg, int *rec_id) {
 // Note: To reduce wear/tear, instead of erasing, manipulating the metadata
 int
 sel_erase(int node, int rsv_id) {
+  int ret = 0;
+
+  if (!sel_node_valid(node)) {
+    return -1;
+  }
+
+  pthread_mutex_lock(&g_sel_lock[node]);
   if (rsv_id != g_rsv_id[node]) {
+    pthread_mutex_unlock(&g_sel_lock[node]);
     return -1;
   }
 
   // Erase SEL Logs
-  g_sel_hdr[node].begin = SEL_INDEX_MIN;
-  g_sel_hdr[node].end = SEL_INDEX_MIN;
+  g_sel_hdr[node]->begin = SEL_INDEX_MIN;
+  g_sel_hdr[node]->end = SEL_INDEX_MIN;
+
+  g_sel_ts_cnt[node] = 0;
 
   // Update timestamp for erase in header
-  time_stamp_fill(g_sel_hdr[node].ts_erase.ts);
+  time_stamp_fill(g_sel_hdr[node]->ts_erase.ts);
+  sel_hdr_update(node);
 
-  // Store the structure persistently
-  if (file_store_sel_hdr(node)) {
-    syslog(LOG_WARNING, "sel_erase: file_store_sel_hdr\n");
-    return -1;
-  }
+  // Store the structure persistently right away
+  ret = sel_flush(node);
+  pthread_mutex_unlock(&g_sel_lock[node]);
 
-  return 0;
+  return ret;
 }
 
 // To get the erase status while erase happens
@@ -567,6 +778,10 @@ sel_erase(int node, int rsv_id) {
 // Note: Since we are not doing offline erasing, need not return in-progress state
 int
 sel_erase_status(int node, int rsv_id, sel_erase_stat_t *status) {
+  if (!sel_node_valid(node)) {
+    return -1;
+  }
+
   if (rsv_id != g_rsv_id[node]) {
     return -1;
   }
@@ -580,76 +795,263 @@ sel_erase_status(int node, int rsv_id, sel_erase_stat_t *status) {
 // Initialize SEL log file
 static int
 sel_node_init(int node) {
-  FILE *fp;
-  int i;
   char fpath[SIZE_PATH_MAX] = {0};
+  struct stat st;
+  uint8_t *buf;
+  ssize_t len;
+  int fd;
 
-  sprintf(fpath, SEL_LOG_FILE, node);
+  snprintf(fpath, sizeof(fpath), sel_log_file, node);
 
-  // Check if the file exists or not
-  if (access(fpath, F_OK) == 0) {
-    // Since file is present, fetch all the contents to cache
-    if (file_get_sel_hdr(node)) {
-      syslog(LOG_WARNING, "init_sel: file_get_sel_hdr\n");
-      return -1;
-    }
-
-    if (file_get_sel_data(node)) {
-      syslog(LOG_WARNING, "init_sel: file_get_sel_data\n");
-      return -1;
-    }
-
-    return 0;
+  fd = open(fpath, O_RDWR | O_CREAT, S_IRUSR | S_IWUSR | S_IRGRP | S_IROTH);
+  if (fd < 0) {
+    syslog(LOG_WARNING, "init_sel: open\n");
+    return -1;
   }
 
-  // File not present, so create the file
-  fp = fopen(fpath, "w+");
-  if (fp == NULL) {
-    syslog(LOG_WARNING, "init_sel: fopen\n");
+  // Files created before the last slot was ever written are short
+  if (fstat(fd, &st) || (st.st_size < SEL_FILE_SIZE && ftruncate(fd, SEL_FILE_SIZE))) {
+    syslog(LOG_WARNING, "init_sel: ftruncate\n");
+    close(fd);
     return -1;
   }
 
-  fclose (fp);
-
-  // Populate SEL Header in to the file
-  g_sel_hdr[node].magic = SEL_HDR_MAGIC;
-  g_sel_hdr[node].version = SEL_HDR_VERSION;
-  g_sel_hdr[node].begin = SEL_INDEX_MIN;
-  g_sel_hdr[node].end = SEL_INDEX_MIN;
-  memset(g_sel_hdr[node].ts_add.ts, 0x0, 4);
-  memset(g_sel_hdr[node].ts_erase.ts, 0x0, 4);
+  buf = malloc(SEL_FILE_SIZE);
+  if (buf == NULL) {
+    close(fd);
+    return -1;
+  }
 
-  if (file_store_sel_hdr(node)) {
-    syslog(LOG_WARNING, "init_sel: file_store_sel_hdr\n");
+  len = pread(fd, buf, SEL_FILE_SIZE, 0);
+  if (len != SEL_FILE_SIZE) {
+    syslog(LOG_WARNING, "init_sel: read\n");
+    free(buf);
+    close(fd);
     return -1;
   }
 
-  // Populate SEL Data in to the file
-  for (i = 1;  i <= SEL_RECORDS_MAX; i++) {
-    sel_msg_t msg = {0};
-    if (file_store_sel_data(node, i, &msg)) {
-      syslog(LOG_WARNING, "init_sel: file_store_sel_data\n");
-      return -1;
+  g_sel_fd[node] = fd;
+  g_sel_hdr[node] = (sel_hdr_t *) buf;
+  g_sel_data[node] = (sel_msg_t *) (buf + SEL_DATA_OFFSET);
+
+  if (!sel_hdr_valid(g_sel_hdr[node])) {
+    if (st.st_size) {
+      syslog(LOG_WARNING, "init_sel: SEL header of node %d is corrupted, starting a new log\n", node);
     }
+
+    // Populate SEL Header and Data in to the file
+    memset(buf, 0, SEL_FILE_SIZE);
+    g_sel_hdr[node]->magic = SEL_HDR_MAGIC;
+    g_sel_hdr[node]->begin = SEL_INDEX_MIN;
+    g_sel_hdr[node]->end = SEL_INDEX_MIN;
+
+    g_rsv_id[node] = 0x01;
   }
 
-  g_rsv_id[node] = 0x01;
+  // Headers from before version 2 get their checksum here
+  g_sel_hdr[node]->version = SEL_HDR_VERSION;
+  sel_hdr_update(node);
 
-  return 0;
+  sel_ts_rebuild(node);
+
+  // Write the new or upgraded header out now rather than on the next add
+  return sel_flush(node);
 }
 
 int
 sel_init(void) {
-  int ret;
+  pthread_t tid;
+  int ret = 0;
   int i;
 
+  // Locks first; requests for a node that failed to load still take them
   for (i = 1; i < MAX_NODES+1; i++) {
-    ret = sel_node_init(i);
-    if (ret) {
-      return ret;
+    pthread_mutex_init(&g_sel_lock[i], NULL);
+  }
+
+  // A node that fails to load is rejected by sel_node_valid(), the rest work
+  for (i = 1; i < MAX_NODES+1; i++) {
+    if (sel_node_init(i)) {
+      syslog(LOG_WARNING, "init_sel: SEL of node %d unavailable\n", i);
+      ret = -1;
     }
   }
 
+  if (pthread_create(&tid, NULL, sel_sync_thread, NULL) == 0) {
+    pthread_detach(tid);
+  } else {
+    syslog(LOG_WARNING, "init_sel: pthread_create\n");
+  }
+
   return ret;
 }
 
+#ifdef __TEST__
+#include <assert.h>
+
+// The test drives the clock and stands in for the platform parsers
+static uint32_t g_test_now;
+
+void
+time_stamp_fill(unsigned char *ts) {
+  ts[0] = g_test_now & 0xFF;
+  ts[1] = (g_test_now >> 8) & 0xFF;
+  ts[2] = (g_test_now >> 16) & 0xFF;
+  ts[3] = (g_test_now >> 24) & 0xFF;
+}
+
+uint8_t pal_parse_ras_sel(uint8_t slot, uint8_t *sel, char *error_log) { error_log[0] = '\0'; return 0; }
+int pal_get_event_sensor_name(uint8_t fru, uint8_t *sel, char *name) { strcpy(name, "test"); return 0; }
+int pal_parse_sel(uint8_t fru, uint8_t *sel, char *error_log) { error_log[0] = '\0'; return 0; }
+int pal_sel_handler(uint8_t fru, uint8_t snr_num, uint8_t *event_data) { return 0; }
+int pal_parse_oem_sel(uint8_t fru, uint8_t *sel, char *error_log) { error_log[0] = '\0'; return 0; }
+void pal_update_ts_sled(void) {}
+
+static void
+test_add(int node, int seq, uint8_t type, int *rec_id) {
+  sel_msg_t msg;
+
+  memset(&msg, 0, sizeof(msg));
+  msg.msg[2] = type;
+  msg.msg[13] = seq & 0xFF;
+  msg.msg[14] = (seq >> 8) & 0xFF;
+  assert(sel_add_entry(node, &msg, rec_id) == 0);
+}
+
+static int
+test_seq(sel_msg_t *msg) {
+  return msg->msg[13] | (msg->msg[14] << 8);
+}
+
+// Page through the log as Get SEL Range does; returns the number of records
+static int
+test_range(int node, int rec_id, int *seqs) {
+  sel_msg_t msgs[14];
+  int next, cnt, i, total = 0;
+
+  do {
+    cnt = sel_get_entries(node, rec_id, msgs, 14, &next);
+    assert(cnt > 0 && cnt <= 14);
+    for (i = 0; i < cnt; i++) {
+      seqs[total++] = test_seq(&msgs[i]);
+    }
+    rec_id = next;
+  } while (next != SEL_RECID_LAST);
+
+  return total;
+}
+
+int main(int argc, char *argv[])
+{
+  int seqs[SEL_ELEMS_MAX];
+  sel_msg_t msg;
+  time_stamp_t ts;
+  sel_erase_stat_t status;
+  sel_hdr_t *hdr;
+  int i, rec_id, next, first, rsv_id, node = 1;
+
+  sel_log_file = "./test/sel%d.bin";
+  system("rm -rf ./test");
+  mkdir("./test", 0755);
+  assert(sel_init() == 0);
+
+  // Out of range nodes and nodes whose SEL file failed to load are rejected
+  assert(sel_num_entries(0) < 0);
+  assert(sel_num_entries(MAX_NODES+1) < 0);
+  assert(sel_free_space(-1) < 0);
+  assert(sel_rsv_id(0) < 0);
+  assert(sel_ts_recent_add(0, &ts) < 0);
+  assert(sel_ts_recent_erase(MAX_NODES+1, &ts) < 0);
+  assert(sel_get_entry(0, SEL_RECID_FIRST, &msg, &next) < 0);
+  assert(sel_get_entries(MAX_NODES+1, SEL_RECID_FIRST, &msg, 1, &next) < 0);
+  assert(sel_find_ts(0, 0) < 0);
+  assert(sel_erase(0, 1) < 0);
+  assert(sel_erase_status(MAX_NODES+1, 1, &status) < 0);
+  memset(&msg, 0, sizeof(msg));
+  assert(sel_add_entry(0, &msg, &rec_id) < 0);
+  hdr = g_sel_hdr[MAX_NODES];
+  g_sel_hdr[MAX_NODES] = NULL;
+  assert(sel_num_entries(MAX_NODES) < 0);
+  assert(sel_add_entry(MAX_NODES, &msg, &rec_id) < 0);
+  g_sel_hdr[MAX_NODES] = hdr;
+  assert(sel_num_entries(MAX_NODES) == 0);
+  printf("SUCCESS: Invalid nodes rejected\n");
+
+  // Fill the ring past its end; the oldest records roll over
+  for (i = 0; i < SEL_RECORDS_MAX + 10; i++) {
+    g_test_now = 1000 + i;
+    test_add(node, i, 0x02, &rec_id);
+  }
+  assert(sel_num_entries(node) == SEL_RECORDS_MAX);
+  assert(sel_free_space(node) == 0);
+  assert(sel_get_entry(node, SEL_RECID_FIRST, &msg, &next) == 0);
+  assert(test_seq(&msg) == 10);
+  assert(sel_get_entry(node, SEL_RECID_LAST, &msg, &next) == 0);
+  assert(test_seq(&msg) == SEL_RECORDS_MAX + 9 && next == SEL_RECID_LAST);
+  assert(sel_get_entry(node, rec_id, &msg, &next) == 0);
+  assert(test_seq(&msg) == SEL_RECORDS_MAX + 9);
+  for (rec_id = SEL_RECID_FIRST, i = 10; rec_id != SEL_RECID_LAST; rec_id = next, i++) {
+    assert(sel_get_entry(node, rec_id, &msg, &next) == 0);
+    assert(test_seq(&msg) == i);
+  }
+  assert(i == SEL_RECORDS_MAX + 10);
+  printf("SUCCESS: Ring rolled over and kept the newest records in order\n");
+
+  // Get SEL Range pages through the same records, from the start or a time stamp
+  assert(test_range(node, SEL_RECID_FIRST, seqs) == SEL_RECORDS_MAX);
+  for (i = 0; i < SEL_RECORDS_MAX; i++) {
+    assert(seqs[i] == i + 10);
+  }
+  assert(sel_find_ts(node, 0) == sel_find_ts(node, 1010));
+  first = sel_find_ts(node, 1050);
+  assert(first > 0);
+  assert(test_range(node, first, seqs) == SEL_RECORDS_MAX - 40);
+  assert(seqs[0] == 50 && seqs[SEL_RECORDS_MAX - 41] == SEL_RECORDS_MAX + 9);
+  assert(sel_find_ts(node, 1000 + SEL_RECORDS_MAX + 10) < 0);
+  assert(sel_get_entries(node, SEL_RECID_LAST, &msg, 14, &next) == 1);
+  assert(next == SEL_RECID_LAST);
+  printf("SUCCESS: Range reads matched the record walk\n");
+
+  // The log survives reloading the file, as after an ipmid restart
+  assert(sel_flush(node) == 0);
+  free(g_sel_hdr[node]);
+  close(g_sel_fd[node]);
+  assert(sel_node_init(node) == 0);
+  assert(sel_num_entries(node) == SEL_RECORDS_MAX);
+  assert(sel_find_ts(node, 1050) == first);
+  assert(test_range(node, SEL_RECID_FIRST, seqs) == SEL_RECORDS_MAX);
+  assert(seqs[0] == 10 && seqs[SEL_RECORDS_MAX - 1] == SEL_RECORDS_MAX + 9);
+  printf("SUCCESS: Log reloaded from the file\n");
+
+  // Erasing needs the current reservation
+  rsv_id = sel_rsv_id(node);
+  assert(sel_erase(node, rsv_id + 1) < 0);
+  assert(sel_erase(node, rsv_id) == 0);
+  assert(sel_erase_status(node, rsv_id, &status) == 0 && status == SEL_ERASE_DONE);
+  assert(sel_num_entries(node) == 0);
+  assert(sel_get_entries(node, SEL_RECID_FIRST, &msg, 14, &next) < 0);
+  assert(sel_find_ts(node, 0) < 0);
+  assert(sel_ts_recent_erase(node, &ts) == 0 && ts.ts[0] == (g_test_now & 0xFF));
+  free(g_sel_hdr[node]);
+  close(g_sel_fd[node]);
+  assert(sel_node_init(node) == 0);
+  assert(sel_num_entries(node) == 0);
+  printf("SUCCESS: SEL erased\n");
+
+  // Non-timestamped OEM records sort with the record before them
+  g_test_now = 2000;
+  test_add(node, 1, 0x02, &rec_id);
+  test_add(node, 2, 0xE0, &rec_id);
+  g_test_now = 3000;
+  test_add(node, 3, 0x02, &rec_id);
+  assert(sel_find_ts(node, 2000) == 1);
+  assert(sel_find_ts(node, 2001) == 3);
+  assert(test_range(node, sel_find_ts(node, 2000), seqs) == 3);
+  assert(seqs[1] == 2);
+  printf("SUCCESS: OEM records kept their place in the time index\n");
+
+  system("rm -rf ./test");
+
+  return 0;
+}
+#endif
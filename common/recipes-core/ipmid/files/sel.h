@@ -21,6 +21,7 @@
 #ifndef __SEL_H__
 #define __SEL_H__
 
+#include <stdint.h>
 #include "timestamp.h"
 
 enum {
@@ -41,12 +42,14 @@ typedef struct {
   unsigned char msg[35];
 } ras_sel_msg_t;
 
-void sel_ts_recent_add(int node, time_stamp_t *ts);
-void sel_ts_recent_erase(int node, time_stamp_t *ts);
+int sel_ts_recent_add(int node, time_stamp_t *ts);
+int sel_ts_recent_erase(int node, time_stamp_t *ts);
 int sel_num_entries(int node);
 int sel_free_space(int node);
 int sel_rsv_id(int node);
 int sel_get_entry(int node, int read_rec_id, sel_msg_t *msg, int *next_rec_id);
+int sel_get_entries(int node, int read_rec_id, sel_msg_t *msgs, int max, int *next_rec_id);
+int sel_find_ts(int node, uint32_t ts);
 int sel_add_entry(int node, sel_msg_t *msg, int *rec_id);
 int sel_erase(int node, int rsv_id);
 int sel_erase_status(int node, int rsv_id, sel_erase_stat_t *status);
@@ -44,6 +44,7 @@
  */
 #include <errno.h>
 #include <fcntl.h>
+#include <poll.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <stdbool.h>
@@ -55,6 +56,7 @@
 #include <sys/stat.h>
 #include <sys/types.h>
 #include <sys/socket.h>
+#include <sys/signalfd.h>
 #include <sys/un.h>
 #include <unistd.h>
 #include <stdint.h>
@@ -63,17 +65,35 @@
 #include "openbmc/ipmi.h"
 #include <time.h>
 
-unsigned char req_buf[256];
+#define KCS_TOUCH_FILE    "/tmp/kcs_touch"
+#define KCS_STATS_FILE    "/tmp/kcsd_stats.%d"
+
+// Latency histogram: bucket i counts transactions under KCS_HIST_BASE_US << i
+#define KCS_HIST_BASE_US  128
+#define KCS_HIST_BUCKETS  16
+#define KCS_HIST_CMDS     64
+
+typedef struct {
+  uint8_t netfn;
+  uint8_t cmd;
+  uint32_t count;
+  uint64_t total_us;
+  uint32_t max_us;
+  uint32_t bucket[KCS_HIST_BUCKETS + 1];
+} kcs_hist_t;
+
+// One byte of headroom for the payload ID passed to ipmid
+unsigned char req_buf[1 + 256];
 unsigned char res_buf[300];
 uint8_t debug = 0;
 uint8_t fm_bmc_ready_n = 145;
+uint8_t kcs_channel_num = 2;
 int kcs_fd;
+int sig_fd = -1;
 
-#define TOUCH(path) \
-{\
-  int fd = creat(path, 0644);\
-  if (fd) close(fd);\
-}
+// Commands beyond the first KCS_HIST_CMDS share the last entry
+static kcs_hist_t hist[KCS_HIST_CMDS + 1];
+static int hist_cnt;
 
 void set_bmc_ready(bool ready)
 {
@@ -87,64 +107,193 @@ void set_bmc_ready(bool ready)
   gpio_close(&gpio);
 }
 
-void *kcs_thread(void *unused) {
+/*
+ * Tell the PAL the host talked to us. Readers only look at the mtime in
+ * seconds, so once per second is enough.
+ */
+static void
+kcs_touch(void)
+{
+  static time_t last;
+  time_t now = time(NULL);
+  int fd;
+
+  if (now == last)
+    return;
+  last = now;
+
+  if (utimensat(AT_FDCWD, KCS_TOUCH_FILE, NULL, 0) < 0) {
+    fd = creat(KCS_TOUCH_FILE, 0644);
+    if (fd >= 0)
+      close(fd);
+  }
+}
+
+static void
+kcs_hist_add(uint8_t netfn, uint8_t cmd, uint32_t us)
+{
+  kcs_hist_t *h;
+  int i;
+
+  for (i = 0; i < hist_cnt; i++) {
+    if (hist[i].netfn == netfn && hist[i].cmd == cmd)
+      break;
+  }
+  if (i == hist_cnt) {
+    if (hist_cnt < KCS_HIST_CMDS) {
+      hist_cnt++;
+    } else {
+      i = KCS_HIST_CMDS;
+      netfn = cmd = 0xff;
+    }
+    hist[i].netfn = netfn;
+    hist[i].cmd = cmd;
+  }
+  h = &hist[i];
+
+  h->count++;
+  h->total_us += us;
+  if (us > h->max_us)
+    h->max_us = us;
+  for (i = 0; i < KCS_HIST_BUCKETS; i++) {
+    if (us < (KCS_HIST_BASE_US << i))
+      break;
+  }
+  h->bucket[i]++;
+}
+
+static void
+kcs_hist_dump(void)
+{
+  char path[64];
+  FILE *fp;
+  kcs_hist_t *h;
+  int i, b;
+
+  sprintf(path, KCS_STATS_FILE, kcs_channel_num);
+  fp = fopen(path, "w");
+  if (fp == NULL) {
+    syslog(LOG_WARNING, "kcsd: can not write %s\n", path);
+    return;
+  }
+
+  fprintf(fp, "netfn cmd   count  avg_us  max_us |");
+  for (b = 0; b < KCS_HIST_BUCKETS; b++)
+    fprintf(fp, " <%u", KCS_HIST_BASE_US << b);
+  fprintf(fp, " more\n");
+
+  for (i = 0; i <= KCS_HIST_CMDS; i++) {
+    h = &hist[i];
+    if (h->count == 0)
+      continue;
+    fprintf(fp, " 0x%02x 0x%02x %7u %7llu %7u |", h->netfn, h->cmd, h->count,
+            (unsigned long long)(h->total_us / h->count), h->max_us);
+    for (b = 0; b <= KCS_HIST_BUCKETS; b++)
+      fprintf(fp, " %u", h->bucket[b]);
+    fprintf(fp, "\n");
+  }
+  fclose(fp);
+}
+
+/*
+ * Wait for a request from the host, dumping the histograms if asked to.
+ * Returns the length of the request read after the headroom byte.
+ */
+static int
+kcs_read(void)
+{
+  struct pollfd fds[2];
+  struct signalfd_siginfo si;
   struct timespec req;
-  struct timespec rem;
+  int n;
+
+  fds[0].fd = kcs_fd;
+  fds[0].events = POLLIN;
+  fds[1].fd = sig_fd;
+  fds[1].events = POLLIN;
+
+  while (1) {
+    if (poll(fds, sig_fd >= 0 ? 2 : 1, -1) < 0) {
+      if (errno != EINTR) {
+        syslog(LOG_WARNING, "kcsd: poll() failed, errno: %d\n", errno);
+        sleep(1);
+      }
+      continue;
+    }
+
+    if (sig_fd >= 0 && (fds[1].revents & POLLIN)) {
+      if (read(sig_fd, &si, sizeof(si)) == sizeof(si))
+        kcs_hist_dump();
+    }
+
+    if (fds[0].revents & (POLLIN | POLLERR | POLLHUP)) {
+      n = read(kcs_fd, req_buf + 1, sizeof(req_buf) - 1);
+      if (n > 0)
+        return n;
+
+      // The device claimed to be readable but was not: a driver without
+      // poll support, pace the retries as kcsd always did
+      req.tv_sec = 0;
+      req.tv_nsec = 10000000;//10mSec
+      nanosleep(&req, NULL);
+    }
+  }
+}
+
+void *kcs_thread(void *unused) {
   struct timespec req_tv;
   struct timespec res_tv;
+  struct timespec now_tv;
 
-  unsigned char req_len;
+  int req_len;
   unsigned short res_len;
+  uint32_t us;
   double temp=0;
   char cmd[200]={0};
   int i = 0;
 
   set_bmc_ready(true);
 
-  // Setup wait time
-  req.tv_sec = 0;
-  req.tv_nsec = 10000000;//10mSec
-
   while(1) {
-    req_len = read(kcs_fd, req_buf, sizeof(req_buf));
-    if (req_len > 0) {
-      //dump read data
-      if(debug) {
-        memset(cmd, 0, 200);
-        clock_gettime(CLOCK_REALTIME, &req_tv);
-        for(i=0; i < req_len; i++) {
-          sprintf(cmd, "%s %02x", cmd, req_buf[i]);
-        }
-        syslog(LOG_WARNING, "[ %ld.%ld ] KCS Req: %s", req_tv.tv_sec, req_tv.tv_nsec, cmd);
-      }
-      // Add payload_id as 1 to  pass to ipmid
-      for (i = req_len; i >=0; i--) {
-        req_buf[i+1] = req_buf[i];
-      }
+    req_len = kcs_read();
+    clock_gettime(CLOCK_MONOTONIC, &req_tv);
 
-      req_buf[0] = 0x01;
+    //dump read data
+    if(debug) {
+      memset(cmd, 0, 200);
+      clock_gettime(CLOCK_REALTIME, &now_tv);
+      for(i=0; i < req_len; i++) {
+        sprintf(cmd, "%s %02x", cmd, req_buf[i + 1]);
+      }
+      syslog(LOG_WARNING, "[ %ld.%ld ] KCS Req: %s", now_tv.tv_sec, now_tv.tv_nsec, cmd);
+    }
+    // Add payload_id as 1 to  pass to ipmid
+    req_buf[0] = 0x01;
 
-      TOUCH("/tmp/kcs_touch");
+    kcs_touch();
 
     // Send to IPMI stack and get response
     // Additional byte as we are adding and passing payload ID for MN support
+    // lib_ipmi_handle keeps its connection to ipmid open across requests
+    res_len = 0;
     lib_ipmi_handle(req_buf, req_len + 1, res_buf, &res_len);
 
-    } else {
-      //sleep(0);
-      nanosleep(&req, &rem);
-      continue;
-    }
-
     res_len = write(kcs_fd, res_buf, res_len);
+    clock_gettime(CLOCK_MONOTONIC, &res_tv);
+
+    us = (res_tv.tv_sec - req_tv.tv_sec) * 1000000 +
+         (res_tv.tv_nsec - req_tv.tv_nsec) / 1000;
+    if (req_len >= 2)
+      kcs_hist_add(req_buf[1] >> 2, req_buf[2], us);
+
     if(debug) {
       memset(cmd, 0, 200);
-      clock_gettime(CLOCK_REALTIME, &res_tv);
+      clock_gettime(CLOCK_REALTIME, &now_tv);
       for(i=0; i < res_len; i++)
         sprintf(cmd, "%s %02x", cmd, res_buf[i]);
-      syslog(LOG_WARNING, "[ %ld.%ld ] KCS Res: %s", res_tv.tv_sec, res_tv.tv_nsec, cmd);
+      syslog(LOG_WARNING, "[ %ld.%ld ] KCS Res: %s", now_tv.tv_sec, now_tv.tv_nsec, cmd);
 
-      temp =  (res_tv.tv_sec - req_tv.tv_sec -1) *1000 + (1000 + (float) ((res_tv.tv_nsec - req_tv.tv_nsec)/1000000) );
+      temp = us / 1000.0;
       syslog(LOG_WARNING, "KCS transaction time: %f ms ", temp);
     }
   }
@@ -154,7 +303,7 @@ int
 main(int argc, char * const argv[]) {
   pthread_t thread;
   char cmd[256], device[256];
-  uint8_t kcs_channel_num = 2;
+  sigset_t mask;
 
   daemon(1, 0);
   openlog("kcsd", LOG_CONS, LOG_DAEMON);
@@ -168,11 +317,21 @@ main(int argc, char * const argv[]) {
 
   sprintf(device, "/dev/ast-kcs.%d", kcs_channel_num);
   kcs_fd = open(device, O_RDWR);
-  if (!kcs_fd) {
+  if (kcs_fd < 0) {
     syslog(LOG_WARNING, "kcsd: can not open kcs device\n");
     exit(-1);
   }
 
+  // SIGUSR1 dumps the latency histograms; the KCS thread picks it up
+  // from its poll() set, so block it everywhere
+  sigemptyset(&mask);
+  sigaddset(&mask, SIGUSR1);
+  pthread_sigmask(SIG_BLOCK, &mask, NULL);
+  sig_fd = signalfd(-1, &mask, SFD_CLOEXEC);
+  if (sig_fd < 0) {
+    syslog(LOG_WARNING, "kcsd: signalfd() failed, errno: %d\n", errno);
+  }
+
   sleep(1);
 
   if (pthread_create(&thread, NULL, kcs_thread, NULL) < 0) {
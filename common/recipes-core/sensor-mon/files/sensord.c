@@ -28,28 +28,98 @@
 #include <math.h>
 #include <string.h>
 #include <pthread.h>
+#include <time.h>
 #include <sys/file.h>
 #include <sys/stat.h>
 #include <openbmc/ipmi.h>
 #include <openbmc/sdr.h>
 #include <openbmc/pal.h>
 #include <openbmc/obmc-sensor.h>
+#include <openbmc/obmc-stats.h>
 #include <openbmc/aggregate-sensor.h>
 
 #define MIN_POLL_INTERVAL 2
 #define STOP_PERIOD 10
 #define MAX_SENSOR_CHECK_RETRY 3
 #define MAX_ASSERT_CHECK_RETRY 1
+#define THRESH_CONFIRM_MS 50
+#define MAX_POLL_WORKERS 8
+/* Aggregate sensors read other FRUs' caches; keep them off the FRU workers */
+#define AGGREGATE_POLL_WORKER MAX_POLL_WORKERS
+#define SENSORD_STATS_SOCK "/var/run/sensord_stats.sock"
 
 static thresh_sensor_t g_snr[MAX_NUM_FRUS][MAX_SENSOR_NUM] = {0};
 static thresh_sensor_t g_aggregate_snr[MAX_SENSOR_NUM] = {0};
 
+/*
+ * Sensors are polled by a small pool of workers. Each worker owns a
+ * min-heap of tasks ordered by deadline and sleeps until the earliest one
+ * is due, so every sensor is read on its own poll_interval and a slow
+ * sensor only delays the sensors sharing its worker. Sensors are assigned
+ * to workers by their PAL poll group; aggregate sensors get a worker of
+ * their own.
+ */
+enum {
+  POLL_TASK_SENSOR = 0,
+  POLL_TASK_FRU,      /* Per-FRU housekeeping and discrete sensors */
+};
+
+typedef struct {
+  uint64_t deadline;  /* CLOCK_MONOTONIC, us */
+  uint64_t base;      /* Regular poll point, deadline may be earlier */
+  uint8_t fru;
+  uint8_t snr_num;
+  uint8_t type;
+} poll_task_t;
+
+typedef struct {
+  pthread_t tid;
+  int cnt;
+  int max;
+  poll_task_t *heap;
+} poll_worker_t;
+
+typedef struct {
+  uint8_t worker;
+  uint8_t interval;
+  uint32_t reads;
+  uint32_t fails;
+  uint32_t last_lat_us;
+  uint32_t max_lat_us;
+  uint64_t total_lat_us;
+  uint32_t max_jitter_us;
+  uint64_t total_jitter_us;
+} snr_poll_stats_t;
+
+static poll_worker_t g_workers[MAX_POLL_WORKERS + 1];
+/* Index 0 holds the aggregate sensors */
+static snr_poll_stats_t g_poll_stats[MAX_NUM_FRUS + 1][MAX_SENSOR_NUM];
+static pthread_mutex_t g_stats_lock = PTHREAD_MUTEX_INITIALIZER;
+/* Serializes threshold state of a FRU between workers */
+static pthread_mutex_t g_fru_lock[MAX_NUM_FRUS + 1];
+/* Set by the FRU task while a firmware update runs, read by other workers */
+static bool g_fru_paused[MAX_NUM_FRUS + 1];
+
+/* Consecutive readings past/clear of each threshold, indexed by *_THRESH */
+typedef struct {
+  uint8_t assert_cnt[LNR_THRESH + 1];
+  uint8_t deassert_cnt[LNR_THRESH + 1];
+} thresh_confirm_t;
+
+static thresh_confirm_t g_thresh_confirm[MAX_NUM_FRUS + 1][MAX_SENSOR_NUM];
+
 static void
 print_usage() {
     printf("Usage: sensord <options>\n");
+    printf("       sensord --stats\n");
     printf("Options: [ %s ]\n", pal_fru_list);
 }
 
+static int
+fru_index(uint8_t fru) {
+  return (fru == AGGREGATE_SENSOR_FRU_ID) ? 0 : fru;
+}
+
 /*
  * Returns the pointer to the struct holding all sensor info and
  * calculated threshold values for the fru#
@@ -95,6 +165,9 @@ init_fru_snr_thresh(uint8_t fru) {
     return ret;
   }
 
+  // The FRU may have been replaced, rebuild its cached thresholds.
+  sdr_thresh_changed(fru);
+
   for (i = 0; i < sensor_cnt; i++) {
     snr_num = sensor_list[i];
 
@@ -113,6 +186,7 @@ init_fru_snr_thresh(uint8_t fru) {
         mkdir(THRESHOLD_PATH, 0777);
   }
   ret = pal_copy_all_thresh_to_file(fru, snr);
+  sdr_thresh_changed(fru);
   if (ret < 0) {
     syslog(LOG_WARNING, "%s: Fail to copy thresh to file for FRU: %d", __func__, fru);
     return ret;
@@ -173,54 +247,22 @@ get_snr_thresh_val(uint8_t fru, uint8_t snr_num, uint8_t thresh) {
   return val;
 }
 
-/*
- * Check the curr sensor values against the threshold and
- * if the curr val has deasserted, log it.
- */
-static int
-check_thresh_deassert(uint8_t fru, uint8_t snr_num, uint8_t thresh,
-  float *curr_val) {
+static bool
+thresh_is_upper(uint8_t thresh) {
+  return (thresh == UNC_THRESH) || (thresh == UCR_THRESH) || (thresh == UNR_THRESH);
+}
+
+/* Record and log a confirmed deassertion */
+static void
+thresh_deassert(uint8_t fru, uint8_t snr_num, uint8_t thresh, float curr_val) {
   uint8_t curr_state = 0;
   float thresh_val;
   char thresh_name[100];
   thresh_sensor_t *snr;
-  uint8_t retry = 0;
-  int ret;
 
   snr = get_struct_thresh_sensor(fru);
-
-  if (!GETBIT(snr[snr_num].flag, thresh) ||
-      !GETBIT(snr[snr_num].curr_state, thresh))
-    return 0;
-
   thresh_val = get_snr_thresh_val(fru, snr_num, thresh);
 
-  while (retry <= MAX_SENSOR_CHECK_RETRY) {
-    switch (thresh) {
-
-      case UNR_THRESH:
-      case UCR_THRESH:
-      case UNC_THRESH:
-        if (*curr_val >= (thresh_val - snr[snr_num].neg_hyst))
-          return 0;
-        break;
-
-      case LNR_THRESH:
-      case LCR_THRESH:
-      case LNC_THRESH:
-        if (*curr_val <= (thresh_val + snr[snr_num].pos_hyst))
-          return 0;
-    }
-
-    if (retry < MAX_SENSOR_CHECK_RETRY) {
-      msleep(50);
-      ret = sensor_raw_read_helper(fru, snr_num, curr_val);
-      if (ret < 0)
-        return -1;
-    }
-    retry++;
-  }
-
   switch (thresh) {
     case UNC_THRESH:
         curr_state = ~(SETBIT(curr_state, UNR_THRESH) |
@@ -268,67 +310,23 @@ check_thresh_deassert(uint8_t fru, uint8_t snr_num, uint8_t thresh,
     pal_update_ts_sled();
     syslog(LOG_CRIT, "DEASSERT: %s threshold - settled - FRU: %d, num: 0x%X "
         "curr_val: %.2f %s, thresh_val: %.2f %s, snr: %-16s",thresh_name,
-        fru, snr_num, *curr_val, snr[snr_num].units, thresh_val,
+        fru, snr_num, curr_val, snr[snr_num].units, thresh_val,
         snr[snr_num].units, snr[snr_num].name);
-    pal_sensor_deassert_handle(fru, snr_num, *curr_val, thresh);
+    pal_sensor_deassert_handle(fru, snr_num, curr_val, thresh);
   }
-
-  return 0;
 }
 
-
-/*
- * Check the curr sensor values against the threshold and
- * if the curr val has asserted, log it.
- */
-static int
-check_thresh_assert(uint8_t fru, uint8_t snr_num, uint8_t thresh,
-  float *curr_val) {
+/* Record and log a confirmed assertion */
+static void
+thresh_assert(uint8_t fru, uint8_t snr_num, uint8_t thresh, float curr_val) {
   uint8_t curr_state = 0;
   float thresh_val;
   char thresh_name[100];
   thresh_sensor_t *snr;
-  uint8_t retry = 0;
-  int ret;
 
   snr = get_struct_thresh_sensor(fru);
-
-  if (pal_ignore_thresh(fru,snr_num,thresh))
-    return 0;
-
-  if (!GETBIT(snr[snr_num].flag, thresh) ||
-      GETBIT(snr[snr_num].curr_state, thresh))
-    return 0;
-
   thresh_val = get_snr_thresh_val(fru, snr_num, thresh);
 
-  while (retry <= MAX_ASSERT_CHECK_RETRY) {
-    switch (thresh) {
-      case UNR_THRESH:
-      case UCR_THRESH:
-      case UNC_THRESH:
-        if (*curr_val < thresh_val) {
-          return 0;
-        }
-        break;
-      case LNR_THRESH:
-      case LCR_THRESH:
-      case LNC_THRESH:
-        if (*curr_val > thresh_val) {
-          return 0;
-        }
-        break;
-    }
-
-    if (retry < MAX_ASSERT_CHECK_RETRY) {
-      msleep(50);
-      ret = sensor_raw_read_helper(fru, snr_num, curr_val);
-      if (ret < 0)
-        return -1;
-    }
-    retry++;
-  }
-
   switch (thresh) {
     case UNR_THRESH:
         curr_state = (SETBIT(curr_state, UNR_THRESH) |
@@ -377,12 +375,78 @@ check_thresh_assert(uint8_t fru, uint8_t snr_num, uint8_t thresh,
     pal_update_ts_sled();
     syslog(LOG_CRIT, "ASSERT: %s threshold - raised - FRU: %d, num: 0x%X"
         " curr_val: %.2f %s, thresh_val: %.2f %s, snr: %-16s", thresh_name,
-        fru, snr_num, *curr_val, snr[snr_num].units, thresh_val,
+        fru, snr_num, curr_val, snr[snr_num].units, thresh_val,
         snr[snr_num].units, snr[snr_num].name);
-    pal_sensor_assert_handle(fru, snr_num, *curr_val, thresh);
+    pal_sensor_assert_handle(fru, snr_num, curr_val, thresh);
   }
+}
 
-  return 0;
+/*
+ * Evaluate all thresholds of a sensor against one reading.
+ *
+ * A threshold is only asserted once MAX_ASSERT_CHECK_RETRY further reads
+ * keep crossing it, and only deasserted once MAX_SENSOR_CHECK_RETRY
+ * further reads stay clear of it by the hysteresis. Instead of sleeping
+ * and re-reading here, the count of consecutive readings is kept per
+ * threshold and true is returned so the caller reads the sensor again
+ * after THRESH_CONFIRM_MS.
+ */
+static bool
+thresh_eval(uint8_t fru, uint8_t snr_num, float curr_val) {
+  static const uint8_t assert_order[] = {
+    UNC_THRESH, UCR_THRESH, UNR_THRESH, LNC_THRESH, LCR_THRESH, LNR_THRESH,
+  };
+  static const uint8_t deassert_order[] = {
+    UNR_THRESH, UCR_THRESH, UNC_THRESH, LNR_THRESH, LCR_THRESH, LNC_THRESH,
+  };
+  thresh_sensor_t *snr = get_struct_thresh_sensor(fru);
+  thresh_confirm_t *cf = &g_thresh_confirm[fru_index(fru)][snr_num];
+  bool pending = false, hit;
+  float thresh_val;
+  uint8_t thresh;
+  int i;
+
+  for (i = 0; i < sizeof(assert_order); i++) {
+    thresh = assert_order[i];
+    if (!GETBIT(snr[snr_num].flag, thresh) ||
+        GETBIT(snr[snr_num].curr_state, thresh) ||
+        pal_ignore_thresh(fru, snr_num, thresh)) {
+      cf->assert_cnt[thresh] = 0;
+      continue;
+    }
+    thresh_val = get_snr_thresh_val(fru, snr_num, thresh);
+    hit = thresh_is_upper(thresh) ? (curr_val >= thresh_val) : (curr_val <= thresh_val);
+    if (!hit) {
+      cf->assert_cnt[thresh] = 0;
+    } else if (++cf->assert_cnt[thresh] > MAX_ASSERT_CHECK_RETRY) {
+      cf->assert_cnt[thresh] = 0;
+      thresh_assert(fru, snr_num, thresh, curr_val);
+    } else {
+      pending = true;
+    }
+  }
+
+  for (i = 0; i < sizeof(deassert_order); i++) {
+    thresh = deassert_order[i];
+    if (!GETBIT(snr[snr_num].flag, thresh) ||
+        !GETBIT(snr[snr_num].curr_state, thresh)) {
+      cf->deassert_cnt[thresh] = 0;
+      continue;
+    }
+    thresh_val = get_snr_thresh_val(fru, snr_num, thresh);
+    hit = thresh_is_upper(thresh) ? (curr_val < (thresh_val - snr[snr_num].neg_hyst)) :
+                                    (curr_val > (thresh_val + snr[snr_num].pos_hyst));
+    if (!hit) {
+      cf->deassert_cnt[thresh] = 0;
+    } else if (++cf->deassert_cnt[thresh] > MAX_SENSOR_CHECK_RETRY) {
+      cf->deassert_cnt[thresh] = 0;
+      thresh_deassert(fru, snr_num, thresh, curr_val);
+    } else {
+      pending = true;
+    }
+  }
+
+  return pending;
 }
 
 static int
@@ -436,113 +500,6 @@ thresh_reinit_chk(uint8_t fru) {
   return ret;
 }
 
-/*
- * Starts monitoring all the sensors on a fru for all the threshold/discrete values.
- * Each pthread runs this monitoring for a different fru.
- */
-static void *
-snr_monitor(void *arg) {
-
-  uint8_t fru = (uint8_t)(uintptr_t)arg;
-  int i, ret, snr_num, sensor_cnt, discrete_cnt;
-  float curr_val;
-  uint8_t *sensor_list, *discrete_list;
-  thresh_sensor_t *snr;
-  uint8_t snr_poll_interval[MAX_SENSOR_NUM] = {0};
-
-  ret = pal_get_fru_sensor_list(fru, &sensor_list, &sensor_cnt);
-  if (ret < 0) {
-    pthread_detach(pthread_self());
-    pthread_exit(NULL);
-  }
-
-  ret = pal_get_fru_discrete_list(fru, &discrete_list, &discrete_cnt);
-  if (ret < 0) {
-    pthread_detach(pthread_self());
-    pthread_exit(NULL);
-  }
-
-  if ((sensor_cnt == 0) && (discrete_cnt == 0)) {
-    pthread_detach(pthread_self());
-    pthread_exit(NULL);
-  }
-
-  snr = get_struct_thresh_sensor(fru);
-  if (snr == NULL) {
-    syslog(LOG_WARNING, "snr_monitor: get_struct_thresh_sensor failed");
-    exit(-1);
-  }
-
-  for (i = 0; i < discrete_cnt; i++) {
-    snr_num = discrete_list[i];
-    pal_get_sensor_name(fru, snr_num, snr[snr_num].name);
-  }
-
-  while(1) {
-    if (pal_is_fw_update_ongoing(fru)) {
-      sleep(STOP_PERIOD);
-      continue;
-    }
-
-    ret = thresh_reinit_chk(fru);
-    if (ret < 0)
-      syslog(LOG_ERR, "%s: Fail to reinit sensor threshold for fru%d",__func__,fru);
-
-    for (i = 0; i < sensor_cnt; i++) {
-      snr_num = sensor_list[i];
-      curr_val = 0;
-      if (snr[snr_num].flag) {
-        // granular the sensor via assigning the poll_interval
-        if (snr_poll_interval[snr_num] > MIN_POLL_INTERVAL) {
-          snr_poll_interval[snr_num] -= MIN_POLL_INTERVAL;
-          continue;
-        }
-        snr_poll_interval[snr_num] = snr[snr_num].poll_interval;
-        if (!(ret = sensor_raw_read_helper(fru, snr_num, &curr_val))) {
-
-          check_thresh_assert(fru, snr_num, UNC_THRESH, &curr_val);
-          check_thresh_assert(fru, snr_num, UCR_THRESH, &curr_val);
-          check_thresh_assert(fru, snr_num, UNR_THRESH, &curr_val);
-          check_thresh_assert(fru, snr_num, LNC_THRESH, &curr_val);
-          check_thresh_assert(fru, snr_num, LCR_THRESH, &curr_val);
-          check_thresh_assert(fru, snr_num, LNR_THRESH, &curr_val);
-
-          check_thresh_deassert(fru, snr_num, UNR_THRESH, &curr_val);
-          check_thresh_deassert(fru, snr_num, UCR_THRESH, &curr_val);
-          check_thresh_deassert(fru, snr_num, UNC_THRESH, &curr_val);
-          check_thresh_deassert(fru, snr_num, LNR_THRESH, &curr_val);
-          check_thresh_deassert(fru, snr_num, LCR_THRESH, &curr_val);
-          check_thresh_deassert(fru, snr_num, LNC_THRESH, &curr_val);
-#ifdef DEBUG
-        } else {
-          syslog(LOG_ERR, "FRU: %d, num: 0x%X, snr:%-16s, read failed",
-              fru, snr_num, snr[snr_num].name);
-#endif /* DEBUG */
-        } /* pal_sensor_read return check */
-      } /* flag check */
-    } /* loop for all sensors */
-
-    for (i = 0; i < discrete_cnt; i++) {
-      snr_num = discrete_list[i];
-      ret = sensor_raw_read_helper(fru, snr_num, &curr_val);
-      if (!ret && (snr[snr_num].curr_state != (int) curr_val)) {
-        pal_sensor_discrete_check(fru, snr_num, snr[snr_num].name,
-            snr[snr_num].curr_state, (int) curr_val);
-        snr[snr_num].curr_state = (int) curr_val;
-      }
-    }
-
-#ifdef DYN_THRESH_FRU1
-    // Handle dynamic threshold changes for FRU1
-    if (fru == 1) {
-      init_fru_snr_thresh(1);
-    }
-#endif
-
-    sleep(MIN_POLL_INTERVAL);
-  } /* while loop*/
-} /* function definition */
-
 static void *
 snr_health_monitor() {
 
@@ -604,78 +561,361 @@ snr_health_monitor() {
   } /* while loop */
 }
 
-static void *
-aggregate_snr_monitor(void *unused)
-{
-  size_t cnt = 0, i;
+static uint64_t
+now_us(void) {
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+static int
+poll_task_push(poll_worker_t *w, poll_task_t *task) {
+  poll_task_t tmp;
+  int i, parent;
+
+  if (w->cnt == w->max) {
+    int max = w->max ? w->max * 2 : 32;
+    poll_task_t *heap = realloc(w->heap, max * sizeof(poll_task_t));
+    if (heap == NULL)
+      return -1;
+    w->heap = heap;
+    w->max = max;
+  }
+
+  i = w->cnt++;
+  w->heap[i] = *task;
+  while (i > 0) {
+    parent = (i - 1) / 2;
+    if (w->heap[parent].deadline <= w->heap[i].deadline)
+      break;
+    tmp = w->heap[parent];
+    w->heap[parent] = w->heap[i];
+    w->heap[i] = tmp;
+    i = parent;
+  }
+  return 0;
+}
+
+static void
+poll_task_pop(poll_worker_t *w, poll_task_t *task) {
+  poll_task_t tmp;
+  int i = 0, child;
+
+  *task = w->heap[0];
+  w->heap[0] = w->heap[--w->cnt];
+  while ((child = 2 * i + 1) < w->cnt) {
+    if (child + 1 < w->cnt && w->heap[child + 1].deadline < w->heap[child].deadline)
+      child++;
+    if (w->heap[i].deadline <= w->heap[child].deadline)
+      break;
+    tmp = w->heap[child];
+    w->heap[child] = w->heap[i];
+    w->heap[i] = tmp;
+    i = child;
+  }
+}
+
+/* Poll interval of a sensor in seconds; threshold reinit may change it */
+static uint8_t
+sensor_poll_interval(thresh_sensor_t *snr) {
+  uint8_t interval = __atomic_load_n(&snr->poll_interval, __ATOMIC_RELAXED);
+
+  return interval ? interval : MIN_POLL_INTERVAL;
+}
+
+/*
+ * Read one threshold sensor. Returns the interval until the next read in
+ * ms; *confirm is set if that is an early re-read to confirm a threshold.
+ */
+static int
+poll_sensor(uint8_t fru, uint8_t snr_num, uint64_t jitter_us, bool *confirm) {
+  thresh_sensor_t *snr = get_struct_thresh_sensor(fru);
+  snr_poll_stats_t *st = &g_poll_stats[fru_index(fru)][snr_num];
+  uint8_t secs = sensor_poll_interval(&snr[snr_num]);
+  int interval = secs * 1000;
+  uint64_t start, lat;
+  float curr_val = 0;
   int ret;
+
+  *confirm = false;
+  if (__atomic_load_n(&g_fru_paused[fru_index(fru)], __ATOMIC_ACQUIRE) ||
+      !snr[snr_num].flag)
+    return interval;
+
+  start = now_us();
+  ret = sensor_raw_read_helper(fru, snr_num, &curr_val);
+  lat = now_us() - start;
+
+  if (!ret) {
+    pthread_mutex_lock(&g_fru_lock[fru_index(fru)]);
+    *confirm = thresh_eval(fru, snr_num, curr_val);
+    pthread_mutex_unlock(&g_fru_lock[fru_index(fru)]);
+#ifdef DEBUG
+  } else {
+    syslog(LOG_ERR, "FRU: %d, num: 0x%X, snr:%-16s, read failed",
+        fru, snr_num, snr[snr_num].name);
+#endif /* DEBUG */
+  }
+
+  pthread_mutex_lock(&g_stats_lock);
+  st->interval = secs;
+  st->reads++;
+  if (ret)
+    st->fails++;
+  st->last_lat_us = lat;
+  if (lat > st->max_lat_us)
+    st->max_lat_us = lat;
+  st->total_lat_us += lat;
+  if (jitter_us > st->max_jitter_us)
+    st->max_jitter_us = jitter_us;
+  st->total_jitter_us += jitter_us;
+  pthread_mutex_unlock(&g_stats_lock);
+
+  return *confirm ? THRESH_CONFIRM_MS : interval;
+}
+
+/* Per-FRU work which used to run once per monitoring loop */
+static int
+poll_fru(uint8_t fru) {
+  thresh_sensor_t *snr = get_struct_thresh_sensor(fru);
+  uint8_t *discrete_list;
+  int i, ret, snr_num, discrete_cnt;
   float curr_val;
-  uint8_t fru = AGGREGATE_SENSOR_FRU_ID;
-  uint8_t snr_num;
+
+  if (pal_is_fw_update_ongoing(fru)) {
+    __atomic_store_n(&g_fru_paused[fru], true, __ATOMIC_RELEASE);
+    return STOP_PERIOD;
+  }
+  __atomic_store_n(&g_fru_paused[fru], false, __ATOMIC_RELEASE);
+
+  pthread_mutex_lock(&g_fru_lock[fru]);
+  ret = thresh_reinit_chk(fru);
+  if (ret < 0)
+    syslog(LOG_ERR, "%s: Fail to reinit sensor threshold for fru%d",__func__,fru);
+#ifdef DYN_THRESH_FRU1
+  // Handle dynamic threshold changes for FRU1
+  if (fru == 1) {
+    init_fru_snr_thresh(1);
+  }
+#endif
+  pthread_mutex_unlock(&g_fru_lock[fru]);
+
+  ret = pal_get_fru_discrete_list(fru, &discrete_list, &discrete_cnt);
+  if (ret < 0)
+    return MIN_POLL_INTERVAL;
+
+  for (i = 0; i < discrete_cnt; i++) {
+    snr_num = discrete_list[i];
+    ret = sensor_raw_read_helper(fru, snr_num, &curr_val);
+    if (!ret && (snr[snr_num].curr_state != (int) curr_val)) {
+      pal_sensor_discrete_check(fru, snr_num, snr[snr_num].name,
+          snr[snr_num].curr_state, (int) curr_val);
+      snr[snr_num].curr_state = (int) curr_val;
+    }
+  }
+
+  return MIN_POLL_INTERVAL;
+}
+
+static void *
+poll_worker(void *arg) {
+  poll_worker_t *w = (poll_worker_t *)arg;
+  poll_task_t task;
+  struct timespec ts;
+  uint64_t now, next;
+  bool confirm;
+  int interval;
+
+  while (w->cnt > 0) {
+    /* Only sensor reads can ask for a confirmation re-read */
+    confirm = false;
+    ts.tv_sec = w->heap[0].deadline / 1000000;
+    ts.tv_nsec = (w->heap[0].deadline % 1000000) * 1000;
+    while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL) == EINTR);
+
+    poll_task_pop(w, &task);
+    now = now_us();
+    if (task.type == POLL_TASK_FRU) {
+      interval = poll_fru(task.fru) * 1000;
+    } else {
+      interval = poll_sensor(task.fru, task.snr_num, now - task.deadline, &confirm);
+    }
+
+    now = now_us();
+    if (confirm) {
+      /* Confirmation re-reads do not move the regular cadence */
+      task.deadline = now + (uint64_t)interval * 1000;
+    } else {
+      /* Keep to the original cadence; if we fell a whole period behind,
+       * restart from now instead of bursting to catch up */
+      next = task.base + (uint64_t)interval * 1000;
+      if (next <= now)
+        next = now + (uint64_t)interval * 1000;
+      task.base = task.deadline = next;
+    }
+    poll_task_push(w, &task);
+  }
+
+  return NULL;
+}
+
+static poll_worker_t *
+get_poll_worker(uint8_t fru, uint8_t snr_num) {
+  uint8_t group = fru;
+
+  if (fru == AGGREGATE_SENSOR_FRU_ID)
+    return &g_workers[AGGREGATE_POLL_WORKER];
+  pal_get_sensor_poll_group(fru, snr_num, &group);
+  return &g_workers[group % MAX_POLL_WORKERS];
+}
+
+static int
+add_sensor_task(uint8_t fru, uint8_t snr_num, uint64_t deadline) {
+  thresh_sensor_t *snr = get_struct_thresh_sensor(fru);
+  snr_poll_stats_t *st = &g_poll_stats[fru_index(fru)][snr_num];
+  poll_worker_t *w = get_poll_worker(fru, snr_num);
+  poll_task_t task = {
+    .deadline = deadline,
+    .base = deadline,
+    .fru = fru,
+    .snr_num = snr_num,
+    .type = POLL_TASK_SENSOR,
+  };
+
+  st->worker = w - g_workers;
+  st->interval = sensor_poll_interval(&snr[snr_num]);
+  return poll_task_push(w, &task);
+}
+
+static int
+add_fru_tasks(uint8_t fru) {
+  int i, ret, sensor_cnt, discrete_cnt;
+  uint8_t *sensor_list, *discrete_list;
   thresh_sensor_t *snr;
+  uint64_t now = now_us();
+  poll_task_t task = {
+    .deadline = now,
+    .base = now,
+    .fru = fru,
+    .type = POLL_TASK_FRU,
+  };
+
+  ret = pal_get_fru_sensor_list(fru, &sensor_list, &sensor_cnt);
+  if (ret < 0)
+    return ret;
+
+  ret = pal_get_fru_discrete_list(fru, &discrete_list, &discrete_cnt);
+  if (ret < 0)
+    return ret;
+
+  if ((sensor_cnt == 0) && (discrete_cnt == 0))
+    return 0;
+
+  snr = get_struct_thresh_sensor(fru);
+  if (snr == NULL) {
+    syslog(LOG_WARNING, "%s: get_struct_thresh_sensor failed", __func__);
+    return -1;
+  }
+
+  for (i = 0; i < discrete_cnt; i++) {
+    pal_get_sensor_name(fru, discrete_list[i], snr[discrete_list[i]].name);
+  }
+
+  /* Housekeeping runs ahead of the FRU's sensors */
+  if (poll_task_push(get_poll_worker(fru, 0), &task) < 0)
+    return -1;
+
+  for (i = 0; i < sensor_cnt; i++) {
+    if (add_sensor_task(fru, sensor_list[i], now + 1) < 0)
+      return -1;
+  }
+  return 0;
+}
+
+static int
+add_aggregate_tasks(void) {
+  size_t cnt = 0, i;
+  uint64_t now = now_us();
 
   if(aggregate_sensor_init(NULL)) {
     syslog(LOG_WARNING, "Initializing aggregate sensors failed!");
   }
 
   aggregate_sensor_count(&cnt);
-  if (cnt == 0) {
-    pthread_exit(NULL);
-    return NULL;
-  }
-  for(i = 0; i < (int)cnt; i++) {
+  for (i = 0; i < cnt; i++) {
     aggregate_sensor_threshold(i, &g_aggregate_snr[i]);
+    if (add_sensor_task(AGGREGATE_SENSOR_FRU_ID, (uint8_t)i, now) < 0)
+      return -1;
   }
-  snr = get_struct_thresh_sensor(fru);
-  if (snr == NULL) {
-    syslog(LOG_WARNING, "agg_snr_monitor: get_struct_thresh_sensor failed");
-    pthread_exit(NULL);
-  }
-
-  while(1) {
-    for (i = 0; i < cnt; i++) {
-      snr_num = (uint8_t)i;
-      curr_val = 0;
-      if (snr[snr_num].flag) {
-        if (!(ret = sensor_raw_read_helper(fru, snr_num, &curr_val))) {
-
-          check_thresh_assert(fru, snr_num, UNC_THRESH, &curr_val);
-          check_thresh_assert(fru, snr_num, UCR_THRESH, &curr_val);
-          check_thresh_assert(fru, snr_num, UNR_THRESH, &curr_val);
-          check_thresh_assert(fru, snr_num, LNC_THRESH, &curr_val);
-          check_thresh_assert(fru, snr_num, LCR_THRESH, &curr_val);
-          check_thresh_assert(fru, snr_num, LNR_THRESH, &curr_val);
-
-          check_thresh_deassert(fru, snr_num, UNR_THRESH, &curr_val);
-          check_thresh_deassert(fru, snr_num, UCR_THRESH, &curr_val);
-          check_thresh_deassert(fru, snr_num, UNC_THRESH, &curr_val);
-          check_thresh_deassert(fru, snr_num, LNR_THRESH, &curr_val);
-          check_thresh_deassert(fru, snr_num, LCR_THRESH, &curr_val);
-          check_thresh_deassert(fru, snr_num, LNC_THRESH, &curr_val);
-#ifdef DEBUG
-        } else {
-          syslog(LOG_ERR, "FRU: %d, num: 0x%X, snr:%-16s, read failed",
-              fru, snr_num, snr[snr_num].name);
-#endif /* DEBUG */
-        } /* pal_sensor_read return check */
-      } /* flag check */
-    } /* loop for all sensors */
-    sleep(MIN_POLL_INTERVAL);
+  return 0;
+}
+
+static void
+dump_poll_stats(FILE *fp) {
+  thresh_sensor_t *snr;
+  snr_poll_stats_t *st, copy;
+  int fru, idx, num;
+
+  fprintf(fp, "%-4s %-4s %-24s %-6s %-8s %-8s %-6s %-10s %-10s %-10s %-10s %-10s\n",
+      "FRU", "NUM", "NAME", "WORKER", "INTERVAL", "READS", "FAILS",
+      "LAT_LAST", "LAT_AVG", "LAT_MAX", "JIT_AVG", "JIT_MAX");
+  for (idx = 0; idx <= MAX_NUM_FRUS; idx++) {
+    fru = idx ? idx : AGGREGATE_SENSOR_FRU_ID;
+    snr = get_struct_thresh_sensor(fru);
+    for (num = 0; num < MAX_SENSOR_NUM; num++) {
+      st = &g_poll_stats[idx][num];
+      pthread_mutex_lock(&g_stats_lock);
+      copy = *st;
+      pthread_mutex_unlock(&g_stats_lock);
+      if (copy.interval == 0)
+        continue;
+      fprintf(fp, "%-4d 0x%-2X %-24.24s %-6u %-8u %-8u %-6u %-10u %-10llu %-10u %-10llu %-10u\n",
+          fru, num, snr[num].name, copy.worker, copy.interval, copy.reads, copy.fails,
+          copy.last_lat_us,
+          (unsigned long long)(copy.reads ? copy.total_lat_us / copy.reads : 0),
+          copy.max_lat_us,
+          (unsigned long long)(copy.reads ? copy.total_jitter_us / copy.reads : 0),
+          copy.max_jitter_us);
+    }
+  }
+}
+
+/* Serves per-sensor latency and jitter to "sensord --stats" */
+static void *
+stats_server(void *unused) {
+  int sock, cli;
+  FILE *fp;
+
+  sock = obmc_stats_listen(SENSORD_STATS_SOCK, 0);
+  if (sock < 0) {
+    return NULL;
+  }
+
+  while (1) {
+    cli = obmc_stats_accept(sock);
+    if (cli < 0)
+      continue;
+    fp = fdopen(cli, "w");
+    if (fp == NULL) {
+      close(cli);
+      continue;
+    }
+    dump_poll_stats(fp);
+    fclose(fp);
   }
-  pthread_exit(NULL);
   return NULL;
 }
 
-/* Spawns a pthread for each fru to monitor all the sensors on it */
+/* Schedules every sensor of the given frus on the poll workers */
 static int
 run_sensord(int argc, char **argv) {
 
-  int ret, arg;
+  int ret, arg, i;
   uint8_t fru;
   uint8_t fru_flag = 0;
-  pthread_t thread_snr[MAX_NUM_FRUS];
   pthread_t sensor_health;
-  pthread_t agg_sensor_mon;
+  pthread_t stats_tid;
 
   arg = 1;
   while(arg < argc) {
@@ -688,6 +928,10 @@ run_sensord(int argc, char **argv) {
     arg++;
   }
 
+  for (i = 0; i <= MAX_NUM_FRUS; i++) {
+    pthread_mutex_init(&g_fru_lock[i], NULL);
+  }
+
   for (fru = 1; fru <= MAX_NUM_FRUS; fru++) {
 
     if (GETBIT(fru_flag, fru)) {
@@ -696,15 +940,23 @@ run_sensord(int argc, char **argv) {
         continue;
 
       /* Threshold Sensors */
-      if (pthread_create(&thread_snr[fru-1], NULL, snr_monitor,
-          (void*)(uintptr_t)fru) < 0) {
-        syslog(LOG_WARNING, "pthread_create for Threshold Sensors for FRU %d failed\n", fru);
-#ifdef DEBUG
-      } else {
-        syslog(LOG_WARNING, "pthread_create for Threshold Sensors for FRU %d succeed\n", fru);
-#endif /* DEBUG */
+      if (add_fru_tasks(fru) < 0) {
+        syslog(LOG_WARNING, "Scheduling Threshold Sensors for FRU %d failed\n", fru);
       }
-      sleep(1);
+    }
+  }
+
+  /* Aggregate sensors */
+  if (add_aggregate_tasks() < 0) {
+    syslog(LOG_WARNING, "Scheduling aggregate sensors failed!\n");
+  }
+
+  for (i = 0; i <= MAX_POLL_WORKERS; i++) {
+    if (g_workers[i].cnt == 0)
+      continue;
+    if (pthread_create(&g_workers[i].tid, NULL, poll_worker, &g_workers[i]) != 0) {
+      syslog(LOG_WARNING, "pthread_create for poll worker %d failed\n", i);
+      g_workers[i].cnt = 0;
     }
   }
 
@@ -713,24 +965,20 @@ run_sensord(int argc, char **argv) {
     syslog(LOG_WARNING, "pthread_create for sensor health failed\n");
   }
 
-  /* Aggregate sensor monitor */
-  if (pthread_create(&agg_sensor_mon, NULL, aggregate_snr_monitor, NULL) < 0) {
-    syslog(LOG_WARNING, "pthread_create for aggregate sensor failed!\n");
+  /* Poll statistics */
+  if (pthread_create(&stats_tid, NULL, stats_server, NULL) < 0) {
+    syslog(LOG_WARNING, "pthread_create for stats server failed\n");
   }
 
-  pthread_join(agg_sensor_mon, NULL);
-
   pthread_join(sensor_health, NULL);
 
-  for (fru = 1; fru <= MAX_NUM_FRUS; fru++) {
-
-    if (GETBIT(fru_flag, fru))
-      pthread_join(thread_snr[fru-1], NULL);
+  for (i = 0; i <= MAX_POLL_WORKERS; i++) {
+    if (g_workers[i].cnt)
+      pthread_join(g_workers[i].tid, NULL);
   }
   return 0;
 }
 
-
 int
 main(int argc, char **argv) {
   int rc, pid_file;
@@ -740,6 +988,10 @@ main(int argc, char **argv) {
     exit(1);
   }
 
+  if (!strcmp(argv[1], "--stats")) {
+    return obmc_stats_print(SENSORD_STATS_SOCK, "sensord") ? -1 : 0;
+  }
+
   pid_file = open("/var/run/sensord.pid", O_CREAT | O_RDWR, 0666);
   rc = flock(pid_file, LOCK_EX | LOCK_NB);
   if(rc) {
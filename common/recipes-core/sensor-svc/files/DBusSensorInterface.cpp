@@ -83,11 +83,14 @@ void DBusSensorInterface::sensorRawRead(GDBusMethodInvocation* invocation,
                                         gpointer               arg) {
   Sensor* obj = static_cast<Sensor*>(arg);
   LOG(INFO) << "sensorRawRead of " << obj->getName();
-  obj->sensorRawRead();
-  g_dbus_method_invocation_return_value(invocation,
-                                        g_variant_new("(id)",
-                                        obj->getLastReadStatus(),
-                                        obj->getValue()));
+  // reply from the read pool once the read completes, so a slow device
+  // does not hold up the main loop
+  obj->sensorRawReadAsync([invocation](Sensor* sensor) {
+    g_dbus_method_invocation_return_value(invocation,
+                                          g_variant_new("(id)",
+                                          sensor->getLastReadStatus(),
+                                          sensor->getValue()));
+  });
 }
 
 void DBusSensorInterface::getSensorObject(GDBusMethodInvocation* invocation,
@@ -24,6 +24,7 @@
 #include <nlohmann/json.hpp>
 #include "DBusSensorServiceInterface.h"
 #include "SensorJsonParser.h"
+#include "SensorReadPool.h"
 
 namespace openbmc {
 namespace qin {
@@ -56,6 +57,11 @@ static const char* xml =
   "    <method name='getSensorObjects'>"
   "      <arg type='a(syids)' name='sensorlist' direction='out'/>"
   "    </method>"
+  "    <method name='getSensorValues'>"
+  "      <arg type='a(yy)' name='sensors' direction='in'/>"
+  "      <arg type='b' name='raw' direction='in'/>"
+  "      <arg type='a(yyidt)' name='values' direction='out'/>"
+  "    </method>"
   "    <method name='addFRU'>"
   "      <arg type='s' name='fruParentPath' direction='in'/>"
   "      <arg type='s' name='fruJsonString' direction='in'/>"
@@ -167,6 +173,8 @@ void DBusSensorServiceInterface::resetTree(GDBusMethodInvocation* invocation,
   LOG(INFO) << "resetTree at " << objectPath;
 
   Object* obj = sensorTree->getObject(objectPath);
+  // reads in flight still refer to the sensors
+  SensorReadPool::getInstance().drain();
   Object::ChildMap childMap = obj->getChildMap();
   for (auto it = childMap.cbegin(); it != childMap.cend();) {
     deleteSubtree(sensorTree, (it++)->second);
@@ -187,6 +195,8 @@ void DBusSensorServiceInterface::removeFRU(GDBusMethodInvocation* invocation,
 
   Object* obj = sensorTree->getObject(fruPath);
   if ((dynamic_cast<FRU*>(obj)) != nullptr) {
+    // reads in flight still refer to the sensors
+    SensorReadPool::getInstance().drain();
     deleteSubtree(sensorTree, obj);
   }
   else {
@@ -20,6 +20,9 @@
 
 #include <string>
 #include <vector>
+#include <memory>
+#include <atomic>
+#include <unordered_map>
 #include <glog/logging.h>
 #include <gio/gio.h>
 #include "DBusSensorTreeInterface.h"
@@ -57,6 +60,11 @@ static const char* xml =
   "    <method name='getSensorObjects'>"
   "      <arg type='a(syids)' name='sensorlist' direction='out'/>"
   "    </method>"
+  "    <method name='getSensorValues'>"
+  "      <arg type='a(yy)' name='sensors' direction='in'/>"
+  "      <arg type='b' name='raw' direction='in'/>"
+  "      <arg type='a(yyidt)' name='values' direction='out'/>"
+  "    </method>"
   "  </interface>"
   "</node>";
 
@@ -361,6 +369,133 @@ void DBusSensorTreeInterface::getSensorObjects(
   g_variant_builder_unref(builder);
 }
 
+/**
+ * Recursively collects the sensors in the subtree under Object obj
+ */
+static void getSensorsRec(Object* obj, std::vector<Sensor*> &sensors) {
+  for (auto &it : obj->getChildMap()) {
+    Sensor* sensor;
+    if ((sensor = dynamic_cast<Sensor*>(it.second)) != nullptr) {
+      sensors.push_back(sensor);
+    }
+    else if (dynamic_cast<FRU*>(it.second) != nullptr) {
+      getSensorsRec(it.second, sensors);
+    }
+  }
+}
+
+static uint8_t getSensorFruId(Sensor* sensor) {
+  FRU* fru = sensor->getFru();
+  return fru != nullptr ? fru->getId() : 0xFF;
+}
+
+static void addSensorValue(GVariantBuilder* builder, Sensor* sensor) {
+  g_variant_builder_add(builder,
+                        "(yyidt)",
+                        getSensorFruId(sensor),
+                        sensor->getId(),
+                        sensor->getLastReadStatus(),
+                        (double)sensor->getValue(),
+                        (guint64)sensor->getReadTime());
+}
+
+/**
+ * Sensors of one getSensorValues request, in the order of the reply.
+ * A slot without a sensor is answered with READING_NA.
+ */
+struct SensorValuesRequest {
+  struct Slot {
+    guchar fru;
+    guchar id;
+    Sensor* sensor;
+  };
+
+  GDBusMethodInvocation* invocation;
+  std::vector<Slot> slots;
+  std::atomic<size_t> pending{0};   // raw reads still in flight
+};
+
+static void returnSensorValues(const SensorValuesRequest &request) {
+  GVariantBuilder* builder = g_variant_builder_new(G_VARIANT_TYPE("a(yyidt)"));
+
+  for (auto &slot : request.slots) {
+    if (slot.sensor != nullptr) {
+      addSensorValue(builder, slot.sensor);
+    }
+    else {
+      g_variant_builder_add(builder, "(yyidt)", slot.fru, slot.id,
+                            READING_NA, 0.0, (guint64)0);
+    }
+  }
+
+  g_dbus_method_invocation_return_value(request.invocation,
+                                        g_variant_new("(a(yyidt))", builder));
+  g_variant_builder_unref(builder);
+}
+
+void DBusSensorTreeInterface::getSensorValues(
+                                           GDBusMethodInvocation* invocation,
+                                           GVariant*              parameters,
+                                           gpointer               arg) {
+  Object* obj = static_cast<Object*>(arg);
+  GVariantIter* iter;
+  gboolean raw;
+  guchar fru, id;
+  std::vector<Sensor*> sensors;
+  auto request = std::make_shared<SensorValuesRequest>();
+
+  g_variant_get(parameters, "(a(yy)b)", &iter, &raw);
+  LOG(INFO) << "getSensorValues of " << g_variant_iter_n_children(iter)
+            << " sensors from " << obj->getName();
+
+  request->invocation = invocation;
+  getSensorsRec(obj, sensors);
+
+  if (g_variant_iter_n_children(iter) == 0) {
+    // no sensors requested, return all of them
+    for (auto sensor : sensors) {
+      request->slots.push_back({getSensorFruId(sensor), sensor->getId(),
+                                sensor});
+    }
+  }
+  else {
+    std::unordered_map<uint16_t, Sensor*> index;
+    for (auto sensor : sensors) {
+      index.insert({(uint16_t)(getSensorFruId(sensor) << 8 | sensor->getId()),
+                    sensor});
+    }
+    // reply in the order of the request
+    while (g_variant_iter_next(iter, "(yy)", &fru, &id)) {
+      auto it = index.find((uint16_t)(fru << 8 | id));
+      request->slots.push_back({fru, id,
+                                it != index.end() ? it->second : nullptr});
+    }
+  }
+  g_variant_iter_free(iter);
+
+  for (auto &slot : request->slots) {
+    if (raw && slot.sensor != nullptr) {
+      request->pending++;
+    }
+  }
+  if (request->pending == 0) {
+    returnSensorValues(*request);
+    return;
+  }
+
+  // read on the pool, sensors on different buses in parallel; the last
+  // read to complete sends the reply
+  for (auto &slot : request->slots) {
+    if (slot.sensor != nullptr) {
+      slot.sensor->sensorRawReadAsync([request](Sensor* sensor) {
+        if (--request->pending == 0) {
+          returnSensorValues(*request);
+        }
+      });
+    }
+  }
+}
+
 void DBusSensorTreeInterface::methodCallBack(
                           GDBusConnection*       connection,
                           const char*            sender,
@@ -391,6 +526,9 @@ void DBusSensorTreeInterface::methodCallBack(
   else if (g_strcmp0(methodName, "getSensorObjects") == 0) {
     getSensorObjects(invocation, arg);
   }
+  else if (g_strcmp0(methodName, "getSensorValues") == 0) {
+    getSensorValues(invocation, parameters, arg);
+  }
 }
 
 } // namespace qin
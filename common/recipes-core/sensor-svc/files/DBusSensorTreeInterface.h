@@ -107,6 +107,18 @@ class DBusSensorTreeInterface: public DBusInterfaceBase {
      */
     static void getSensorObjects(GDBusMethodInvocation* invocation,
                                  gpointer               arg);
+
+    /**
+     * Callback for getSensorValues method
+     * Returns fru, id, read status, value and read time of the requested
+     * (fru, sensor id) pairs in request order, or of all sensors under
+     * subtree if none are requested. If raw is set the sensors are read
+     * first on the sensor read pool and the reply is sent when the last
+     * read completes
+     */
+    static void getSensorValues(GDBusMethodInvocation* invocation,
+                                GVariant*              parameters,
+                                gpointer               arg);
 };
 
 } // namespace qin
@@ -18,8 +18,10 @@
  * Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
  */
 
+#include <ctime>
 #include "Sensor.h"
 #include "SensorAccessMechanism.h"
+#include "SensorReadPool.h"
 
 namespace openbmc {
 namespace qin {
@@ -53,6 +55,7 @@ uint8_t Sensor::getId(){
 }
 
 float Sensor::getValue() {
+  std::lock_guard<std::mutex> guard(valueLock_);
   return value_;
 }
 
@@ -60,19 +63,39 @@ std::string Sensor::getUnit() {
   return unit_;
 }
 
+uint64_t Sensor::getReadTime() {
+  std::lock_guard<std::mutex> guard(valueLock_);
+  return readTime_;
+}
+
 ReadResult Sensor::getLastReadStatus() {
-  return sensorAccess_->getLastReadResult();
+  std::lock_guard<std::mutex> guard(valueLock_);
+  return readResult_;
 }
 
 ReadResult Sensor::sensorRawRead(){
   float val;
+  // the access mechanism keeps state between reads, one read at a time
+  std::lock_guard<std::mutex> readGuard(readLock_);
   ReadResult readResult = sensorAccess_->sensorRawRead(this, &val);
+
+  std::lock_guard<std::mutex> guard(valueLock_);
+  readResult_ = readResult;
   if (readResult == READING_SUCCESS){
     value_ = val;
+    readTime_ = std::time(nullptr);
   }
 
   return readResult;
 }
 
+void Sensor::sensorRawReadAsync(ReadCallback done) {
+  SensorReadPool::getInstance().submit(sensorAccess_->getBusId(),
+                                       [this, done]() {
+    sensorRawRead();
+    done(this);
+  });
+}
+
 } // namespace qin
 } // namespace openbmc
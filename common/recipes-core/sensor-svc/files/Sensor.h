@@ -21,6 +21,8 @@
 #pragma once
 #include <string>
 #include <cstdint>
+#include <mutex>
+#include <functional>
 #include <stdlib.h>
 #include <stdio.h>
 #include <object-tree/Object.h>
@@ -31,9 +33,17 @@ namespace openbmc {
 namespace qin {
 
 class Sensor : public Object{
+  public:
+    using ReadCallback = std::function<void(Sensor*)>;
+
   private:
     uint8_t id_ = 0xFF;                           // Sensor Id
-    float value_;                                 // Last Read Sensor Value
+    float value_ = 0;                             // Last Read Sensor Value
+    uint64_t readTime_ = 0;                       // Time of last successful
+                                                  // read, 0 if none
+    ReadResult readResult_ = READING_NA;          // Last raw read status
+    std::mutex readLock_;                         // held during a raw read
+    std::mutex valueLock_;                        // guards the three above
     std::string unit_;                            // Unit of Sensor
     std::unique_ptr<SensorAccessMechanism> sensorAccess_;
                                                   // sensorAccess mechanism
@@ -75,6 +85,12 @@ class Sensor : public Object{
      */
     std::string getUnit();
 
+    /*
+     * Returns time of the last successful read in seconds since the
+     * epoch, 0 if the sensor was never read
+     */
+    uint64_t getReadTime();
+
     /*
      * Returns last raw read status
      */
@@ -84,6 +100,12 @@ class Sensor : public Object{
      * sensorRaw
      */
     ReadResult sensorRawRead();
+
+    /*
+     * Queues a raw read on the sensor read pool and returns at once.
+     * done is called from the worker thread once the read completes.
+     */
+    void sensorRawReadAsync(ReadCallback done);
 };
 
 } // namespace qin
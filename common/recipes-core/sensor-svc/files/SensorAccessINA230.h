@@ -25,8 +25,20 @@ namespace openbmc {
 namespace qin {
 
 class SensorAccessINA230 : public SensorAccessMechanism {
+  private:
+    int busId_;
+
   protected:
     void rawRead(Sensor* s, float *value) override;
+
+  public:
+    SensorAccessINA230(int busId = -1) {
+      this->busId_ = busId;
+    }
+
+    int getBusId() override {
+      return busId_;
+    }
 };
 
 } // namespace qin
@@ -98,6 +98,16 @@ public:
     return readResult_;
   }
 
+  /*
+   * Returns the I2C bus the sensor is read over, -1 if none.
+   * Reads on the same bus are never run in parallel.
+   */
+  virtual int getBusId() {
+    return -1;
+  }
+
+  virtual ~SensorAccessMechanism() {}
+
   void setmaxNofRetry (uint8_t maxNofRetry) {
     this->maxNofRetry_ = maxNofRetry;
   }
@@ -1,6 +1,5 @@
 /*
- * SensorAccessNVME.cpp : Functions need to be implemented
- *                        in platform specific directory
+ * SensorAccessNVME.cpp
  *
  * Copyright 2017-present Facebook. All Rights Reserved.
  *
@@ -19,14 +18,51 @@
  * Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
  */
 
+#include <cstdio>
+#include <stdint.h>
+#include <glog/logging.h>
+extern "C" {
+#include <openbmc/nvme-mi.h>
+}
 #include "SensorAccessNVME.h"
 #include "Sensor.h"
 
 namespace openbmc {
 namespace qin {
 
+// NVMe-MI composite temperature encoding
+#define NVME_TEMP_MAX_POSITIVE 0x7F   // 0x00 - 0x7F: 0 to 127 C
+#define NVME_TEMP_MIN_NEGATIVE 0xC4   // 0xC4 - 0xFF: -60 to -1 C
+
 void SensorAccessNVME::rawRead(Sensor* s, float *value) {
+  char dev[32];
+  uint8_t temp;
+
   readResult_ = READING_NA;
+  if (busId_ < 0) {
+    return;
+  }
+
+  snprintf(dev, sizeof(dev), "/dev/i2c-%d", busId_);
+  if (nvme_temp_read(dev, &temp) != 0) {
+    LOG(WARNING) << "nvme_temp_read failed on " << dev;
+    return;
+  }
+
+  if (temp <= NVME_TEMP_MAX_POSITIVE) {
+    *value = temp;
+  }
+  else if (temp >= NVME_TEMP_MIN_NEGATIVE) {
+    *value = (int)temp - 0x100;
+  }
+  else {
+    // no data yet, sensor failure or reserved
+    VLOG(1) << "no NVMe temperature on " << dev << ": 0x" << std::hex
+            << (int)temp;
+    return;
+  }
+
+  readResult_ = READING_SUCCESS;
 }
 
 } // namespace qin
@@ -19,14 +19,32 @@
  */
 
 #pragma once
+#include <cstdint>
 #include "SensorAccessMechanism.h"
 
 namespace openbmc {
 namespace qin {
 
+/**
+ * Composite temperature of an NVMe drive, read over NVMe-MI basic
+ * management on /dev/i2c-<busId>. Without a bus (-1) the drive sits
+ * behind a platform mux and the sensor is not readable here.
+ */
 class SensorAccessNVME : public SensorAccessMechanism {
+  private:
+    int busId_;
+
   protected:
     void rawRead(Sensor* s, float *value) override;
+
+  public:
+    SensorAccessNVME(int busId = -1) {
+      this->busId_ = busId;
+    }
+
+    int getBusId() override {
+      return busId_;
+    }
 };
 
 } // namespace qin
@@ -28,6 +28,7 @@
 #include <syslog.h>
 #include <chrono>
 #include <thread>
+#include <atomic>
 #include <cstring>
 #include <linux/i2c.h>
 #include <linux/i2c-dev.h>
@@ -66,6 +67,10 @@ class SensorAccessVR : public SensorAccessMechanism {
       this->slaveAddr_ = slaveAddr;
     }
 
+    int getBusId() override {
+      return busId_;
+    }
+
     bool preRawRead(Sensor* s, float* value) override;
 
     void rawRead(Sensor* s, float *value) override{
@@ -79,7 +84,8 @@ class SensorAccessVR : public SensorAccessMechanism {
 
       readResult_ = READING_NA;
 
-      static uint16_t vrUpdateInProgressCount = 0;
+      // shared by the VR sensors, which may be read on different workers
+      static std::atomic<uint16_t> vrUpdateInProgressCount(0);
       if ( access(VR_UPDATE_IN_PROGRESS, F_OK) == 0 )
       {
         //Avoid sensord unmonitoring vr sensors
@@ -92,7 +98,7 @@ class SensorAccessVR : public SensorAccessMechanism {
 
         syslog(LOG_WARNING,
                "[%d]Stop Monitor VR Volt due to VR update is in progress\n",
-               vrUpdateInProgressCount++);
+               (int)vrUpdateInProgressCount++);
         LOG(INFO) << "VR update in progress ";
         return;
       }
@@ -19,12 +19,28 @@
  * Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
  */
 
+#include <stdlib.h>
 #include "SensorAccessViaPath.h"
 #include "Sensor.h"
 
 namespace openbmc {
 namespace qin {
 
+int SensorAccessViaPath::busIdFromPath(const std::string &path) {
+  // e.g. /sys/devices/platform/ast-i2c.6/i2c-6/6-004e/hwmon/hwmon*/...
+  size_t pos = path.find("/i2c-");
+  while (pos != std::string::npos) {
+    const char* start = path.c_str() + pos + 5;
+    char* end;
+    long busId = strtol(start, &end, 10);
+    if (end != start && (*end == '/' || *end == '\0')) {
+      return (int)busId;
+    }
+    pos = path.find("/i2c-", pos + 1);
+  }
+  return -1;
+}
+
 bool SensorAccessViaPath::preRawRead(Sensor* s, float* value) {
   return true;
 }
@@ -20,6 +20,7 @@
 
 #pragma once
 #include <string>
+#include <cstring>
 #include <fstream>
 #include <sstream>
 #include <glog/logging.h>
@@ -36,13 +37,23 @@ class SensorAccessViaPath : public SensorAccessMechanism {
   private:
     std::string path_;          //sensor path
     float unitDiv_ = 1;         //divisor for value read from path
+    int busId_;                 //I2C bus the device sits on, -1 if none
+
+    /*
+     * Returns N of an i2c-N directory in path, -1 if there is none
+     */
+    static int busIdFromPath(const std::string &path);
 
   public:
     SensorAccessViaPath(std::string path)
-      : path_(path) {}
+      : path_(path), busId_(busIdFromPath(path)) {}
 
     SensorAccessViaPath(std::string path, float unitDiv)
-      : path_(path), unitDiv_(unitDiv) {}
+      : path_(path), unitDiv_(unitDiv), busId_(busIdFromPath(path)) {}
+
+    int getBusId() override {
+      return busId_;
+    }
 
     void rawRead(Sensor* s, float *value) override {
       int pos = path_.find('*');
@@ -167,11 +167,29 @@ void SensorJsonParser::parseSensor(const nlohmann::json &jObject,
       upSensorAccess =  std::unique_ptr<SensorAccessMechanism>
                            (new SensorAccessAVA());
     } else if (type.compare("INA230") == 0) {
-      upSensorAccess = std::unique_ptr<SensorAccessMechanism>
+      try {
+        //Queue reads by bus if busId is set in json file
+        const std::string &busId = access.at("busId");
+        upSensorAccess = std::unique_ptr<SensorAccessMechanism>
+                           (new SensorAccessINA230(std::stoi(busId, nullptr, 0)));
+      }
+      catch (const std::out_of_range& oor) {
+        //if busId is not mentioned
+        upSensorAccess = std::unique_ptr<SensorAccessMechanism>
                            (new SensorAccessINA230());
+      }
     } else if (type.compare("NVME") == 0) {
-      upSensorAccess = std::unique_ptr<SensorAccessMechanism>
+      try {
+        //Read over NVMe-MI if busId is set in json file
+        const std::string &busId = access.at("busId");
+        upSensorAccess = std::unique_ptr<SensorAccessMechanism>
+                           (new SensorAccessNVME(std::stoi(busId, nullptr, 0)));
+      }
+      catch (const std::out_of_range& oor) {
+        //if busId is not mentioned
+        upSensorAccess = std::unique_ptr<SensorAccessMechanism>
                            (new SensorAccessNVME());
+      }
     } else if (type.compare("VR") == 0) {
       const std::string &busId = access.at("busId");
       const std::string &loop = access.at("loop");
@@ -0,0 +1,94 @@
+/*
+ * SensorReadPool.cpp
+ *
+ * Copyright 2017-present Facebook. All Rights Reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+#include "SensorReadPool.h"
+
+namespace openbmc {
+namespace qin {
+
+SensorReadPool::SensorReadPool(unsigned int nofWorkers)
+    : workers_(nofWorkers > 0 ? nofWorkers : 1) {
+  for (auto &worker : workers_) {
+    worker.thread = std::thread(&SensorReadPool::run, this, std::ref(worker));
+  }
+}
+
+SensorReadPool::~SensorReadPool() {
+  {
+    std::lock_guard<std::mutex> guard(lock_);
+    stop_ = true;
+  }
+  for (auto &worker : workers_) {
+    worker.cond.notify_one();
+  }
+  for (auto &worker : workers_) {
+    worker.thread.join();
+  }
+}
+
+SensorReadPool& SensorReadPool::getInstance() {
+  static SensorReadPool pool;
+  return pool;
+}
+
+void SensorReadPool::submit(int busId, Job job) {
+  Worker* worker;
+  {
+    std::lock_guard<std::mutex> guard(lock_);
+    if (busId < 0) {
+      worker = &workers_[next_++ % workers_.size()];
+    }
+    else {
+      worker = &workers_[(unsigned int)busId % workers_.size()];
+    }
+    worker->jobs.push_back(std::move(job));
+    pending_++;
+  }
+  worker->cond.notify_one();
+}
+
+void SensorReadPool::drain() {
+  std::unique_lock<std::mutex> guard(lock_);
+  idle_.wait(guard, [this] { return pending_ == 0; });
+}
+
+void SensorReadPool::run(Worker &worker) {
+  std::unique_lock<std::mutex> guard(lock_);
+  while (true) {
+    worker.cond.wait(guard, [&] { return stop_ || !worker.jobs.empty(); });
+    if (worker.jobs.empty()) {
+      // stopping and nothing left to run
+      return;
+    }
+    Job job = std::move(worker.jobs.front());
+    worker.jobs.pop_front();
+
+    guard.unlock();
+    job();
+    guard.lock();
+
+    if (--pending_ == 0) {
+      idle_.notify_all();
+    }
+  }
+}
+
+} // namespace qin
+} // namespace openbmc
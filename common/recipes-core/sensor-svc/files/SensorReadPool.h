@@ -0,0 +1,83 @@
+/*
+ * SensorReadPool.h
+ *
+ * Copyright 2017-present Facebook. All Rights Reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+#pragma once
+#include <deque>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <functional>
+#include <condition_variable>
+
+namespace openbmc {
+namespace qin {
+
+#define SENSOR_READ_WORKERS 4
+
+/**
+ * Fixed set of worker threads running sensor reads off the GLib main loop.
+ * Each worker has its own queue and reads are queued by bus, so reads on
+ * one I2C bus run one after the other while reads on different buses run
+ * in parallel. Reads without a bus (busId -1) do not contend for one and
+ * are spread over all the queues in turn.
+ */
+class SensorReadPool {
+  public:
+    using Job = std::function<void()>;
+
+    explicit SensorReadPool(unsigned int nofWorkers = SENSOR_READ_WORKERS);
+    ~SensorReadPool();
+
+    /**
+     * Returns the pool shared by all the sensors of the daemon
+     */
+    static SensorReadPool& getInstance();
+
+    /**
+     * Queues job on the worker of bus busId, or on the next worker in
+     * turn if busId is negative
+     */
+    void submit(int busId, Job job);
+
+    /**
+     * Blocks until every queued job has completed. Call it before
+     * deleting sensors that may have reads in flight.
+     */
+    void drain();
+
+  private:
+    struct Worker {
+      std::thread thread;
+      std::deque<Job> jobs;
+      std::condition_variable cond;
+    };
+
+    std::mutex lock_;
+    std::condition_variable idle_;
+    std::vector<Worker> workers_;
+    unsigned int pending_ = 0;      // jobs queued or running
+    unsigned int next_ = 0;         // worker of the next read without a bus
+    bool stop_ = false;
+
+    void run(Worker &worker);
+};
+
+} // namespace qin
+} // namespace openbmc
@@ -0,0 +1,200 @@
+/*
+ * DBusSensorTreeTest.cpp
+ *
+ * Copyright 2017-present Facebook. All Rights Reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <thread>
+#include <fstream>
+#include <stdlib.h>
+#include <unistd.h>
+#include <gtest/gtest.h>
+#include <glog/logging.h>
+#include <gio/gio.h>
+#include <dbus-utils/DBus.h>
+#include "../SensorObjectTree.h"
+#include "../SensorAccessViaPath.h"
+#include "../SensorReadPool.h"
+using namespace openbmc::qin;
+
+// Calls the methods over the system bus, so sensor-svcd must not be running
+static const char* dbusName = "org.openbmc.SensorService";
+static const char* servicePath = "/org/openbmc/SensorService";
+static const char* fruPath = "/org/openbmc/SensorService/slot1";
+
+struct SensorValue {
+  guchar fru;
+  guchar id;
+  gint status;
+  gdouble value;
+  guint64 readTime;
+};
+
+static void eventLoop(GMainLoop* loop) {
+  LOG(INFO) << "Event loop begins";
+  g_main_loop_run(loop);
+  LOG(INFO) << "Event loop ends";
+}
+
+class SensorTreeDBusTest : public ::testing::Test {
+  protected:
+    virtual void SetUp() {
+      char path[] = "/tmp/sensor-svc-test-XXXXXX";
+      int fd = mkstemp(path);
+      ASSERT_GE(fd, 0);
+      close(fd);
+      path_ = path;
+      writeValue("42500");
+
+      sDbus_ = std::shared_ptr<DBus>(new DBus(dbusName));
+      dbus_ = sDbus_.get();
+      dbus_->registerConnection();
+      loop_ = g_main_loop_new(nullptr, FALSE);
+      t_ = std::thread(eventLoop, loop_);
+      dbus_->waitForConnection();
+
+      tree_ = new SensorObjectTree(sDbus_, "org");
+      tree_->addObject("openbmc", "/org");
+      tree_->addSensorService("SensorService", "/org/openbmc");
+      tree_->addFRU("slot1", servicePath, "1");
+      tree_->addSensor("temp", fruPath, "0x10", "C",
+          std::unique_ptr<SensorAccessMechanism>(
+            new SensorAccessViaPath(path_, 1000)));
+      tree_->addSensor("volt", fruPath, "0x11", "V",
+          std::unique_ptr<SensorAccessMechanism>(
+            new SensorAccessViaPath(path_ + ".missing")));
+
+      conn_ = g_bus_get_sync(G_BUS_TYPE_SYSTEM, nullptr, nullptr);
+      ASSERT_TRUE(conn_ != nullptr);
+    }
+
+    virtual void TearDown() {
+      g_object_unref(conn_);
+      SensorReadPool::getInstance().drain();
+      delete tree_;
+      g_main_loop_quit(loop_);
+      g_main_loop_unref(loop_);
+      t_.join();
+      dbus_->unregisterConnection();
+      unlink(path_.c_str());
+    }
+
+    void writeValue(const std::string &value) {
+      std::ofstream ofs(path_);
+      ofs << value;
+    }
+
+    /**
+     * Call getSensorValues on the object at path over the bus
+     */
+    std::vector<SensorValue> getSensorValues(
+        const char* path,
+        const std::vector<std::pair<guchar, guchar>> &sensors,
+        bool raw) {
+      std::vector<SensorValue> values;
+      GError* error = nullptr;
+      GVariantBuilder* builder = g_variant_builder_new(G_VARIANT_TYPE("a(yy)"));
+      for (auto &it : sensors) {
+        g_variant_builder_add(builder, "(yy)", it.first, it.second);
+      }
+      GVariant* response = g_dbus_connection_call_sync(
+          conn_, dbusName, path, "org.openbmc.SensorTree", "getSensorValues",
+          g_variant_new("(a(yy)b)", builder, raw),
+          G_VARIANT_TYPE("(a(yyidt))"), G_DBUS_CALL_FLAGS_NONE, -1,
+          nullptr, &error);
+      g_variant_builder_unref(builder);
+      if (error != nullptr) {
+        ADD_FAILURE() << "getSensorValues failed: " << error->message;
+        g_error_free(error);
+        return values;
+      }
+
+      GVariantIter* iter;
+      SensorValue v;
+      g_variant_get(response, "(a(yyidt))", &iter);
+      while (g_variant_iter_next(iter, "(yyidt)", &v.fru, &v.id, &v.status,
+                                 &v.value, &v.readTime)) {
+        values.push_back(v);
+      }
+      g_variant_iter_free(iter);
+      g_variant_unref(response);
+      return values;
+    }
+
+    std::string path_;
+    std::shared_ptr<DBus> sDbus_;
+    DBus* dbus_;
+    GMainLoop* loop_;
+    std::thread t_;
+    SensorObjectTree* tree_;
+    GDBusConnection* conn_;
+};
+
+/**
+ * An empty request with raw set reads every sensor under the service
+ */
+TEST_F(SensorTreeDBusTest, RawReadAll) {
+  std::vector<SensorValue> values = getSensorValues(servicePath, {}, true);
+  ASSERT_EQ(values.size(), 2u);
+  for (auto &v : values) {
+    EXPECT_EQ(v.fru, 1);
+    if (v.id == 0x10) {
+      EXPECT_EQ(v.status, READING_SUCCESS);
+      EXPECT_DOUBLE_EQ(v.value, 42.5);
+      EXPECT_GT(v.readTime, 0u);
+    }
+    else {
+      EXPECT_EQ(v.id, 0x11);
+      EXPECT_EQ(v.status, READING_NA);
+      EXPECT_EQ(v.readTime, 0u);
+    }
+  }
+}
+
+/**
+ * Values come back in request order, unknown sensors as not available,
+ * and without raw the last values read are returned
+ */
+TEST_F(SensorTreeDBusTest, RequestOrder) {
+  getSensorValues(fruPath, {}, true);
+  writeValue("43000");
+
+  std::vector<SensorValue> values =
+    getSensorValues(servicePath, {{1, 0x11}, {1, 0x10}, {2, 0x10}}, false);
+  ASSERT_EQ(values.size(), 3u);
+  EXPECT_EQ(values[0].id, 0x11);
+  EXPECT_EQ(values[0].status, READING_NA);
+  EXPECT_EQ(values[1].id, 0x10);
+  EXPECT_EQ(values[1].status, READING_SUCCESS);
+  EXPECT_DOUBLE_EQ(values[1].value, 42.5);
+  EXPECT_EQ(values[2].fru, 2);
+  EXPECT_EQ(values[2].status, READING_NA);
+
+  values = getSensorValues(fruPath, {{1, 0x10}}, true);
+  ASSERT_EQ(values.size(), 1u);
+  EXPECT_DOUBLE_EQ(values[0].value, 43.0);
+}
+
+int main(int argc, char* argv[]) {
+  ::testing::InitGoogleTest(&argc, argv);
+  ::google::InitGoogleLogging(argv[0]);
+
+  return RUN_ALL_TESTS();
+}
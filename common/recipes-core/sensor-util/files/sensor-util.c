@@ -30,6 +30,7 @@
 #include <time.h>
 #include <pthread.h>
 #include <signal.h>
+#include <jansson.h>
 #include <openbmc/pal.h>
 #include <openbmc/sdr.h>
 #include <openbmc/obmc-sensor.h>
@@ -45,6 +46,8 @@
 #define STATUS_LNR  "lnr"
 
 #define SENSOR_ALL             -1
+#define MAX_HISTORY_PERIODS    8
+#define READ_TIMEOUT_SEC       4
 #ifdef CUSTOM_FRU_LIST
   static const char * pal_fru_list_sensor_history_t =  pal_fru_list_sensor_history;
 #else
@@ -54,16 +57,55 @@
 static pthread_mutex_t timer = PTHREAD_MUTEX_INITIALIZER;
 static pthread_cond_t done = PTHREAD_COND_INITIALIZER;
 static pthread_condattr_t done_attr;
-static bool done_flag = false;
 
-// This is for get_sensor_reading
+// Why a FRU has no readings
+enum {
+  FRU_OK = 0,
+  FRU_ERROR,
+  FRU_PRSNT_FAILED,
+  FRU_NOT_PRESENT,
+  FRU_UNAVAILABLE,
+  FRU_LIST_FAILED,
+  FRU_SDR_MISSING,
+  FRU_TIMED_OUT,
+};
+
+static const struct {
+  const char *status;  // JSON output
+  const char *fmt;     // Text output, %s is the FRU name
+} fru_states[] = {
+  [FRU_OK]           = {"ok", NULL},
+  [FRU_ERROR]        = {"error", NULL},
+  [FRU_PRSNT_FAILED] = {"error", "pal_is_fru_prsnt failed for fru: %s\n"},
+  [FRU_NOT_PRESENT]  = {"not present", "%s is not present!\n\n"},
+  [FRU_UNAVAILABLE]  = {"unavailable", "%s is unavailable!\n\n"},
+  [FRU_LIST_FAILED]  = {"error", "%s get sensor list failed!\n"},
+  [FRU_SDR_MISSING]  = {"sdr missing", "%s SDR is missing!\n"},
+  [FRU_TIMED_OUT]    = {"timed out", "FRU:%s timed out...\n"},
+};
+
+// Readings of one FRU. The output slots are allocated before the reader
+// thread starts and only looked at once it is done.
 typedef struct {
   uint8_t fru;
-  int sensor_cnt;
+  char fruname[32];
   int sensor_num;
-  bool threshold;
-  uint8_t sensor_list[];  
-} get_sensor_reading_struct;
+  int sensor_cnt;
+  uint8_t *sensor_list;
+  int state;
+  bool done;
+  int cnt;
+  thresh_sensor_t *thresh;
+  sensor_hist_id_t *ids;
+  float *values;
+  int *read_status;
+} fru_reading_t;
+
+// Thresholds of a FRU's sensors, indexed by sensor number
+typedef struct {
+  thresh_sensor_t snr[MAX_SENSOR_NUM + 1];
+  int ret[MAX_SENSOR_NUM + 1];
+} fru_thresh_t;
 
 static void
 print_usage() {
@@ -75,10 +117,14 @@ print_usage() {
   printf("       <sensor num>: 0xXX (Omit [sensor num] means all sensors.)\n");
   printf("       <option>:\n");
   printf("         --threshold               show all thresholds\n");
+  printf("         --json                    print the readings (and thresholds) as JSON\n");
   printf("         --history <period>        show max, min and average values of last <period> seconds\n");
   printf("         --history <period>[m/h/d] show max, min and average values of last <period> minutes/hours/days\n");
   printf("              example --history 4d means history of 4 days\n");
   printf("         --history-clear           clear history values\n");
+  printf("         --history-stats <period>[,<period>..]\n");
+  printf("                                   show max, min, average and 50/90/99th percentiles for\n");
+  printf("                                   each period, reading all requested sensors in one pass\n");
 }
 
 static int convert_period(char *str, long *val) {
@@ -182,79 +228,89 @@ get_sensor_status(float fvalue, thresh_sensor_t *thresh, char *status) {
     sprintf(status, STATUS_LNR);
 }
 
+/* Fetch the thresholds of sensor num, or of every sensor of the FRU in one
+ * call for SENSOR_ALL. Returns ERR_NOT_READY if the FRU's SDR is missing. */
+static int
+get_fru_thresh(uint8_t fru, int num, fru_thresh_t *t) {
+  int i, ret;
+
+  if (num == SENSOR_ALL) {
+    for (i = 0; i <= MAX_SENSOR_NUM; i++) {
+      t->ret[i] = ERR_FAILURE;
+    }
+    ret = sdr_get_all_snr_thresh(fru, t->snr, t->ret);
+    return ret == ERR_NOT_READY ? ERR_NOT_READY : 0;
+  }
+  t->ret[num] = sdr_get_snr_thresh(fru, num, &t->snr[num]);
+  return t->ret[num] == ERR_NOT_READY ? ERR_NOT_READY : 0;
+}
+
 static void*
-get_sensor_reading(void *sensor_data) {
+get_sensor_reading(void *data) {
 
-  get_sensor_reading_struct *sensor_info = sensor_data;
-  int i;
+  fru_reading_t *r = data;
+  fru_thresh_t *t = NULL;
+  int i, cnt = 0;
   uint8_t snr_num;
-  float fvalue;
-  char status[8];
-  thresh_sensor_t thresh;
+  int state = FRU_OK;
   int ret = 0;
-  char fruname[32] = {0};
-
-  pthread_detach(pthread_self());
-  //Allow this thread to be killed at any time
-  pthread_setcanceltype(PTHREAD_CANCEL_ASYNCHRONOUS, NULL);
 
-  for (i = 0; i < sensor_info->sensor_cnt; i++) {    
-    snr_num = sensor_info->sensor_list[i];
+  // Thresholds first, then all readings of the FRU in one go
+  if (r->fru != AGGREGATE_SENSOR_FRU_ID) {
+    t = malloc(sizeof(*t));
+    if (!t) {
+      state = FRU_ERROR;
+    } else if (get_fru_thresh(r->fru, r->sensor_num, t) == ERR_NOT_READY) {
+      state = FRU_SDR_MISSING;
+    }
+  }
+  for (i = 0; state == FRU_OK && i < r->sensor_cnt; i++) {
+    snr_num = r->sensor_list[i];
     /* If calculation is for a single sensor, ignore all others. */
-    if (sensor_info->sensor_num != SENSOR_ALL && snr_num != sensor_info->sensor_num) {
+    if (r->sensor_num != SENSOR_ALL && snr_num != r->sensor_num) {
       continue;
     }
 
-    if (sensor_info->fru == AGGREGATE_SENSOR_FRU_ID) {
-      if (aggregate_sensor_threshold(snr_num, &thresh)) {
+    if (r->fru == AGGREGATE_SENSOR_FRU_ID) {
+      if (aggregate_sensor_threshold(snr_num, &r->thresh[cnt])) {
         syslog(LOG_ERR, "agg_snr_thresh failed for agg num: 0x%X", snr_num);
         continue;
       }
     } else {
-      ret = sdr_get_snr_thresh(sensor_info->fru, snr_num, &thresh);
-      pal_alter_sensor_thresh_flag(sensor_info->fru, snr_num, &(thresh.flag));
-      if (ret == ERR_NOT_READY) {
-        pal_get_fru_name(sensor_info->fru, fruname);
-        printf("%s SDR is missing!\n", fruname);
-
-        //modify the flag to true if we get the sensor reading
-        done_flag = true;
-
-        //Tell caller it's done
-        pthread_cond_signal(&done);
-
-        return NULL;
-      }
-      else if (ret < 0) {
-        syslog(LOG_ERR, "sdr_get_snr_thresh failed for FRU %d num: 0x%X", sensor_info->fru, snr_num);
+      ret = t->ret[snr_num];
+      memcpy(&r->thresh[cnt], &t->snr[snr_num], sizeof(thresh_sensor_t));
+      pal_alter_sensor_thresh_flag(r->fru, snr_num, &(r->thresh[cnt].flag));
+      if (ret < 0) {
+        syslog(LOG_ERR, "sdr_get_snr_thresh failed for FRU %d num: 0x%X", r->fru, snr_num);
         continue;
       }
     }
+    r->ids[cnt].fru = r->fru;
+    r->ids[cnt].sensor_num = snr_num;
+    cnt++;
+  }
 
-    usleep(50);
-    if (sensor_cache_read(sensor_info->fru, snr_num, &fvalue) < 0) {
-      printf("%-28s (0x%X) : NA | (na)\n", thresh.name, sensor_info->sensor_list[i]);
-      continue;
-    } else {
-      get_sensor_status(fvalue, &thresh, status);
-      print_sensor_reading(fvalue, (uint16_t)snr_num, &thresh, sensor_info->threshold, status);
-    }
+  // Anything the bulk read does not get to stays failed
+  for (i = 0; i < cnt; i++) {
+    r->read_status[i] = ERR_FAILURE;
   }
+  if (cnt > 0) {
+    sensor_cache_read_bulk(r->ids, cnt, r->values, r->read_status);
+  }
+  free(t);
 
-  //if the mutex is already locked, the calling thread shall block until the mutex becomes available
-  //wait for the mutex is released and then get the sensor reading
   pthread_mutex_lock(&timer);
-
-  //modify the flag to true if we get the sensor reading
-  done_flag = true;
-
+  //Given up on at the deadline, the caller may be printing it already
+  if (r->state != FRU_TIMED_OUT) {
+    r->cnt = cnt;
+    r->state = state;
+  }
+  r->done = true;
   //Tell caller it's done
   pthread_cond_signal(&done);
-
-  //release the mutex
   pthread_mutex_unlock(&timer);
 
-  pthread_exit(0);
+  return NULL;
 }
 
 static void
@@ -264,11 +320,25 @@ get_sensor_history(uint8_t fru, uint8_t *sensor_list, int sensor_cnt, int num, i
   uint8_t snr_num;
   float min, average, max;
   thresh_sensor_t thresh;
+  fru_thresh_t *t = NULL;
   int ret = 0;
   char fruname[32] = {0};
 
   start_time = time(NULL) - period;
 
+  if (fru != AGGREGATE_SENSOR_FRU_ID) {
+    t = malloc(sizeof(*t));
+    if (!t) {
+      return;
+    }
+    if (get_fru_thresh(fru, num, t) == ERR_NOT_READY) {
+      pal_get_fru_name(fru, fruname);
+      printf("%s SDR is missing!\n", fruname);
+      free(t);
+      return;
+    }
+  }
+
   for (i = 0; i < sensor_cnt; i++) {
     snr_num = sensor_list[i];
     if (num != SENSOR_ALL && snr_num != num) {
@@ -281,16 +351,12 @@ get_sensor_history(uint8_t fru, uint8_t *sensor_list, int sensor_cnt, int num, i
         continue;
       }
     } else {
-      ret = sdr_get_snr_thresh(fru, snr_num, &thresh);
-      if (ret == ERR_NOT_READY) {
-        pal_get_fru_name(fru, fruname);
-        printf("%s SDR is missing!\n", fruname);
-        return;
-      }
-      else if (ret < 0) {
+      ret = t->ret[snr_num];
+      if (ret < 0) {
         syslog(LOG_ERR, "sdr_get_snr_thresh failed for FRU %d num: 0x%X", fru, snr_num);
         continue;
       }
+      memcpy(&thresh, &t->snr[snr_num], sizeof(thresh_sensor_t));
     }
 
     if (sensor_read_history(fru, snr_num, &min, &average, &max, start_time) < 0) {
@@ -300,6 +366,7 @@ get_sensor_history(uint8_t fru, uint8_t *sensor_list, int sensor_cnt, int num, i
 
     printf("%-18s (0x%X) min = %.2f, average = %.2f, max = %.2f\n", thresh.name, snr_num, min, average, max);
   }
+  free(t);
 }
 
 static void clear_sensor_history(uint8_t fru, uint8_t *sensor_list, int sensor_cnt, int num) {
@@ -317,13 +384,15 @@ static void clear_sensor_history(uint8_t fru, uint8_t *sensor_list, int sensor_c
   }
 }
 
-void get_sensor_reading_timer(struct timespec *timeout, get_sensor_reading_struct *sensor_data)
+/* Read all the FRUs at once, giving up on those not done by the deadline */
+static void
+get_sensor_reading_timer(fru_reading_t *frus, int nfrus)
 {
   struct timespec abs_time;
-  pthread_t tid_get_sensor_reading;
+  pthread_t tid[nfrus];
+  bool started[nfrus];
+  int i, pending = 0;
   int err = 0;
-  int thread_alive = 0;
-  char fruname[32] = {0};
 
   err = pthread_condattr_init(&done_attr);
   if ( err != 0 )
@@ -348,140 +417,450 @@ void get_sensor_reading_timer(struct timespec *timeout, get_sensor_reading_struc
 
   pthread_mutex_lock(&timer);
 
-  //Assign the timeout time to abs_time
+  //One deadline for all the FRUs
   clock_gettime(CLOCK_MONOTONIC, &abs_time);
-  abs_time.tv_sec += timeout->tv_sec;
-  abs_time.tv_nsec += timeout->tv_nsec;
-
-   pal_get_fru_name(sensor_data->fru, fruname);
+  abs_time.tv_sec += READ_TIMEOUT_SEC;
 
-  //Make get_sensor_reading a thread
-  if (pthread_create(&tid_get_sensor_reading, NULL, get_sensor_reading, (void *) sensor_data) < 0) {
-    syslog(LOG_WARNING, "sensor-util FRU:%s, pthread_create failed\n", fruname);
-    pthread_mutex_unlock(&timer);
-    return;
+  for (i = 0; i < nfrus; i++) {
+    started[i] = false;
+    if (frus[i].state != FRU_OK || frus[i].sensor_cnt == 0) {
+      continue;
+    }
+    if (pthread_create(&tid[i], NULL, get_sensor_reading, &frus[i]) != 0) {
+      syslog(LOG_WARNING, "sensor-util FRU:%s, pthread_create failed\n", frus[i].fruname);
+      frus[i].state = FRU_ERROR;
+      continue;
+    }
+    started[i] = true;
+    pending++;
   }
 
-  //Check if thread is alive, if pthread_kill (thread_id, sig = 0) returns 0, means thread is alive
-  thread_alive = pthread_kill(tid_get_sensor_reading, 0);
-
-  if (thread_alive == 0) 
-  {
-    while ( false == done_flag )
-    {
-      //Timer thread, continue only when get_sensor_reading send the done signal or abs_time timed out
-      err = pthread_cond_timedwait(&done, &timer, &abs_time); 
-      if (err == ETIMEDOUT) {
-        break;
-      }
+  while (pending > 0) {
+    //Continue only when a reader sends the done signal or abs_time timed out
+    err = pthread_cond_timedwait(&done, &timer, &abs_time);
+    if (err == ETIMEDOUT) {
+      break;
     }
-
-    //Double Check if thread is still alive
-    thread_alive = pthread_kill(tid_get_sensor_reading, 0);
-
-    //Timeout actions
-    //If Timed out, and Thread is still alive, it means the thread is really timed out, cancel the thread
-    //If Timed out, and Thread is dead, it means the timed out is fake, do nothing
-    if ( (err == ETIMEDOUT) && (thread_alive == 0) ) {     
-      printf("FRU:%s timed out...\n", fruname);
-      pthread_cancel(tid_get_sensor_reading);
+    for (pending = 0, i = 0; i < nfrus; i++) {
+      pending += started[i] && !frus[i].done;
     }
   }
 
-  //re-init for the next fru
-  done_flag = false;
+  for (i = 0; i < nfrus; i++) {
+    if (!started[i]) {
+      continue;
+    }
+    if (frus[i].done) {
+      pthread_join(tid[i], NULL);
+    } else {
+      //Still reading at the deadline, leave it and its slots alone; it
+      //may hold library locks, so it is not cancelled but left to exit
+      frus[i].state = FRU_TIMED_OUT;
+      pthread_detach(tid[i]);
+    }
+  }
 
   pthread_mutex_unlock(&timer);
+}
 
-  return;
+static void
+print_fru_state(const char *fruname, int state) {
+  if (fru_states[state].fmt) {
+    printf(fru_states[state].fmt, fruname);
+  }
 }
 
+/* Get the sensors of a FRU. *sensor_cnt stays 0 if there is nothing to
+ * print for the FRU, *state says why. The list of the aggregate FRU is
+ * allocated here and released with put_fru_sensor_list(). */
 static int
-print_sensor(uint8_t fru, int sensor_num, bool history, bool threshold, bool history_clear, long period) {
+get_fru_sensor_list(uint8_t fru, char *fruname, uint8_t **sensor_list, int *sensor_cnt,
+    int *state) {
   int ret;
   uint8_t status;
-  int sensor_cnt;
-  uint8_t *sensor_list;
-  char fruname[16] = {0};
-  struct timespec timeout;
-  get_sensor_reading_struct data;
-
-  //Setup 4 seconds timeout for each fru get_sensor_reading
-  memset(&timeout, 0, sizeof(timeout));
-  timeout.tv_sec = 4;
 
+  *sensor_list = NULL;
+  *sensor_cnt = 0;
+  *state = FRU_OK;
   if (fru == AGGREGATE_SENSOR_FRU_ID) {
     size_t cnt, i;
+    strcpy(fruname, AGGREGATE_SENSOR_FRU_NAME);
     if (aggregate_sensor_init(NULL)) {
+      *state = FRU_ERROR;
       return -1;
     }
     if (aggregate_sensor_count(&cnt)) {
       return 0;
     }
-    strcpy(fruname, AGGREGATE_SENSOR_FRU_NAME);
-    sensor_list = malloc(sizeof(uint8_t) * cnt);
-    if (!sensor_list) {
+    *sensor_list = malloc(sizeof(uint8_t) * cnt);
+    if (!*sensor_list) {
+      *state = FRU_ERROR;
       return -1;
     }
     for (i = 0; i < cnt; i++) {
-      sensor_list[i] = i;
+      (*sensor_list)[i] = i;
     }
-    sensor_cnt = (int)cnt;
+    *sensor_cnt = (int)cnt;
   } else {
     if (pal_get_fru_name(fru, fruname)) {
       sprintf(fruname, "fru%d", fru);
     }
     ret = pal_is_fru_prsnt(fru, &status);
     if (ret < 0) {
-      printf("pal_is_fru_prsnt failed for fru: %s\n", fruname);
+      *state = FRU_PRSNT_FAILED;
       return ret;
     }
     if (status == 0) {
-      printf("%s is not present!\n\n", fruname);
+      *state = FRU_NOT_PRESENT;
       return -1;
     }
 
     ret = pal_is_fru_ready(fru, &status);
     if ((ret < 0) || (status == 0)) {
-      printf("%s is unavailable!\n\n", fruname);
+      *state = FRU_UNAVAILABLE;
       return ret;
     }
 
-    ret = pal_get_fru_sensor_list(fru, &sensor_list, &sensor_cnt);
+    ret = pal_get_fru_sensor_list(fru, sensor_list, sensor_cnt);
     if (ret < 0) {
-      printf("%s get sensor list failed!\n", fruname);
+      *state = FRU_LIST_FAILED;
       return ret;
     }
   }
 
+  return 0;
+}
+
+static void
+put_fru_sensor_list(uint8_t fru, uint8_t *sensor_list) {
+  /* PAL lists are static */
+  if (fru == AGGREGATE_SENSOR_FRU_ID) {
+    free(sensor_list);
+  }
+}
+
+static int
+print_sensor_history(uint8_t fru, int sensor_num, bool history_clear, long period) {
+  int ret;
+  int sensor_cnt;
+  int state;
+  uint8_t *sensor_list;
+  char fruname[32] = {0};
+
+  ret = get_fru_sensor_list(fru, fruname, &sensor_list, &sensor_cnt, &state);
+  if (state != FRU_OK) {
+    print_fru_state(fruname, state);
+  }
+  if (ret < 0) {
+    return ret;
+  }
+
   if (sensor_cnt == 0) {
+    put_fru_sensor_list(fru, sensor_list);
     return 0;
   }
 
   if (history_clear) {
     clear_sensor_history(fru, sensor_list, sensor_cnt, sensor_num);
-  } else if (history) {
-    get_sensor_history(fru, sensor_list, sensor_cnt, sensor_num, period);
   } else {
-    data.fru = fru;
-    data.sensor_cnt = sensor_cnt;
-    data.sensor_num = sensor_num;
-    data.threshold = threshold;
-    memcpy(data.sensor_list, sensor_list, sizeof(uint8_t)*sensor_cnt);
-    get_sensor_reading_timer(&timeout, &data);
+    get_sensor_history(fru, sensor_list, sensor_cnt, sensor_num, period);
+    //Print Empty Line to separate frus, only when sensor_num is not specified
+    if (sensor_num == SENSOR_ALL) {
+      printf("\n");
+    }
   }
+  put_fru_sensor_list(fru, sensor_list);
+
+  return 0;
+}
 
-  //Print Empty Line to separate frus,
-  //only when sensor_cnt greater than 0, not history-clear, and sensor_num is not specified
-  if ( (sensor_cnt > 0) && (!history_clear) && (sensor_num == SENSOR_ALL) ){
+static json_t *
+thresh_json(thresh_sensor_t *thresh, int type, float value) {
+  return thresh->flag & GETMASK(type) ? json_real(value) : json_null();
+}
+
+static json_t *
+fru_readings_json(fru_reading_t *r, bool threshold) {
+  json_t *fru, *sensors, *sensor, *thresholds;
+  thresh_sensor_t *thresh;
+  char status[8];
+  int i;
+
+  fru = json_object();
+  json_object_set_new(fru, "status", json_string(fru_states[r->state].status));
+  if (r->state != FRU_OK) {
+    return fru;
+  }
+
+  sensors = json_array();
+  for (i = 0; i < r->cnt; i++) {
+    thresh = &r->thresh[i];
+    sensor = json_object();
+    json_object_set_new(sensor, "name", json_string(thresh->name));
+    json_object_set_new(sensor, "num", json_integer(r->ids[i].sensor_num));
+    if (r->read_status[i] < 0) {
+      json_object_set_new(sensor, "value", json_null());
+      json_object_set_new(sensor, "status", json_string("na"));
+    } else {
+      get_sensor_status(r->values[i], thresh, status);
+      json_object_set_new(sensor, "value", json_real(r->values[i]));
+      json_object_set_new(sensor, "status", json_string(status));
+    }
+    json_object_set_new(sensor, "units", json_string(thresh->units));
+    if (threshold) {
+      thresholds = json_object();
+      json_object_set_new(thresholds, "ucr", thresh_json(thresh, UCR_THRESH, thresh->ucr_thresh));
+      json_object_set_new(thresholds, "unc", thresh_json(thresh, UNC_THRESH, thresh->unc_thresh));
+      json_object_set_new(thresholds, "unr", thresh_json(thresh, UNR_THRESH, thresh->unr_thresh));
+      json_object_set_new(thresholds, "lcr", thresh_json(thresh, LCR_THRESH, thresh->lcr_thresh));
+      json_object_set_new(thresholds, "lnc", thresh_json(thresh, LNC_THRESH, thresh->lnc_thresh));
+      json_object_set_new(thresholds, "lnr", thresh_json(thresh, LNR_THRESH, thresh->lnr_thresh));
+      json_object_set_new(sensor, "thresholds", thresholds);
+    }
+    json_array_append_new(sensors, sensor);
+  }
+  json_object_set_new(fru, "sensors", sensors);
+  return fru;
+}
+
+static void
+print_fru_readings(fru_reading_t *r, bool threshold) {
+  char status[8];
+  int i;
+
+  if (r->state != FRU_OK) {
+    print_fru_state(r->fruname, r->state);
+    return;
+  }
+  for (i = 0; i < r->cnt; i++) {
+    if (r->read_status[i] < 0) {
+      printf("%-28s (0x%X) : NA | (na)\n", r->thresh[i].name, r->ids[i].sensor_num);
+    } else {
+      get_sensor_status(r->values[i], &r->thresh[i], status);
+      print_sensor_reading(r->values[i], (uint16_t)r->ids[i].sensor_num, &r->thresh[i], threshold, status);
+    }
+  }
+}
+
+/* Read the sensors of all the FRUs in parallel, then print them in order */
+static int
+print_sensor(uint8_t *fru_ids, int nfrus, int sensor_num, bool threshold, bool json) {
+  fru_reading_t *frus, *r;
+  json_t *root = NULL;
+  int i, ret = 0;
+  bool timed_out = false;
+
+  frus = calloc(nfrus, sizeof(*frus));
+  if (!frus) {
+    return -1;
+  }
+
+  for (i = 0; i < nfrus; i++) {
+    r = &frus[i];
+    r->fru = fru_ids[i];
+    r->sensor_num = sensor_num;
+    ret |= get_fru_sensor_list(r->fru, r->fruname, &r->sensor_list, &r->sensor_cnt, &r->state);
+    if (r->sensor_cnt == 0) {
+      continue;
+    }
+    r->thresh = calloc(r->sensor_cnt, sizeof(*r->thresh));
+    r->ids = calloc(r->sensor_cnt, sizeof(*r->ids));
+    r->values = calloc(r->sensor_cnt, sizeof(*r->values));
+    r->read_status = calloc(r->sensor_cnt, sizeof(*r->read_status));
+    if (!r->thresh || !r->ids || !r->values || !r->read_status) {
+      r->state = FRU_ERROR;
+    }
+  }
+
+  get_sensor_reading_timer(frus, nfrus);
+
+  if (json) {
+    root = json_object();
+  }
+  for (i = 0; i < nfrus; i++) {
+    r = &frus[i];
+    if (json) {
+      if (r->sensor_cnt > 0 || r->state != FRU_OK) {
+        json_object_set_new(root, r->fruname, fru_readings_json(r, threshold));
+      }
+    } else {
+      print_fru_readings(r, threshold);
+      //Print Empty Line to separate frus,
+      //only when sensor_cnt greater than 0 and sensor_num is not specified
+      if ((r->sensor_cnt > 0) && (sensor_num == SENSOR_ALL)) {
+        printf("\n");
+      }
+    }
+  }
+  if (json) {
+    json_dumpf(root, stdout, JSON_COMPACT | JSON_PRESERVE_ORDER);
     printf("\n");
+    json_decref(root);
   }
 
-  return 0;
+  for (i = 0; i < nfrus; i++) {
+    timed_out |= frus[i].state == FRU_TIMED_OUT;
+  }
+  if (timed_out) {
+    //Readers that timed out still use frus; leave without waiting for
+    //them or running the exit handlers under them
+    fflush(stdout);
+    _exit(ret);
+  }
+
+  for (i = 0; i < nfrus; i++) {
+    put_fru_sensor_list(frus[i].fru, frus[i].sensor_list);
+    free(frus[i].thresh);
+    free(frus[i].ids);
+    free(frus[i].values);
+    free(frus[i].read_status);
+  }
+  free(frus);
+  return ret;
+}
+
+static int
+print_sensor_history_stats(uint8_t *frus, int nfrus, int num, long *periods,
+    char periods_str[][16], int nperiods) {
+  sensor_hist_id_t *ids = NULL, *tmp_ids;
+  char (*names)[32] = NULL, (*tmp_names)[32];
+  sensor_hist_stats_t *stats, *st;
+  thresh_sensor_t thresh;
+  fru_thresh_t *t;
+  uint8_t *sensor_list;
+  int sensor_cnt, total = 0;
+  int i, j, p, ret;
+  int state;
+  char fruname[32] = {0};
+
+  t = malloc(sizeof(*t));
+  if (!t) {
+    return -1;
+  }
+
+  /* Gather every requested sensor first so the history is read in one call */
+  for (i = 0; i < nfrus; i++) {
+    ret = get_fru_sensor_list(frus[i], fruname, &sensor_list, &sensor_cnt, &state);
+    if (state != FRU_OK) {
+      print_fru_state(fruname, state);
+    }
+    if (ret < 0) {
+      continue;
+    }
+    tmp_ids = realloc(ids, sizeof(*ids) * (total + sensor_cnt));
+    tmp_names = realloc(names, sizeof(*names) * (total + sensor_cnt));
+    if (tmp_ids) {
+      ids = tmp_ids;
+    }
+    if (tmp_names) {
+      names = tmp_names;
+    }
+    if (!tmp_ids || !tmp_names) {
+      put_fru_sensor_list(frus[i], sensor_list);
+      free(ids);
+      free(names);
+      free(t);
+      return -1;
+    }
+    if (frus[i] != AGGREGATE_SENSOR_FRU_ID &&
+        get_fru_thresh(frus[i], num, t) == ERR_NOT_READY) {
+      printf("%s SDR is missing!\n", fruname);
+      put_fru_sensor_list(frus[i], sensor_list);
+      continue;
+    }
+
+    for (j = 0; j < sensor_cnt; j++) {
+      if (num != SENSOR_ALL && sensor_list[j] != num) {
+        continue;
+      }
+      if (frus[i] == AGGREGATE_SENSOR_FRU_ID) {
+        if (aggregate_sensor_threshold(sensor_list[j], &thresh)) {
+          syslog(LOG_ERR, "agg_snr_threshold failed 0x%x", sensor_list[j]);
+          continue;
+        }
+      } else {
+        if (t->ret[sensor_list[j]] < 0) {
+          syslog(LOG_ERR, "sdr_get_snr_thresh failed for FRU %d num: 0x%X", frus[i], sensor_list[j]);
+          continue;
+        }
+        memcpy(&thresh, &t->snr[sensor_list[j]], sizeof(thresh_sensor_t));
+      }
+      ids[total].fru = frus[i];
+      ids[total].sensor_num = sensor_list[j];
+      strncpy(names[total], thresh.name, sizeof(names[total]) - 1);
+      names[total][sizeof(names[total]) - 1] = '\0';
+      total++;
+    }
+    put_fru_sensor_list(frus[i], sensor_list);
+  }
+  free(t);
+
+  if (total == 0) {
+    free(ids);
+    free(names);
+    return 0;
+  }
+
+  stats = calloc(total * nperiods, sizeof(*stats));
+  if (!stats) {
+    free(ids);
+    free(names);
+    return -1;
+  }
+
+  ret = sensor_read_history_bulk(ids, total, periods, nperiods, stats);
+  if (ret == 0) {
+    for (i = 0; i < total; i++) {
+      //Print Empty Line to separate frus
+      if (i > 0 && ids[i].fru != ids[i - 1].fru) {
+        printf("\n");
+      }
+      for (p = 0; p < nperiods; p++) {
+        st = &stats[i * nperiods + p];
+        if (st->status) {
+          printf("%-18s (0x%X) %-5s min = NA, average = NA, max = NA\n",
+              names[i], ids[i].sensor_num, periods_str[p]);
+          continue;
+        }
+        printf("%-18s (0x%X) %-5s min = %.2f, average = %.2f, max = %.2f, "
+            "p50 = %.2f, p90 = %.2f, p99 = %.2f\n",
+            names[i], ids[i].sensor_num, periods_str[p], st->min, st->avg,
+            st->max, st->p50, st->p90, st->p99);
+      }
+    }
+    if (num == SENSOR_ALL) {
+      printf("\n");
+    }
+  }
+
+  free(stats);
+  free(ids);
+  free(names);
+  return ret;
+}
+
+static int
+convert_periods(char *str, long *periods, char periods_str[][16], int *nperiods) {
+  char *tok, *saveptr = NULL;
+
+  *nperiods = 0;
+  for (tok = strtok_r(str, ",", &saveptr); tok; tok = strtok_r(NULL, ",", &saveptr)) {
+    if (*nperiods >= MAX_HISTORY_PERIODS || strlen(tok) >= 16) {
+      return -1;
+    }
+    strcpy(periods_str[*nperiods], tok);
+    if (convert_period(tok, &periods[*nperiods])) {
+      return -1;
+    }
+    (*nperiods)++;
+  }
+  return *nperiods ? 0 : -1;
 }
 
 int parse_args(int argc, char *argv[], char *fruname,
-    bool *history_clear, bool *history, bool *threshold, long *period, int *snr)
+    bool *history_clear, bool *history, bool *threshold, long *period, int *snr,
+    bool *history_stats, long *periods, char periods_str[][16], int *nperiods,
+    bool *json)
 {
   int ret;
   int num;
@@ -490,7 +869,9 @@ int parse_args(int argc, char *argv[], char *fruname,
   static struct option long_opts[] = {
     {"history-clear", no_argument, 0, 'c'},
     {"history", required_argument, 0, 'h'},
+    {"history-stats", required_argument, 0, 's'},
     {"threshold", no_argument,     0, 't'},
+    {"json", no_argument,          0, 'j'},
     {0,0,0,0},
   };
 
@@ -500,8 +881,11 @@ int parse_args(int argc, char *argv[], char *fruname,
   *threshold = false;
   *period = 60;
   *snr = -1;
+  *history_stats = false;
+  *nperiods = 0;
+  *json = false;
 
-  while(-1 != (ret = getopt_long(argc, argv, "ch:t", long_opts, &index))) {
+  while(-1 != (ret = getopt_long(argc, argv, "ch:ts:j", long_opts, &index))) {
     switch(ret) {
       case 'c':
         *history_clear = true;
@@ -515,6 +899,15 @@ int parse_args(int argc, char *argv[], char *fruname,
           return -1;
         }
         break;
+      case 's':
+        *history_stats = true;
+        if (convert_periods(optarg, periods, periods_str, nperiods)) {
+          return -1;
+        }
+        break;
+      case 'j':
+        *json = true;
+        break;
       default:
         return -1;
     }
@@ -533,10 +926,14 @@ int parse_args(int argc, char *argv[], char *fruname,
   }
   /* Only one of these flags should be on at 
    * any time */
-  num = (int)*threshold + (int)*history_clear + (int)*history;
+  num = (int)*threshold + (int)*history_clear + (int)*history + (int)*history_stats;
   if (num > 1) {
     return -1;
   }
+  /* JSON is only for readings */
+  if (*json && (*history_clear || *history || *history_stats)) {
+    return -1;
+  }
 
   return 0;
 }
@@ -552,10 +949,19 @@ main(int argc, char **argv) {
   bool history_clear;
   long period;
   char fruname[32];
+  bool history_stats;
+  long periods[MAX_HISTORY_PERIODS];
+  char periods_str[MAX_HISTORY_PERIODS][16];
+  int nperiods;
+  uint8_t frus[MAX_NUM_FRUS + 1];
+  int nfrus = 0;
+  int i;
+  bool json;
 
   if (parse_args(argc, argv, fruname,
         &history_clear, &history,
-        &threshold, &period, &num)) {
+        &threshold, &period, &num,
+        &history_stats, periods, periods_str, &nperiods, &json)) {
     print_usage();
     exit(-1);
   }
@@ -568,7 +974,7 @@ main(int argc, char **argv) {
       print_usage();
       return ret;
     }
-    if (history_clear || history) {
+    if (history_clear || history || history_stats) {
       //Check if the input FRU is exist in sensor history list
       if (NULL == strstr(pal_fru_list_sensor_history_t, fruname)) {
         print_usage();
@@ -579,11 +985,23 @@ main(int argc, char **argv) {
 
   if (fru == 0) {
     for (fru = 1; fru <= MAX_NUM_FRUS; fru++) {
-      ret |= print_sensor(fru, num, history, threshold, history_clear, period);
+      frus[nfrus++] = fru;
     }
-    ret |= print_sensor(AGGREGATE_SENSOR_FRU_ID, num, history, threshold, history_clear, period);
+    frus[nfrus++] = AGGREGATE_SENSOR_FRU_ID;
   } else {
-    ret = print_sensor(fru, num, history, threshold, history_clear, period);
+    frus[nfrus++] = fru;
   }
-  return ret;
+
+  if (history_stats) {
+    return print_sensor_history_stats(frus, nfrus, num, periods, periods_str, nperiods);
+  }
+
+  if (history || history_clear) {
+    for (i = 0; i < nfrus; i++) {
+      ret |= print_sensor_history(frus[i], num, history_clear, period);
+    }
+    return ret;
+  }
+
+  return print_sensor(frus, nfrus, num, threshold, json);
 }
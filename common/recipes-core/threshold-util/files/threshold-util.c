@@ -103,6 +103,7 @@ clear_thresh_value_setting(uint8_t fru) {
   sprintf(fpath, THRESHOLD_RE_FLAG, fruname);
   sprintf(cmd,"touch %s",fpath);
   system(cmd); 
+  sdr_thresh_changed(fru);
 
   return 0;
 }
@@ -165,6 +166,7 @@ main(int argc, char **argv) {
         }
 
         ret = pal_sensor_thresh_modify(fru, snr_num, thresh_type, threshold_value);
+        sdr_thresh_changed(fru);
         if (ret < 0)
           printf("Fail to set sensor 0x%x threshold for fru%d\n", snr_num, fru);
       }
@@ -174,6 +176,7 @@ main(int argc, char **argv) {
         return 0;
       }
       ret = pal_sensor_thresh_modify(fru, snr_num, thresh_type, threshold_value);
+      sdr_thresh_changed(fru);
       if (ret < 0)
         printf("Fail to set sensor 0x%x threshold for fru%d\n", snr_num, fru);
     }
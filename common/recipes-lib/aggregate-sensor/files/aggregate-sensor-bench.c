@@ -0,0 +1,121 @@
+/*
+ *
+ * Copyright 2017-present Facebook. All Rights Reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+/*
+ * Cost of reading aggregate sensors.
+ *
+ * aggregate-sensor-bench [iterations] [conf]
+ *
+ * Loads the configuration sensord monitors (or the given one) and reads
+ * every aggregate sensor the given number of times, the way sensord
+ * does, against the live sensor cache. Then times the evaluation of
+ * every compiled expression alone, with its inputs fixed at 1.0.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+#include "aggregate-sensor-internal.h"
+
+static uint64_t
+now_us(void)
+{
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+static int
+fixed_values(void **states, size_t num, float *values)
+{
+  size_t i;
+
+  (void)states;
+  for (i = 0; i < num; i++) {
+    values[i] = 1.0;
+  }
+  return 0;
+}
+
+int
+main(int argc, char *argv[])
+{
+  const char *conf = NULL;
+  char name[MAX_STRING_SIZE];
+  int iters = 1000;
+  size_t cnt, i, j;
+  int k, errs;
+  float value;
+  uint64_t start, elapsed, total = 0;
+
+  if (argc > 1)
+    iters = atoi(argv[1]);
+  if (argc > 2)
+    conf = argv[2];
+  if (iters <= 0) {
+    printf("Usage: %s [iterations] [conf]\n", argv[0]);
+    return -1;
+  }
+
+  if (aggregate_sensor_init(conf)) {
+    printf("Loading aggregate sensors failed\n");
+    return -1;
+  }
+  aggregate_sensor_count(&cnt);
+  printf("%zu sensors, %d iterations\n", cnt, iters);
+
+  printf("%-24s %10s %8s\n", "sensor", "us/read", "errors");
+  for (i = 0; i < cnt; i++) {
+    errs = 0;
+    start = now_us();
+    for (k = 0; k < iters; k++) {
+      if (aggregate_sensor_read(i, &value)) {
+        errs++;
+      }
+    }
+    elapsed = now_us() - start;
+    total += elapsed;
+
+    aggregate_sensor_name(i, name);
+    printf("%-24s %10.2f %8d\n", name, (double)elapsed / iters, errs);
+  }
+  printf("all sensors: %.2f us/cycle\n", (double)total / iters);
+
+  // Expressions alone, without the cache reads
+  total = 0;
+  for (i = 0; i < g_sensors_count; i++) {
+    for (j = 0; j < g_sensors[i].num_expressions; j++) {
+      expression_type *exp = g_sensors[i].expressions[j];
+
+      expression_set_values(exp, fixed_values);
+      start = now_us();
+      for (k = 0; k < iters; k++) {
+        expression_evaluate(exp, &value);
+      }
+      total += now_us() - start;
+      expression_set_values(exp, get_sensor_values);
+    }
+  }
+  printf("all expressions, inputs fixed: %.2f us/cycle\n", (double)total / iters);
+
+  return 0;
+}
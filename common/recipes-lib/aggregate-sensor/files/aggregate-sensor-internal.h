@@ -35,6 +35,9 @@
 #define MAX_CONDITIONALS 16
 #define MAX_STRING_SIZE 128
 
+/* cond_f_idx before the condition key was first resolved */
+#define COND_UNRESOLVED -2
+
 struct sensor_src {
   uint8_t fru;
   uint8_t id;
@@ -62,6 +65,8 @@ typedef struct {
   size_t value_map_size;
   value_map_element_type value_map[MAX_CONDITIONALS];
   int default_expression_idx; /* -1 == invalid */
+  kv_watch_t *cond_watch;
+  int cond_f_idx; /* Formula for the last condition value, -1 == none */
 } aggregate_sensor_t;
 
 extern size_t g_sensors_count;
@@ -69,5 +74,6 @@ extern aggregate_sensor_t *g_sensors;
 
 int load_aggregate_conf(const char *conf_path);
 int get_sensor_value(void *state, float *value);
+int get_sensor_values(void **states, size_t num, float *values);
 
 #endif
@@ -68,9 +68,11 @@ static int load_variable(const char *name, json_t *obj, variable_type *var)
   }
 
   strncpy(var->name, name, sizeof(var->name));
-  /* Copy the function pointer which will be called
-   * when the value of this variable is required */
+  /* Copy the function pointers which will be called
+   * when the value of this variable is required; get_sensor_values
+   * reads all the variables of an expression in one go */
   var->value = get_sensor_value;
+  var->values = get_sensor_values;
 
   /* Allocate the state which will be passed to
    * get_sensor_value (fru, id) */
@@ -279,6 +281,10 @@ static int load_linear_cond_eq(aggregate_sensor_t *snr, json_t *obj)
       snr->default_expression_idx = (int)idx;
     }
   }
+  snr->cond_f_idx = COND_UNRESOLVED;
+  snr->cond_watch = kv_watch(snr->cond_key,
+      snr->cond_type == KEY_PATH ? KV_FPATH :
+      snr->cond_type == KEY_PERSISTENT ? KV_FPERSIST : 0);
   /* We don't need vars anymore */
   free(vars);
   return 0;
@@ -443,6 +449,9 @@ int load_aggregate_conf(const char *file)
     ret = load_sensor_conf(&g_sensors[i], json_array_get(tmp, i));
     if (ret) {
       DEBUG("Loading configuration for sensor %zu failed!\n", i);
+      while (i--) {
+        kv_unwatch(g_sensors[i].cond_watch);
+      }
       free(g_sensors);
       g_sensors = NULL;
       g_sensors_count = 0;
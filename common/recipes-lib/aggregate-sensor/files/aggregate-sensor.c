@@ -49,6 +49,22 @@ int get_sensor_value(void *state, float *value)
   return sensor_cache_read(snr->fru, snr->id, value);
 }
 
+/* Read all the sources of an expression with one cache request */
+int get_sensor_values(void **states, size_t num, float *values)
+{
+  sensor_hist_id_t ids[num + 1];
+  int status[num + 1];
+  size_t i;
+
+  for (i = 0; i < num; i++) {
+    struct sensor_src *snr = (struct sensor_src *)states[i];
+    assert(snr);
+    ids[i].fru = snr->fru;
+    ids[i].sensor_num = snr->id;
+  }
+  return sensor_cache_read_bulk(ids, (int)num, values, status);
+}
+
 int
 aggregate_sensor_count(size_t *count)
 {
@@ -72,7 +88,7 @@ int get_key(cond_key_type type, const char *cond_key, char *cond_value)
         if (!fp) {
           return -1;
         }
-        ret = (int)fread(cond_value, 1, MAX_STRING_SIZE, fp);
+        ret = (int)fread(cond_value, 1, MAX_VALUE_LEN - 1, fp);
         fclose(fp);
         if (ret <= 0) {
           return -1;
@@ -87,32 +103,51 @@ int get_key(cond_key_type type, const char *cond_key, char *cond_value)
 }
 
 
-int
-aggregate_sensor_read(size_t index, float *value)
+/*
+ * Formula for the current value of the condition key. The key is only read
+ * and looked up in the value map again once it has changed.
+ */
+static int
+cond_formula(aggregate_sensor_t *snr)
 {
   char cond_value[MAX_VALUE_LEN] = {0};
   size_t i;
-  int f_idx = -1;
+  int f_idx = __atomic_load_n(&snr->cond_f_idx, __ATOMIC_ACQUIRE);
+
+  if (!kv_changed(snr->cond_watch) && f_idx != COND_UNRESOLVED) {
+    return f_idx;
+  }
+
+  f_idx = -1;
+  if (!get_key(snr->cond_type, snr->cond_key, cond_value)) {
+    for (i = 0; i < snr->value_map_size; i++) {
+      if (!strncmp(snr->value_map[i].condition_value, cond_value,
+          sizeof(snr->value_map[i].condition_value))) {
+        f_idx = snr->value_map[i].formula_index;
+        break;
+      }
+    }
+  }
+  if (f_idx == -1) {
+    f_idx = snr->default_expression_idx;
+  }
+  __atomic_store_n(&snr->cond_f_idx, f_idx, __ATOMIC_RELEASE);
+  return f_idx;
+}
+
+int
+aggregate_sensor_read(size_t index, float *value)
+{
+  int f_idx;
   aggregate_sensor_t *snr;
   if (index >= g_sensors_count) {
     return -1;
   }
   snr = &g_sensors[index];
   if (snr->conditional) {
-    if (!get_key(snr->cond_type, snr->cond_key, cond_value)) {
-      for (i = 0; i < snr->value_map_size; i++) {
-        if (!strncmp(snr->value_map[i].condition_value, cond_value,
-            sizeof(snr->value_map[i].condition_value))) {
-          f_idx = snr->value_map[i].formula_index;
-          break;
-        }
-      }
-    }
+    f_idx = cond_formula(snr);
     if (f_idx == -1) {
-      if (snr->default_expression_idx == -1) {
-        return -1;
-      }
-      f_idx = snr->default_expression_idx;
+      return -1;
     }
   } else {
     f_idx = 0;
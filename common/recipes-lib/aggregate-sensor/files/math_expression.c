@@ -22,6 +22,7 @@
 #include <ctype.h>
 #include <string.h>
 #include <assert.h>
+#include <stdint.h>
 #include "math_expression.h"
 
 typedef enum {
@@ -45,6 +46,41 @@ typedef enum {
   OP_DIVIDE /* L / R */
 } operator_type;
 
+/* Instructions of the compiled expression, run on a value stack */
+typedef enum {
+  INSN_CONSTANT, /* Push constants[arg] */
+  INSN_VARIABLE, /* Push the value of vars[arg] */
+  INSN_ADD, /* Pop R, pop L, push L + R */
+  INSN_SUBTRACT, /* Pop R, pop L, push L - R */
+  INSN_MULTIPLY, /* Pop R, pop L, push L * R */
+  INSN_DIVIDE, /* Pop R, pop L, push L / R */
+  INSN_SUBTRACT_REV, /* Pop L, pop R, push L - R */
+  INSN_DIVIDE_REV /* Pop L, pop R, push L / R */
+} insn_op_type;
+
+#define MAX_INSN_ARG 256
+
+typedef struct {
+  uint8_t op;
+  uint8_t arg;
+} insn_type;
+
+typedef struct {
+  insn_type     *insns;
+  size_t        num_insns;
+  float         *constants;
+  size_t        num_constants;
+  /* Distinct variables used, each read once per evaluation */
+  variable_type *vars;
+  void          **states;
+  size_t        num_vars;
+  /* Set if all variables can be read with one call */
+  get_values_func values;
+  size_t        stack_size;
+  /* Compile time only */
+  size_t        depth;
+} program_type;
+
 struct expression_type_s {
   operator_type type;
   expression_term_type *left_exp_term;
@@ -52,8 +88,17 @@ struct expression_type_s {
   expression_term_type *right_exp_term;
   expression_type      *right_exp_group;
   expression_type      *parent;
+  /* Compiled form, only on the top group */
+  program_type         *program;
 };
 
+/* Result of compiling a term or group; constants are not emitted right
+ * away so they can be folded in to their parent */
+typedef struct {
+  bool  constant;
+  float value;
+} operand_type;
+
 static operator_type get_operator(char *str)
 {
   operator_type op;
@@ -131,13 +176,203 @@ static expression_term_type *alloc_expression_term(char *name, variable_type *va
   return term;
 }
 
-static int expression_term_evaluate(expression_term_type *term, float *value)
+static int emit(program_type *prog, insn_op_type op, size_t arg)
+{
+  insn_type *insns;
+
+  if (arg >= MAX_INSN_ARG) {
+    return -1;
+  }
+  insns = realloc(prog->insns, (prog->num_insns + 1) * sizeof(insn_type));
+  if (!insns) {
+    return -1;
+  }
+  prog->insns = insns;
+  prog->insns[prog->num_insns].op = op;
+  prog->insns[prog->num_insns].arg = arg;
+  prog->num_insns++;
+
+  if (op == INSN_CONSTANT || op == INSN_VARIABLE) {
+    if (++prog->depth > prog->stack_size) {
+      prog->stack_size = prog->depth;
+    }
+  } else {
+    prog->depth--;
+  }
+  return 0;
+}
+
+static int emit_constant(program_type *prog, float value)
+{
+  float *constants;
+  size_t i;
+
+  for (i = 0; i < prog->num_constants; i++) {
+    if (!memcmp(&prog->constants[i], &value, sizeof(float))) {
+      return emit(prog, INSN_CONSTANT, i);
+    }
+  }
+  constants = realloc(prog->constants, (i + 1) * sizeof(float));
+  if (!constants) {
+    return -1;
+  }
+  prog->constants = constants;
+  prog->constants[i] = value;
+  prog->num_constants++;
+  return emit(prog, INSN_CONSTANT, i);
+}
+
+static int emit_variable(program_type *prog, variable_type *var)
+{
+  variable_type *vars;
+  size_t i;
+
+  for (i = 0; i < prog->num_vars; i++) {
+    if (!strncmp(prog->vars[i].name, var->name, sizeof(var->name))) {
+      return emit(prog, INSN_VARIABLE, i);
+    }
+  }
+  vars = realloc(prog->vars, (i + 1) * sizeof(variable_type));
+  if (!vars) {
+    return -1;
+  }
+  prog->vars = vars;
+  prog->vars[i] = *var;
+  prog->num_vars++;
+  return emit(prog, INSN_VARIABLE, i);
+}
+
+static int compile_term(program_type *prog, expression_term_type *term, operand_type *res)
 {
   if (term->type == TERM_CONSTANT) {
-    *value = term->term.constant;
+    res->constant = true;
+    res->value = term->term.constant;
     return 0;
   }
-  return term->term.var.value(term->term.var.state, value);
+  res->constant = false;
+  return emit_variable(prog, &term->term.var);
+}
+
+static float fold(operator_type type, float l_val, float r_val)
+{
+  switch(type) {
+    case OP_ADD:
+      return l_val + r_val;
+    case OP_SUBTRACT:
+      return l_val - r_val;
+    case OP_MULTIPLY:
+      return l_val * r_val;
+    case OP_DIVIDE:
+      return l_val / r_val;
+    default:
+      assert(0);
+  }
+  return 0;
+}
+
+/* Emit the code of a group in postfix order. Left to right evaluation
+ * order is kept as is, only groups of constants are folded. */
+static int compile_group(program_type *prog, expression_type *exp, operand_type *res)
+{
+  operand_type l, r;
+  insn_op_type op;
+  int ret;
+
+  if (!exp->left_exp_term && !exp->left_exp_group) {
+    return -1;
+  }
+  ret = exp->left_exp_term ? compile_term(prog, exp->left_exp_term, &l) :
+    compile_group(prog, exp->left_exp_group, &l);
+  if (ret) {
+    return ret;
+  }
+
+  if (!exp->right_exp_term && !exp->right_exp_group) {
+    /* Example use case would be the expression ( a + b ). This would be parsed
+     * as ( ( a + b ) ) thus, the outer redundant group would have ( a + b )
+     * as the left expression group with nothing on the right. Hense the
+     * group is just its left expression. */
+    *res = l;
+    return 0;
+  }
+  if (exp->type == OP_INVALID) {
+    return -1;
+  }
+  ret = exp->right_exp_term ? compile_term(prog, exp->right_exp_term, &r) :
+    compile_group(prog, exp->right_exp_group, &r);
+  if (ret) {
+    return ret;
+  }
+
+  res->constant = false;
+  /* Operators and their instructions are listed in the same order */
+  op = INSN_ADD + (exp->type - OP_ADD);
+  if (l.constant && r.constant) {
+    res->constant = true;
+    res->value = fold(exp->type, l.value, r.value);
+    return 0;
+  } else if (l.constant) {
+    /* R is already on the stack, so L goes on top of it */
+    if (exp->type == OP_SUBTRACT) {
+      op = INSN_SUBTRACT_REV;
+    } else if (exp->type == OP_DIVIDE) {
+      op = INSN_DIVIDE_REV;
+    }
+    ret = emit_constant(prog, l.value);
+  } else if (r.constant) {
+    ret = emit_constant(prog, r.value);
+  }
+  if (ret) {
+    return ret;
+  }
+  return emit(prog, op, 0);
+}
+
+static void program_destroy(program_type *prog)
+{
+  if (!prog) {
+    return;
+  }
+  free(prog->insns);
+  free(prog->constants);
+  free(prog->vars);
+  free(prog->states);
+  free(prog);
+}
+
+static program_type *expression_compile(expression_type *exp)
+{
+  program_type *prog;
+  operand_type res;
+  size_t i;
+
+  prog = calloc(1, sizeof(program_type));
+  if (!prog) {
+    return NULL;
+  }
+  if (compile_group(prog, exp, &res) ||
+      (res.constant && emit_constant(prog, res.value))) {
+    goto bail;
+  }
+  assert(prog->depth == 1);
+
+  if (prog->num_vars) {
+    prog->states = calloc(prog->num_vars, sizeof(void *));
+    if (!prog->states) {
+      goto bail;
+    }
+    prog->values = prog->vars[0].values;
+    for (i = 0; i < prog->num_vars; i++) {
+      prog->states[i] = prog->vars[i].state;
+      if (prog->vars[i].values != prog->values) {
+        prog->values = NULL;
+      }
+    }
+  }
+  return prog;
+bail:
+  program_destroy(prog);
+  return NULL;
 }
 
 expression_type *expression_parse(const char *user_str, variable_type *vars, size_t num)
@@ -223,6 +458,11 @@ expression_type *expression_parse(const char *user_str, variable_type *vars, siz
    * and the user is not missing any unclosed parenthesis */
   assert(current->parent == NULL);
   free(str);
+  current->program = expression_compile(current);
+  if (!current->program) {
+    expression_destroy(current);
+    return NULL;
+  }
   return current;
 free_bail:
   /* Free the partially created tree if it exists */
@@ -232,48 +472,73 @@ free_bail:
 
 int expression_evaluate(expression_type *exp, float *value)
 {
-  float l_val, r_val;
+  program_type *prog = exp->program;
+  float vals[prog->num_vars + 1];
+  float stack[prog->stack_size + 1];
+  insn_type *insn, *end = prog->insns + prog->num_insns;
+  size_t i, sp = 0;
   int ret;
-  assert(exp->left_exp_term || exp->left_exp_group);
-  ret = exp->left_exp_term ? expression_term_evaluate(exp->left_exp_term, &l_val) :
-    expression_evaluate(exp->left_exp_group, &l_val);
-  if (ret) {
-    return ret;
-  }
 
-  if (!exp->right_exp_term && !exp->right_exp_group) {
-    /* Example use case would be the expression ( a + b ). This would be parsed
-     * as ( ( a + b ) ) thus, the outer redundant group would have ( a + b )
-     * as the left expression group with nothing on the right. Hense just
-     * return success with the evaluation of the left expression. */
-    *value = l_val;
-    return 0;
-  }
-  ret = exp->right_exp_term ? expression_term_evaluate(exp->right_exp_term, &r_val) :
-    expression_evaluate(exp->right_exp_group, &r_val);
-  if (ret) {
-    return ret;
+  /* Read all inputs up front */
+  if (prog->values) {
+    ret = prog->values(prog->states, prog->num_vars, vals);
+    if (ret) {
+      return ret;
+    }
+  } else {
+    for (i = 0; i < prog->num_vars; i++) {
+      ret = prog->vars[i].value(prog->vars[i].state, &vals[i]);
+      if (ret) {
+        return ret;
+      }
+    }
   }
 
-  switch(exp->type) {
-    case OP_ADD:
-      *value = l_val + r_val;
-      break;
-    case OP_SUBTRACT:
-      *value = l_val - r_val;
-      break;
-    case OP_MULTIPLY:
-      *value = l_val * r_val;
-      break;
-    case OP_DIVIDE:
-      *value = l_val / r_val;
-      break;
-    default:
-      assert(0);
+  for (insn = prog->insns; insn < end; insn++) {
+    switch(insn->op) {
+      case INSN_CONSTANT:
+        stack[sp++] = prog->constants[insn->arg];
+        break;
+      case INSN_VARIABLE:
+        stack[sp++] = vals[insn->arg];
+        break;
+      case INSN_ADD:
+        sp--;
+        stack[sp - 1] = stack[sp - 1] + stack[sp];
+        break;
+      case INSN_SUBTRACT:
+        sp--;
+        stack[sp - 1] = stack[sp - 1] - stack[sp];
+        break;
+      case INSN_MULTIPLY:
+        sp--;
+        stack[sp - 1] = stack[sp - 1] * stack[sp];
+        break;
+      case INSN_DIVIDE:
+        sp--;
+        stack[sp - 1] = stack[sp - 1] / stack[sp];
+        break;
+      case INSN_SUBTRACT_REV:
+        sp--;
+        stack[sp - 1] = stack[sp] - stack[sp - 1];
+        break;
+      case INSN_DIVIDE_REV:
+        sp--;
+        stack[sp - 1] = stack[sp] / stack[sp - 1];
+        break;
+      default:
+        assert(0);
+    }
   }
+  *value = stack[0];
   return 0;
 }
 
+void expression_set_values(expression_type *exp, get_values_func values)
+{
+  exp->program->values = values;
+}
+
 void expression_destroy(expression_type *exp)
 {
   if (!exp) {
@@ -287,6 +552,7 @@ void expression_destroy(expression_type *exp)
     free(exp->right_exp_term);
   else if (exp->right_exp_group)
     expression_destroy(exp->right_exp_group);
+  program_destroy(exp->program);
   free(exp);
 }
 
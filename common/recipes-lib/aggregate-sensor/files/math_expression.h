@@ -18,6 +18,7 @@
  */
 #ifndef _MATH_EXPRESSION_H_
 #define _MATH_EXPRESSION_H_
+#include <stddef.h>
 /* Rules:
  * 1. Expression is always parsed left to right with no regard to operator
  *    precedence. When in doubt, use parenthesis. Also use
@@ -36,6 +37,11 @@
  * at parse time rather than at evaluation time */
 typedef int (*get_value_func)(void *state, float *value);
 
+/* Optional function reading several variables of the same kind at once;
+ * states[i] is the state of the variable whose value goes to values[i].
+ * Returns 0 only if every read succeeded. */
+typedef int (*get_values_func)(void **states, size_t num, float *values);
+
 /* Full description of the variable */
 typedef struct {
   /* Name of the variable used in the expression */
@@ -46,6 +52,9 @@ typedef struct {
   /* Any state information which will be useful to determine
    * the variable the call is interested in. */
   void  *state;
+  /* Optional; used instead of 'value' when every variable of an
+   * expression provides the same function */
+  get_values_func values;
 } variable_type;
 
 /* Opaque object with full description of the expression */
@@ -59,10 +68,16 @@ typedef struct expression_type_s expression_type;
  * the scope of 'value' & 'state' if they are dynamic objects */
 expression_type *expression_parse(const char *str, variable_type *vars, size_t num);
 
-/* Evaluate the expression. Note, multiple calls to the functions
- * provided in 'vars' in expression_parse might be made */
+/* Evaluate the expression. The expression is compiled in to a flat
+ * instruction list by expression_parse, with constant sub-expressions
+ * folded, and each variable it uses is read exactly once per call,
+ * before any arithmetic is done. */
 int expression_evaluate(expression_type *op, float *value);
 
+/* Read all variables of the expression with 'values' from now on, or
+ * one by one with their own function if NULL */
+void expression_set_values(expression_type *exp, get_values_func values);
+
 /* Destroy the object created in expression_parse */
 void expression_destroy(expression_type *exp);
 
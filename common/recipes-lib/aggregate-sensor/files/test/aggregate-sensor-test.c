@@ -21,8 +21,10 @@
 #include <stdlib.h>
 #include <stdio.h>
 #include <assert.h>
+#include <math.h>
 #include <jansson.h>
 #include "aggregate-sensor.h"
+#include "math_expression.h"
 #include <openbmc/kv.h>
 #include <openbmc/obmc-sensor.h>
 
@@ -56,6 +58,21 @@ int kv_get(char *key, char *value, size_t *len, unsigned int flags)
   return -1;
 }
 
+/* No change notification, so the condition is resolved on every read */
+kv_watch_t *kv_watch(const char *key, unsigned int flags)
+{
+  return NULL;
+}
+
+int kv_changed(kv_watch_t *w)
+{
+  return 1;
+}
+
+void kv_unwatch(kv_watch_t *w)
+{
+}
+
 int sensor_cache_read(uint8_t fru, uint8_t snr_num, float *value)
 {
   size_t i;
@@ -69,6 +86,19 @@ int sensor_cache_read(uint8_t fru, uint8_t snr_num, float *value)
   return -1;
 }
 
+int sensor_cache_read_bulk(const sensor_hist_id_t *sensors, int nsensors,
+    float *values, int *status)
+{
+  int i, ret = 0;
+  for (i = 0; i < nsensors; i++) {
+    status[i] = sensor_cache_read(sensors[i].fru, sensors[i].sensor_num, &values[i]);
+    if (status[i] && !ret) {
+      ret = status[i];
+    }
+  }
+  return ret;
+}
+
 static json_t *get_sensor(const char *file, size_t num)
 {
   static json_t *conf = NULL;
@@ -247,11 +277,166 @@ int aggregate_sensor_test(const char *file)
   return 0;
 }
 
+/* Differential test of the expression compiler: random expressions are
+ * built together with their value, computed left to right with float
+ * arithmetic as the old tree walk did, and must evaluate bit for bit
+ * the same after parsing. */
+#define EXPR_TESTS      400
+#define EXPR_VARS       8
+#define EXPR_MAX_DEPTH  3
+#define EXPR_MAX_CHAIN  3
+#define EXPR_MAX_STR    4096
+
+static float expr_var_values[EXPR_VARS];
+static int expr_var_reads[EXPR_VARS];
+
+static int expr_get_value(void *state, float *value)
+{
+  int i = (int)(intptr_t)state;
+  expr_var_reads[i]++;
+  *value = expr_var_values[i];
+  return 0;
+}
+
+static int expr_get_values(void **states, size_t num, float *values)
+{
+  size_t i;
+  for (i = 0; i < num; i++) {
+    expr_get_value(states[i], &values[i]);
+  }
+  return 0;
+}
+
+static float expr_apply(char op, float l, float r)
+{
+  switch (op) {
+    case '+':
+      return l + r;
+    case '-':
+      return l - r;
+    case '*':
+      return l * r;
+    default:
+      return l / r;
+  }
+}
+
+static float expr_gen_group(char *str, int depth, unsigned int *used);
+
+static float expr_gen_operand(char *str, int depth, unsigned int *used)
+{
+  char tok[32];
+  float value;
+  int i;
+
+  if (depth > 0 && rand() % 3 == 0) {
+    strcat(str, "( ");
+    value = expr_gen_group(str, depth - 1, used);
+    strcat(str, ") ");
+    return value;
+  }
+  if (rand() % 2) {
+    i = rand() % EXPR_VARS;
+    *used |= 1 << i;
+    sprintf(tok, "v%d ", i);
+    strcat(str, tok);
+    return expr_var_values[i];
+  }
+  /* Zero now and then, so division by zero and NaN are covered */
+  sprintf(tok, "%s%d.%02d", rand() % 4 ? "" : "-", rand() % 20, rand() % 100);
+  value = atof(tok);
+  strcat(str, tok);
+  strcat(str, " ");
+  return value;
+}
+
+static float expr_gen_group(char *str, int depth, unsigned int *used)
+{
+  static const char ops[] = "+-*/";
+  char op[3] = " ";
+  float value;
+  int i, n = 1 + rand() % EXPR_MAX_CHAIN;
+
+  value = expr_gen_operand(str, depth, used);
+  for (i = 1; i < n; i++) {
+    op[0] = ops[rand() % 4];
+    strcat(str, op);
+    strcat(str, " ");
+    value = expr_apply(op[0], value, expr_gen_operand(str, depth, used));
+  }
+  return value;
+}
+
+static bool expr_same(float a, float b)
+{
+  if (isnan(a) || isnan(b)) {
+    return isnan(a) && isnan(b);
+  }
+  return !memcmp(&a, &b, sizeof(float));
+}
+
+int expression_differential_test(void)
+{
+  variable_type vars[EXPR_VARS];
+  expression_type *exp;
+  char str[EXPR_MAX_STR];
+  unsigned int used;
+  float expected, value;
+  int t, i, pass, failed = 0;
+
+  srand(1);
+  memset(vars, 0, sizeof(vars));
+  for (i = 0; i < EXPR_VARS; i++) {
+    sprintf(vars[i].name, "v%d", i);
+    vars[i].value = expr_get_value;
+    vars[i].state = (void *)(intptr_t)i;
+  }
+
+  for (t = 0; t < EXPR_TESTS; t++) {
+    for (i = 0; i < EXPR_VARS; i++) {
+      expr_var_values[i] = (float)(rand() % 20001 - 10000) / 100;
+    }
+    str[0] = '\0';
+    used = 0;
+    expected = expr_gen_group(str, EXPR_MAX_DEPTH, &used);
+
+    exp = expression_parse(str, vars, EXPR_VARS);
+    if (!exp) {
+      printf("FAILED: parse of \"%s\"\n", str);
+      failed++;
+      continue;
+    }
+    /* Once with each variable's own function, once with the bulk one */
+    for (pass = 0; pass < 2; pass++) {
+      expression_set_values(exp, pass ? expr_get_values : NULL);
+      memset(expr_var_reads, 0, sizeof(expr_var_reads));
+      if (expression_evaluate(exp, &value) || !expr_same(value, expected)) {
+        printf("FAILED: \"%s\" = %f, expected %f\n", str, value, expected);
+        failed++;
+        break;
+      }
+      for (i = 0; i < EXPR_VARS; i++) {
+        if (expr_var_reads[i] != ((used >> i) & 1)) {
+          printf("FAILED: \"%s\" read v%d %d times\n", str, i, expr_var_reads[i]);
+          failed++;
+          break;
+        }
+      }
+    }
+    expression_destroy(exp);
+  }
+  printf("Expression differential test: %d of %d failed\n", failed, EXPR_TESTS);
+  return failed ? -1 : 0;
+}
+
 int main(int argc, char *argv[])
 {
+  if (expression_differential_test()) {
+    return -1;
+  }
   if (argc < 2) {
     printf("Usage: %s <JSON Config>\n", argv[0]);
-    return -1;
+    return 0;
   }
   return aggregate_sensor_test(argv[1]);
 }
@@ -24,7 +24,7 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <unistd.h>
-#include <poll.h>
+#include <stdint.h>
 #include <string.h>
 #include <ctype.h>
 #include <pthread.h>
@@ -32,10 +32,41 @@
 #include <sys/stat.h>
 #include <sys/types.h>
 #include <sys/errno.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
 
 #include <openbmc/log.h>
 
-#define MAX_PINS 64
+#define GPIO_EVENT_QUEUE 256  /* Power of 2 */
+
+/* An edge, as handed from the watcher thread to the caller of gpio_poll */
+typedef struct {
+  int pin;
+  int value;
+  struct timespec ts;
+} gpio_event_t;
+
+/*
+ * Single producer, single consumer ring: only the producer moves tail
+ * and only the consumer moves head. efd wakes up the consumer.
+ */
+typedef struct {
+  int efd;
+  unsigned int head;
+  unsigned int tail;
+  gpio_event_t events[GPIO_EVENT_QUEUE];
+} gpio_ring_t;
+
+typedef struct {
+  gpio_poll_st *gpios;
+  int count;
+  int timeout;
+  int epfd;
+  int stop;               /* Set by the watcher once it is done */
+  int rc;
+  gpio_ring_t ring;       /* Watcher to the caller of gpio_poll */
+  gpio_ring_t offload;    /* Caller to the offload thread */
+} gpio_watch_t;
 
 static void strip(char *str) {
   while(*str != '\0') {
@@ -317,68 +348,286 @@ int gpio_poll_open(gpio_poll_st *gpios, int count)
   return 0;
 }
 
-static void *gpio_poll_pin(void *arg)
+static long long now_ms(struct timespec *ts)
 {
-  gpio_poll_st *gpios = (gpio_poll_st *)arg;
-  struct pollfd fdset;
-  int rc;
+  clock_gettime(CLOCK_MONOTONIC, ts);
+  return (long long)ts->tv_sec * 1000 + ts->tv_nsec / 1000000;
+}
+
+static void gpio_ring_push(gpio_watch_t *w, gpio_ring_t *r, int pin,
+                           int value, struct timespec *ts)
+{
+  unsigned int tail = r->tail;
+  gpio_event_t *ev;
+  uint64_t one = 1;
+
+  if (tail - __atomic_load_n(&r->head, __ATOMIC_ACQUIRE) == GPIO_EVENT_QUEUE) {
+    LOG_ERR(ENOBUFS, "gpio_poll: %s event dropped\n", w->gpios[pin].desc);
+    return;
+  }
+  ev = &r->events[tail % GPIO_EVENT_QUEUE];
+  ev->pin = pin;
+  ev->value = value;
+  ev->ts = *ts;
+  __atomic_store_n(&r->tail, tail + 1, __ATOMIC_RELEASE);
+  write(r->efd, &one, sizeof(one));
+}
+
+/* Take the oldest event of the ring, 0 if it is empty */
+static int gpio_ring_pop(gpio_ring_t *r, gpio_event_t *ev)
+{
+  unsigned int head = r->head;
+
+  if (head == __atomic_load_n(&r->tail, __ATOMIC_ACQUIRE)) {
+    return 0;
+  }
+  *ev = r->events[head % GPIO_EVENT_QUEUE];
+  __atomic_store_n(&r->head, head + 1, __ATOMIC_RELEASE);
+  return 1;
+}
+
+/*
+ * Wait for edges on all the pins. Without debounce every edge is queued
+ * as it comes; with it, the value read at the last edge is queued once
+ * the pin has had no edge for debounce ms, if it differs from the last
+ * value queued.
+ */
+static void *gpio_watch_thread(void *arg)
+{
+  gpio_watch_t *w = (gpio_watch_t *)arg;
+  gpio_poll_st *gpios = w->gpios;
+  struct epoll_event *evs;
+  struct timespec ts, *edge_ts;
+  long long now, deadline = -1, *due;
+  int *last, *value, *pending;
+  int i, n, v, wait;
+  int nevs = w->count > 0 ? w->count : 1;
+  uint64_t one = 1;
+
+  evs = calloc(nevs, sizeof(*evs));
+  edge_ts = calloc(nevs, sizeof(*edge_ts));
+  due = calloc(nevs, sizeof(*due));
+  last = calloc(nevs, sizeof(*last));
+  value = calloc(nevs, sizeof(*value));
+  pending = calloc(nevs, sizeof(*pending));
+  if (!evs || !edge_ts || !due || !last || !value || !pending) {
+    w->rc = -ENOMEM;
+    goto done;
+  }
+
+  for (i = 0; i < w->count; i++) {
+    last[i] = gpios[i].value;
+  }
+  now = now_ms(&ts);
+  if (w->timeout >= 0) {
+    deadline = now + w->timeout;
+  }
 
   while (1) {
-    memset((void *)&fdset, 0, sizeof(fdset));
-    fdset.fd = gpios->gs.gs_fd;
-    fdset.events = POLLPRI;
-    gpios->value = gpio_read(&gpios->gs);
-
-    rc = poll(&fdset, 1, -1); /* -1 : Forever */
-    if (rc < 0) {
-      if (errno == EINTR) {
-        continue;
+    wait = -1;
+    if (deadline >= 0) {
+      if (now >= deadline) {
+        break;
+      }
+      wait = deadline - now;
+    }
+    for (i = 0; i < w->count; i++) {
+      if (pending[i] && (wait < 0 || due[i] - now < wait)) {
+        wait = due[i] > now ? due[i] - now : 0;
+      }
+    }
+
+    n = epoll_wait(w->epfd, evs, nevs, wait);
+    if (n < 0 && errno != EINTR) {
+      w->rc = -errno;
+      LOG_ERR(w->rc, "gpio_poll: epoll_wait() fails\n");
+      break;
+    }
+    now = now_ms(&ts);
+
+    for (i = 0; i < n; i++) {
+      int pin = evs[i].data.u32;
+
+      // Reading the value also rearms the edge notification
+      v = gpio_read(&gpios[pin].gs);
+      if (gpios[pin].debounce > 0) {
+        pending[pin] = 1;
+        value[pin] = v;
+        due[pin] = now + gpios[pin].debounce;
+        edge_ts[pin] = ts;
       } else {
-        rc = -errno;
-        LOG_ERR(rc, "gpio_poll: %s poll() fails\n", gpios[0].desc);
-        pthread_exit(&rc);
+        last[pin] = v;
+        gpio_ring_push(w, &w->ring, pin, v, &ts);
       }
     }
 
-    if (rc == 0) {
-      LOG_ERR(rc, "gpio_poll: %s poll() timeout\n", gpios[0].desc);
-      pthread_exit(&rc);
+    for (i = 0; i < w->count; i++) {
+      if (pending[i] && due[i] <= now) {
+        pending[i] = 0;
+        if (value[i] != last[i]) {
+          last[i] = value[i];
+          gpio_ring_push(w, &w->ring, i, value[i], &edge_ts[i]);
+        }
+      }
     }
+  }
 
-    if (fdset.revents & POLLPRI) {
-      gpios->value = gpio_read(&gpios->gs);
-      gpios->fp(gpios);
+done:
+  free(evs);
+  free(edge_ts);
+  free(due);
+  free(last);
+  free(value);
+  free(pending);
+  __atomic_store_n(&w->stop, 1, __ATOMIC_RELEASE);
+  write(w->ring.efd, &one, sizeof(one));
+  return NULL;
+}
+
+static void gpio_event_call(gpio_poll_st *gpio, gpio_event_t *ev)
+{
+  gpio->value = ev->value;
+  gpio->ts = ev->ts;
+  if (gpio->fp) {
+    gpio->fp(gpio);
+  }
+}
+
+/* Run the callbacks of the queued events, handing those of offload pins on */
+static void gpio_watch_dispatch(gpio_watch_t *w)
+{
+  gpio_event_t ev;
+
+  while (gpio_ring_pop(&w->ring, &ev)) {
+    if (w->gpios[ev.pin].offload) {
+      gpio_ring_push(w, &w->offload, ev.pin, ev.value, &ev.ts);
+    } else {
+      gpio_event_call(&w->gpios[ev.pin], &ev);
     }
   }
+}
+
+/*
+ * Run the callbacks of the offload pins, in edge order, until gpio_poll
+ * is done and has nothing left to hand on
+ */
+static void *gpio_offload_thread(void *arg)
+{
+  gpio_watch_t *w = (gpio_watch_t *)arg;
+  gpio_event_t ev;
+  uint64_t cnt;
+  int stop;
+
+  do {
+    if (read(w->offload.efd, &cnt, sizeof(cnt)) < 0 && errno != EINTR) {
+      LOG_ERR(errno, "gpio_poll: offload eventfd read fails\n");
+    }
+    // gpio_poll sets stop to 2 once it is done handing events on
+    stop = __atomic_load_n(&w->stop, __ATOMIC_ACQUIRE) == 2;
+    while (gpio_ring_pop(&w->offload, &ev)) {
+      gpio_event_call(&w->gpios[ev.pin], &ev);
+    }
+  } while (!stop);
 
-  pthread_exit(&rc);
+  return NULL;
 }
 
 int gpio_poll(gpio_poll_st *gpios, int count, int timeout)
 {
-  pthread_t thread_ids[count];
+  struct epoll_event ev;
+  gpio_watch_t *w;
+  pthread_t tid, offload_tid;
+  uint64_t cnt, one = 1;
+  int offload = 0;
+  int stop;
   int ret;
   int i;
 
-  if (count > MAX_PINS) {
-    return -EINVAL;
+  w = calloc(1, sizeof(*w));
+  if (w == NULL) {
+    return -ENOMEM;
+  }
+  w->gpios = gpios;
+  w->count = count;
+  w->timeout = timeout;
+  w->offload.efd = -1;
+  w->epfd = epoll_create1(EPOLL_CLOEXEC);
+  w->ring.efd = eventfd(0, EFD_CLOEXEC);
+  if (w->epfd < 0 || w->ring.efd < 0) {
+    ret = -errno;
+    LOG_ERR(ret, "gpio_poll: epoll/eventfd setup failed\n");
+    goto out;
   }
 
-  for ( i = 0; i < count; i++) {
-    // TODO pass timeout value into thread
-    if ((ret = pthread_create(&thread_ids[i], NULL, gpio_poll_pin, &gpios[i])) < 0) {
-      LOG_ERR(ret, "pthread_create failed for %s\n", gpios[i].desc);
-      return ret;
+  for (i = 0; i < count; i++) {
+    if (gpios[i].gs.gs_fd < 0) {
+      continue;
+    }
+    gpios[i].value = gpio_read(&gpios[i].gs);
+    ev.events = EPOLLPRI | EPOLLERR;
+    ev.data.u32 = i;
+    if (epoll_ctl(w->epfd, EPOLL_CTL_ADD, gpios[i].gs.gs_fd, &ev) < 0) {
+      ret = -errno;
+      LOG_ERR(ret, "gpio_poll: epoll_ctl failed for %s\n", gpios[i].desc);
+      goto out;
     }
   }
 
-  for ( i = 0; i < count; i++) {
-    if ((ret = pthread_join(thread_ids[i], NULL) < 0)) {
-      LOG_ERR(ret, "pthread_join failed for %s\n", gpios[i].desc);
+  for (i = 0; i < count; i++) {
+    offload |= gpios[i].offload && gpios[i].gs.gs_fd >= 0;
+  }
+  if (offload) {
+    w->offload.efd = eventfd(0, EFD_CLOEXEC);
+    if (w->offload.efd < 0) {
+      ret = -errno;
+      LOG_ERR(ret, "gpio_poll: offload eventfd setup failed\n");
+      goto out;
+    }
+    if ((ret = pthread_create(&offload_tid, NULL, gpio_offload_thread, w)) != 0) {
+      LOG_ERR(ret, "pthread_create failed for gpio_poll offload\n");
+      ret = -ret;
+      goto out;
     }
   }
 
-  return 0;
+  if ((ret = pthread_create(&tid, NULL, gpio_watch_thread, w)) != 0) {
+    LOG_ERR(ret, "pthread_create failed for gpio_poll\n");
+    ret = -ret;
+    __atomic_store_n(&w->stop, 1, __ATOMIC_RELEASE);
+    goto stop_offload;
+  }
+
+  do {
+    if (read(w->ring.efd, &cnt, sizeof(cnt)) < 0 && errno != EINTR) {
+      LOG_ERR(errno, "gpio_poll: eventfd read fails\n");
+    }
+    // Checked before draining so events queued ahead of it are not missed
+    stop = __atomic_load_n(&w->stop, __ATOMIC_ACQUIRE);
+    gpio_watch_dispatch(w);
+  } while (!stop);
+
+  pthread_join(tid, NULL);
+  ret = w->rc;
+
+stop_offload:
+  if (offload) {
+    __atomic_store_n(&w->stop, 2, __ATOMIC_RELEASE);
+    write(w->offload.efd, &one, sizeof(one));
+    pthread_join(offload_tid, NULL);
+  }
+
+out:
+  if (w->epfd >= 0) {
+    close(w->epfd);
+  }
+  if (w->ring.efd >= 0) {
+    close(w->ring.efd);
+  }
+  if (w->offload.efd >= 0) {
+    close(w->offload.efd);
+  }
+  free(w);
+  return ret;
 }
 
 int gpio_poll_close(gpio_poll_st *gpios, int count)
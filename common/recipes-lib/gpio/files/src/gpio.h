@@ -18,6 +18,8 @@
 #ifndef GPIO_H
 #define GPIO_H
 
+#include <time.h>
+
 #ifdef __cplusplus
 extern "C" {
 #endif
@@ -55,6 +57,9 @@ struct gpio_poll_s {
   void (*fp)(gpio_poll_st *);
   char name[32];
   char desc[64];
+  int debounce;         /* ms the pin must be stable for, 0: report every edge */
+  struct timespec ts;   /* CLOCK_MONOTONIC time of the edge fp is called for */
+  int offload;          /* fp may block: call it from the offload thread */
 };
 
 /* Operations for extended gpio operations */
@@ -78,6 +83,13 @@ char *gpio_name(int gpio, char *str);
 int gpio_export(int gpio);
 int gpio_unexport(int gpio);
 int gpio_poll_open(gpio_poll_st *gpios, int count);
+/*
+ * Watch all the pins from one thread and call their fp, one event at a
+ * time in the order the edges were seen, from the calling thread. The fp
+ * of pins with offload set are called in turn from one separate thread,
+ * so they may block without holding up the other pins. Returns 0 once
+ * timeout ms have passed (never if -1), or a negative errno.
+ */
 int gpio_poll(gpio_poll_st *gpios, int count, int timeout);
 int gpio_poll_close(gpio_poll_st *gpios, int count);
 
@@ -32,8 +32,36 @@
 #include <pthread.h>
 #include <stdarg.h>
 #include <unistd.h>
+#include <poll.h>
+#include <time.h>
 #include "ipmb.h"
 
+#define IPMB_MUX_RETRY_SEC  5   // Wait before retrying an absent mux socket
+
+// Caller waiting for the response to one tag
+typedef struct {
+  int in_use;
+  int done;
+  unsigned char *buf;
+  unsigned char len;
+} ipmb_mux_slot_t;
+
+// One multiplexed connection per bus per process
+typedef struct {
+  pthread_mutex_t mutex;
+  pthread_cond_t cond;
+  pid_t pid;
+  int fd;
+  int reading;      // A caller is receiving on behalf of everyone
+  int broken;       // Close fd once the reader is back
+  time_t retry_at;  // Mux socket unavailable until then
+  uint8_t next_tag;
+  ipmb_mux_slot_t slots[IPMB_MUX_TAGS];
+} ipmb_mux_conn_t;
+
+static ipmb_mux_conn_t *g_mux[256];
+static pthread_mutex_t m_mux = PTHREAD_MUTEX_INITIALIZER;
+
 static pthread_key_t rxkey, txkey;
 static pthread_once_t key_once = PTHREAD_ONCE_INIT;
 
@@ -85,11 +113,239 @@ ipmb_txb()
   return (ipmb_req_t*)buf;
 }
 
+static time_t
+mux_now(struct timespec *ts)
+{
+  clock_gettime(CLOCK_MONOTONIC, ts);
+  return ts->tv_sec;
+}
+
+static void
+mux_init(ipmb_mux_conn_t *conn)
+{
+  pthread_condattr_t attr;
+
+  memset(conn, 0, sizeof(*conn));
+  pthread_mutex_init(&conn->mutex, NULL);
+  pthread_condattr_init(&attr);
+  pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+  pthread_cond_init(&conn->cond, &attr);
+  pthread_condattr_destroy(&attr);
+  conn->pid = getpid();
+  conn->fd = -1;
+}
+
+static ipmb_mux_conn_t *
+mux_get(unsigned char bus_id)
+{
+  ipmb_mux_conn_t *conn;
+
+  pthread_mutex_lock(&m_mux);
+  conn = g_mux[bus_id];
+  if (conn == NULL) {
+    conn = malloc(sizeof(ipmb_mux_conn_t));
+    if (conn != NULL) {
+      mux_init(conn);
+      g_mux[bus_id] = conn;
+    }
+  } else if (conn->pid != getpid()) {
+    // Forked child; the connection belongs to the parent
+    if (conn->fd >= 0)
+      close(conn->fd);
+    mux_init(conn);
+  }
+  pthread_mutex_unlock(&m_mux);
+
+  return conn;
+}
+
+// Fail everything in flight; caller holds conn->mutex
+static void
+mux_fail(ipmb_mux_conn_t *conn)
+{
+  int i;
+
+  for (i = 0; i < IPMB_MUX_TAGS; i++) {
+    if (conn->slots[i].in_use && !conn->slots[i].done) {
+      conn->slots[i].len = 0;
+      conn->slots[i].done = 1;
+    }
+  }
+
+  // The reader is still using fd; it closes it when it comes back
+  if (conn->reading) {
+    conn->broken = 1;
+  } else if (conn->fd >= 0) {
+    close(conn->fd);
+    conn->fd = -1;
+  }
+  pthread_cond_broadcast(&conn->cond);
+}
+
+static int
+mux_connect(ipmb_mux_conn_t *conn, unsigned char bus_id)
+{
+  struct sockaddr_un remote;
+  struct timespec ts;
+  int s;
+
+  if (conn->fd >= 0)
+    return conn->broken ? -1 : 0;
+  if (mux_now(&ts) < conn->retry_at)
+    return -1;
+
+  if ((s = socket(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0)) == -1)
+    return -1;
+
+  memset(&remote, 0, sizeof(remote));
+  remote.sun_family = AF_UNIX;
+  snprintf(remote.sun_path, sizeof(remote.sun_path), "%s_%d",
+           SOCK_PATH_IPMB_MUX, bus_id);
+  if (connect(s, (struct sockaddr *)&remote, sizeof(remote)) == -1) {
+    // Older ipmbd without the mux socket, use the plain one for a while
+    close(s);
+    conn->retry_at = ts.tv_sec + IPMB_MUX_RETRY_SEC;
+    return -1;
+  }
+
+  conn->fd = s;
+  return 0;
+}
+
+// Receive one response and hand it to its owner; caller holds conn->mutex
+// and has set conn->reading
+static void
+mux_recv(ipmb_mux_conn_t *conn, int timeout_ms)
+{
+  unsigned char buf[MAX_IPMB_RES_LEN + 1];
+  struct pollfd pfd;
+  ipmb_mux_slot_t *slot;
+  int n = -1, err = EAGAIN;
+
+  pfd.fd = conn->fd;
+  pfd.events = POLLIN;
+  pthread_mutex_unlock(&conn->mutex);
+  if (poll(&pfd, 1, timeout_ms) > 0) {
+    n = recv(pfd.fd, buf, sizeof(buf), MSG_DONTWAIT);
+    err = errno;
+  }
+  pthread_mutex_lock(&conn->mutex);
+  conn->reading = 0;
+
+  if (conn->broken) {
+    close(conn->fd);
+    conn->fd = -1;
+    conn->broken = 0;
+  } else if (n > 0) {
+    slot = &conn->slots[buf[0] % IPMB_MUX_TAGS];
+    if (slot->in_use && !slot->done) {
+      memcpy(slot->buf, &buf[1], n - 1);
+      slot->len = n - 1;
+      slot->done = 1;
+    }
+  } else if (n == 0 || (err != EAGAIN && err != EINTR)) {
+#ifdef DEBUG
+    syslog(LOG_WARNING, "lib_ipmb_handle: mux connection lost\n");
+#endif
+    mux_fail(conn);
+  }
+  pthread_cond_broadcast(&conn->cond);
+}
+
 /*
- * Function to handle IPMB messages
+ * Send a request over the multiplexed connection of bus_id and wait for
+ * its response. Waiting callers take turns receiving, so responses are
+ * delivered to their owners in whatever order ipmbd sends them.
+ *
+ * Returns -1 if the request could not be sent, the caller should then
+ * use the plain socket.
  */
-void
-lib_ipmb_handle(unsigned char bus_id,
+static int
+ipmb_mux_handle(unsigned char bus_id,
+            unsigned char *request, unsigned short req_len,
+            unsigned char *response, unsigned char *res_len) {
+
+  ipmb_mux_conn_t *conn;
+  ipmb_mux_slot_t *slot = NULL;
+  unsigned char tbuf[MAX_IPMB_RES_LEN + 1];
+  struct timespec now, deadline;
+  int i, tag, remain;
+
+  if (req_len > MAX_IPMB_RES_LEN)
+    return -1;
+
+  conn = mux_get(bus_id);
+  if (conn == NULL)
+    return -1;
+
+  mux_now(&deadline);
+  deadline.tv_sec += TIMEOUT_IPMB + 1;
+
+  pthread_mutex_lock(&conn->mutex);
+  if (mux_connect(conn, bus_id)) {
+    pthread_mutex_unlock(&conn->mutex);
+    return -1;
+  }
+
+  // Pick the next free tag, waiting if all of them are in flight
+  while (1) {
+    for (i = 0; i < IPMB_MUX_TAGS; i++) {
+      tag = (conn->next_tag + i) % IPMB_MUX_TAGS;
+      if (!conn->slots[tag].in_use) {
+        slot = &conn->slots[tag];
+        break;
+      }
+    }
+    if (slot != NULL)
+      break;
+    if (pthread_cond_timedwait(&conn->cond, &conn->mutex, &deadline) == ETIMEDOUT) {
+      pthread_mutex_unlock(&conn->mutex);
+      *res_len = 0;
+      return 0;
+    }
+  }
+  // Rotate tags so a late response can not be taken for a new request
+  conn->next_tag = (tag + 1) % IPMB_MUX_TAGS;
+  slot->in_use = 1;
+  slot->done = 0;
+  slot->buf = response;
+  slot->len = 0;
+
+  tbuf[0] = tag;
+  memcpy(&tbuf[1], request, req_len);
+  if (conn->fd < 0 || send(conn->fd, tbuf, req_len + 1, MSG_NOSIGNAL) < 0) {
+    mux_fail(conn);
+    slot->in_use = 0;
+    pthread_mutex_unlock(&conn->mutex);
+    return -1;
+  }
+
+  while (!slot->done) {
+    mux_now(&now);
+    remain = (deadline.tv_sec - now.tv_sec) * 1000 +
+             (deadline.tv_nsec - now.tv_nsec) / 1000000;
+    if (remain <= 0)
+      break;
+
+    if (!conn->reading && conn->fd >= 0) {
+      conn->reading = 1;
+      mux_recv(conn, remain);
+    } else {
+      pthread_cond_timedwait(&conn->cond, &conn->mutex, &deadline);
+    }
+  }
+
+  *res_len = slot->done ? slot->len : 0;
+  slot->in_use = 0;
+  slot->buf = NULL;
+  pthread_cond_broadcast(&conn->cond);
+  pthread_mutex_unlock(&conn->mutex);
+
+  return 0;
+}
+
+static void
+ipmb_sock_handle(unsigned char bus_id,
             unsigned char *request, unsigned short req_len,
             unsigned char *response, unsigned char *res_len) {
 
@@ -101,7 +357,6 @@ lib_ipmb_handle(unsigned char bus_id,
 
   sprintf(sock_path, "%s_%d", SOCK_PATH_IPMB, bus_id);
 
-  // TODO: Need to update to reuse the socket instead of creating new
   if ((s = socket(AF_UNIX, SOCK_STREAM, 0)) == -1) {
 #ifdef DEBUG
     syslog(LOG_WARNING, "lib_ipmb_handle: socket() failed\n");
@@ -162,6 +417,20 @@ clean_exit:
   return;
 }
 
+/*
+ * Function to handle IPMB messages
+ */
+void
+lib_ipmb_handle(unsigned char bus_id,
+            unsigned char *request, unsigned short req_len,
+            unsigned char *response, unsigned char *res_len) {
+
+  if (ipmb_mux_handle(bus_id, request, req_len, response, res_len) == 0)
+    return;
+
+  ipmb_sock_handle(bus_id, request, req_len, response, res_len);
+}
+
 int
 ipmb_send_buf (unsigned char bus_id, unsigned char tlen)
 {
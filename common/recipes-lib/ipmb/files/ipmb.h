@@ -27,6 +27,12 @@ extern "C" {
 
 #define SOCK_PATH_IPMB "/tmp/ipmb_socket"
 
+// Multiplexed (SOCK_SEQPACKET) socket; every message in either direction
+// is prefixed by one tag byte, an IPMB sequence number picked by the client,
+// so many requests can be in flight and be answered out of order.
+#define SOCK_PATH_IPMB_MUX "/tmp/ipmb_mux_socket"
+#define IPMB_MUX_TAGS 64
+
 #define BMC_SLAVE_ADDR 0x10
 #define BRIDGE_SLAVE_ADDR 0x20
 #define ZERO_CKSUM_CONST 0x100
@@ -27,24 +27,213 @@
 #include <errno.h>
 #include <string.h>
 #include <syslog.h>
+#include <pthread.h>
 #include <sys/types.h>
 #include <sys/socket.h>
 #include <sys/un.h>
 
 #define MAX_IPMI_RES_LEN 300
 
+struct ipmi_client {
+  int fd;
+  pid_t pid;                      // Process the connection belongs to
+  int pending;                    // Requests sent and not answered yet
+};
+
+static pthread_key_t g_client_key;
+static pthread_once_t g_client_once = PTHREAD_ONCE_INIT;
+
+static int
+client_connect(ipmi_client_t *client) {
+
+  int len;
+  struct sockaddr_un remote;
+  struct timeval tv;
+
+  if ((client->fd = socket(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0)) == -1) {
+    return -1;
+  }
+
+  // setup timeout for receving on socket
+  tv.tv_sec = TIMEOUT_IPMI + 1;
+  tv.tv_usec = 0;
+
+  setsockopt(client->fd, SOL_SOCKET, SO_RCVTIMEO, (char *)&tv,sizeof(struct timeval));
+
+  remote.sun_family = AF_UNIX;
+  strcpy(remote.sun_path, SOCK_PATH_IPMI_SEQ);
+  len = strlen(remote.sun_path) + sizeof(remote.sun_family);
+
+  if (connect(client->fd, (struct sockaddr *)&remote, len) == -1) {
+    close(client->fd);
+    client->fd = -1;
+    return -1;
+  }
+
+  client->pid = getpid();
+  client->pending = 0;
+  return 0;
+}
+
+static void
+client_disconnect(ipmi_client_t *client) {
+
+  if (client->fd >= 0) {
+    close(client->fd);
+  }
+  client->fd = -1;
+  client->pending = 0;
+}
+
 /*
- * Function to handle IPMI messages
+ * Make sure the client has a usable connection, opening a new one if
+ * ipmid restarted or dropped it as idle since the last request.
  */
+static int
+client_check(ipmi_client_t *client) {
+
+  char c;
+  int n;
+
+  if (client->fd >= 0 && client->pid != getpid()) {
+    // Inherited over fork(), leave it to the parent
+    close(client->fd);
+    client->fd = -1;
+    client->pending = 0;
+  }
+
+  if (client->fd >= 0 && client->pending == 0) {
+    n = recv(client->fd, &c, 1, MSG_PEEK | MSG_DONTWAIT);
+    if (n >= 0 || (errno != EAGAIN && errno != EWOULDBLOCK)) {
+      client_disconnect(client);
+    }
+  }
+
+  if (client->fd < 0) {
+    return client_connect(client);
+  }
+  return 0;
+}
+
+static int
+client_send(ipmi_client_t *client, unsigned char *request, unsigned char req_len) {
+
+  if (send(client->fd, request, req_len, MSG_NOSIGNAL) == -1) {
+    if (client->pending == 0 && (errno == EPIPE || errno == ECONNRESET)) {
+      // Closed by ipmid since the check; nothing was lost, try once more
+      client_disconnect(client);
+      if (client_connect(client) == 0 &&
+          send(client->fd, request, req_len, MSG_NOSIGNAL) != -1) {
+        client->pending++;
+        return 0;
+      }
+    }
+#ifdef DEBUG
+    syslog(LOG_WARNING, "ipmi_client_send: send() failed\n");
+#endif
+    // Responses still due are lost with the connection
+    client_disconnect(client);
+    return -1;
+  }
+
+  client->pending++;
+  return 0;
+}
+
+ipmi_client_t *
+ipmi_client_open(void) {
+
+  ipmi_client_t *client;
+
+  client = calloc(1, sizeof(*client));
+  if (client == NULL) {
+    return NULL;
+  }
+  // Connected on first use
+  client->fd = -1;
+  return client;
+}
+
 void
-lib_ipmi_handle(unsigned char *request, unsigned char req_len,
+ipmi_client_close(ipmi_client_t *client) {
+
+  if (client == NULL) {
+    return;
+  }
+  if (client->fd >= 0 && client->pid == getpid()) {
+    close(client->fd);
+  }
+  free(client);
+}
+
+/*
+ * Send a request without waiting for its response
+ */
+int
+ipmi_client_send(ipmi_client_t *client, unsigned char *request,
+            unsigned char req_len) {
+
+  if (client->pending >= IPMI_CLIENT_MAX_PENDING) {
+    return -1;
+  }
+  if (client_check(client)) {
+#ifdef DEBUG
+    syslog(LOG_WARNING, "ipmi_client_send: connect() failed\n");
+#endif
+    return -1;
+  }
+  return client_send(client, request, req_len);
+}
+
+/*
+ * Wait for the response to the oldest request not answered yet
+ */
+int
+ipmi_client_recv(ipmi_client_t *client, unsigned char *response,
+            unsigned short *res_len) {
+
+  int t;
+
+  if (client->fd < 0 || client->pending == 0) {
+    return -1;
+  }
+
+  if ((t = recv(client->fd, response, MAX_IPMI_RES_LEN, 0)) <= 0) {
+#ifdef DEBUG
+    syslog(LOG_WARNING, "ipmi_client_recv: recv() failed\n");
+#endif
+    // A late response would be taken for the next one, start over
+    client_disconnect(client);
+    return -1;
+  }
+
+  client->pending--;
+  *res_len = t;
+  return 0;
+}
+
+int
+ipmi_client_pending(ipmi_client_t *client) {
+  return client->pending;
+}
+
+static void
+client_key_init(void) {
+  pthread_key_create(&g_client_key, (void (*)(void *))ipmi_client_close);
+}
+
+/*
+ * One request per connection over the stream socket, for an ipmid that
+ * does not have the packet socket.
+ */
+static void
+ipmi_handle_oneshot(unsigned char *request, unsigned char req_len,
             unsigned char *response, unsigned short *res_len) {
 
   int s, t, len;
   struct sockaddr_un remote;
   struct timeval tv;
 
-  // TODO: Need to update to reuse the socket instead of creating new
   if ((s = socket(AF_UNIX, SOCK_STREAM, 0)) == -1) {
 #ifdef DEBUG
     syslog(LOG_WARNING, "lib_ipmi_handle: socket() failed\n");
@@ -94,3 +283,35 @@ cleanup:
 
   return;
 }
+
+/*
+ * Function to handle IPMI messages
+ *
+ * Every thread keeps its own connection to ipmid across calls, so
+ * callers on different threads are still handled in parallel.
+ */
+void
+lib_ipmi_handle(unsigned char *request, unsigned char req_len,
+            unsigned char *response, unsigned short *res_len) {
+
+  ipmi_client_t *client;
+
+  pthread_once(&g_client_once, client_key_init);
+  client = pthread_getspecific(g_client_key);
+  if (client == NULL) {
+    client = ipmi_client_open();
+    if (client != NULL && pthread_setspecific(g_client_key, client)) {
+      ipmi_client_close(client);
+      client = NULL;
+    }
+  }
+
+  if (client == NULL || client_check(client)) {
+    ipmi_handle_oneshot(request, req_len, response, res_len);
+    return;
+  }
+
+  if (client_send(client, request, req_len) == 0) {
+    ipmi_client_recv(client, response, res_len);
+  }
+}
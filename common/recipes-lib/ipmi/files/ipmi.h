@@ -28,6 +28,7 @@ extern "C" {
 #include <stdint.h>
 
 #define SOCK_PATH_IPMI "/tmp/ipmi_socket"
+#define SOCK_PATH_IPMI_SEQ "/tmp/ipmi_socket_seq"
 
 #define IPMI_SEL_VERSION  0x51
 #define IPMI_SDR_VERSION  0x51
@@ -438,6 +439,7 @@ enum
 enum
 {
   CMD_OEM_STOR_ADD_STRING_SEL = 0x30,
+  CMD_OEM_STOR_GET_SEL_RANGE = 0x31,
 };
 
 // OEM Command Codes for QC
@@ -616,6 +618,24 @@ enum RESTART_CAUSE {
 void lib_ipmi_handle(unsigned char *request, unsigned char req_len,
                  unsigned char *response, unsigned short *res_len);
 
+/*
+ * Persistent connection to ipmid, reopened as needed when ipmid restarts.
+ * Up to IPMI_CLIENT_MAX_PENDING requests may be sent before reading their
+ * responses, which come back in the order the requests were sent. A
+ * client must only be used by one thread at a time.
+ */
+#define IPMI_CLIENT_MAX_PENDING 16
+
+typedef struct ipmi_client ipmi_client_t;
+
+ipmi_client_t *ipmi_client_open(void);
+void ipmi_client_close(ipmi_client_t *client);
+int ipmi_client_send(ipmi_client_t *client, unsigned char *request,
+                 unsigned char req_len);
+int ipmi_client_recv(ipmi_client_t *client, unsigned char *response,
+                 unsigned short *res_len);
+int ipmi_client_pending(ipmi_client_t *client);
+
 #ifdef __cplusplus
 } // extern "C"
 #endif
@@ -0,0 +1,135 @@
+/*
+ * Copyright 2018-present Facebook. All Rights Reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+/*
+ * Micro-benchmark of the cache_store backends.
+ *
+ * kv-bench [iterations] [keys]
+ *
+ * Times kv_set/kv_get against the file backend and the shared-memory
+ * backend with sensor-cache sized keys and values. kv.c is built without
+ * CONFIG_KV_SHM_CACHE here, so kv_set/kv_get always go to the files, and
+ * both backends use private locations so a running system is not touched.
+ */
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include "kv.h"
+#include "kv_shm.h"
+
+extern const char *cache_store;
+
+typedef int (*bench_set_t)(char *key, char *value, size_t len);
+typedef int (*bench_get_t)(char *key, char *value, size_t *len);
+
+static int
+file_set(char *key, char *value, size_t len) {
+  return kv_set(key, value, len, 0);
+}
+
+static int
+file_get(char *key, char *value, size_t *len) {
+  return kv_get(key, value, len, 0);
+}
+
+static int
+shm_set(char *key, char *value, size_t len) {
+  return kv_shm_set(key, value, len);
+}
+
+static int
+shm_get(char *key, char *value, size_t *len) {
+  return kv_shm_get(key, value, len);
+}
+
+static uint64_t
+now_ns(void) {
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static void
+bench(const char *name, bench_set_t set, bench_get_t get, int iters, int nkeys) {
+  char key[MAX_KEY_LEN];
+  char value[MAX_VALUE_LEN];
+  size_t len;
+  uint64_t start, set_ns, get_ns;
+  int i, errs = 0;
+
+  start = now_ns();
+  for (i = 0; i < iters; i++) {
+    snprintf(key, sizeof(key), "slot%d_sensor%d", i % 4, i % nkeys);
+    snprintf(value, sizeof(value), "%.2f", i * 0.25);
+    if (set(key, value, strlen(value)) != 0) {
+      errs++;
+    }
+  }
+  set_ns = now_ns() - start;
+
+  start = now_ns();
+  for (i = 0; i < iters; i++) {
+    snprintf(key, sizeof(key), "slot%d_sensor%d", i % 4, i % nkeys);
+    if (get(key, value, &len) != 0) {
+      errs++;
+    }
+  }
+  get_ns = now_ns() - start;
+
+  printf("%-6s set: %8.2f us/op  get: %8.2f us/op  errors: %d\n", name,
+         (double)set_ns / iters / 1000, (double)get_ns / iters / 1000, errs);
+}
+
+int
+main(int argc, char *argv[]) {
+  int iters = 100000;
+  int nkeys = 256;
+  char shm_name[32], store_dir[32], store[40], cmd[48];
+
+  if (argc > 1) {
+    iters = atoi(argv[1]);
+  }
+  if (argc > 2) {
+    nkeys = atoi(argv[2]);
+  }
+  if (iters <= 0 || nkeys <= 0 || nkeys > KV_SHM_SLOTS / 2) {
+    printf("Usage: %s [iterations] [keys <= %d]\n", argv[0], KV_SHM_SLOTS / 2);
+    return -1;
+  }
+
+  snprintf(shm_name, sizeof(shm_name), "/kv-bench.%d", getpid());
+  snprintf(store_dir, sizeof(store_dir), "/tmp/kv-bench.%d", getpid());
+  snprintf(store, sizeof(store), "%s/%%s", store_dir);
+  kv_shm_name = shm_name;
+  cache_store = store;
+
+  printf("%d iterations over %d keys\n", iters, nkeys);
+  bench("file", file_set, file_get, iters, nkeys);
+  bench("shm", shm_set, shm_get, iters, nkeys);
+
+  shm_unlink(shm_name);
+  snprintf(cmd, sizeof(cmd), "rm -rf %s", store_dir);
+  system(cmd);
+  return 0;
+}
@@ -25,13 +25,23 @@
 #include <errno.h>
 #include <syslog.h>
 #include <string.h>
+#include <dirent.h>
 #include <sys/file.h>
 #include <sys/stat.h>
+#include <sys/mman.h>
 #include "kv.h"
+#ifdef CONFIG_KV_SHM_CACHE
+#include "kv_shm.h"
+#endif
+#ifdef CONFIG_KV_PERSIST_LOG
+#include "kv_log.h"
+#endif
 
 /* Used for the non-persist database */
 const char *cache_store = "/tmp/cache_store/%s";
 const char *kv_store    = "/mnt/data/kv_store/%s";
+/* Used for the log-structured persist database */
+const char *kv_log_path = "/mnt/data/kv_store.log";
 
 #ifdef DEBUG
 #ifdef __TEST__
@@ -82,6 +92,51 @@ kv_set(char *key, char *value, size_t len, unsigned int flags) {
   int rc, ret = -1;
   char kpath[MAX_KEY_PATH_LEN] = {0};
 
+#ifdef CONFIG_KV_SHM_CACHE
+  if ((flags & KV_FPERSIST) == 0) {
+    /* The key may also exist only as a file written by a script */
+    if (flags & KV_FCREATE) {
+      sprintf(kpath, cache_store, key);
+      if (kv_shm_exists(key) || access(kpath, F_OK) != -1) {
+        KV_DEBUG("kv_set: FCREATE is provided and %s already exist!\n", key);
+        return -1;
+      }
+    }
+    if (len == 0) {
+      len = strlen(value);
+    }
+    rc = kv_shm_set(key, value, len);
+    if (rc != KV_SHM_MISS) {
+      return rc;
+    }
+  }
+#endif
+
+#ifdef CONFIG_KV_PERSIST_LOG
+  if (flags & KV_FPERSIST) {
+    /* Keys from before the log still live in kv_store files */
+    if (flags & KV_FCREATE) {
+      sprintf(kpath, kv_store, key);
+      if (access(kpath, F_OK) != -1) {
+        KV_DEBUG("kv_set: FCREATE is provided and %s already exist!\n", kpath);
+        return -1;
+      }
+    }
+    if (len == 0) {
+      len = strlen(value);
+    }
+    rc = kv_log_set(key, value, len, flags);
+    if (rc == 0) {
+      /* The log now shadows the legacy file, which would go stale */
+      sprintf(kpath, kv_store, key);
+      if (unlink(kpath) < 0 && errno != ENOENT) {
+        KV_DEBUG("kv_set: failed to remove %s, err %d", kpath, errno);
+      }
+    }
+    return rc;
+  }
+#endif
+
   key_path_setup(kpath, key, flags);
 
   /* If the key already exists, and user wants to create it,
@@ -152,6 +207,24 @@ kv_get(char *key, char *value, size_t *len, unsigned int flags) {
   int rc, ret=-1;
   char kpath[MAX_KEY_PATH_LEN] = {0};
 
+#ifdef CONFIG_KV_SHM_CACHE
+  if ((flags & KV_FPERSIST) == 0) {
+    rc = kv_shm_get(key, value, len);
+    if (rc != KV_SHM_MISS) {
+      return rc;
+    }
+  }
+#endif
+
+#ifdef CONFIG_KV_PERSIST_LOG
+  if (flags & KV_FPERSIST) {
+    rc = kv_log_get(key, value, len);
+    if (rc != KV_LOG_MISS) {
+      return rc;
+    }
+  }
+#endif
+
   key_path_setup(kpath, key, flags);
 
   fp = fopen(kpath, "r");
@@ -185,20 +258,162 @@ close_bail:
   return ret;
 }
 
+/*
+*  get the values of nkeys keys in one call
+*  Value i is stored at values + i * MAX_VALUE_LEN and its length in
+*  lens[i] (lens may be NULL); status[i] is 0 or a negative error code.
+*  With CONFIG_KV_SHM_CACHE the non-persistent keys are all copied from
+*  the shared table in one pass without entering the kernel; only keys
+*  that live in a cache_store file are opened.
+*
+*  return 0 if every key was read, else the first error.
+*/
+#define KV_BULK_PENDING 1
+
+int
+kv_get_bulk(char **keys, int nkeys, char *values, size_t *lens, int *status,
+    unsigned int flags) {
+  int i, ret = 0;
+  size_t len;
+
+  if (!keys || !values || !status || nkeys < 0) {
+    return -1;
+  }
+
+  for (i = 0; i < nkeys; i++) {
+    status[i] = KV_BULK_PENDING;
+#ifdef CONFIG_KV_SHM_CACHE
+    if ((flags & KV_FPERSIST) == 0) {
+      status[i] = kv_shm_get(keys[i], values + i * MAX_VALUE_LEN, &len);
+      if (status[i] == 0 && lens) {
+        lens[i] = len;
+      }
+    }
+#endif
+  }
+
+  for (i = 0; i < nkeys; i++) {
+    if (status[i] == KV_BULK_PENDING) {
+      status[i] = kv_get(keys[i], values + i * MAX_VALUE_LEN, &len, flags);
+      if (status[i] == 0 && lens) {
+        lens[i] = len;
+      }
+    }
+    if (status[i] && !ret) {
+      ret = status[i];
+    }
+  }
+
+  return ret;
+}
+
+/*
+*  delete key
+*  With KV_FPREFIX, key is a prefix and every key starting with it is
+*  deleted.
+*
+*  return 0 on success, negative error code on failure.
+*/
+int
+kv_del(char *key, unsigned int flags) {
+  char kpath[MAX_KEY_PATH_LEN] = {0};
+  char path[MAX_KEY_PATH_LEN];
+  char *dir, *base;
+  struct dirent *ent;
+  DIR *dp;
+  int ret = 0;
+
+#ifdef CONFIG_KV_SHM_CACHE
+  if ((flags & KV_FPERSIST) == 0) {
+    if (flags & KV_FPREFIX) {
+      kv_shm_mark_prefix(key);
+    } else {
+      kv_shm_mark_file(key);
+    }
+  }
+#endif
+
+#ifdef CONFIG_KV_PERSIST_LOG
+  if ((flags & KV_FPERSIST) && kv_log_del(key, flags & KV_FPREFIX) < 0) {
+    ret = -1;
+  }
+#endif
+
+  /* Persist keys not yet in the log still have their legacy files */
+  snprintf(kpath, sizeof(kpath), (flags & KV_FPERSIST) ? kv_store : cache_store, key);
+  if (!(flags & KV_FPREFIX)) {
+    if (unlink(kpath) < 0 && errno != ENOENT) {
+      KV_DEBUG("kv_del: failed to remove %s, err %d", kpath, errno);
+      return -1;
+    }
+    return ret;
+  }
+
+  /* A prefix may end in the middle of a path component */
+  strcpy(path, kpath);
+  dir = dirname(path);
+  base = kpath + strlen(dir) + 1;
+  dp = opendir(dir);
+  if (!dp) {
+    return 0;
+  }
+  while ((ent = readdir(dp)) != NULL) {
+    if (ent->d_type == DT_DIR ||
+        strncmp(ent->d_name, base, strlen(base)) != 0) {
+      continue;
+    }
+    if (unlinkat(dirfd(dp), ent->d_name, 0) < 0 && errno != ENOENT) {
+      KV_DEBUG("kv_del: failed to remove %s/%s, err %d", dir, ent->d_name, errno);
+      ret = -1;
+    }
+  }
+  closedir(dp);
+
+  return ret;
+}
+
+/*
+*  Make persistent keys written by this process durable.
+*
+*  return 0 on success, negative error code on failure.
+*/
+int
+kv_sync(void) {
+#ifdef CONFIG_KV_PERSIST_LOG
+  return kv_log_sync();
+#else
+  sync();
+  return 0;
+#endif
+}
+
 #ifdef __TEST__
 #include <assert.h>
 int main(int argc, char *argv[])
 {
   char value[MAX_VALUE_LEN];
+#if defined(CONFIG_KV_SHM_CACHE) || defined(CONFIG_KV_PERSIST_LOG)
+  char big[MAX_VALUE_LEN * 2];
+#endif
   size_t len;
 
   cache_store = "./test/tmp/%s";
   kv_store    = "./test/persist/%s";
+  kv_log_path = "./test/persist.log";
+#ifdef CONFIG_KV_SHM_CACHE
+  kv_shm_name = "/kv_test_store";
+  shm_unlink(kv_shm_name);
+#endif
 
   assert(kv_set("test1", "val", 0, KV_FPERSIST) == 0);
   printf("SUCCESS: Creating persist key func call\n");
+#ifdef CONFIG_KV_PERSIST_LOG
+  assert(access("./test/persist.log", F_OK) == 0);
+  printf("SUCCESS: key appended to log as expected!\n");
+#else
   assert(access("./test/persist/test1", F_OK) == 0);
   printf("SUCCESS: key file created as expected!\n");
+#endif
   assert(kv_get("test1", value, NULL, KV_FPERSIST) == 0);
   printf("SUCCESS: Read of key succeeded!\n");
   assert(strcmp(value, "val") == 0);
@@ -206,8 +421,13 @@ int main(int argc, char *argv[])
 
   assert(kv_set("test1", "val", 0, 0) == 0);
   printf("SUCCESS: Creating non-persist key func call\n");
+#ifdef CONFIG_KV_SHM_CACHE
+  assert(access("./test/tmp/test1", F_OK) != 0);
+  printf("SUCCESS: key kept in shared memory as expected!\n");
+#else
   assert(access("./test/tmp/test1", F_OK) == 0);
   printf("SUCCESS: key file created as expected!\n");
+#endif
   assert(kv_get("test1", value, NULL, 0) == 0);
   printf("SUCCESS: Read of key succeeded!\n");
   assert(strcmp(value, "val") == 0);
@@ -235,6 +455,135 @@ int main(int argc, char *argv[])
   assert(strcmp(value, "val2") == 0);
   printf("SUCCESS: KV_FCREATE succeeded on non-existing key\n");
 
+  {
+    char *keys[] = {"test1", "test2", "nokey"};
+    char values[3][MAX_VALUE_LEN] = {{0}};
+    size_t lens[3];
+    int status[3];
+
+    assert(kv_get_bulk(keys, 3, values[0], lens, status, 0) != 0);
+    assert(status[0] == 0 && strcmp(values[0], "val") == 0 && lens[0] == 3);
+    assert(status[1] == 0 && strcmp(values[1], "val2") == 0 && lens[1] == 4);
+    assert(status[2] != 0);
+    printf("SUCCESS: kv_get_bulk read the existing keys\n");
+  }
+
+  assert(kv_sync() == 0);
+  printf("SUCCESS: kv_sync\n");
+
+  {
+    kv_watch_t *w = kv_watch("test2", 0);
+    kv_watch_t *wp = kv_watch("test6", KV_FPERSIST);
+
+    assert(w && wp);
+    assert(kv_changed(w) && kv_changed(wp));
+    assert(!kv_changed(w) && !kv_changed(wp));
+    assert(kv_set("test2", "val3", 0, 0) == 0);
+    assert(kv_changed(w) && !kv_changed(w));
+    assert(!kv_changed(wp));
+    assert(kv_set("test6", "vb", 0, KV_FPERSIST) == 0);
+    assert(kv_changed(wp) && !kv_changed(wp));
+    kv_unwatch(w);
+    kv_unwatch(wp);
+    printf("SUCCESS: kv_changed follows writes\n");
+  }
+
+#ifdef CONFIG_KV_PERSIST_LOG
+  {
+    int fd, i;
+
+    for (i = 0; i < 4096; i++) {
+      snprintf(value, sizeof(value), "%d", i);
+      assert(kv_set("test4", value, 0, KV_FPERSIST) == 0);
+    }
+    memset(value, 0, sizeof(value));
+    assert(kv_get("test4", value, NULL, KV_FPERSIST) == 0);
+    assert(strcmp(value, "4095") == 0);
+    memset(value, 0, sizeof(value));
+    assert(kv_get("test1", value, NULL, KV_FPERSIST) == 0);
+    assert(strcmp(value, "va") == 0);
+    printf("SUCCESS: Log compaction kept the latest values\n");
+
+    /* Simulate a power cut in the middle of an append */
+    fd = open("./test/persist.log", O_WRONLY | O_APPEND);
+    assert(fd >= 0);
+    assert(write(fd, "KVLG\x01\x02", 6) == 6);
+    close(fd);
+    assert(kv_set("test5", "after", 0, KV_FPERSIST) == 0);
+    memset(value, 0, sizeof(value));
+    assert(kv_get("test5", value, NULL, KV_FPERSIST) == 0);
+    assert(strcmp(value, "after") == 0);
+    memset(value, 0, sizeof(value));
+    assert(kv_get("test4", value, NULL, KV_FPERSIST) == 0);
+    assert(strcmp(value, "4095") == 0);
+    printf("SUCCESS: Torn record dropped, last good values recovered\n");
+
+    /* Keys from before the log are read from, then replaced by, the log */
+    fd = open("./test/persist/test7", O_WRONLY | O_CREAT, 0644);
+    assert(fd >= 0);
+    assert(write(fd, "old", 3) == 3);
+    close(fd);
+    memset(value, 0, sizeof(value));
+    assert(kv_get("test7", value, NULL, KV_FPERSIST) == 0);
+    assert(strcmp(value, "old") == 0);
+    assert(kv_set("test7", "new", 0, KV_FPERSIST) == 0);
+    assert(access("./test/persist/test7", F_OK) != 0);
+    memset(value, 0, sizeof(value));
+    assert(kv_get("test7", value, NULL, KV_FPERSIST) == 0);
+    assert(strcmp(value, "new") == 0);
+    printf("SUCCESS: Legacy key file removed on its first log write\n");
+
+    memset(big, 'x', sizeof(big));
+    assert(kv_set("test8", big, MAX_VALUE_LEN + 1, KV_FPERSIST) != 0);
+    printf("SUCCESS: Value longer than kv_get can return rejected\n");
+  }
+#endif
+
+#ifdef CONFIG_KV_SHM_CACHE
+  assert(access("./test/tmp/test2", F_OK) != 0);
+  printf("SUCCESS: KV_FCREATE key kept in shared memory\n");
+
+  memset(big, 'x', sizeof(big));
+  assert(kv_set("test3", big, sizeof(big), 0) == 0);
+  assert(access("./test/tmp/test3", F_OK) == 0);
+  assert(kv_get("test3", value, &len, 0) == 0);
+  assert(len == MAX_VALUE_LEN);
+  printf("SUCCESS: Oversized value fell back to file\n");
+
+  assert(kv_set("test3", "short", 0, 0) == 0);
+  memset(value, 0, sizeof(value));
+  assert(kv_get("test3", value, NULL, 0) == 0);
+  assert(strcmp(value, "short") == 0);
+  printf("SUCCESS: Key moved back into shared memory\n");
+  shm_unlink(kv_shm_name);
+#endif
+
+  assert(kv_set("slot9_a", "1", 0, 0) == 0);
+  assert(kv_set("slot9_b", "2", 0, 0) == 0);
+  assert(kv_set("slot10_a", "3", 0, 0) == 0);
+  assert(kv_del("slot9_", KV_FPREFIX) == 0);
+  assert(kv_get("slot9_a", value, NULL, 0) != 0);
+  assert(kv_get("slot9_b", value, NULL, 0) != 0);
+  assert(kv_get("slot10_a", value, NULL, 0) == 0);
+  assert(kv_del("slot10_a", 0) == 0);
+  assert(kv_get("slot10_a", value, NULL, 0) != 0);
+  assert(kv_set("slot9_a", "4", 0, 0) == 0);
+  memset(value, 0, sizeof(value));
+  assert(kv_get("slot9_a", value, NULL, 0) == 0);
+  assert(strcmp(value, "4") == 0);
+  printf("SUCCESS: kv_del removed keys and they can be set again\n");
+
+  assert(kv_set("sys_config/fru9_a", "1", 0, KV_FPERSIST) == 0);
+  assert(kv_set("sys_config/fru9_b", "2", 0, KV_FPERSIST) == 0);
+  assert(kv_set("sys_config/fru10_a", "3", 0, KV_FPERSIST) == 0);
+  assert(kv_del("sys_config/fru9_", KV_FPERSIST | KV_FPREFIX) == 0);
+  assert(kv_get("sys_config/fru9_a", value, NULL, KV_FPERSIST) != 0);
+  assert(kv_get("sys_config/fru9_b", value, NULL, KV_FPERSIST) != 0);
+  assert(kv_get("sys_config/fru10_a", value, NULL, KV_FPERSIST) == 0);
+  assert(kv_del("sys_config/fru10_a", KV_FPERSIST) == 0);
+  assert(kv_get("sys_config/fru10_a", value, NULL, KV_FPERSIST) != 0);
+  printf("SUCCESS: kv_del removed persist keys\n");
+
   system("rm -rf ./test");
 
   return 0;
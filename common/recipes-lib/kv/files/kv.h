@@ -41,8 +41,25 @@ extern "C" {
 /* Will set the key:value only if the key does not already exist */
 #define KV_FCREATE        (1 << 1)
 
+/* kv_watch only: key is the path of a plain file outside the databases */
+#define KV_FPATH          (1 << 2)
+
+/* kv_del only: key is a prefix, all keys starting with it are deleted */
+#define KV_FPREFIX        (1 << 3)
+
+/* Handle returned by kv_watch() */
+typedef struct kv_watch kv_watch_t;
+
 int kv_get(char *key, char *value, size_t *len, unsigned int flags);
+int kv_get_bulk(char **keys, int nkeys, char *values, size_t *lens,
+                int *status, unsigned int flags);
 int kv_set(char *key, char *value, size_t len, unsigned int flags);
+int kv_del(char *key, unsigned int flags);
+int kv_sync(void);
+
+kv_watch_t *kv_watch(const char *key, unsigned int flags);
+int kv_changed(kv_watch_t *w);
+void kv_unwatch(kv_watch_t *w);
 
 #ifdef __cplusplus
 }
@@ -23,18 +23,22 @@ lkv_hndl = ctypes.CDLL("libkv.so")
 
 FPERSIST = 1
 FCREATE = 2
+FPREFIX = 8
 
 
 class KeyOperationFailure(Exception):
     pass
 
 
-def kv_get(key, flags=0):
+def kv_get(key, flags=0, binary=False):
     key_c = ctypes.create_string_buffer(key.encode())
     value = ctypes.create_string_buffer(64)
-    ret = lkv_hndl.kv_get(key_c, value, 0, ctypes.c_uint(flags))
+    len_c = ctypes.c_size_t(0)
+    ret = lkv_hndl.kv_get(key_c, value, ctypes.byref(len_c), ctypes.c_uint(flags))
     if (ret != 0):
         raise KeyOperationFailure
+    if binary:
+        return value.raw[:len_c.value]
     return value.value.decode()
 
 
@@ -44,3 +48,16 @@ def kv_set(key, value, flags=0):
     ret = lkv_hndl.kv_set(key_c, value_c, 0, ctypes.c_uint(flags))
     if (ret != 0):
         raise KeyOperationFailure
+
+
+def kv_del(key, flags=0):
+    key_c = ctypes.create_string_buffer(key.encode())
+    ret = lkv_hndl.kv_del(key_c, ctypes.c_uint(flags))
+    if (ret != 0):
+        raise KeyOperationFailure
+
+
+def kv_sync():
+    ret = lkv_hndl.kv_sync()
+    if (ret != 0):
+        raise KeyOperationFailure
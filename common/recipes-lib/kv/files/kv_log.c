@@ -0,0 +1,655 @@
+/*
+ * Copyright 2018-present Facebook. All Rights Reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <libgen.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <syslog.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+#include <sys/file.h>
+#include <sys/stat.h>
+#include "kv_log.h"
+
+extern const char *kv_log_path;
+void mkdir_recurse(char *dir, mode_t mode);
+
+typedef struct kv_log_ent {
+  struct kv_log_ent *next;
+  uint16_t klen;
+  uint16_t vlen;
+  char key[MAX_KEY_LEN];
+  char *value;
+} kv_log_ent_t;
+
+static pthread_mutex_t g_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_once_t g_exit_once = PTHREAD_ONCE_INIT;
+static int g_fd = -1;
+static ino_t g_ino;
+static off_t g_off;           /* Log replayed up to here */
+static off_t g_live;          /* Bytes the live records would take */
+static int g_dirty;
+static int g_flush_pending;   /* A flusher thread is waiting */
+static uint64_t g_last_sync;
+static kv_log_ent_t *g_index[KV_LOG_BUCKETS];
+
+static uint32_t g_crc_table[256];
+static pthread_once_t g_crc_once = PTHREAD_ONCE_INIT;
+
+static void
+crc32_init(void) {
+  uint32_t c;
+  int i, j;
+
+  for (i = 0; i < 256; i++) {
+    c = i;
+    for (j = 0; j < 8; j++) {
+      c = (c & 1) ? (0xEDB88320 ^ (c >> 1)) : (c >> 1);
+    }
+    g_crc_table[i] = c;
+  }
+}
+
+static uint32_t
+crc32_update(uint32_t crc, const void *buf, size_t len) {
+  const uint8_t *p = buf;
+
+  pthread_once(&g_crc_once, crc32_init);
+  crc = ~crc;
+  while (len--) {
+    crc = g_crc_table[(crc ^ *p++) & 0xFF] ^ (crc >> 8);
+  }
+  return ~crc;
+}
+
+/* Bytes of value following the key; tombstones have none */
+static size_t
+rec_vbytes(uint16_t vlen) {
+  return vlen == KV_LOG_TOMBSTONE ? 0 : vlen;
+}
+
+static uint32_t
+rec_crc(const kv_log_rec_t *rec, const char *key, const char *value) {
+  uint32_t crc;
+
+  crc = crc32_update(0, &rec->klen, sizeof(rec->klen) + sizeof(rec->vlen));
+  crc = crc32_update(crc, key, rec->klen);
+  return crc32_update(crc, value, rec_vbytes(rec->vlen));
+}
+
+static uint64_t
+now_ms(void) {
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+static uint32_t
+key_bucket(const char *key, size_t klen) {
+  uint32_t h = 2166136261u;
+
+  while (klen--) {
+    h ^= (uint8_t)*key++;
+    h *= 16777619u;
+  }
+  return h % KV_LOG_BUCKETS;
+}
+
+static kv_log_ent_t *
+index_find(const char *key, size_t klen) {
+  kv_log_ent_t *ent;
+
+  for (ent = g_index[key_bucket(key, klen)]; ent; ent = ent->next) {
+    if (ent->klen == klen && !memcmp(ent->key, key, klen)) {
+      return ent;
+    }
+  }
+  return NULL;
+}
+
+static int
+index_put(const char *key, size_t klen, const char *value, size_t vlen) {
+  kv_log_ent_t *ent = index_find(key, klen);
+  uint32_t b;
+  char *v;
+
+  v = malloc(vlen ? vlen : 1);
+  if (!v) {
+    return -1;
+  }
+  memcpy(v, value, vlen);
+
+  if (ent) {
+    g_live -= sizeof(kv_log_rec_t) + ent->klen + ent->vlen;
+    free(ent->value);
+  } else {
+    ent = calloc(1, sizeof(*ent));
+    if (!ent) {
+      free(v);
+      return -1;
+    }
+    memcpy(ent->key, key, klen);
+    ent->klen = klen;
+    b = key_bucket(key, klen);
+    ent->next = g_index[b];
+    g_index[b] = ent;
+  }
+  ent->value = v;
+  ent->vlen = vlen;
+  g_live += sizeof(kv_log_rec_t) + klen + vlen;
+  return 0;
+}
+
+static void
+index_remove(const char *key, size_t klen) {
+  kv_log_ent_t **pp, *ent;
+
+  for (pp = &g_index[key_bucket(key, klen)]; (ent = *pp) != NULL; pp = &ent->next) {
+    if (ent->klen == klen && !memcmp(ent->key, key, klen)) {
+      *pp = ent->next;
+      g_live -= sizeof(kv_log_rec_t) + ent->klen + ent->vlen;
+      free(ent->value);
+      free(ent);
+      return;
+    }
+  }
+}
+
+static void
+index_clear(void) {
+  kv_log_ent_t *ent, *next;
+  int i;
+
+  for (i = 0; i < KV_LOG_BUCKETS; i++) {
+    for (ent = g_index[i]; ent; ent = next) {
+      next = ent->next;
+      free(ent->value);
+      free(ent);
+    }
+    g_index[i] = NULL;
+  }
+  g_live = 0;
+}
+
+static void
+log_close(void) {
+  if (g_fd >= 0) {
+    close(g_fd);
+    g_fd = -1;
+  }
+  g_off = 0;
+  index_clear();
+}
+
+static void
+log_exit_sync(void) {
+  kv_log_sync();
+}
+
+static void
+log_atfork_child(void) {
+  /* The flusher thread did not come along */
+  g_flush_pending = 0;
+}
+
+static void
+log_register_exit(void) {
+  atexit(log_exit_sync);
+  pthread_atfork(NULL, NULL, log_atfork_child);
+}
+
+/* Sync the tail of a burst once its commit window is over */
+static void *
+log_flusher(void *arg) {
+  uint64_t due = (uintptr_t)arg;
+  uint64_t now = now_ms();
+  struct timespec ts;
+
+  if (due > now) {
+    ts.tv_sec = (due - now) / 1000;
+    ts.tv_nsec = ((due - now) % 1000) * 1000000;
+    nanosleep(&ts, NULL);
+  }
+
+  pthread_mutex_lock(&g_mutex);
+  g_flush_pending = 0;
+  pthread_mutex_unlock(&g_mutex);
+  kv_log_sync();
+  return NULL;
+}
+
+/* Make sure a write left dirty in the page cache is synced later. Mutex held. */
+static void
+log_schedule_flush(void) {
+  pthread_attr_t attr;
+  pthread_t tid;
+  uint64_t due = g_last_sync + KV_LOG_COMMIT_MS;
+
+  if (g_flush_pending) {
+    return;
+  }
+  pthread_attr_init(&attr);
+  pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+  if (pthread_create(&tid, &attr, log_flusher, (void *)(uintptr_t)due) == 0) {
+    g_flush_pending = 1;
+  } else {
+    /* No thread, no deferral */
+    fdatasync(g_fd);
+    g_last_sync = now_ms();
+    g_dirty = 0;
+  }
+  pthread_attr_destroy(&attr);
+}
+
+static int
+log_open(void) {
+  char dir[MAX_KEY_PATH_LEN];
+  struct stat st;
+
+  log_close();
+
+  strncpy(dir, kv_log_path, sizeof(dir) - 1);
+  dir[sizeof(dir) - 1] = '\0';
+  mkdir_recurse(dirname(dir), 0777);
+
+  g_fd = open(kv_log_path, O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+  if (g_fd < 0) {
+    syslog(LOG_WARNING, "kv_log: failed to open %s, errno=%d", kv_log_path, errno);
+    return -1;
+  }
+  if (fstat(g_fd, &st) < 0) {
+    log_close();
+    return -1;
+  }
+  g_ino = st.st_ino;
+  pthread_once(&g_exit_once, log_register_exit);
+  return 0;
+}
+
+/*
+ * Bring the index up to date with the log, reopening it if it was
+ * replaced by a compaction. *torn is set if the log ends with a record
+ * which is incomplete or fails its CRC; this is a write in progress unless
+ * the caller holds the log lock.
+ */
+static int
+log_replay(int *torn) {
+  struct stat st;
+  kv_log_rec_t rec;
+  char *buf, *p, *key, *value;
+  off_t size, pos;
+  ssize_t rc;
+
+  *torn = 0;
+  if (g_fd < 0 || stat(kv_log_path, &st) < 0 || st.st_ino != g_ino) {
+    if (log_open() < 0) {
+      return -1;
+    }
+  }
+  if (fstat(g_fd, &st) < 0) {
+    return -1;
+  }
+
+  size = st.st_size;
+  if (size < g_off) {
+    /* Tail was truncated under us, start over */
+    g_off = 0;
+    index_clear();
+  }
+  if (size == g_off) {
+    return 0;
+  }
+
+  buf = malloc(size - g_off);
+  if (!buf) {
+    return -1;
+  }
+  rc = pread(g_fd, buf, size - g_off, g_off);
+  if (rc < 0) {
+    free(buf);
+    return -1;
+  }
+
+  pos = 0;
+  while (pos + (off_t)sizeof(rec) <= rc) {
+    p = buf + pos;
+    memcpy(&rec, p, sizeof(rec));
+    if (rec.magic != KV_LOG_MAGIC || rec.klen == 0 || rec.klen >= MAX_KEY_LEN ||
+        (rec.vlen > KV_LOG_MAX_VALUE && rec.vlen != KV_LOG_TOMBSTONE) ||
+        pos + (off_t)(sizeof(rec) + rec.klen + rec_vbytes(rec.vlen)) > rc) {
+      break;
+    }
+    key = p + sizeof(rec);
+    value = key + rec.klen;
+    if (rec_crc(&rec, key, value) != rec.crc) {
+      break;
+    }
+    if (rec.vlen == KV_LOG_TOMBSTONE) {
+      index_remove(key, rec.klen);
+    } else if (index_put(key, rec.klen, value, rec.vlen) < 0) {
+      break;
+    }
+    pos += sizeof(rec) + rec.klen + rec_vbytes(rec.vlen);
+  }
+  free(buf);
+
+  g_off += pos;
+  if (g_off != size) {
+    *torn = 1;
+  }
+  return 0;
+}
+
+/* Take the log lock, making sure it is on the file currently at the path */
+static int
+log_lock(void) {
+  struct stat st;
+  int torn;
+
+  for (;;) {
+    if (log_replay(&torn) < 0) {
+      return -1;
+    }
+    if (flock(g_fd, LOCK_EX) < 0) {
+      return -1;
+    }
+    if (stat(kv_log_path, &st) == 0 && st.st_ino == g_ino) {
+      break;
+    }
+    flock(g_fd, LOCK_UN);
+    log_close();
+  }
+
+  if (log_replay(&torn) < 0) {
+    flock(g_fd, LOCK_UN);
+    return -1;
+  }
+  if (torn) {
+    /* Nobody else is writing, so this is left over from a crash */
+    syslog(LOG_WARNING, "kv_log: dropping torn tail of %s at %ld",
+           kv_log_path, (long)g_off);
+    if (ftruncate(g_fd, g_off) < 0) {
+      flock(g_fd, LOCK_UN);
+      return -1;
+    }
+  }
+  return 0;
+}
+
+static int
+log_fill_rec(char *buf, const char *key, size_t klen, const char *value, size_t vlen) {
+  kv_log_rec_t rec;
+
+  rec.magic = KV_LOG_MAGIC;
+  rec.klen = klen;
+  rec.vlen = vlen;
+  rec.crc = rec_crc(&rec, key, value);
+  memcpy(buf, &rec, sizeof(rec));
+  memcpy(buf + sizeof(rec), key, klen);
+  memcpy(buf + sizeof(rec) + klen, value, rec_vbytes(vlen));
+  return sizeof(rec) + klen + rec_vbytes(vlen);
+}
+
+/* Rewrite the live records into a new log and swap it in. Lock held. */
+static int
+log_compact(void) {
+  char tmp[MAX_KEY_PATH_LEN + 8];
+  char dir[MAX_KEY_PATH_LEN];
+  kv_log_ent_t *ent;
+  struct stat st;
+  char *buf;
+  off_t pos = 0;
+  int fd, dfd, i;
+
+  buf = malloc(g_live);
+  if (!buf) {
+    return -1;
+  }
+  for (i = 0; i < KV_LOG_BUCKETS; i++) {
+    for (ent = g_index[i]; ent; ent = ent->next) {
+      pos += log_fill_rec(buf + pos, ent->key, ent->klen, ent->value, ent->vlen);
+    }
+  }
+
+  snprintf(tmp, sizeof(tmp), "%s.tmp", kv_log_path);
+  fd = open(tmp, O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+  if (fd < 0) {
+    free(buf);
+    return -1;
+  }
+  if (write(fd, buf, pos) != pos || fdatasync(fd) < 0 || fstat(fd, &st) < 0 ||
+      rename(tmp, kv_log_path) < 0) {
+    syslog(LOG_WARNING, "kv_log: compaction of %s failed, errno=%d", kv_log_path, errno);
+    close(fd);
+    unlink(tmp);
+    free(buf);
+    return -1;
+  }
+  free(buf);
+
+  strncpy(dir, kv_log_path, sizeof(dir) - 1);
+  dir[sizeof(dir) - 1] = '\0';
+  dfd = open(dirname(dir), O_RDONLY | O_DIRECTORY);
+  if (dfd >= 0) {
+    fsync(dfd);
+    close(dfd);
+  }
+
+  /* Waiters on the old lock notice the new inode and retry there */
+  flock(g_fd, LOCK_UN);
+  close(g_fd);
+  g_fd = fd;
+  g_ino = st.st_ino;
+  g_off = pos;
+  g_dirty = 0;
+  g_last_sync = now_ms();
+  return 0;
+}
+
+/*
+ * Look up key in the log.
+ *
+ * return 0 on success, KV_LOG_MISS if the key was never written to the
+ * log, negative error code on failure.
+ */
+int
+kv_log_get(const char *key, char *value, size_t *len) {
+  kv_log_ent_t *ent;
+  size_t klen = strlen(key);
+  size_t vlen;
+  int torn, ret = KV_LOG_MISS;
+
+  if (klen == 0 || klen >= MAX_KEY_LEN) {
+    return -1;
+  }
+
+  pthread_mutex_lock(&g_mutex);
+  if (log_replay(&torn) < 0) {
+    pthread_mutex_unlock(&g_mutex);
+    return KV_LOG_MISS;
+  }
+  ent = index_find(key, klen);
+  if (ent) {
+    vlen = ent->vlen;
+    memcpy(value, ent->value, vlen);
+    if (len) {
+      *len = vlen;
+    }
+    ret = 0;
+  }
+  pthread_mutex_unlock(&g_mutex);
+  return ret;
+}
+
+/* Append n bytes at the end of the log. Lock held. */
+static int
+log_append(const char *buf, int n) {
+  if (pwrite(g_fd, buf, n, g_off) != n) {
+    syslog(LOG_WARNING, "kv_log: append to %s failed, errno=%d", kv_log_path, errno);
+    if (ftruncate(g_fd, g_off) < 0) {
+      syslog(LOG_WARNING, "kv_log: failed to roll back %s", kv_log_path);
+    }
+    return -1;
+  }
+  g_off += n;
+  g_dirty = 1;
+  return 0;
+}
+
+/* Compact the log or get the appends to flash, and drop the lock */
+static void
+log_commit(void) {
+  uint64_t now;
+
+  if (g_off > KV_LOG_COMPACT_MIN && g_off > 2 * g_live) {
+    if (log_compact() == 0) {
+      return;
+    }
+  }
+
+  /* Group commit: the first write after a quiet window goes to flash right
+   * away, later ones ride along with the flush at the end of the window */
+  now = now_ms();
+  if (now - g_last_sync >= KV_LOG_COMMIT_MS) {
+    fdatasync(g_fd);
+    g_last_sync = now;
+    g_dirty = 0;
+  } else {
+    log_schedule_flush();
+  }
+  flock(g_fd, LOCK_UN);
+}
+
+/*
+ * Append key::value to the log.
+ *
+ * return 0 on success, negative error code on failure.
+ */
+int
+kv_log_set(const char *key, const char *value, size_t len, unsigned int flags) {
+  char buf[sizeof(kv_log_rec_t) + MAX_KEY_LEN + KV_LOG_MAX_VALUE];
+  size_t klen = strlen(key);
+  int n, ret = -1;
+
+  if (klen == 0 || klen >= MAX_KEY_LEN) {
+    return -1;
+  }
+  if (len > KV_LOG_MAX_VALUE) {
+    syslog(LOG_WARNING, "kv_log: value of %s is %zu bytes, limit is %d",
+           key, len, KV_LOG_MAX_VALUE);
+    return -1;
+  }
+
+  pthread_mutex_lock(&g_mutex);
+  if (log_lock() < 0) {
+    goto bail;
+  }
+
+  if ((flags & KV_FCREATE) && index_find(key, klen)) {
+    flock(g_fd, LOCK_UN);
+    goto bail;
+  }
+
+  n = log_fill_rec(buf, key, klen, value, len);
+  if (log_append(buf, n) < 0) {
+    flock(g_fd, LOCK_UN);
+    goto bail;
+  }
+  ret = 0;
+  if (index_put(key, klen, value, len) < 0) {
+    /* Still in the log, the next replay picks it up */
+    log_close();
+    goto bail;
+  }
+  log_commit();
+
+bail:
+  pthread_mutex_unlock(&g_mutex);
+  return ret;
+}
+
+/*
+ * Append a tombstone for key, or with prefix set for every key in the
+ * log starting with it.
+ *
+ * return 0 on success, negative error code on failure.
+ */
+int
+kv_log_del(const char *key, int prefix) {
+  char buf[sizeof(kv_log_rec_t) + MAX_KEY_LEN];
+  kv_log_ent_t *ent, *next;
+  size_t klen = strlen(key);
+  int i, n, dirty = 0, ret = -1;
+
+  if (klen == 0 || klen >= MAX_KEY_LEN) {
+    return -1;
+  }
+
+  pthread_mutex_lock(&g_mutex);
+  if (log_lock() < 0) {
+    goto bail;
+  }
+
+  ret = 0;
+  for (i = 0; i < KV_LOG_BUCKETS && ret == 0; i++) {
+    for (ent = g_index[i]; ent; ent = next) {
+      next = ent->next;
+      if (prefix ? (ent->klen < klen || memcmp(ent->key, key, klen)) :
+                   (ent->klen != klen || memcmp(ent->key, key, klen))) {
+        continue;
+      }
+      n = log_fill_rec(buf, ent->key, ent->klen, "", KV_LOG_TOMBSTONE);
+      if (log_append(buf, n) < 0) {
+        ret = -1;
+        break;
+      }
+      index_remove(ent->key, ent->klen);
+      dirty = 1;
+    }
+  }
+  if (dirty) {
+    log_commit();
+  } else {
+    flock(g_fd, LOCK_UN);
+  }
+
+bail:
+  pthread_mutex_unlock(&g_mutex);
+  return ret;
+}
+
+/* Flush pending appends to flash */
+int
+kv_log_sync(void) {
+  int ret = 0;
+
+  pthread_mutex_lock(&g_mutex);
+  if (g_fd >= 0 && g_dirty) {
+    ret = fdatasync(g_fd);
+    g_last_sync = now_ms();
+    g_dirty = 0;
+  }
+  pthread_mutex_unlock(&g_mutex);
+  return ret;
+}
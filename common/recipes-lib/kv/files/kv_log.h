@@ -0,0 +1,63 @@
+/*
+ * Copyright 2018-present Facebook. All Rights Reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+#ifndef __KV_LOG_H__
+#define __KV_LOG_H__
+
+/*
+ * Log-structured backend for the persistent (kv_store) database.
+ *
+ * Every kv_set appends one CRC protected record to a single log file under
+ * flock. Appends land in the page cache right away, so other processes see
+ * them, but the log is only fdatasync'ed once per commit window, letting
+ * writes in the same window reach flash together. A write which falls
+ * inside a window is synced by a short-lived thread when the window ends,
+ * or earlier by kv_sync() or process exit.
+ * A delete appends a tombstone record, which has no value.
+ * On load, records are replayed up to the first torn or corrupt one, so
+ * the last good value of every key survives a power cut. Once the log has
+ * grown well past its live data it is compacted into a new file which
+ * atomically replaces the old one.
+ */
+
+#include <stdint.h>
+#include "kv.h"
+
+#define KV_LOG_MAGIC        0x4B564C47  /* "KVLG" */
+#define KV_LOG_COMMIT_MS    1000        /* Group commit window */
+#define KV_LOG_COMPACT_MIN  (64 * 1024) /* Never compact below this size */
+#define KV_LOG_BUCKETS      256
+#define KV_LOG_MAX_VALUE    MAX_VALUE_LEN /* What kv_get can return */
+#define KV_LOG_TOMBSTONE    0xFFFF      /* vlen of a delete record */
+
+typedef struct {
+  uint32_t magic;
+  uint32_t crc;       /* Over klen, vlen, key and value */
+  uint16_t klen;
+  uint16_t vlen;
+} kv_log_rec_t;
+
+/* Return values of kv_log_get besides 0 */
+#define KV_LOG_MISS         1   /* Not in the log, try the legacy file */
+
+int kv_log_get(const char *key, char *value, size_t *len);
+int kv_log_set(const char *key, const char *value, size_t len, unsigned int flags);
+int kv_log_del(const char *key, int prefix);
+int kv_log_sync(void);
+
+#endif /* __KV_LOG_H__ */
@@ -0,0 +1,356 @@
+/*
+ * Copyright 2018-present Facebook. All Rights Reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <sched.h>
+#include <syslog.h>
+#include <string.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "kv_shm.h"
+
+/* Bounded spins before a reader gives up or a writer takes over a slot
+ * left busy by a process that died in the middle of an update */
+#define KV_SHM_READ_RETRY   1000
+#define KV_SHM_WRITE_SPIN   10000
+
+const char *kv_shm_name = KV_SHM_NAME;
+
+static kv_shm_table_t *g_table = NULL;
+static pthread_once_t g_table_once = PTHREAD_ONCE_INIT;
+
+static void
+kv_shm_map(void) {
+  int fd;
+  struct stat st;
+  void *addr;
+  uint32_t magic = 0;
+
+  fd = shm_open(kv_shm_name, O_RDWR | O_CREAT, 0666);
+  if (fd < 0) {
+    syslog(LOG_WARNING, "kv_shm: shm_open failed, errno=%d", errno);
+    return;
+  }
+  /* Do not let the umask of whoever comes first lock others out */
+  fchmod(fd, 0666);
+
+  if (fstat(fd, &st) < 0) {
+    syslog(LOG_WARNING, "kv_shm: fstat failed, errno=%d", errno);
+    close(fd);
+    return;
+  }
+
+  /* A zero-filled table is a valid empty table, so concurrent
+   * initialization by several processes is harmless */
+  if (st.st_size < (off_t)sizeof(kv_shm_table_t) &&
+      ftruncate(fd, sizeof(kv_shm_table_t)) < 0) {
+    syslog(LOG_WARNING, "kv_shm: ftruncate failed, errno=%d", errno);
+    close(fd);
+    return;
+  }
+
+  addr = mmap(NULL, sizeof(kv_shm_table_t), PROT_READ | PROT_WRITE,
+              MAP_SHARED, fd, 0);
+  close(fd);
+  if (addr == MAP_FAILED) {
+    syslog(LOG_WARNING, "kv_shm: mmap failed, errno=%d", errno);
+    return;
+  }
+
+  g_table = (kv_shm_table_t *)addr;
+  if (__atomic_compare_exchange_n(&g_table->magic, &magic, KV_SHM_MAGIC, 0,
+                                  __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+    g_table->version = KV_SHM_VERSION;
+    g_table->nslots = KV_SHM_SLOTS;
+  } else if (magic != KV_SHM_MAGIC) {
+    syslog(LOG_WARNING, "kv_shm: bad magic 0x%x, disabled", magic);
+    munmap(addr, sizeof(kv_shm_table_t));
+    g_table = NULL;
+  }
+}
+
+static kv_shm_table_t *
+kv_shm_table(void) {
+  pthread_once(&g_table_once, kv_shm_map);
+  return g_table;
+}
+
+/* FNV-1a */
+static uint32_t
+kv_shm_hash(const char *key) {
+  uint32_t h = 2166136261u;
+
+  while (*key) {
+    h ^= (uint8_t)*key++;
+    h *= 16777619u;
+  }
+  return h;
+}
+
+static kv_shm_slot_t *
+kv_shm_find(kv_shm_table_t *tbl, const char *key, int create) {
+  uint32_t hash = kv_shm_hash(key);
+  uint32_t i, idx, state;
+  kv_shm_slot_t *slot;
+  int spin;
+
+  for (i = 0; i < KV_SHM_SLOTS; i++) {
+    idx = (hash + i) & (KV_SHM_SLOTS - 1);
+    slot = &tbl->slots[idx];
+    state = __atomic_load_n(&slot->state, __ATOMIC_ACQUIRE);
+
+    if (state == KV_SHM_EMPTY) {
+      if (!create) {
+        return NULL;
+      }
+      if (__atomic_compare_exchange_n(&slot->state, &state, KV_SHM_CLAIMED,
+                                      0, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+        slot->hash = hash;
+        strncpy(slot->key, key, MAX_KEY_LEN - 1);
+        slot->flags = KV_SHM_FFILE;  /* No value until the first write */
+        __atomic_store_n(&slot->state, KV_SHM_USED, __ATOMIC_RELEASE);
+        return slot;
+      }
+      /* Lost the race; state now holds what the winner stored */
+    }
+
+    /* Someone is inserting here; it may be the same key */
+    for (spin = 0; state == KV_SHM_CLAIMED && spin < KV_SHM_WRITE_SPIN; spin++) {
+      sched_yield();
+      state = __atomic_load_n(&slot->state, __ATOMIC_ACQUIRE);
+    }
+
+    if (state == KV_SHM_USED && slot->hash == hash &&
+        strncmp(slot->key, key, MAX_KEY_LEN) == 0) {
+      return slot;
+    }
+  }
+
+  return NULL;
+}
+
+static uint32_t
+kv_shm_write_begin(kv_shm_slot_t *slot) {
+  uint32_t seq = __atomic_load_n(&slot->seq, __ATOMIC_RELAXED);
+  int spin;
+
+  for (spin = 0; spin < KV_SHM_WRITE_SPIN; spin++) {
+    if (!(seq & 1) &&
+        __atomic_compare_exchange_n(&slot->seq, &seq, seq + 1, 0,
+                                    __ATOMIC_ACQUIRE, __ATOMIC_RELAXED)) {
+      return seq + 1;
+    }
+    sched_yield();
+    seq = __atomic_load_n(&slot->seq, __ATOMIC_RELAXED);
+  }
+
+  /* The previous writer never finished; take the slot over */
+  syslog(LOG_WARNING, "kv_shm: taking over stale slot %s", slot->key);
+  seq |= 1;
+  __atomic_store_n(&slot->seq, seq, __ATOMIC_RELAXED);
+  __atomic_thread_fence(__ATOMIC_RELEASE);
+  return seq;
+}
+
+static void
+kv_shm_write_end(kv_shm_slot_t *slot, uint32_t seq) {
+  __atomic_store_n(&slot->seq, seq + 1, __ATOMIC_RELEASE);
+}
+
+/*
+ * Look up key in the shared table.
+ *
+ * return 0 on success, KV_SHM_MISS if the value is not held in the
+ * table, negative error code on failure.
+ */
+int
+kv_shm_get(const char *key, char *value, size_t *len) {
+  kv_shm_table_t *tbl = kv_shm_table();
+  kv_shm_slot_t *slot;
+  uint32_t seq1, seq2;
+  uint16_t vlen, flags;
+  int retry;
+
+  if (!tbl || strlen(key) >= MAX_KEY_LEN) {
+    return KV_SHM_MISS;
+  }
+
+  slot = kv_shm_find(tbl, key, 0);
+  if (!slot) {
+    return KV_SHM_MISS;
+  }
+
+  for (retry = 0; retry < KV_SHM_READ_RETRY; retry++) {
+    seq1 = __atomic_load_n(&slot->seq, __ATOMIC_ACQUIRE);
+    if (seq1 & 1) {
+      sched_yield();
+      continue;
+    }
+    flags = slot->flags;
+    vlen = slot->len;
+    if (vlen > KV_SHM_VALUE_LEN) {
+      vlen = KV_SHM_VALUE_LEN;
+    }
+    if (!(flags & KV_SHM_FFILE)) {
+      memcpy(value, slot->value, vlen);
+    }
+    __atomic_thread_fence(__ATOMIC_ACQUIRE);
+    seq2 = __atomic_load_n(&slot->seq, __ATOMIC_RELAXED);
+    if (seq1 == seq2) {
+      if (flags & KV_SHM_FFILE) {
+        return KV_SHM_MISS;
+      }
+      if (len) {
+        *len = vlen;
+      }
+      return 0;
+    }
+  }
+
+  syslog(LOG_WARNING, "kv_shm_get: %s is busy", key);
+  return -1;
+}
+
+/*
+ * Store key::value in the shared table.
+ *
+ * return 0 on success, KV_SHM_MISS if the value has to go to the file
+ * instead, negative error code on failure.
+ */
+int
+kv_shm_set(const char *key, const char *value, size_t len) {
+  kv_shm_table_t *tbl = kv_shm_table();
+  kv_shm_slot_t *slot;
+  uint32_t seq;
+
+  if (!tbl || strlen(key) >= MAX_KEY_LEN) {
+    return KV_SHM_MISS;
+  }
+
+  if (len > KV_SHM_VALUE_LEN) {
+    kv_shm_mark_file(key);
+    return KV_SHM_MISS;
+  }
+
+  slot = kv_shm_find(tbl, key, 1);
+  if (!slot) {
+    return KV_SHM_MISS;
+  }
+
+  seq = kv_shm_write_begin(slot);
+  memcpy(slot->value, value, len);
+  slot->len = (uint16_t)len;
+  slot->flags &= ~KV_SHM_FFILE;
+  kv_shm_write_end(slot, seq);
+
+  return 0;
+}
+
+/* Return 1 if key holds a value in the shared table, 0 otherwise */
+int
+kv_shm_exists(const char *key) {
+  kv_shm_table_t *tbl = kv_shm_table();
+  kv_shm_slot_t *slot;
+
+  if (!tbl || strlen(key) >= MAX_KEY_LEN) {
+    return 0;
+  }
+
+  slot = kv_shm_find(tbl, key, 0);
+  if (!slot) {
+    return 0;
+  }
+
+  return (__atomic_load_n(&slot->flags, __ATOMIC_ACQUIRE) & KV_SHM_FFILE) ? 0 : 1;
+}
+
+/*
+ * Sequence count of the slot holding key, 0 if there is none. It changes
+ * on every write, so callers can tell whether the key was touched.
+ */
+uint32_t
+kv_shm_stamp(const char *key) {
+  kv_shm_table_t *tbl = kv_shm_table();
+  kv_shm_slot_t *slot;
+
+  if (!tbl || strlen(key) >= MAX_KEY_LEN) {
+    return 0;
+  }
+
+  slot = kv_shm_find(tbl, key, 0);
+  if (!slot) {
+    return 0;
+  }
+
+  return __atomic_load_n(&slot->seq, __ATOMIC_ACQUIRE);
+}
+
+/* Redirect readers of key to its cache_store file */
+int
+kv_shm_mark_file(const char *key) {
+  kv_shm_table_t *tbl = kv_shm_table();
+  kv_shm_slot_t *slot;
+  uint32_t seq;
+
+  if (!tbl || strlen(key) >= MAX_KEY_LEN) {
+    return 0;
+  }
+
+  slot = kv_shm_find(tbl, key, 0);
+  if (!slot) {
+    return 0;
+  }
+
+  seq = kv_shm_write_begin(slot);
+  slot->flags |= KV_SHM_FFILE;
+  kv_shm_write_end(slot, seq);
+
+  return 0;
+}
+
+/* Redirect readers of every key starting with prefix to its file */
+int
+kv_shm_mark_prefix(const char *prefix) {
+  kv_shm_table_t *tbl = kv_shm_table();
+  kv_shm_slot_t *slot;
+  size_t plen = strlen(prefix);
+  uint32_t i, seq;
+
+  if (!tbl || plen >= MAX_KEY_LEN) {
+    return 0;
+  }
+
+  for (i = 0; i < KV_SHM_SLOTS; i++) {
+    slot = &tbl->slots[i];
+    if (__atomic_load_n(&slot->state, __ATOMIC_ACQUIRE) != KV_SHM_USED ||
+        strncmp(slot->key, prefix, plen) != 0) {
+      continue;
+    }
+    seq = kv_shm_write_begin(slot);
+    slot->flags |= KV_SHM_FFILE;
+    kv_shm_write_end(slot, seq);
+  }
+
+  return 0;
+}
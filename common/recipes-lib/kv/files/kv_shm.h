@@ -0,0 +1,83 @@
+/*
+ * Copyright 2018-present Facebook. All Rights Reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+#ifndef __KV_SHM_H__
+#define __KV_SHM_H__
+
+/*
+ * Shared-memory backend for the non-persistent (cache_store) database.
+ *
+ * All processes map one fixed-size open-addressing hash table from
+ * /dev/shm. Each slot is protected by a sequence counter: writers make it
+ * odd while updating, readers retry until they observe the same even value
+ * before and after copying. Readers never lock and, once the table is
+ * mapped, never enter the kernel.
+ *
+ * Keys which do not fit (table full, value too long) stay in
+ * /tmp/cache_store; the slot is then marked so readers go to the file.
+ */
+
+#include <stdint.h>
+#include "kv.h"
+
+#define KV_SHM_NAME         "/kv_cache_store"
+#define KV_SHM_MAGIC        0x4B565348  /* "KVSH" */
+#define KV_SHM_VERSION      1
+#define KV_SHM_SLOTS        2048        /* Must be a power of 2 */
+#define KV_SHM_VALUE_LEN    MAX_VALUE_LEN
+
+/* Slot states */
+#define KV_SHM_EMPTY        0
+#define KV_SHM_CLAIMED      1
+#define KV_SHM_USED         2
+
+/* Slot flags */
+#define KV_SHM_FFILE        (1 << 0)    /* Value lives in cache_store file */
+
+typedef struct {
+  uint32_t seq;
+  uint32_t state;
+  uint32_t hash;
+  uint16_t len;
+  uint16_t flags;
+  char key[MAX_KEY_LEN];
+  char value[KV_SHM_VALUE_LEN];
+} kv_shm_slot_t;
+
+typedef struct {
+  uint32_t magic;
+  uint32_t version;
+  uint32_t nslots;
+  uint32_t rsvd;
+  kv_shm_slot_t slots[KV_SHM_SLOTS];
+} kv_shm_table_t;
+
+/* Return values of kv_shm_get/kv_shm_set besides 0 */
+#define KV_SHM_MISS         1   /* Not in the table, use the file */
+
+/* Name of the shared object; tests and benchmarks point it elsewhere */
+extern const char *kv_shm_name;
+
+int kv_shm_get(const char *key, char *value, size_t *len);
+int kv_shm_set(const char *key, const char *value, size_t len);
+int kv_shm_exists(const char *key);
+int kv_shm_mark_file(const char *key);
+int kv_shm_mark_prefix(const char *prefix);
+uint32_t kv_shm_stamp(const char *key);
+
+#endif /* __KV_SHM_H__ */
@@ -0,0 +1,271 @@
+/*
+ * Copyright 2018-present Facebook. All Rights Reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+/*
+ * Change notification for keys.
+ *
+ * kv_changed() tells a caller whether a key may have been written since
+ * it last asked, so values derived from it only need to be recomputed
+ * when it returns nonzero. Files backing a key (cache_store and kv_store
+ * files, the persist log, plain files) are followed with one inotify
+ * instance per process; keys held in shared memory are followed through
+ * the sequence count of their slot, which costs no system call.
+ *
+ * Answers err on the side of "changed": on the first call, when the
+ * kernel dropped events, when a directory cannot be watched and for
+ * files inotify cannot follow, such as sysfs attributes.
+ */
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <libgen.h>
+#include <errno.h>
+#include <syslog.h>
+#include <string.h>
+#include <pthread.h>
+#include <sys/stat.h>
+#include <sys/vfs.h>
+#include <sys/inotify.h>
+#include <linux/magic.h>
+#include "kv.h"
+#ifdef CONFIG_KV_SHM_CACHE
+#include "kv_shm.h"
+#endif
+
+extern const char *cache_store;
+extern const char *kv_store;
+extern const char *kv_log_path;
+void mkdir_recurse(char *dir, mode_t mode);
+
+#define KV_WATCH_FILES    2   /* Files that may hold one key */
+#define KV_WATCH_MASK     (IN_MODIFY | IN_CLOSE_WRITE | IN_CREATE | \
+                           IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO)
+
+typedef struct {
+  char dir[MAX_KEY_PATH_LEN];
+  char name[MAX_KEY_PATH_LEN];
+  int wd;             /* -1 if the directory is not watched */
+} kv_watch_file_t;
+
+struct kv_watch {
+  struct kv_watch *next;
+  char key[MAX_KEY_PATH_LEN];
+  int nfiles;
+  kv_watch_file_t files[KV_WATCH_FILES];
+  int dirty;
+  int shm;            /* Key may be held in shared memory */
+  uint32_t stamp;     /* Slot sequence count seen last */
+};
+
+static pthread_mutex_t g_lock = PTHREAD_MUTEX_INITIALIZER;
+static kv_watch_t *g_watches = NULL;
+static int g_ifd = -1;
+
+/* inotify reports nothing for pseudo files which change on their own */
+static int
+kv_watch_followable(const char *dir) {
+  struct statfs sfs;
+
+  if (statfs(dir, &sfs) < 0) {
+    return 0;
+  }
+  return sfs.f_type != SYSFS_MAGIC && sfs.f_type != PROC_SUPER_MAGIC;
+}
+
+static void
+kv_watch_add(kv_watch_file_t *f) {
+  if (g_ifd < 0) {
+    g_ifd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (g_ifd < 0) {
+      syslog(LOG_WARNING, "kv_watch: inotify_init1 failed, errno=%d", errno);
+      return;
+    }
+  }
+  if (!kv_watch_followable(f->dir)) {
+    return;
+  }
+  /* Directories are shared between watches and so never removed */
+  f->wd = inotify_add_watch(g_ifd, f->dir, KV_WATCH_MASK);
+}
+
+static void
+kv_watch_file(kv_watch_t *w, const char *path, int create) {
+  kv_watch_file_t *f = &w->files[w->nfiles++];
+  char tmp[MAX_KEY_PATH_LEN];
+
+  strncpy(tmp, path, sizeof(tmp) - 1);
+  tmp[sizeof(tmp) - 1] = '\0';
+  strcpy(f->dir, dirname(tmp));
+  strncpy(tmp, path, sizeof(tmp) - 1);
+  strcpy(f->name, basename(tmp));
+  if (create) {
+    mkdir_recurse(f->dir, 0777);
+  }
+  f->wd = -1;
+  kv_watch_add(f);
+}
+
+/* Mark the watches an event applies to; called with g_lock held */
+static void
+kv_watch_mark(const struct inotify_event *ev) {
+  kv_watch_t *w;
+  int i;
+
+  for (w = g_watches; w; w = w->next) {
+    for (i = 0; i < w->nfiles; i++) {
+      if (ev->mask & IN_Q_OVERFLOW) {
+        w->dirty = 1;
+      } else if (w->files[i].wd == ev->wd) {
+        if (ev->mask & IN_IGNORED) {
+          w->files[i].wd = -1;
+          w->dirty = 1;
+        } else if (ev->len && !strcmp(ev->name, w->files[i].name)) {
+          w->dirty = 1;
+        }
+      }
+    }
+  }
+}
+
+static void
+kv_watch_drain(void) {
+  char buf[4096] __attribute__((aligned(__alignof__(struct inotify_event))));
+  const struct inotify_event *ev;
+  ssize_t n;
+  char *p;
+
+  if (g_ifd < 0) {
+    return;
+  }
+  while ((n = read(g_ifd, buf, sizeof(buf))) > 0) {
+    for (p = buf; p < buf + n; p += sizeof(*ev) + ev->len) {
+      ev = (const struct inotify_event *)p;
+      kv_watch_mark(ev);
+    }
+  }
+}
+
+/*
+ * Start following key. flags are those used to get it, or KV_FPATH if
+ * key is the path of a plain file.
+ *
+ * return a handle for kv_changed(), NULL on failure.
+ */
+kv_watch_t *
+kv_watch(const char *key, unsigned int flags) {
+  char kpath[MAX_KEY_PATH_LEN];
+  kv_watch_t *w;
+
+  if (strlen(key) >= MAX_KEY_PATH_LEN - 32) {
+    return NULL;
+  }
+  w = calloc(1, sizeof(*w));
+  if (!w) {
+    return NULL;
+  }
+  strcpy(w->key, key);
+  w->dirty = 1;
+
+  pthread_mutex_lock(&g_lock);
+  if (flags & KV_FPATH) {
+    kv_watch_file(w, key, 0);
+  } else if (flags & KV_FPERSIST) {
+    snprintf(kpath, sizeof(kpath), kv_store, key);
+    kv_watch_file(w, kpath, 1);
+#ifdef CONFIG_KV_PERSIST_LOG
+    kv_watch_file(w, kv_log_path, 1);
+#endif
+  } else {
+    snprintf(kpath, sizeof(kpath), cache_store, key);
+    kv_watch_file(w, kpath, 1);
+#ifdef CONFIG_KV_SHM_CACHE
+    w->shm = 1;
+#endif
+  }
+  w->next = g_watches;
+  g_watches = w;
+  pthread_mutex_unlock(&g_lock);
+
+  return w;
+}
+
+/*
+ * Check whether the key may have changed since the previous call. Call
+ * it before reading the key, so a write racing with the read is seen on
+ * the next call.
+ *
+ * return 1 if it may have changed (always on the first call), 0 if not.
+ */
+int
+kv_changed(kv_watch_t *w) {
+  int i, changed;
+#ifdef CONFIG_KV_SHM_CACHE
+  uint32_t stamp;
+#endif
+
+  if (!w) {
+    return 1;
+  }
+
+  pthread_mutex_lock(&g_lock);
+  kv_watch_drain();
+  changed = w->dirty;
+  w->dirty = 0;
+
+  for (i = 0; i < w->nfiles; i++) {
+    if (w->files[i].wd < 0) {
+      /* Unwatched: retry, and assume a change until it works */
+      kv_watch_add(&w->files[i]);
+      changed = 1;
+    }
+  }
+
+#ifdef CONFIG_KV_SHM_CACHE
+  if (w->shm) {
+    stamp = kv_shm_stamp(w->key);
+    if (stamp != w->stamp || (stamp & 1)) {
+      changed = 1;
+    }
+    w->stamp = stamp;
+  }
+#endif
+  pthread_mutex_unlock(&g_lock);
+
+  return changed;
+}
+
+void
+kv_unwatch(kv_watch_t *w) {
+  kv_watch_t **pp;
+
+  if (!w) {
+    return;
+  }
+
+  pthread_mutex_lock(&g_lock);
+  for (pp = &g_watches; *pp; pp = &(*pp)->next) {
+    if (*pp == w) {
+      *pp = w->next;
+      break;
+    }
+  }
+  pthread_mutex_unlock(&g_lock);
+  free(w);
+}
@@ -352,6 +352,17 @@ pal_get_sensor_poll_interval(uint8_t fru, uint8_t sensor_num, uint8_t *value)
   return PAL_EOK;
 }
 
+/* Sensors in the same poll group are read by the same sensord worker.
+ * Platforms should put sensors behind slow links (BIC/IPMB, PECI,
+ * NVMe-MI) in groups of their own so they do not delay local sensors;
+ * see fby2. By default every FRU is a group. */
+int __attribute__((weak))
+pal_get_sensor_poll_group(uint8_t fru, uint8_t sensor_num, uint8_t *group)
+{
+  *group = fru;
+  return PAL_EOK;
+}
+
 int __attribute__((weak))
 pal_get_fru_discrete_list(uint8_t fru, uint8_t **sensor_list, int *cnt)
 {
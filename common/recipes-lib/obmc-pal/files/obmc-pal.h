@@ -219,6 +219,7 @@ int pal_get_fruid_name(uint8_t fru, char *name);
 int pal_slotid_to_fruid(int slotid);
 int pal_get_fru_sensor_list(uint8_t fru, uint8_t **sensor_list, int *cnt);
 int pal_get_sensor_poll_interval(uint8_t fru, uint8_t sensor_num, uint8_t *value);
+int pal_get_sensor_poll_group(uint8_t fru, uint8_t sensor_num, uint8_t *group);
 int pal_get_fru_discrete_list(uint8_t fru, uint8_t **sensor_list, int *cnt);
 int pal_fruid_write(uint8_t slot, char *path);
 int pal_get_fru_devtty(uint8_t fru, char *devtty);
@@ -29,6 +29,7 @@
 #include <sys/types.h>
 #include <sys/stat.h>
 #include <fcntl.h>
+#include <sched.h>
 #include <sys/mman.h>
 #include <errno.h>
 #include <openbmc/kv.h>
@@ -78,8 +79,10 @@ typedef struct {
   sensor_coarse_data_t data[MAX_COARSE_DATA_NUM];
 } sensor_coarse_shm_t;
 
+/* Cache keys are "<fruname>_sensor<num>"; returns the length of the
+ * "<fruname>_sensor" prefix written to key */
 static int
-sensor_key_get(uint8_t fru, uint8_t sensor_num, char *key)
+sensor_key_prefix_get(uint8_t fru, char *key)
 {
   char fruname[32];
 
@@ -89,7 +92,17 @@ sensor_key_get(uint8_t fru, uint8_t sensor_num, char *key)
     if (pal_get_fru_name(fru, fruname))
       return -1;
   }
-  sprintf(key, "%s_sensor%d", fruname, sensor_num);
+  return sprintf(key, "%s_sensor", fruname);
+}
+
+static int
+sensor_key_get(uint8_t fru, uint8_t sensor_num, char *key)
+{
+  int len = sensor_key_prefix_get(fru, key);
+
+  if (len < 0)
+    return -1;
+  sprintf(key + len, "%d", sensor_num);
   return 0;
 }
 
@@ -104,142 +117,294 @@ sensor_coarse_key_get(uint8_t fru, uint8_t sensor_num, char *key)
   return 0;
 }
 
-static int
-cache_set_coarse_history(char *key, float value) {
-  int fd;
-  int share_size = sizeof(sensor_coarse_shm_t);
+/*
+ * History of all sensors lives in one shared-memory arena which every
+ * process maps once. A directory indexed by (fru, sensor_num) points at a
+ * slot holding the sensor's fine and coarse rings. Each slot has its own
+ * sequence counter: writers make it odd while updating, readers scan
+ * without locking and retry if the counter moved under them.
+ */
+#define SENSOR_HIST_SHM       "/sensor_history"
+#define SENSOR_HIST_MAGIC     0x534e4848  /* "SNHH" */
+#define SENSOR_HIST_VERSION   1
+#define MAX_HIST_SLOTS        1024
+#define HIST_READ_RETRY       10
+#define HIST_WRITE_SPIN       10000
+
+typedef struct {
+  uint32_t seq;
+  uint8_t fru;
+  uint8_t sensor_num;
+  uint16_t rsvd;
+  sensor_shm_t fine;
+  sensor_coarse_shm_t coarse;
+} sensor_hist_slot_t;
+
+typedef struct {
+  uint32_t magic;
+  uint32_t version;
+  uint32_t nslots;
+  uint32_t next_slot;
+  /* slot index + 1, 0 if the sensor has no history yet */
+  uint16_t dir[256][256];
+  sensor_hist_slot_t slots[MAX_HIST_SLOTS];
+} sensor_hist_arena_t;
+
+static sensor_hist_arena_t *g_hist = NULL;
+/* Slot this process allocated but lost to a racing creator, index + 1 */
+static uint32_t g_hist_spare = 0;
+
+static sensor_hist_arena_t *
+hist_arena(void)
+{
+  sensor_hist_arena_t *arena = __atomic_load_n(&g_hist, __ATOMIC_ACQUIRE);
+  sensor_hist_arena_t *expected = NULL;
+  uint32_t magic = 0;
+  struct stat st;
   void *ptr;
-  sensor_coarse_shm_t *snr_shm;
-  long current_time;
-  int ret = ERR_FAILURE;
+  int fd;
 
-  fd = shm_open(key, O_CREAT | O_RDWR, S_IRUSR | S_IWUSR);
+  if (arena) {
+    return arena;
+  }
+
+  fd = shm_open(SENSOR_HIST_SHM, O_CREAT | O_RDWR, S_IRUSR | S_IWUSR);
   if (fd < 0) {
-    DEBUG_STR("%s: shm_open %s failed, errno = %d", __FUNCTION__, key, errno);
-    return -1;
+    DEBUG_STR("%s: shm_open failed, errno = %d", __FUNCTION__, errno);
+    return NULL;
+  }
+  /* The arena is sparse; pages are only backed once a slot is used. A
+   * zero-filled arena is valid, so racing initializers are harmless. */
+  if (fstat(fd, &st) < 0 ||
+      (st.st_size < sizeof(sensor_hist_arena_t) &&
+       ftruncate(fd, sizeof(sensor_hist_arena_t)) < 0)) {
+    syslog(LOG_INFO, "%s: sizing arena failed, errno = %d", __FUNCTION__, errno);
+    close(fd);
+    return NULL;
+  }
+  ptr = mmap(NULL, sizeof(sensor_hist_arena_t), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  close(fd);
+  if (ptr == MAP_FAILED) {
+    syslog(LOG_INFO, "%s: mmap failed, errno = %d", __FUNCTION__, errno);
+    return NULL;
   }
 
-  if (flock(fd, LOCK_EX) < 0) {
-    syslog(LOG_INFO, "%s: file-lock %s failed errno = %d\n", __FUNCTION__, key, errno);
-    goto close_bail;
+  arena = (sensor_hist_arena_t *)ptr;
+  if (__atomic_compare_exchange_n(&arena->magic, &magic, SENSOR_HIST_MAGIC, 0,
+                                  __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+    arena->version = SENSOR_HIST_VERSION;
+    arena->nslots = MAX_HIST_SLOTS;
+  } else if (magic != SENSOR_HIST_MAGIC || arena->version != SENSOR_HIST_VERSION) {
+    syslog(LOG_WARNING, "%s: incompatible history arena", __FUNCTION__);
+    munmap(ptr, sizeof(sensor_hist_arena_t));
+    return NULL;
   }
 
-  ftruncate(fd, share_size);
+  /* Another thread may have mapped it meanwhile */
+  if (!__atomic_compare_exchange_n(&g_hist, &expected, arena, 0,
+                                   __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+    munmap(ptr, sizeof(sensor_hist_arena_t));
+    arena = expected;
+  }
+  return arena;
+}
 
-  ptr = mmap(NULL, share_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
-  if (ptr == MAP_FAILED) {
-    syslog(LOG_INFO, "%s: mmap %s failed, errno = %d", __FUNCTION__, key, errno);
-    goto unlock_bail;
+/* Copy a per-sensor history segment from before the arena existed */
+static void
+hist_import_legacy(char *key, void *dst, int size)
+{
+  struct stat st;
+  void *ptr;
+  int fd;
+
+  fd = shm_open(key, O_RDWR, S_IRUSR | S_IWUSR);
+  if (fd < 0) {
+    return;
+  }
+  if (flock(fd, LOCK_EX) == 0) {
+    if (fstat(fd, &st) == 0 && st.st_size >= size) {
+      ptr = mmap(NULL, size, PROT_READ, MAP_SHARED, fd, 0);
+      if (ptr != MAP_FAILED) {
+        memcpy(dst, ptr, size);
+        munmap(ptr, size);
+      }
+    }
+    flock(fd, LOCK_UN);
   }
+  close(fd);
+}
 
-  snr_shm = (sensor_coarse_shm_t *)ptr;
-  current_time = time(NULL);
-  if (snr_shm->data[snr_shm->index].log_time == 0) {
-    sensor_coarse_data_t *s = &snr_shm->data[snr_shm->index];
-    s->log_time = current_time;
-    s->avg = s->sum = s->max = s->min = value;
-    s->count = 1;
-  } else {
-    sensor_coarse_data_t *s = &snr_shm->data[snr_shm->index];
-    /* If the log was started less than an hour ago, then 
-     * continue to log to this entry */
-    if (difftime(current_time, s->log_time) < COARSE_THRESHOLD) {
-      s->sum += value;
-      s->count += 1;
-      if (value > s->max)
-        s->max = value;
-      if (value < s->min)
-        s->min = value;
-      s->avg = s->sum / s->count;
-    } else {
-      /* Start logging to the next entry */
-      snr_shm->index = (snr_shm->index + 1) % MAX_COARSE_DATA_NUM;
-      s = &snr_shm->data[snr_shm->index];
-      memset(s, 0, sizeof(*s));
-      s->log_time = current_time;
-      s->avg = s->sum = s->max = s->min = value;
-      s->count = 1;
+static uint32_t
+hist_write_begin(sensor_hist_slot_t *slot)
+{
+  uint32_t seq = __atomic_load_n(&slot->seq, __ATOMIC_RELAXED);
+  int spin;
+
+  for (spin = 0; spin < HIST_WRITE_SPIN; spin++) {
+    if (!(seq & 1) &&
+        __atomic_compare_exchange_n(&slot->seq, &seq, seq + 1, 0,
+                                    __ATOMIC_ACQUIRE, __ATOMIC_RELAXED)) {
+      return seq + 1;
     }
+    sched_yield();
+    seq = __atomic_load_n(&slot->seq, __ATOMIC_RELAXED);
   }
 
-  if (munmap(ptr, share_size) != 0) {
-    syslog(LOG_INFO, "%s: munmap %s failed, errno = %d", __FUNCTION__, key, errno);
-    goto unlock_bail;
+  /* The previous writer died mid-update; take the slot over */
+  seq |= 1;
+  __atomic_store_n(&slot->seq, seq, __ATOMIC_RELAXED);
+  __atomic_thread_fence(__ATOMIC_RELEASE);
+  return seq;
+}
+
+static void
+hist_write_end(sensor_hist_slot_t *slot, uint32_t seq)
+{
+  __atomic_store_n(&slot->seq, seq + 1, __ATOMIC_RELEASE);
+}
+
+static sensor_hist_slot_t *
+hist_slot_get(uint8_t fru, uint8_t sensor_num, bool create)
+{
+  sensor_hist_arena_t *arena = hist_arena();
+  sensor_hist_slot_t *slot;
+  uint16_t expected = 0;
+  uint32_t id, seq, spare = 0;
+  char key[MAX_KEY_LEN] = {0};
+
+  if (!arena) {
+    return NULL;
   }
-  ret = 0;
 
-unlock_bail:
-  if (flock(fd, LOCK_UN) < 0) {
-    syslog(LOG_INFO, "%s: file-unlock %s failed errno = %d\n", __FUNCTION__, key, errno);
-    ret = -1;
+  id = __atomic_load_n(&arena->dir[fru][sensor_num], __ATOMIC_ACQUIRE);
+  if (id) {
+    return &arena->slots[id - 1];
+  }
+  if (!create) {
+    return NULL;
   }
-close_bail:
-  close(fd);
-  return ret;
-}
 
-static int
-cache_set_history(char *key, float value) {
+  /* The slot is private until published in the directory */
+  id = __atomic_exchange_n(&g_hist_spare, 0, __ATOMIC_ACQ_REL);
+  if (id) {
+    id--;
+  } else {
+    id = __atomic_fetch_add(&arena->next_slot, 1, __ATOMIC_RELAXED);
+    if (id >= MAX_HIST_SLOTS) {
+      DEBUG_STR("%s: no history slot left for fru %u sensor %u", __FUNCTION__, fru, sensor_num);
+      return NULL;
+    }
+  }
+  slot = &arena->slots[id];
 
-  int fd;
-  int share_size = sizeof(sensor_shm_t);
-  void *ptr;
-  sensor_shm_t *snr_shm;
-  int ret = ERR_FAILURE;
+  seq = hist_write_begin(slot);
+  slot->fru = fru;
+  slot->sensor_num = sensor_num;
+  memset(&slot->fine, 0, sizeof(slot->fine));
+  memset(&slot->coarse, 0, sizeof(slot->coarse));
+  if (sensor_key_get(fru, sensor_num, key) == 0) {
+    hist_import_legacy(key, &slot->fine, sizeof(sensor_shm_t));
+    if (slot->fine.index < 0 || slot->fine.index >= MAX_DATA_NUM)
+      slot->fine.index = 0;
+  }
+  if (sensor_coarse_key_get(fru, sensor_num, key) == 0) {
+    hist_import_legacy(key, &slot->coarse, sizeof(sensor_coarse_shm_t));
+    if (slot->coarse.index < 0 || slot->coarse.index >= MAX_COARSE_DATA_NUM)
+      slot->coarse.index = 0;
+  }
+  hist_write_end(slot, seq);
 
-  fd = shm_open(key, O_CREAT | O_RDWR, S_IRUSR | S_IWUSR);
-  if (fd < 0) {
-    DEBUG_STR("%s: shm_open %s failed, errno = %d", __FUNCTION__, key, errno);
-    return -1;
+  if (!__atomic_compare_exchange_n(&arena->dir[fru][sensor_num], &expected, id + 1, 0,
+                                   __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+    /* Lost the race; keep our slot for the next sensor this process adds */
+    __atomic_compare_exchange_n(&g_hist_spare, &spare, id + 1, 0,
+                                __ATOMIC_ACQ_REL, __ATOMIC_RELAXED);
+    return &arena->slots[expected - 1];
   }
 
-  if (flock(fd, LOCK_EX) < 0) {
-    syslog(LOG_INFO, "%s: file-lock %s failed errno = %d\n", __FUNCTION__, key, errno);
-    goto close_bail;
+  /* Only the winner retires the legacy segments */
+  if (sensor_key_get(fru, sensor_num, key) == 0) {
+    shm_unlink(key);
+  }
+  if (sensor_coarse_key_get(fru, sensor_num, key) == 0) {
+    shm_unlink(key);
   }
+  return slot;
+}
 
-  ftruncate(fd, share_size);
+static void
+cache_set_coarse_history(sensor_coarse_shm_t *snr_shm, long current_time, float value)
+{
+  sensor_coarse_data_t *s = &snr_shm->data[snr_shm->index];
 
-  ptr = mmap(NULL, share_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
-  if (ptr == MAP_FAILED) {
-    syslog(LOG_INFO, "%s: mmap %s failed, errno = %d", __FUNCTION__, key, errno);
-    goto unlock_bail;
+  if (s->log_time == 0) {
+    s->log_time = current_time;
+    s->avg = s->sum = s->max = s->min = value;
+    s->count = 1;
+  /* If the log was started less than an hour ago, then
+   * continue to log to this entry */
+  } else if (difftime(current_time, s->log_time) < COARSE_THRESHOLD) {
+    s->sum += value;
+    s->count += 1;
+    if (value > s->max)
+      s->max = value;
+    if (value < s->min)
+      s->min = value;
+    s->avg = s->sum / s->count;
+  } else {
+    /* Start logging to the next entry */
+    snr_shm->index = (snr_shm->index + 1) % MAX_COARSE_DATA_NUM;
+    s = &snr_shm->data[snr_shm->index];
+    memset(s, 0, sizeof(*s));
+    s->log_time = current_time;
+    s->avg = s->sum = s->max = s->min = value;
+    s->count = 1;
+  }
+}
+
+static int
+cache_set_history(uint8_t fru, uint8_t sensor_num, float value)
+{
+  sensor_hist_slot_t *slot;
+  sensor_shm_t *snr_shm;
+  long current_time = time(NULL);
+  uint32_t seq;
+
+  slot = hist_slot_get(fru, sensor_num, true);
+  if (!slot) {
+    return ERR_FAILURE;
   }
 
-  snr_shm = (sensor_shm_t *)ptr;
-  snr_shm->data[snr_shm->index].log_time = time(NULL);
+  seq = hist_write_begin(slot);
+  snr_shm = &slot->fine;
+  snr_shm->data[snr_shm->index].log_time = current_time;
   snr_shm->data[snr_shm->index].value = value;
   snr_shm->index = (snr_shm->index + 1) % MAX_DATA_NUM;
+  cache_set_coarse_history(&slot->coarse, current_time, value);
+  hist_write_end(slot, seq);
 
-  if (munmap(ptr, share_size) != 0) {
-    syslog(LOG_INFO, "%s: munmap %s failed, errno = %d", __FUNCTION__, key, errno);
-    goto unlock_bail;
-  }
-  ret = 0;
+  return 0;
+}
 
-unlock_bail:
-  if (flock(fd, LOCK_UN) < 0) {
-    syslog(LOG_INFO, "%s: file-unlock %s failed errno = %d\n", __FUNCTION__, key, errno);
-    ret = -1;
+#ifndef DBUS_SENSOR_SVC
+static int
+sensor_cache_parse(const char *str, float *value)
+{
+  if (0 == strcmp(str, "NA")) {
+    return ERR_SENSOR_NA;
   }
-close_bail:
-  close(fd);
-  return ret;
+
+  *((float*)value) = atof(str);
+  return 0;
 }
 
-int __attribute__((weak))
-sensor_cache_read(uint8_t fru, uint8_t sensor_num, float *value)
+static int
+sensor_cache_get(char *key, float *value)
 {
-#ifndef DBUS_SENSOR_SVC
   int ret;
-  char key[MAX_KEY_LEN];
   char str[MAX_VALUE_LEN];
   int retry = 0;
 
-  pal_sensor_check(fru, sensor_num);
-
-  if (sensor_key_get(fru, sensor_num, key))
-    return ERR_UNKNOWN_FRU;
   for (retry = 0; retry < CACHE_READ_RETRY; retry++) {
     memset(str, 0, MAX_VALUE_LEN);
     if (!(ret = kv_get(key, str, NULL, 0))) {
@@ -250,17 +415,136 @@ sensor_cache_read(uint8_t fru, uint8_t sensor_num, float *value)
     DEBUG_STR("sensor_cache_read: cache_get %s failed.\n", key);
     return ERR_SENSOR_NA;
   }
-  if (0 == strcmp(str, "NA")) {
-    return ERR_SENSOR_NA;
-  }
+  return sensor_cache_parse(str, value);
+}
+#endif
 
-  *((float*)value) = atof(str);
-  return 0;
+int __attribute__((weak))
+sensor_cache_read(uint8_t fru, uint8_t sensor_num, float *value)
+{
+#ifndef DBUS_SENSOR_SVC
+  char key[MAX_KEY_LEN];
+
+  pal_sensor_check(fru, sensor_num);
+
+  if (sensor_key_get(fru, sensor_num, key))
+    return ERR_UNKNOWN_FRU;
+  return sensor_cache_get(key, value);
 #else
   return sensor_svc_read(fru, sensor_num, value);
 #endif
 }
 
+int
+sensor_cache_read_bulk(const sensor_hist_id_t *sensors, int nsensors,
+    float *values, int *status)
+{
+  int i, ret = 0;
+#ifdef DBUS_SENSOR_SVC
+  sensor_svc_reading_t *readings;
+#else
+  char prefix[MAX_KEY_LEN];
+  char str[MAX_VALUE_LEN + 1];
+  char *keybuf, *valbuf, **keys;
+  size_t *lens;
+  int *idx, *kstatus;
+  int fru = -1, len = -1, k, nkeys = 0;
+#endif
+
+  if (!sensors || !values || !status || nsensors < 0) {
+    return ERR_FAILURE;
+  }
+
+#ifdef DBUS_SENSOR_SVC
+  /* One round trip to the sensor service for all of them */
+  if (nsensors == 0) {
+    return 0;
+  }
+  readings = calloc(nsensors, sizeof(*readings));
+  if (!readings) {
+    return ERR_FAILURE;
+  }
+  for (i = 0; i < nsensors; i++) {
+    readings[i].fru = sensors[i].fru;
+    readings[i].sensor_num = sensors[i].sensor_num;
+  }
+  if (sensor_svc_read_bulk(readings, nsensors)) {
+    free(readings);
+    return ERR_FAILURE;
+  }
+  for (i = 0; i < nsensors; i++) {
+    status[i] = readings[i].status;
+    if (!status[i]) {
+      values[i] = readings[i].value;
+    } else if (!ret) {
+      ret = status[i];
+    }
+  }
+  free(readings);
+#else
+  if (nsensors == 0) {
+    return 0;
+  }
+  keybuf = calloc(nsensors, MAX_KEY_LEN);
+  valbuf = calloc(nsensors, MAX_VALUE_LEN);
+  keys = calloc(nsensors, sizeof(*keys));
+  idx = calloc(nsensors, sizeof(*idx));
+  lens = calloc(nsensors, sizeof(*lens));
+  kstatus = calloc(nsensors, sizeof(*kstatus));
+  if (!keybuf || !valbuf || !keys || !idx || !lens || !kstatus) {
+    ret = ERR_FAILURE;
+    goto bail;
+  }
+
+  /* Callers group sensors by FRU, so the key prefix is mostly reused */
+  for (i = 0; i < nsensors; i++) {
+    pal_sensor_check(sensors[i].fru, sensors[i].sensor_num);
+    if (sensors[i].fru != fru) {
+      fru = sensors[i].fru;
+      len = sensor_key_prefix_get(fru, prefix);
+    }
+    if (len < 0) {
+      status[i] = ERR_UNKNOWN_FRU;
+      continue;
+    }
+    keys[nkeys] = keybuf + nkeys * MAX_KEY_LEN;
+    snprintf(keys[nkeys], MAX_KEY_LEN, "%s%d", prefix, sensors[i].sensor_num);
+    idx[nkeys++] = i;
+  }
+
+  /* All keys in one libkv call; with CONFIG_KV_SHM_CACHE that is a single
+   * pass over the shared table, otherwise it is still one file per key */
+  kv_get_bulk(keys, nkeys, valbuf, lens, kstatus, 0);
+
+  for (k = 0; k < nkeys; k++) {
+    i = idx[k];
+    if (kstatus[k]) {
+      /* Retry the failed ones the way sensor_cache_read() does */
+      status[i] = sensor_cache_get(keys[k], &values[i]);
+    } else {
+      memcpy(str, valbuf + k * MAX_VALUE_LEN, lens[k]);
+      str[lens[k]] = '\0';
+      status[i] = sensor_cache_parse(str, &values[i]);
+    }
+  }
+  for (i = 0; i < nsensors; i++) {
+    if (status[i] && !ret) {
+      ret = status[i];
+    }
+  }
+
+bail:
+  free(kstatus);
+  free(lens);
+  free(idx);
+  free(keys);
+  free(valbuf);
+  free(keybuf);
+#endif
+
+  return ret;
+}
+
 int
 sensor_cache_write(uint8_t fru, uint8_t sensor_num, bool available, float value)
 {
@@ -282,10 +566,7 @@ sensor_cache_write(uint8_t fru, uint8_t sensor_num, bool available, float value)
     return ERR_FAILURE;
   }
   if (available) {
-    cache_set_history(key, value);
-    if (sensor_coarse_key_get(fru, sensor_num, key) == 0) {
-      cache_set_coarse_history(key, value);
-    }
+    cache_set_history(fru, sensor_num, value);
   }
   return 0;
 }
@@ -309,70 +590,61 @@ static int
 sensor_read_short_history(uint8_t fru, uint8_t sensor_num, float *min,
     float *average, float *max, int start_time)
 {
-  char key[MAX_KEY_LEN] = {0};
-  int fd;
-  int share_size = sizeof(sensor_shm_t);
-  void *ptr;
+  sensor_hist_slot_t *slot;
   sensor_shm_t *snr_shm;
   int16_t read_index;
   uint16_t count = 0;
   float read_val;
   double total = 0;
-  int ret = ERR_FAILURE;
-
-  if (sensor_key_get(fru, sensor_num, key))
-    return ERR_UNKNOWN_FRU;
-
-  fd = shm_open(key, O_RDONLY, S_IRUSR | S_IWUSR);
-  if (fd < 0) {
-    DEBUG_STR("%s: shm_open %s failed, errno = %d", __FUNCTION__, key, errno);
-    return ERR_FAILURE;
-  }
-
-  if (flock(fd, LOCK_EX) < 0) {
-    syslog(LOG_INFO, "%s: file-lock %s failed errno = %d\n", __FUNCTION__, key, errno);
-    goto close_bail;
-  }
-
-  ptr = mmap(NULL, share_size, PROT_READ, MAP_SHARED, fd, 0);
-  if (ptr == MAP_FAILED) {
-    syslog(LOG_INFO, "%s: mmap %s failed, errno = %d", __FUNCTION__, key, errno);
-    goto unlock_bail;
-  }
-
-  snr_shm = (sensor_shm_t *)ptr;
-  read_index = snr_shm->index - 1;
-  if (read_index < 0) {
-    read_index += MAX_DATA_NUM;
-  }
-
-  read_val = snr_shm->data[read_index].value;
-  *min = read_val;
-  *max = read_val;
-
-  while ((snr_shm->data[read_index].log_time >= start_time) && (count < MAX_DATA_NUM)) {
-    read_val = snr_shm->data[read_index].value;
-    if (read_val > *max)
-      *max = read_val;
-    if (read_val < *min)
+  uint32_t seq;
+  int retry;
+
+  slot = hist_slot_get(fru, sensor_num, false);
+  if (slot) {
+    snr_shm = &slot->fine;
+    for (retry = 0; retry < HIST_READ_RETRY; retry++) {
+      seq = __atomic_load_n(&slot->seq, __ATOMIC_ACQUIRE);
+      if (seq & 1) {
+        sched_yield();
+        continue;
+      }
+
+      count = 0;
+      total = 0;
+      read_index = (snr_shm->index + MAX_DATA_NUM - 1) % MAX_DATA_NUM;
+      read_val = snr_shm->data[read_index].value;
       *min = read_val;
+      *max = read_val;
 
-    total += read_val;
-    count++;
-    if ((--read_index) < 0) {
-      read_index += MAX_DATA_NUM;
+      while ((snr_shm->data[read_index].log_time >= start_time) && (count < MAX_DATA_NUM)) {
+        read_val = snr_shm->data[read_index].value;
+        if (read_val > *max)
+          *max = read_val;
+        if (read_val < *min)
+          *min = read_val;
+
+        total += read_val;
+        count++;
+        if ((--read_index) < 0) {
+          read_index += MAX_DATA_NUM;
+        }
+      }
+
+      __atomic_thread_fence(__ATOMIC_ACQUIRE);
+      if (__atomic_load_n(&slot->seq, __ATOMIC_RELAXED) == seq) {
+        break;
+      }
+    }
+    if (retry == HIST_READ_RETRY) {
+      /* Never got a consistent copy; do not report a torn one */
+      return ERR_FAILURE;
     }
-  }
-
-  if (munmap(ptr, share_size) != 0) {
-    syslog(LOG_INFO, "%s: munmap %s failed, errno = %d", __FUNCTION__, key, errno);
-    goto unlock_bail;
   }
 
   /* If none found in history, just return the cached value */
   if (!count) {
     float read_value;
-    ret = sensor_cache_read(fru, sensor_num, &read_value);
+    int ret = sensor_cache_read(fru, sensor_num, &read_value);
     if (ret)
       return ret;
     total = *min = *max = read_value;
@@ -380,81 +652,68 @@ sensor_read_short_history(uint8_t fru, uint8_t sensor_num, float *min,
   }
 
   *average = total / count;
-  ret = 0;
-unlock_bail:
-  if (flock(fd, LOCK_UN) < 0) {
-    syslog(LOG_INFO, "%s: file-unlock %s failed errno = %d\n", __FUNCTION__, key, errno);
-    ret = -1;
-  }
-close_bail:
-  close(fd);
-  return ret;
+  return 0;
 }
 
 static int
 sensor_read_long_history(uint8_t fru, uint8_t sensor_num, float *min,
     float *average, float *max, int start_time)
 {
-  char key[MAX_KEY_LEN] = {0};
-  int fd;
-  int share_size = sizeof(sensor_coarse_shm_t);
-  void *ptr;
+  sensor_hist_slot_t *slot;
   sensor_coarse_shm_t *snr_shm;
   sensor_coarse_data_t *s;
   int16_t read_index;
   uint16_t count = 0;
   double total = 0;
-  int ret = ERR_FAILURE;
-
-  if (sensor_coarse_key_get(fru, sensor_num, key))
-    return ERR_UNKNOWN_FRU;
-
-  fd = shm_open(key, O_RDONLY, S_IRUSR | S_IWUSR);
-  if (fd < 0) {
-    DEBUG_STR("%s: shm_open %s failed, errno = %d", __FUNCTION__, key, errno);
-    return ERR_FAILURE;
-  }
-
-  if (flock(fd, LOCK_EX) < 0) {
-    syslog(LOG_INFO, "%s: file-lock %s failed errno = %d\n", __FUNCTION__, key, errno);
-    goto close_bail;
-  }
-
-  ptr = mmap(NULL, share_size, PROT_READ, MAP_SHARED, fd, 0);
-  if (ptr == MAP_FAILED) {
-    syslog(LOG_INFO, "%s: mmap %s failed, errno = %d", __FUNCTION__, key, errno);
-    goto unlock_bail;
-  }
-
-  snr_shm = (sensor_coarse_shm_t *)ptr;
-  read_index = snr_shm->index;
-  total = 0;
-  *max = -FLT_MAX;
-  *min = FLT_MAX;
-  while (count < MAX_COARSE_DATA_NUM) {
-    s = &snr_shm->data[read_index];
-    if (s->log_time < start_time) {
-      break;
+  uint32_t seq;
+  int retry;
+
+  slot = hist_slot_get(fru, sensor_num, false);
+  if (slot) {
+    snr_shm = &slot->coarse;
+    for (retry = 0; retry < HIST_READ_RETRY; retry++) {
+      seq = __atomic_load_n(&slot->seq, __ATOMIC_ACQUIRE);
+      if (seq & 1) {
+        sched_yield();
+        continue;
+      }
+
+      count = 0;
+      total = 0;
+      read_index = snr_shm->index % MAX_COARSE_DATA_NUM;
+      *max = -FLT_MAX;
+      *min = FLT_MAX;
+      while (count < MAX_COARSE_DATA_NUM) {
+        s = &snr_shm->data[read_index];
+        if (s->log_time < start_time) {
+          break;
+        }
+        if (s->max > *max)
+          *max = s->max;
+        if (s->min < *min)
+          *min = s->min;
+        total += s->avg;
+        count++;
+        if ((--read_index) < 0) {
+          read_index += MAX_COARSE_DATA_NUM;
+        }
+      }
+
+      __atomic_thread_fence(__ATOMIC_ACQUIRE);
+      if (__atomic_load_n(&slot->seq, __ATOMIC_RELAXED) == seq) {
+        break;
+      }
     }
-    if (s->max > *max)
-      *max = s->max;
-    if (s->min < *min)
-      *min = s->min;
-    total += s->avg;
-    count++;
-    if ((--read_index) < 0) {
-      read_index += MAX_COARSE_DATA_NUM;
+    if (retry == HIST_READ_RETRY) {
+      /* Never got a consistent copy; do not report a torn one */
+      return ERR_FAILURE;
     }
   }
-  if (munmap(ptr, share_size) != 0) {
-    syslog(LOG_INFO, "%s: munmap %s failed, errno = %d", __FUNCTION__, key, errno);
-    goto unlock_bail;
-  }
 
   /* If none found in history, just return the cached value */
   if (!count) {
     float read_value;
-    ret = sensor_cache_read(fru, sensor_num, &read_value);
+    int ret = sensor_cache_read(fru, sensor_num, &read_value);
     if (ret)
       return ret;
     total = *min = *max = read_value;
@@ -462,15 +721,7 @@ sensor_read_long_history(uint8_t fru, uint8_t sensor_num, float *min,
   }
 
   *average = total / count;
-  ret = 0;
-unlock_bail:
-  if (flock(fd, LOCK_UN) < 0) {
-    syslog(LOG_INFO, "%s: file-unlock %s failed errno = %d\n", __FUNCTION__, key, errno);
-    ret = -1;
-  }
-close_bail:
-  close(fd);
-  return ret;
+  return 0;
 }
 
 int
@@ -487,62 +738,262 @@ sensor_read_history(uint8_t fru, uint8_t sensor_num, float *min, float *average,
   return sensor_read_short_history(fru, sensor_num, min, average, max, start_time);
 }
 
-static int sensor_clear_history_helper(char *shm_name, int share_size)
-{
-  int fd;
-  long *shm;
-  int ret = ERR_FAILURE;
+/*
+ * Structure-of-arrays copies of one sensor's rings, newest sample first,
+ * so the window statistics below are straight loops over contiguous data.
+ */
+typedef struct {
+  int n;
+  long time[MAX_DATA_NUM];
+  float value[MAX_DATA_NUM];
+} hist_fine_soa_t;
 
-  fd = shm_open(shm_name, O_CREAT | O_RDWR, S_IRUSR | S_IWUSR);
-  if (fd < 0) {
-    return ERR_FAILURE;
+typedef struct {
+  int n;
+  long time[MAX_COARSE_DATA_NUM];
+  float min[MAX_COARSE_DATA_NUM];
+  float max[MAX_COARSE_DATA_NUM];
+  float avg[MAX_COARSE_DATA_NUM];
+} hist_coarse_soa_t;
+
+static int
+hist_snapshot_fine(sensor_hist_slot_t *slot, long oldest, hist_fine_soa_t *soa)
+{
+  sensor_shm_t *snr_shm = &slot->fine;
+  int read_index, retry;
+  uint32_t seq;
+
+  for (retry = 0; retry < HIST_READ_RETRY; retry++) {
+    seq = __atomic_load_n(&slot->seq, __ATOMIC_ACQUIRE);
+    if (seq & 1) {
+      sched_yield();
+      continue;
+    }
+    read_index = (snr_shm->index + MAX_DATA_NUM - 1) % MAX_DATA_NUM;
+    for (soa->n = 0; soa->n < MAX_DATA_NUM; soa->n++) {
+      if (snr_shm->data[read_index].log_time < oldest) {
+        break;
+      }
+      soa->time[soa->n] = snr_shm->data[read_index].log_time;
+      soa->value[soa->n] = snr_shm->data[read_index].value;
+      if ((--read_index) < 0) {
+        read_index += MAX_DATA_NUM;
+      }
+    }
+    __atomic_thread_fence(__ATOMIC_ACQUIRE);
+    if (__atomic_load_n(&slot->seq, __ATOMIC_RELAXED) == seq) {
+      return 0;
+    }
   }
-  if (flock(fd, LOCK_EX) < 0) {
-    syslog(LOG_INFO, "%s: file-lock %s failed errno = %d\n", __FUNCTION__, shm_name, errno);
-    goto close_bail;
+  soa->n = 0;
+  return -1;
+}
+
+static int
+hist_snapshot_coarse(sensor_hist_slot_t *slot, long oldest, hist_coarse_soa_t *soa)
+{
+  sensor_coarse_shm_t *snr_shm = &slot->coarse;
+  sensor_coarse_data_t *s;
+  int read_index, retry;
+  uint32_t seq;
+
+  for (retry = 0; retry < HIST_READ_RETRY; retry++) {
+    seq = __atomic_load_n(&slot->seq, __ATOMIC_ACQUIRE);
+    if (seq & 1) {
+      sched_yield();
+      continue;
+    }
+    read_index = snr_shm->index % MAX_COARSE_DATA_NUM;
+    for (soa->n = 0; soa->n < MAX_COARSE_DATA_NUM; soa->n++) {
+      s = &snr_shm->data[read_index];
+      if (s->log_time < oldest) {
+        break;
+      }
+      soa->time[soa->n] = s->log_time;
+      soa->min[soa->n] = s->min;
+      soa->max[soa->n] = s->max;
+      soa->avg[soa->n] = s->avg;
+      if ((--read_index) < 0) {
+        read_index += MAX_COARSE_DATA_NUM;
+      }
+    }
+    __atomic_thread_fence(__ATOMIC_ACQUIRE);
+    if (__atomic_load_n(&slot->seq, __ATOMIC_RELAXED) == seq) {
+      return 0;
+    }
   }
+  soa->n = 0;
+  return -1;
+}
+
+static int
+float_cmp(const void *a, const void *b)
+{
+  float fa = *(const float *)a, fb = *(const float *)b;
+  return (fa > fb) - (fa < fb);
+}
 
-  ftruncate(fd, share_size);
+/* Fill in percentiles from the first count entries of values */
+static void
+hist_percentiles(const float *values, int count, float *scratch, sensor_hist_stats_t *st)
+{
+  memcpy(scratch, values, count * sizeof(float));
+  qsort(scratch, count, sizeof(float), float_cmp);
+  st->p50 = scratch[(count - 1) * 50 / 100];
+  st->p90 = scratch[(count - 1) * 90 / 100];
+  st->p99 = scratch[(count - 1) * 99 / 100];
+}
 
-  shm = (long *)mmap(NULL, share_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
-  if (shm == MAP_FAILED) {
-    syslog(LOG_INFO, "%s: mmap %s failed, errno = %d", __FUNCTION__, shm_name, errno);
-    goto unlock_bail;
+static void
+hist_stats_fine(const hist_fine_soa_t *soa, int count, float *scratch, sensor_hist_stats_t *st)
+{
+  float min = soa->value[0], max = soa->value[0];
+  double total = 0;
+  int i;
+
+  for (i = 0; i < count; i++) {
+    min = soa->value[i] < min ? soa->value[i] : min;
+    max = soa->value[i] > max ? soa->value[i] : max;
+    total += soa->value[i];
+  }
+  st->count = count;
+  st->min = min;
+  st->max = max;
+  st->avg = total / count;
+  hist_percentiles(soa->value, count, scratch, st);
+}
+
+/* Coarse entries only hold hourly aggregates; percentiles are over the
+ * hourly averages */
+static void
+hist_stats_coarse(const hist_coarse_soa_t *soa, int count, float *scratch, sensor_hist_stats_t *st)
+{
+  float min = FLT_MAX, max = -FLT_MAX;
+  double total = 0;
+  int i;
+
+  for (i = 0; i < count; i++) {
+    min = soa->min[i] < min ? soa->min[i] : min;
+    max = soa->max[i] > max ? soa->max[i] : max;
+    total += soa->avg[i];
+  }
+  st->count = count;
+  st->min = min;
+  st->max = max;
+  st->avg = total / count;
+  hist_percentiles(soa->avg, count, scratch, st);
+}
+
+int
+sensor_read_history_bulk(const sensor_hist_id_t *sensors, int nsensors,
+    const long *periods, int nperiods, sensor_hist_stats_t *stats)
+{
+  hist_fine_soa_t *fine;
+  hist_coarse_soa_t *coarse;
+  sensor_hist_slot_t *slot;
+  sensor_hist_stats_t *st;
+  float *scratch;
+  long now = time(NULL);
+  long fine_oldest = now, coarse_oldest = now;
+  long start;
+  float value;
+  int i, p, count, ret, torn;
+
+  if (!sensors || !periods || !stats || nsensors < 0 || nperiods <= 0) {
+    return ERR_FAILURE;
   }
 
-  memset(shm, 0, share_size);
-  if (munmap(shm, share_size) != 0) {
-    syslog(LOG_INFO, "%s: munmap %s failed, errno = %d", __FUNCTION__, shm_name, errno);
-    goto unlock_bail;
+  for (p = 0; p < nperiods; p++) {
+    start = now - periods[p];
+    if (periods[p] > COARSE_THRESHOLD) {
+      coarse_oldest = start < coarse_oldest ? start : coarse_oldest;
+    } else {
+      fine_oldest = start < fine_oldest ? start : fine_oldest;
+    }
   }
-  ret = 0;
-unlock_bail:
-  if (flock(fd, LOCK_UN) < 0) {
-    syslog(LOG_INFO, "%s: file-unlock %s failed errno = %d\n", __FUNCTION__, shm_name, errno);
-    ret = -1;
+
+  fine = malloc(sizeof(*fine));
+  coarse = malloc(sizeof(*coarse));
+  scratch = malloc(sizeof(float) * MAX_DATA_NUM);
+  if (!fine || !coarse || !scratch) {
+    free(fine);
+    free(coarse);
+    free(scratch);
+    return ERR_FAILURE;
   }
-close_bail:
-  close(fd);
-  return ret;
+
+  for (i = 0; i < nsensors; i++) {
+    fine->n = coarse->n = 0;
+    torn = 0;
+    slot = hist_slot_get(sensors[i].fru, sensors[i].sensor_num, false);
+    if (slot) {
+      /* One pass over the arena per ring, whatever the number of windows */
+      if (fine_oldest < now && hist_snapshot_fine(slot, fine_oldest, fine)) {
+        torn = 1;
+      }
+      if (coarse_oldest < now && hist_snapshot_coarse(slot, coarse_oldest, coarse)) {
+        torn = 1;
+      }
+    }
+
+    for (p = 0; p < nperiods; p++) {
+      st = &stats[i * nperiods + p];
+      memset(st, 0, sizeof(*st));
+      start = now - periods[p];
+      if (torn) {
+        st->status = ERR_FAILURE;
+        continue;
+      }
+
+      if (periods[p] > COARSE_THRESHOLD) {
+        for (count = 0; count < coarse->n && coarse->time[count] >= start; count++);
+        if (count) {
+          hist_stats_coarse(coarse, count, scratch, st);
+          continue;
+        }
+      } else {
+        for (count = 0; count < fine->n && fine->time[count] >= start; count++);
+        if (count) {
+          hist_stats_fine(fine, count, scratch, st);
+          continue;
+        }
+      }
+
+      /* If none found in history, just return the cached value */
+      ret = sensor_cache_read(sensors[i].fru, sensors[i].sensor_num, &value);
+      if (ret) {
+        st->status = ret;
+        continue;
+      }
+      st->min = st->avg = st->max = value;
+      st->p50 = st->p90 = st->p99 = value;
+    }
+  }
+
+  free(fine);
+  free(coarse);
+  free(scratch);
+  return 0;
 }
 
 int sensor_clear_history(uint8_t fru, uint8_t sensor_num)
 {
   char key[MAX_KEY_LEN] = {0};
-  int ret1, ret2;
+  sensor_hist_slot_t *slot;
+  uint32_t seq;
 
   if (sensor_key_get(fru, sensor_num, key))
     return ERR_UNKNOWN_FRU;
 
-  ret1 = sensor_clear_history_helper(key, sizeof(sensor_shm_t));
-  if (ret1) {
-    syslog(LOG_INFO, "Clearing history failed: %d\n", ret1);
-  }
-  if (sensor_coarse_key_get(fru, sensor_num, key))
-    return ERR_UNKNOWN_FRU;
-  ret2 = sensor_clear_history_helper(key, sizeof(sensor_coarse_shm_t));
-  if (ret2) {
-    syslog(LOG_INFO, "Clearing coarse history failed: %d\n", ret2);
+  slot = hist_slot_get(fru, sensor_num, true);
+  if (!slot) {
+    syslog(LOG_INFO, "Clearing history failed for %s\n", key);
+    return ERR_FAILURE;
   }
-  return ret1 || ret2 ? ERR_FAILURE : 0;
+
+  seq = hist_write_begin(slot);
+  memset(&slot->fine, 0, sizeof(slot->fine));
+  memset(&slot->coarse, 0, sizeof(slot->coarse));
+  hist_write_end(slot, seq);
+  return 0;
 }
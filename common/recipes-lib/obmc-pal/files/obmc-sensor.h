@@ -42,11 +42,35 @@ extern "C" {
 #define AGGREGATE_SENSOR_FRU_ID   0xff
 #define AGGREGATE_SENSOR_FRU_NAME "aggregate"
 
+/* Identifies one sensor in bulk requests */
+typedef struct {
+  uint8_t fru;
+  uint8_t sensor_num;
+} sensor_hist_id_t;
+
+/* Statistics of one sensor over one history window */
+typedef struct {
+  int status;     /* 0 or one of the error codes above */
+  int count;      /* Samples in the window, 0 if the cached value was used */
+  float min;
+  float avg;
+  float max;
+  float p50;
+  float p90;
+  float p99;
+} sensor_hist_stats_t;
+
 /* Functions */
 
 /* Read a cached value of the given sensor */
 int sensor_cache_read(uint8_t fru, uint8_t sensor_num, float *value);
 
+/* Read the cached values of many sensors in one call. status[i] is set to
+ * 0 or the error code for sensors[i]; returns 0 if every read succeeded,
+ * else the first error. */
+int sensor_cache_read_bulk(const sensor_hist_id_t *sensors, int nsensors,
+               float *values, int *status);
+
 /* Writes the cache explicitly */
 int sensor_cache_write(uint8_t fru, uint8_t sensor_num, bool available, float value);
 
@@ -54,6 +78,12 @@ int sensor_cache_write(uint8_t fru, uint8_t sensor_num, bool available, float va
 int sensor_read_history(uint8_t fru, uint8_t sensor_num, float *min,
                float *average, float *max, int start_time);
 
+/* Read the history of many sensors over several windows in one pass.
+ * periods are in seconds back from now; stats must hold nsensors * nperiods
+ * entries and is filled as stats[sensor * nperiods + period]. */
+int sensor_read_history_bulk(const sensor_hist_id_t *sensors, int nsensors,
+               const long *periods, int nperiods, sensor_hist_stats_t *stats);
+
 /* Clear the sensor history */
 int sensor_clear_history(uint8_t fru, uint8_t sensor_num);
 
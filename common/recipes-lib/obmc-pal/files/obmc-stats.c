@@ -0,0 +1,130 @@
+/*
+ *
+ * Copyright 2018-present Facebook. All Rights Reserved.
+ *
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <string.h>
+#include <syslog.h>
+#include <unistd.h>
+#include <errno.h>
+#include <sys/time.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include "obmc-stats.h"
+
+/* A client which stops reading must not stall the daemon */
+#define STATS_SEND_TIMEOUT_MS 1000
+
+static void
+stats_addr(struct sockaddr_un *addr, const char *path)
+{
+  memset(addr, 0, sizeof(*addr));
+  addr->sun_family = AF_UNIX;
+  strncpy(addr->sun_path, path, sizeof(addr->sun_path) - 1);
+}
+
+int
+obmc_stats_listen(const char *path, int type_flags)
+{
+  struct sockaddr_un addr;
+  int s;
+
+  s = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC | type_flags, 0);
+  if (s < 0) {
+    return -1;
+  }
+
+  stats_addr(&addr, path);
+  unlink(path);
+  if (bind(s, (struct sockaddr *)&addr, sizeof(addr)) < 0 || listen(s, 5) < 0) {
+    syslog(LOG_WARNING, "%s: cannot listen on %s, errno=%d", __func__, path, errno);
+    close(s);
+    return -1;
+  }
+
+  return s;
+}
+
+int
+obmc_stats_accept(int lfd)
+{
+  struct timeval tv = {
+    .tv_sec = STATS_SEND_TIMEOUT_MS / 1000,
+    .tv_usec = (STATS_SEND_TIMEOUT_MS % 1000) * 1000,
+  };
+  int cli;
+
+  cli = accept4(lfd, NULL, NULL, SOCK_CLOEXEC);
+  if (cli < 0) {
+    return -1;
+  }
+  setsockopt(cli, SOL_SOCKET, SO_SNDTIMEO, &tv, sizeof(tv));
+
+  return cli;
+}
+
+void
+obmc_stats_send(int cli, const char *buf, size_t len)
+{
+  ssize_t n;
+
+  while (len > 0) {
+    n = send(cli, buf, len, MSG_NOSIGNAL);
+    if (n < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      syslog(LOG_DEBUG, "%s: send() failed, errno=%d", __func__, errno);
+      break;
+    }
+    buf += n;
+    len -= n;
+  }
+  close(cli);
+}
+
+int
+obmc_stats_print(const char *path, const char *daemon)
+{
+  struct sockaddr_un addr;
+  char buf[1024];
+  ssize_t n;
+  int sock;
+
+  sock = socket(AF_UNIX, SOCK_STREAM, 0);
+  if (sock < 0) {
+    return -1;
+  }
+
+  stats_addr(&addr, path);
+  if (connect(sock, (struct sockaddr *)&addr, sizeof(addr)) < 0) {
+    printf("%s is not running\n", daemon);
+    close(sock);
+    return -1;
+  }
+
+  while ((n = read(sock, buf, sizeof(buf))) > 0) {
+    fwrite(buf, 1, n, stdout);
+  }
+  close(sock);
+
+  return 0;
+}
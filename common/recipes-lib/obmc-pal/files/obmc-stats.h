@@ -0,0 +1,54 @@
+/*
+ *
+ * Copyright 2018-present Facebook. All Rights Reserved.
+ *
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+#ifndef __OBMC_STATS_H__
+#define __OBMC_STATS_H__
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stddef.h>
+
+/*
+ * Runtime statistics of a daemon, served on a unix socket under /var/run.
+ * Every connection gets one text snapshot and is closed; "<daemon> --stats"
+ * prints it with obmc_stats_print().
+ */
+
+/* Listen on path; type_flags (SOCK_NONBLOCK) are or'ed into the socket
+ * type. Returns the listening fd or -1. */
+int obmc_stats_listen(const char *path, int type_flags);
+
+/* Accept one client of the stats socket. Returns its fd or -1. */
+int obmc_stats_accept(int lfd);
+
+/* Send a snapshot to a client from obmc_stats_accept() and close it */
+void obmc_stats_send(int cli, const char *buf, size_t len);
+
+/* Copy the snapshot served on path to stdout. Returns 0 on success, -1 if
+ * daemon is not running. */
+int obmc_stats_print(const char *path, const char *daemon);
+
+#ifdef __cplusplus
+} // extern "C"
+#endif
+
+#endif /* __OBMC_STATS_H__ */
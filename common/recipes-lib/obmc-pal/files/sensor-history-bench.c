@@ -0,0 +1,159 @@
+/*
+ *
+ * Copyright 2018-present Facebook. All Rights Reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+/*
+ * Poll-cycle cost of the sensor cache and history.
+ *
+ * sensor-history-bench [cycles] [sensors]
+ *
+ * "legacy" replays what sensor_cache_write did per sample before the
+ * history arena: a kv_set plus shm_open/flock/ftruncate/mmap of one fine
+ * and one coarse segment per sensor. "arena" is the current
+ * sensor_cache_write. Both write into fru 254 so live data is untouched.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+#include <time.h>
+#include <fcntl.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <openbmc/kv.h>
+#include "obmc-sensor.h"
+
+#define BENCH_FRU       254
+#define LEGACY_FINE     (4 + 2000 * 8)
+#define LEGACY_COARSE   (4 + 720 * 24)
+
+static uint64_t
+now_us(void)
+{
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+static void
+legacy_history(char *key, int size, float value)
+{
+  int fd;
+  int *ptr;
+
+  fd = shm_open(key, O_CREAT | O_RDWR, S_IRUSR | S_IWUSR);
+  if (fd < 0) {
+    return;
+  }
+  flock(fd, LOCK_EX);
+  if (ftruncate(fd, size) == 0) {
+    ptr = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (ptr != MAP_FAILED) {
+      ptr[0] = (ptr[0] + 1) % 100;
+      ptr[1 + ptr[0] * 2] = time(NULL);
+      memcpy(&ptr[2 + ptr[0] * 2], &value, sizeof(value));
+      munmap(ptr, size);
+    }
+  }
+  flock(fd, LOCK_UN);
+  close(fd);
+}
+
+static void
+legacy_cycle(int nsensors, float value)
+{
+  char key[MAX_KEY_LEN];
+  char str[MAX_VALUE_LEN];
+  int snr;
+
+  for (snr = 0; snr < nsensors; snr++) {
+    sprintf(key, "fru%d_sensor%d", BENCH_FRU, snr);
+    sprintf(str, "%.2f", value);
+    kv_set(key, str, 0, 0);
+    legacy_history(key, LEGACY_FINE, value);
+    strcat(key, "_coarse");
+    legacy_history(key, LEGACY_COARSE, value);
+  }
+}
+
+static void
+legacy_cleanup(int nsensors)
+{
+  char key[MAX_KEY_LEN];
+  int snr;
+
+  for (snr = 0; snr < nsensors; snr++) {
+    sprintf(key, "fru%d_sensor%d", BENCH_FRU, snr);
+    shm_unlink(key);
+    strcat(key, "_coarse");
+    shm_unlink(key);
+  }
+}
+
+int
+main(int argc, char *argv[])
+{
+  int cycles = 100, nsensors = 200;
+  int c, snr;
+  uint64_t start, legacy_us, arena_us, read_us;
+  float min, avg, max;
+
+  if (argc > 1)
+    cycles = atoi(argv[1]);
+  if (argc > 2)
+    nsensors = atoi(argv[2]);
+  if (cycles <= 0 || nsensors <= 0 || nsensors > 256) {
+    printf("Usage: %s [cycles] [sensors <= 256]\n", argv[0]);
+    return -1;
+  }
+
+  start = now_us();
+  for (c = 0; c < cycles; c++) {
+    legacy_cycle(nsensors, c * 0.5);
+  }
+  legacy_us = now_us() - start;
+  legacy_cleanup(nsensors);
+
+  start = now_us();
+  for (c = 0; c < cycles; c++) {
+    for (snr = 0; snr < nsensors; snr++) {
+      sensor_cache_write(BENCH_FRU, snr, true, c * 0.5);
+    }
+  }
+  arena_us = now_us() - start;
+
+  start = now_us();
+  for (snr = 0; snr < nsensors; snr++) {
+    sensor_read_history(BENCH_FRU, snr, &min, &avg, &max, time(NULL) - 60);
+  }
+  read_us = now_us() - start;
+
+  for (snr = 0; snr < nsensors; snr++) {
+    sensor_clear_history(BENCH_FRU, snr);
+  }
+
+  printf("%d sensors, %d cycles\n", nsensors, cycles);
+  printf("legacy: %8.1f us/cycle\n", (double)legacy_us / cycles);
+  printf("arena:  %8.1f us/cycle\n", (double)arena_us / cycles);
+  printf("history read of all sensors: %.1f us\n", (double)read_us);
+  return 0;
+}
@@ -28,6 +28,10 @@
 #include <errno.h>
 #include <syslog.h>
 #include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 #include "sdr.h"
 
 #define FIELD_RATE_UNIT(x)  ((x & (0x07 << 3)) >> 3)
@@ -577,21 +581,15 @@ _sdr_get_snr_thresh(uint8_t fru, sdr_full_t *sdr, uint8_t snr_num,
   return 0;
 }
 
-int
-sdr_get_snr_thresh(uint8_t fru, uint8_t snr_num, thresh_sensor_t *snr) {
+/* Read the SDR of every sensor of the FRU, retrying while it is not ready */
+static int
+sdr_init_fru(uint8_t fru, sensor_info_t *sinfo) {
 
-  int ret = 0;
-  sdr_full_t *sdr;
+  int ret;
 #ifdef DEBUG
   int cnt = 0;
 #endif /* DEBUG */
   int retry = 0;
-  char fpath[64] = {0};
-  char initpath[64] = {0};
-  char initflag[64] = {0};
-  char fru_name[8];
-
-  sensor_info_t sinfo[MAX_SENSOR_NUM] = {0};
 
   ret = pal_sensor_sdr_init(fru, sinfo);
 
@@ -609,35 +607,50 @@ sdr_get_snr_thresh(uint8_t fru, uint8_t snr_num, thresh_sensor_t *snr) {
     ret = pal_sensor_sdr_init(fru, sinfo);
   }
 
-  if (ret < 0) {
-    sdr = NULL;
-  } else {
-    sdr = &sinfo[snr_num].sdr;
+  return ret;
+}
+
+/* 1 if the thresholds set by threshold-util are to be used, 0 if not */
+static int
+sdr_thresh_in_file(uint8_t fru) {
+
+  char fpath[64] = {0};
+  char initpath[64] = {0};
+  char fru_name[8];
+
+  if (pal_get_fru_name(fru, fru_name) < 0) {
+    printf("%s: Fail to get fru%d name\n", __func__, fru);
+    return -1;
   }
 
+  sprintf(initpath, INIT_THRESHOLD_BIN, fru_name);
+  sprintf(fpath, THRESHOLD_BIN, fru_name);
+  return access(initpath, F_OK) == 0 && access(fpath, F_OK) == 0;
+}
+
+/*
+ * Thresholds of one sensor, from the threshold file if in_file is set,
+ * else from its SDR or from the PAL if sdr is NULL.
+ */
+static int
+sdr_load_snr_thresh(uint8_t fru, sdr_full_t *sdr, int in_file,
+    uint8_t snr_num, thresh_sensor_t *snr) {
+
+  int ret = 0;
+
   /* Set all the threshold options set in the flag */
   snr->flag = GETMASK(SENSOR_VALID) | GETMASK(UCR_THRESH) |
     GETMASK(UNC_THRESH) | GETMASK(UNR_THRESH) | GETMASK(LCR_THRESH) |
     GETMASK(LNC_THRESH) | GETMASK(LNR_THRESH);
 
-  ret = pal_get_fru_name(fru, fru_name);
-  if (ret < 0) {
-    printf("%s: Fail to get fru%d name\n", __func__, fru);
-    return -1;
-  }
-  
-  sprintf(initpath, INIT_THRESHOLD_BIN, fru_name);
-  if (0 == access(initpath, F_OK)) { // init done
-    sprintf(fpath, THRESHOLD_BIN, fru_name);
-    if (0 == access(fpath, F_OK)) {
-      ret = pal_get_thresh_from_file(fru, snr_num, snr);
-      if (0 != ret) {
-        syslog(LOG_WARNING, "%s: Fail to get threshold from file for slot%d", __func__, fru);
-        return -1;
-      }
+  if (in_file) {
+    ret = pal_get_thresh_from_file(fru, snr_num, snr);
+    if (0 != ret) {
+      syslog(LOG_WARNING, "%s: Fail to get threshold from file for slot%d", __func__, fru);
+      return -1;
+    }
 
-      return ret;
-    } 
+    return ret;
   }
 
   if (sdr != NULL) {
@@ -686,3 +699,455 @@ sdr_get_snr_thresh(uint8_t fru, uint8_t snr_num, thresh_sensor_t *snr) {
 
   return ret;
 }
+
+/* Thresholds of one sensor, without going through the cache */
+static int
+sdr_read_snr_thresh(uint8_t fru, uint8_t snr_num, thresh_sensor_t *snr) {
+
+  int ret, in_file;
+  sdr_full_t *sdr = NULL;
+  sensor_info_t *sinfo;
+
+  sinfo = calloc(MAX_SENSOR_NUM, sizeof(sensor_info_t));
+  if (sinfo == NULL) {
+    return -1;
+  }
+
+  ret = sdr_init_fru(fru, sinfo);
+  if (ret == ERR_NOT_READY) {
+    free(sinfo);
+    return ERR_NOT_READY;
+  }
+  if (ret >= 0 && snr_num < MAX_SENSOR_NUM) {
+    sdr = &sinfo[snr_num].sdr;
+  }
+
+  in_file = sdr_thresh_in_file(fru);
+  if (in_file < 0) {
+    free(sinfo);
+    return -1;
+  }
+
+  ret = sdr_load_snr_thresh(fru, sdr, in_file, snr_num, snr);
+  free(sinfo);
+  return ret;
+}
+
+/*
+ * Threshold cache
+ *
+ * The thresholds of every sensor of a FRU are worked out at once and kept
+ * in a file under THRESHOLD_PATH, which every process maps. A generation
+ * counter per FRU, kept in a small shared file, is bumped by
+ * sdr_thresh_changed() whenever the threshold files change; a cache built
+ * at an older generation is rebuilt on the next lookup. The SDR dump is
+ * rewritten by the platform daemons (bic-cached...), so the cache also
+ * records the inode and mtime of SDR_BIN and is rebuilt when they change.
+ *
+ * Thresholds that could not be read are not cached; those sensors take
+ * the uncached path and are retried on every lookup.
+ */
+#define SDR_CACHE_BIN     THRESHOLD_PATH "/%s_sdr-cache.bin"
+#define SDR_GEN_BIN       THRESHOLD_PATH "/%s_sdr-gen.bin"
+#define SDR_CACHE_MAGIC   0x43524453    /* "SDRC" */
+
+#ifndef SDR_BIN
+#define SDR_BIN           "/tmp/sdr_%s.bin"
+#endif
+
+/* FRU ids the cache is kept for */
+#ifdef MAX_NUM_FRUS
+#define SDR_CACHE_FRUS    (MAX_NUM_FRUS + 1)
+#else
+#define SDR_CACHE_FRUS    (UINT8_MAX + 1)
+#endif
+
+typedef struct {
+  uint64_t ino;                         /* Of the SDR dump, 0 if none */
+  uint64_t mtime;                       /* In ns */
+} sdr_stamp_t;
+
+typedef struct {
+  uint32_t magic;
+  uint32_t gen;                         /* Generation built at */
+  sdr_stamp_t sdr;                      /* SDR dump built from */
+  uint32_t entry_size;
+  uint32_t count;
+  uint16_t index[MAX_SENSOR_NUM + 1];   /* Entry of each sensor + 1, 0 if none */
+} sdr_cache_hdr_t;
+
+typedef struct {
+  int32_t ret;                          /* sdr_get_snr_thresh() return value */
+  thresh_sensor_t thresh;
+} sdr_cache_entry_t;
+
+typedef struct {
+  uint32_t *gen;                        /* Shared generation counter */
+  sdr_cache_hdr_t *hdr;                 /* Mapped cache, NULL if none */
+  size_t len;
+} sdr_cache_t;
+
+static sdr_cache_t g_cache[SDR_CACHE_FRUS];
+static pthread_mutex_t g_cache_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static int
+sdr_cache_path(uint8_t fru, const char *fmt, char *path) {
+
+  char fru_name[16];
+
+  if (pal_get_fru_name(fru, fru_name) < 0) {
+    return -1;
+  }
+  if (access(THRESHOLD_PATH, F_OK) == -1) {
+    mkdir(THRESHOLD_PATH, 0777);
+  }
+  sprintf(path, fmt, fru_name);
+  return 0;
+}
+
+/* Identify the SDR dump of the FRU as it is now */
+static void
+sdr_stamp_get(uint8_t fru, sdr_stamp_t *stamp) {
+
+  char path[64];
+  char fru_name[16];
+  struct stat st;
+
+  memset(stamp, 0, sizeof(sdr_stamp_t));
+  if (pal_get_fru_name(fru, fru_name) < 0) {
+    return;
+  }
+  snprintf(path, sizeof(path), SDR_BIN, fru_name);
+  if (stat(path, &st) == 0) {
+    stamp->ino = st.st_ino;
+    stamp->mtime = (uint64_t)st.st_mtim.tv_sec * 1000000000 + st.st_mtim.tv_nsec;
+  }
+}
+
+static uint32_t *
+sdr_gen_map(uint8_t fru) {
+
+  char path[64];
+  struct stat st;
+  void *map;
+  int fd;
+
+  if (sdr_cache_path(fru, SDR_GEN_BIN, path)) {
+    return NULL;
+  }
+  fd = open(path, O_RDWR | O_CREAT, 0666);
+  if (fd < 0) {
+    return NULL;
+  }
+  if (fstat(fd, &st) < 0 ||
+      (st.st_size < (off_t)sizeof(uint32_t) && ftruncate(fd, sizeof(uint32_t)) < 0)) {
+    close(fd);
+    return NULL;
+  }
+  map = mmap(NULL, sizeof(uint32_t), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  close(fd);
+  return map == MAP_FAILED ? NULL : (uint32_t *)map;
+}
+
+static void
+sdr_cache_unmap(sdr_cache_t *c) {
+
+  if (c->hdr) {
+    munmap(c->hdr, c->len);
+    c->hdr = NULL;
+  }
+}
+
+/* Map the cache file of the FRU if it was built at gen from the SDR stamp */
+static int
+sdr_cache_map(uint8_t fru, sdr_cache_t *c, uint32_t gen,
+    const sdr_stamp_t *stamp) {
+
+  char path[64];
+  struct stat st;
+  sdr_cache_hdr_t *hdr;
+  int fd;
+
+  if (sdr_cache_path(fru, SDR_CACHE_BIN, path)) {
+    return -1;
+  }
+  fd = open(path, O_RDONLY);
+  if (fd < 0) {
+    return -1;
+  }
+  if (fstat(fd, &st) < 0 || st.st_size < (off_t)sizeof(sdr_cache_hdr_t)) {
+    close(fd);
+    return -1;
+  }
+  hdr = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+  close(fd);
+  if (hdr == MAP_FAILED) {
+    return -1;
+  }
+  if (hdr->magic != SDR_CACHE_MAGIC || hdr->gen != gen ||
+      memcmp(&hdr->sdr, stamp, sizeof(sdr_stamp_t)) ||
+      hdr->entry_size != sizeof(sdr_cache_entry_t) ||
+      (size_t)st.st_size != sizeof(sdr_cache_hdr_t) +
+                            hdr->count * sizeof(sdr_cache_entry_t)) {
+    munmap(hdr, st.st_size);
+    return -1;
+  }
+  c->hdr = hdr;
+  c->len = st.st_size;
+  return 0;
+}
+
+/* Work out the thresholds of every sensor of the FRU and write the cache */
+static int
+sdr_cache_build(uint8_t fru, uint32_t gen, const sdr_stamp_t *stamp) {
+
+  char path[64], tmp[80];
+  sensor_info_t *sinfo;
+  sdr_cache_hdr_t *hdr;
+  sdr_cache_entry_t *entry;
+  uint8_t *sensor_list;
+  sdr_full_t *sdr;
+  size_t len;
+  int i, fd, ret, in_file, sensor_cnt;
+
+  if (sdr_cache_path(fru, SDR_CACHE_BIN, path)) {
+    return -1;
+  }
+  ret = pal_get_fru_sensor_list(fru, &sensor_list, &sensor_cnt);
+  if (ret < 0 || sensor_cnt < 0 || sensor_cnt > MAX_SENSOR_NUM + 1) {
+    return -1;
+  }
+
+  sinfo = calloc(MAX_SENSOR_NUM, sizeof(sensor_info_t));
+  len = sizeof(sdr_cache_hdr_t) + sensor_cnt * sizeof(sdr_cache_entry_t);
+  hdr = calloc(1, len);
+  if (sinfo == NULL || hdr == NULL) {
+    free(sinfo);
+    free(hdr);
+    return -1;
+  }
+
+  // One SDR read for the whole FRU
+  ret = sdr_init_fru(fru, sinfo);
+  if (ret == ERR_NOT_READY) {
+    free(sinfo);
+    free(hdr);
+    return ERR_NOT_READY;
+  }
+  if (ret < 0 && stamp->ino) {
+    // The SDR is there but could not be read; do not keep the PAL values
+    free(sinfo);
+    free(hdr);
+    return -1;
+  }
+  in_file = sdr_thresh_in_file(fru);
+  if (in_file < 0) {
+    free(sinfo);
+    free(hdr);
+    return -1;
+  }
+
+  hdr->magic = SDR_CACHE_MAGIC;
+  hdr->gen = gen;
+  hdr->sdr = *stamp;
+  hdr->entry_size = sizeof(sdr_cache_entry_t);
+  entry = (sdr_cache_entry_t *)(hdr + 1);
+  for (i = 0; i < sensor_cnt; i++) {
+    uint8_t snr_num = sensor_list[i];
+    if (hdr->index[snr_num]) {
+      continue;
+    }
+    sdr = (ret >= 0 && snr_num < MAX_SENSOR_NUM) ? &sinfo[snr_num].sdr : NULL;
+    entry[hdr->count].ret = sdr_load_snr_thresh(fru, sdr, in_file, snr_num,
+                                                &entry[hdr->count].thresh);
+    if (entry[hdr->count].ret < 0) {
+      memset(&entry[hdr->count], 0, sizeof(sdr_cache_entry_t));
+      continue;
+    }
+    hdr->index[snr_num] = ++hdr->count;
+  }
+  free(sinfo);
+  len = sizeof(sdr_cache_hdr_t) + hdr->count * sizeof(sdr_cache_entry_t);
+
+  // Replace the file so that readers never see it half written
+  snprintf(tmp, sizeof(tmp), "%s.%d", path, getpid());
+  fd = open(tmp, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+  if (fd < 0) {
+    free(hdr);
+    return -1;
+  }
+  ret = write(fd, hdr, len) == (ssize_t)len ? 0 : -1;
+  close(fd);
+  free(hdr);
+  if (ret == 0 && rename(tmp, path) == 0) {
+    return 0;
+  }
+  unlink(tmp);
+  return -1;
+}
+
+/*
+ * Bring the cache of the FRU up to date, building it if needed. Called
+ * with g_cache_lock held. Returns 0 if c->hdr is usable, ERR_NOT_READY
+ * if the SDR is missing, -1 if there is no cache.
+ */
+static int
+sdr_cache_load(uint8_t fru, sdr_cache_t *c) {
+
+  sdr_stamp_t stamp;
+  uint32_t gen;
+  int rc;
+
+  sdr_stamp_get(fru, &stamp);
+  if (c->gen == NULL && (c->gen = sdr_gen_map(fru)) == NULL) {
+    return -1;
+  }
+  gen = __atomic_load_n(c->gen, __ATOMIC_ACQUIRE);
+  if (c->hdr != NULL && c->hdr->gen == gen &&
+      !memcmp(&c->hdr->sdr, &stamp, sizeof(sdr_stamp_t))) {
+    return 0;
+  }
+  sdr_cache_unmap(c);
+  if (sdr_cache_map(fru, c, gen, &stamp) == 0) {
+    return 0;
+  }
+  rc = sdr_cache_build(fru, gen, &stamp);
+  if (rc == ERR_NOT_READY) {
+    return ERR_NOT_READY;
+  }
+  if (rc || sdr_cache_map(fru, c, gen, &stamp)) {
+    return -1;
+  }
+  return 0;
+}
+
+/* Copy the cached entry of the sensor. Called with g_cache_lock held. */
+static int
+sdr_cache_lookup(sdr_cache_t *c, uint8_t snr_num, thresh_sensor_t *snr,
+    int *ret) {
+
+  sdr_cache_entry_t *entry;
+
+  if (!c->hdr->index[snr_num]) {
+    return -1;
+  }
+  entry = (sdr_cache_entry_t *)(c->hdr + 1) + c->hdr->index[snr_num] - 1;
+  memcpy(snr, &entry->thresh, sizeof(thresh_sensor_t));
+  *ret = entry->ret;
+  return 0;
+}
+
+/*
+ * Look the sensor up in the cache of the FRU, bringing the cache up to
+ * date first. Returns 0 with *ret set if the cache answered.
+ */
+static int
+sdr_cache_get(uint8_t fru, uint8_t snr_num, thresh_sensor_t *snr, int *ret) {
+
+  int rc;
+
+  if (fru >= SDR_CACHE_FRUS) {
+    return -1;
+  }
+
+  pthread_mutex_lock(&g_cache_lock);
+  rc = sdr_cache_load(fru, &g_cache[fru]);
+  if (rc == ERR_NOT_READY) {
+    *ret = ERR_NOT_READY;
+    rc = 0;
+  } else if (rc == 0) {
+    rc = sdr_cache_lookup(&g_cache[fru], snr_num, snr, ret);
+  }
+  pthread_mutex_unlock(&g_cache_lock);
+  return rc;
+}
+
+/*
+ * Invalidate the thresholds cached for the FRU. To be called after
+ * its threshold files change; SDR dump changes are picked up by itself.
+ */
+void
+sdr_thresh_changed(uint8_t fru) {
+
+  sdr_cache_t *c;
+
+  if (fru >= SDR_CACHE_FRUS) {
+    return;
+  }
+  c = &g_cache[fru];
+
+  pthread_mutex_lock(&g_cache_lock);
+  if (c->gen == NULL) {
+    c->gen = sdr_gen_map(fru);
+  }
+  if (c->gen != NULL) {
+    __atomic_add_fetch(c->gen, 1, __ATOMIC_RELEASE);
+  }
+  pthread_mutex_unlock(&g_cache_lock);
+}
+
+int
+sdr_get_snr_thresh(uint8_t fru, uint8_t snr_num, thresh_sensor_t *snr) {
+
+  int ret;
+
+  if (sdr_cache_get(fru, snr_num, snr, &ret) == 0) {
+    return ret;
+  }
+  // Not one of the FRU's sensors, or no cache
+  return sdr_read_snr_thresh(fru, snr_num, snr);
+}
+
+/*
+ * Thresholds of every sensor of the FRU in one call. snr and status are
+ * indexed by sensor number and hold MAX_SENSOR_NUM + 1 entries; status[n]
+ * is what sdr_get_snr_thresh() returns for sensor n, entries of sensors not
+ * in the FRU's list are left alone. The cache is checked once for all of
+ * them. Returns ERR_NOT_READY if the SDR is missing.
+ */
+int
+sdr_get_all_snr_thresh(uint8_t fru, thresh_sensor_t *snr, int *status) {
+
+  uint8_t *sensor_list;
+  bool *miss;
+  int i, ret, sensor_cnt;
+  int rc = -1;
+
+  ret = pal_get_fru_sensor_list(fru, &sensor_list, &sensor_cnt);
+  if (ret < 0) {
+    return ret;
+  }
+  miss = calloc(sensor_cnt, sizeof(bool));
+  if (!miss && sensor_cnt > 0) {
+    return -1;
+  }
+
+  if (fru < SDR_CACHE_FRUS) {
+    pthread_mutex_lock(&g_cache_lock);
+    rc = sdr_cache_load(fru, &g_cache[fru]);
+    for (i = 0; rc == 0 && i < sensor_cnt; i++) {
+      miss[i] = sdr_cache_lookup(&g_cache[fru], sensor_list[i],
+                                 &snr[sensor_list[i]], &status[sensor_list[i]]) != 0;
+    }
+    pthread_mutex_unlock(&g_cache_lock);
+  }
+  if (rc == ERR_NOT_READY) {
+    free(miss);
+    return ERR_NOT_READY;
+  }
+
+  // Not one of the FRU's sensors, or no cache
+  for (i = 0; i < sensor_cnt; i++) {
+    if (rc || miss[i]) {
+      status[sensor_list[i]] = sdr_read_snr_thresh(fru, sensor_list[i],
+                                                   &snr[sensor_list[i]]);
+      if (status[sensor_list[i]] == ERR_NOT_READY) {
+        free(miss);
+        return ERR_NOT_READY;
+      }
+    }
+  }
+
+  free(miss);
+  return 0;
+}
@@ -39,6 +39,8 @@ extern "C" {
 int sdr_get_sensor_name(uint8_t fru, uint8_t snr_num, char *name);
 int sdr_get_sensor_units(uint8_t fru, uint8_t snr_num, char *units);
 int sdr_get_snr_thresh(uint8_t fru, uint8_t snr_num, thresh_sensor_t *snr);
+int sdr_get_all_snr_thresh(uint8_t fru, thresh_sensor_t *snr, int *status);
+void sdr_thresh_changed(uint8_t fru);
 
 #ifdef __cplusplus
 } // extern "C"
@@ -50,6 +50,11 @@
 
 #define MAX_NUM_CONDITIONS 32
 #define MAX_NUM_TABLES     32
+#define MAX_NUM_FRUS       256
+#define MAX_NUM_SENSOR_IDS 256
+
+/* cur_table before the condition key was first resolved */
+#define TABLE_UNRESOLVED   -1
 
 typedef struct {
   char cond_value[MAX_VALUE_LEN];
@@ -83,10 +88,14 @@ typedef struct {
   char    cond_key[MAX_KEY_LEN];
   size_t  value_map_size;
   value_map_element_t value_map[MAX_NUM_CONDITIONS];
+  kv_watch_t *cond_watch;
+  int     cur_table;  /* Table for the last condition value */
 } sensor_correction_t;
 
 static sensor_correction_t *g_sensors = NULL;
 static size_t g_sensors_count = 0;
+/* Corrections indexed by FRU and sensor ID, one array per FRU used */
+static sensor_correction_t **g_index[MAX_NUM_FRUS];
 
 static int get_table(value_map_element_t *value_map, size_t num, char *value, size_t *idx)
 {
@@ -102,14 +111,66 @@ static int get_table(value_map_element_t *value_map, size_t num, char *value, si
 }
 
 static sensor_correction_t *get_correction(uint8_t fru, uint8_t sensor_id)
+{
+  if (!g_index[fru]) {
+    return NULL;
+  }
+  return g_index[fru][sensor_id];
+}
+
+static void free_index(void)
 {
   size_t i;
-  for(i = 0; i < g_sensors_count; i++) {
-    if (g_sensors[i].fru == fru && g_sensors[i].id == sensor_id) {
-      return &g_sensors[i];
+  for (i = 0; i < MAX_NUM_FRUS; i++) {
+    free(g_index[i]);
+    g_index[i] = NULL;
+  }
+}
+
+static int build_index(void)
+{
+  sensor_correction_t *snr;
+  size_t i;
+
+  for (i = 0; i < g_sensors_count; i++) {
+    snr = &g_sensors[i];
+    if (!g_index[snr->fru]) {
+      g_index[snr->fru] = calloc(MAX_NUM_SENSOR_IDS, sizeof(sensor_correction_t *));
+      if (!g_index[snr->fru]) {
+        free_index();
+        return -1;
+      }
+    }
+    /* The first entry for a sensor wins, as it always has */
+    if (!g_index[snr->fru][snr->id]) {
+      g_index[snr->fru][snr->id] = snr;
     }
   }
-  return NULL;
+  return 0;
+}
+
+/*
+ * Table for the current value of the condition key. The key is only read
+ * and looked up in the value map again once it has changed.
+ */
+static size_t get_cond_table(sensor_correction_t *snr)
+{
+  char value[MAX_VALUE_LEN] = {0};
+  size_t table_idx = 0;
+  unsigned int flags;
+  int cur = __atomic_load_n(&snr->cur_table, __ATOMIC_ACQUIRE);
+
+  if (!kv_changed(snr->cond_watch) && cur != TABLE_UNRESOLVED) {
+    return (size_t)cur;
+  }
+
+  flags = snr->cond_key_type == KEY_PERSISTENT ? KV_FPERSIST : 0;
+  if (kv_get(snr->cond_key, value, NULL, flags) ||
+      get_table(snr->value_map, snr->value_map_size, value, &table_idx)) {
+    table_idx = snr->default_table;
+  }
+  __atomic_store_n(&snr->cur_table, (int)table_idx, __ATOMIC_RELEASE);
+  return table_idx;
 }
 
 static int load_table(json_t *obj, correction_table_t *tbl)
@@ -249,6 +310,9 @@ static int load_conditional_sensor_correction(json_t *obj, sensor_correction_t *
     strncpy(snr->value_map[i].cond_value, value_str, MAX_VALUE_LEN);
     snr->value_map[i].table_idx = idx;
   }
+  snr->cur_table = TABLE_UNRESOLVED;
+  snr->cond_watch = kv_watch(snr->cond_key,
+      snr->cond_key_type == KEY_PERSISTENT ? KV_FPERSIST : 0);
   return 0;
 }
 
@@ -340,9 +404,16 @@ int sensor_correction_init(const char *file)
       goto bail;
     }
   }
+  if (build_index()) {
+    DEBUG("Allocation failure!\n");
+    goto bail;
+  }
   json_decref(conf);
   return 0;
 bail:
+  for (i = 0; i < g_sensors_count; i++) {
+    kv_unwatch(g_sensors[i].cond_watch);
+  }
   free(g_sensors);
   json_decref(conf);
   g_sensors = NULL;
@@ -352,12 +423,9 @@ bail:
 
 int sensor_correction_apply(uint8_t fru, uint8_t sensor_id, float cond_value, float *sensor_reading)
 {
-  char value[MAX_VALUE_LEN] = {0};
-  size_t table_idx = 0;
   correction_table_t *table;
   size_t i;
   float correction;
-  unsigned int flags;
 
   sensor_correction_t *snr = get_correction(fru, sensor_id);
   if (!snr) {
@@ -365,12 +433,7 @@ int sensor_correction_apply(uint8_t fru, uint8_t sensor_id, float cond_value, fl
      * manipulating it */
     return 0;
   }
-  flags = snr->cond_key_type == KEY_PERSISTENT ? KV_FPERSIST : 0;
-  if (kv_get(snr->cond_key, value, NULL, flags) ||
-      get_table(snr->value_map, snr->value_map_size, value, &table_idx)) {
-    table_idx = snr->default_table;
-  }
-  table = &snr->tables[table_idx];
+  table = &snr->tables[get_cond_table(snr)];
   correction = table->corr_table[0].correction;
   for (i = 0; i < table->num; i++) {
     if (cond_value < table->corr_table[i].cond_value) {
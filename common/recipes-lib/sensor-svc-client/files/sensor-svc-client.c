@@ -18,15 +18,12 @@
  */
 
 #include <gio/gio.h>
-#include <openbmc/pal.h>
 #include <syslog.h>
 #include "sensor-svc-client.h"
 #include <stdio.h>
 
-//proxy to DBus objects are stored to optimize performance
+//proxy to the sensor service is stored to optimize performance
 static GDBusProxy* _proxy_sensor_service = NULL;
-static GDBusProxy* _proxy_fru[MAX_NUM_FRUS] = {NULL};
-static GDBusProxy* _proxy_sensor[MAX_NUM_FRUS][MAX_SENSOR_NUM] = {NULL};
 
 static GDBusProxy*
 get_dbus_proxy(const char* path, const char* interface) {
@@ -43,144 +40,108 @@ get_dbus_proxy(const char* path, const char* interface) {
 
   if (error != NULL) {
     syslog(LOG_ERR, "DBus error in setting proxy for object %s at inteface %s", path, interface);
+    g_error_free(error);
   }
   return proxy;
 }
 
-// function to get proxy to DBUS FRU Object based on fru
-static GDBusProxy*
-get_proxy_fruobject (uint8_t fru){
+// Read all sensors of readings with one getSensorValues call on the tree
+static int
+sensor_read_bulk(sensor_svc_reading_t *readings, int cnt, gboolean raw) {
+  GVariantBuilder *builder;
+  GVariantIter *iter;
   GVariant *response;
-  const gchar* fruPath;
   GError *error = NULL;
+  guchar fru, snr;
+  gint status;
+  gdouble val;
+  guint64 ts;
+  int i;
+
+  if (readings == NULL || cnt <= 0) {
+    return -1;
+  }
 
   if (_proxy_sensor_service == NULL) {
     _proxy_sensor_service = get_dbus_proxy(SENSOR_SVC_BASE_PATH, SENSOR_SVC_SENSOR_TREE_INTERFACE);
     if (_proxy_sensor_service == NULL) {
-      return NULL;
+      return -1;
     }
   }
 
-  //create proxy to FRU object if not yet created
-  if (_proxy_fru[fru] == NULL) {
-    // Get fru path from sensor service
-    response = g_dbus_proxy_call_sync(
-        _proxy_sensor_service,
-        "org.openbmc.SensorTree.getFruPathById",
-        g_variant_new ("(y)", fru),
-        G_DBUS_CALL_FLAGS_NONE,
-        -1,
-        NULL,
-        &error);
-
-    if (error != NULL) {
-      syslog (LOG_ERR, "DBUS error in get_proxy_fruobject fru %d, %s", fru, error->message);
-      g_object_unref(_proxy_sensor_service);
-      _proxy_sensor_service = NULL; // Proxy to sensor service not working, reset
-      return NULL;
-    }
-
-    g_variant_get(response, "(&s)", &fruPath);
-
-    if ((fruPath == NULL) || (fruPath[0] == '\0')) {
-      syslog (LOG_ERR, "Could not locate fru %d", fru);
-      return NULL;
-    }
-
-    _proxy_fru[fru] = get_dbus_proxy(fruPath, SENSOR_SVC_SENSOR_TREE_INTERFACE);
-    g_variant_unref(response);
-
+  builder = g_variant_builder_new(G_VARIANT_TYPE("a(yy)"));
+  for (i = 0; i < cnt; i++) {
+    g_variant_builder_add(builder, "(yy)", readings[i].fru, readings[i].sensor_num);
+    readings[i].status = -1;
   }
-  return _proxy_fru[fru];
-}
+  response = g_dbus_proxy_call_sync(
+      _proxy_sensor_service,
+      "org.openbmc.SensorTree.getSensorValues",
+      g_variant_new("(a(yy)b)", builder, raw),
+      G_DBUS_CALL_FLAGS_NONE,
+      -1,
+      NULL,
+      &error);
+  g_variant_builder_unref(builder);
 
-// function to get proxy to DBUS Sensor Object based on fru and sensor_num
-static GDBusProxy*
-get_proxy_sensorobject (uint8_t fru, uint8_t sensor_num){
-  GDBusProxy* fruProxy;
-  GError* error = NULL;
-  const gchar* sensorPath;
-  GVariant *response;
+  if (error != NULL) {
+    syslog(LOG_ERR, "DBUS error in getSensorValues, %s", error->message);
+    g_error_free(error);
+    g_object_unref(_proxy_sensor_service);
+    _proxy_sensor_service = NULL; // Proxy to sensor service not working, reset
+    return -1;
+  }
 
-  //create proxy to sensor object if not yet created
-  if (_proxy_sensor[fru][sensor_num] == NULL) {
-
-    if ((fruProxy = get_proxy_fruobject(fru)) != NULL) {
-      // Get sensor path from fru
-      response = g_dbus_proxy_call_sync(
-          fruProxy,
-          "org.openbmc.SensorTree.getSensorPathById",
-          g_variant_new ("(y)", sensor_num),
-          G_DBUS_CALL_FLAGS_NONE,
-          -1,
-          NULL,
-          &error);
-
-      if (error != NULL) {
-        syslog (LOG_ERR, "DBUS error in get_proxy_sensorobject fru %d sensor %d, %s", fru, sensor_num, error->message);
-        g_object_unref(_proxy_fru[fru]);
-        _proxy_fru[fru] = NULL; // Proxy to FRU not working, reset
-        return NULL;
-      }
-
-      g_variant_get(response, "(&s)", &sensorPath);
-
-      if ((sensorPath == NULL) || (sensorPath[0] == '\0')) {
-        syslog (LOG_ERR, "Could not locate sensor %d", sensor_num);
-        return NULL;
-      }
-
-      _proxy_sensor[fru][sensor_num] = get_dbus_proxy(sensorPath, SENSOR_SVC_SENSOR_OBJECT_INTERFACE);
-      g_variant_unref(response);
+  // values come back in the order requested
+  g_variant_get(response, "(a(yyidt))", &iter);
+  for (i = 0; i < cnt && g_variant_iter_next(iter, "(yyidt)", &fru, &snr, &status, &val, &ts); i++) {
+    if (fru != readings[i].fru || snr != readings[i].sensor_num) {
+      continue;
+    }
+    readings[i].status = status;
+    readings[i].timestamp = ts;
+    if (status == 0) {
+      readings[i].value = val;
     }
   }
-  return _proxy_sensor[fru][sensor_num];
+  g_variant_iter_free(iter);
+  g_variant_unref(response);
+
+  return 0;
 }
 
 static int
-sensor_read(uint8_t fru, uint8_t sensor_num, float *value, const char* method) {
-  GDBusProxy* proxy = NULL;
-  int readStatus;
-  GVariant *response;
-  GError *error = NULL;
-  gdouble val;
-
-  //create proxy to sensor object if not yet is created
-  if ((proxy = get_proxy_sensorobject(fru, sensor_num)) != NULL) {
-    response = g_dbus_proxy_call_sync(
-        proxy,
-        method,
-        NULL,
-        G_DBUS_CALL_FLAGS_NONE,
-        -1,
-        NULL,
-        &error);
-
-    if (error != NULL) {
-      syslog (LOG_ERR, "DBUS error in sensorRead senor_num %d, %s", sensor_num, error->message);
-      g_object_unref(_proxy_sensor[fru][sensor_num]);
-      _proxy_sensor[fru][sensor_num] = NULL; // Proxy to Sensor not working, reset
-      return -1;
-    }
-
-    g_variant_get(response, "(id)", &readStatus, &val);
-    g_variant_unref(response);
-    if (readStatus == 0) {
-      *value = val;
-    }
-
-    return readStatus;
+sensor_read(uint8_t fru, uint8_t sensor_num, float *value, gboolean raw) {
+  sensor_svc_reading_t reading = {
+    .fru = fru,
+    .sensor_num = sensor_num,
+  };
+
+  if (sensor_read_bulk(&reading, 1, raw)) {
+    return -1;
   }
-
-  return -1;
+  if (reading.status == 0) {
+    *value = reading.value;
+  }
+  return reading.status;
 }
 
 int
 sensor_svc_raw_read(uint8_t fru, uint8_t sensor_num, float *value) {
-  return sensor_read(fru, sensor_num, value, "org.openbmc.SensorObject.sensorRawRead");
+  return sensor_read(fru, sensor_num, value, TRUE);
 }
 
 int
 sensor_svc_read(uint8_t fru, uint8_t sensor_num, float *value) {
-  return sensor_read(fru, sensor_num, value, "org.openbmc.SensorObject.sensorRead");
+  return sensor_read(fru, sensor_num, value, FALSE);
+}
+
+int
+sensor_svc_read_bulk(sensor_svc_reading_t *readings, int cnt) {
+  return sensor_read_bulk(readings, cnt, FALSE);
+}
+
+int
+sensor_svc_raw_read_bulk(sensor_svc_reading_t *readings, int cnt) {
+  return sensor_read_bulk(readings, cnt, TRUE);
 }
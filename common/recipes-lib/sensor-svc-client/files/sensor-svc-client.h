@@ -32,9 +32,24 @@ extern "C" {
 #define SENSOR_SVC_SENSOR_TREE_INTERFACE "org.openbmc.SensorTree"
 #define SENSOR_SVC_SENSOR_OBJECT_INTERFACE "org.openbmc.SensorObject"
 
+typedef struct {
+  uint8_t fru;          /* sensor to read, set by the caller */
+  uint8_t sensor_num;
+  int status;           /* 0 or the read status of the sensor */
+  float value;
+  uint64_t timestamp;   /* seconds since the epoch of the last successful
+                           read, 0 if never read */
+} sensor_svc_reading_t;
+
 extern int sensor_svc_raw_read(uint8_t fru, uint8_t sensor_num, float *value);
 extern int sensor_svc_read(uint8_t fru, uint8_t sensor_num, float *value);
 
+/* Read the sensors of readings[0..cnt) in one call to the sensor service.
+ * Returns 0 if the call went through, then each reading holds its own
+ * status; -1 otherwise. */
+extern int sensor_svc_read_bulk(sensor_svc_reading_t *readings, int cnt);
+extern int sensor_svc_raw_read_bulk(sensor_svc_reading_t *readings, int cnt);
+
 #ifdef __cplusplus
 } // extern "C"
 #endif
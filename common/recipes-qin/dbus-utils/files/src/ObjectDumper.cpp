@@ -52,6 +52,10 @@ DEFINE_bool(r, false, "Recursively dump the child objects");
 
 DEFINE_bool(t, false, "Dump the whole tree recursively");
 
+DEFINE_int64(since, -1, "Dump only the objects of the tree changed after "
+                        "this version, 0 for all; the version of the dump "
+                        "is printed");
+
 DEFINE_string(dbus_name, "org.openbmc.Sensord", "DBus name to be connected");
 
 DEFINE_string(object_path, "/org/openbmc/Chassis",
@@ -102,11 +106,17 @@ int main (int argc, char* argv[]) {
     method_name = "org.openbmc.Object.dumpTree";
   }
 
+  GVariant* params = nullptr;
+  if (FLAGS_since >= 0) {
+    method_name = "org.openbmc.Object.dumpTreeSince";
+    params = g_variant_new("(t)", (guint64)FLAGS_since);
+  }
+
   LOG(INFO) << "Invoking the method " << method_name;
   error = nullptr;
   GVariant* result = g_dbus_proxy_call_sync(proxy,
                                             method_name.c_str(),
-                                            NULL,
+                                            params,
                                             G_DBUS_CALL_FLAGS_NONE,
                                             -1,
                                             NULL,
@@ -118,7 +128,13 @@ int main (int argc, char* argv[]) {
   }
 
   const char* cdump;
-  g_variant_get(result, "(&s)", &cdump);
+  if (FLAGS_since >= 0) {
+    guint64 version;
+    g_variant_get(result, "(t&s)", &version, &cdump);
+    std::cout << "version: " << version << std::endl;
+  } else {
+    g_variant_get(result, "(&s)", &cdump);
+  }
   nlohmann::json jsonDump = nlohmann::json::parse(std::string(cdump));
   LOG(INFO) << "Printing the dump result.";
   std::cout << jsonDump.dump(2) << std::endl;
@@ -22,6 +22,7 @@
 #include <system_error>
 #include <glog/logging.h>
 #include <gio/gio.h>
+#include <nlohmann/json.hpp>
 #include <object-tree/Object.h>
 #include "DBusObjectInterface.h"
 
@@ -68,6 +69,11 @@ const char* DBusObjectInterface::xml =
   "    <method name='dumpTree'>"
   "      <arg type='s' name='json string' direction='out'/>"
   "    </method>"
+  "    <method name='dumpTreeSince'>"
+  "      <arg type='t' name='version' direction='in'/>"
+  "      <arg type='t' name='version' direction='out'/>"
+  "      <arg type='s' name='json string' direction='out'/>"
+  "    </method>"
   "  </interface>"
   "</node>";
 
@@ -238,7 +244,7 @@ void DBusObjectInterface::dumpRecursiveByObject(
   Object* obj = static_cast<Object*>(arg);
   LOG(INFO) << "Dumpping the object \"" << obj->getName()
     << "\" recursively into json string";
-  const std::string objDump = obj->dumpToJsonRecursive().dump();
+  const std::string &objDump = obj->dumpToStringRecursive();
   g_dbus_method_invocation_return_value(invocation,
                                         g_variant_new("(s)", objDump.c_str()));
 }
@@ -251,11 +257,27 @@ void DBusObjectInterface::dumpTree(GDBusMethodInvocation* invocation,
   }
   LOG(INFO) << "Dumpping the object tree starting at root " << root->getName()
     << " into json string";
-  const std::string treeDump = root->dumpToJsonRecursive().dump();
+  const std::string &treeDump = root->dumpToStringRecursive();
   g_dbus_method_invocation_return_value(invocation,
                                         g_variant_new("(s)", treeDump.c_str()));
 }
 
+void DBusObjectInterface::dumpTreeSince(GDBusMethodInvocation* invocation,
+                                        GVariant*              gvparam,
+                                        gpointer               arg) {
+  guint64 since;
+  g_variant_get(gvparam, "(t)", &since);
+  Object* root = static_cast<Object*>(arg);
+  while (root->getParent() != nullptr) {
+    root = root->getParent();
+  }
+  LOG(INFO) << "Dumpping the objects changed since version " << since;
+  nlohmann::json changes = nlohmann::json::array();
+  guint64 version = root->dumpChangesSince(since, changes);
+  g_dbus_method_invocation_return_value(
+      invocation, g_variant_new("(ts)", version, changes.dump().c_str()));
+}
+
 void DBusObjectInterface::methodCallBack(
                           GDBusConnection*       connection,
                           const char*            sender,
@@ -290,6 +312,8 @@ void DBusObjectInterface::methodCallBack(
     dumpRecursiveByObject(invocation, arg);
   } else if (g_strcmp0(methodName, "dumpTree") == 0) {
     dumpTree(invocation, arg);
+  } else if (g_strcmp0(methodName, "dumpTreeSince") == 0) {
+    dumpTreeSince(invocation, parameters, arg);
   }
 }
 
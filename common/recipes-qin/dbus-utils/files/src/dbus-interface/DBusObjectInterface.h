@@ -159,6 +159,20 @@ class DBusObjectInterface: public DBusInterfaceBase {
     static void dumpTree(GDBusMethodInvocation* invocation,
                          gpointer               arg);
 
+    /**
+     * Dump the objects of the whole tree which changed after the version
+     * passed in. Returns the current version of the tree, to be passed in
+     * the next time, and a JSON array of the changed objects, each as
+     * dumped by dumpByObject plus its objectPath.
+     *
+     * @param invocation stands for the identity of the message
+     * @param gvparam contains the version seen last; 0 for all objects
+     * @param arg is the pointer to the specified object
+     */
+    static void dumpTreeSince(GDBusMethodInvocation* invocation,
+                              GVariant*              gvparam,
+                              gpointer               arg);
+
     /**
      * Handles the callback by matching the method names in the DBus message
      * to the functions. The above callbacks should be invoked here with
@@ -17,6 +17,8 @@
  */
 
 #include <string>
+#include <atomic>
+#include <time.h>
 #include <unordered_map>
 #include <glog/logging.h>
 #include <nlohmann/json.hpp>
@@ -39,8 +41,21 @@ std::unordered_map<std::string, const unsigned int> Attribute::stringModesMap =
     {"RW", RW}
   };
 
+// Generations start at the wall clock time in microseconds, so the ones
+// of a restarted process are above any a client got from the previous one
+static uint64_t initialGeneration() {
+  struct timespec ts;
+  clock_gettime(CLOCK_REALTIME, &ts);
+  return (uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+uint64_t Attribute::nextVersion() {
+  static std::atomic<uint64_t> generation{initialGeneration()};
+  return ++generation;
+}
+
 nlohmann::json Attribute::dumpToJson() const {
-  LOG(INFO) << "Dumpping the info for Attribute \"" << name_ << "\"";
+  VLOG(1) << "Dumpping the info for Attribute \"" << name_ << "\"";
   nlohmann::json dump;
   dump["name"] = name_;
   dump["value"] = value_;
@@ -18,6 +18,7 @@
 
 #pragma once
 #include <string>
+#include <cstdint>
 #include <unordered_map>
 #include <nlohmann/json.hpp>
 
@@ -40,6 +41,15 @@ class Attribute {
     std::string name_;
     std::string value_{""};
     Modes       modes_{RO};
+    uint64_t    version_;     // generation of the last change
+
+    /**
+     * Mark the attribute as changed. Derived classes call it when they
+     * change anything that is dumped.
+     */
+    void touch() {
+      version_ = nextVersion();
+    }
 
   public:
     /**
@@ -47,6 +57,7 @@ class Attribute {
      */
     Attribute(const std::string &name) {
       name_  = name;
+      version_ = nextVersion();
     }
 
     virtual ~Attribute() {}
@@ -63,8 +74,15 @@ class Attribute {
       return modes_;
     }
 
+    uint64_t getVersion() const {
+      return version_;
+    }
+
     void setValue(const std::string &value) {
-      value_ = value;
+      if (value != value_) {
+        value_ = value;
+        touch();
+      }
     }
 
     /**
@@ -74,7 +92,10 @@ class Attribute {
      *  @param modes is either RO, WO, or RW
      */
     void setModes(Modes modes) {
-      modes_ = modes;
+      if (modes != modes_) {
+        modes_ = modes;
+        touch();
+      }
     }
 
     /**
@@ -106,6 +127,16 @@ class Attribute {
      *         modes: modes in string of the attribute
      */
     virtual nlohmann::json dumpToJson() const;
+
+    /**
+     * Returns a new generation number. Generations increase with every
+     * change to any attribute or object in the process, so a dump can be
+     * tagged with the generation it reflects. They start at the wall
+     * clock time in microseconds and so keep increasing across restarts.
+     *
+     * @return generation number, never 0
+     */
+    static uint64_t nextVersion();
 };
 
 } // namespace qin
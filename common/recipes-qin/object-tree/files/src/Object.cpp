@@ -17,6 +17,7 @@
  */
 
 #include <string>
+#include <algorithm>
 #include <stdexcept>
 #include <unordered_map>
 #include <memory>
@@ -58,6 +59,7 @@ Attribute* Object::addAttribute(const std::string &name) {
   std::unique_ptr<Attribute> upAttr(new Attribute(name));
   Attribute* attr = upAttr.get();
   attrMap_.insert(std::make_pair(name, std::move(upAttr)));
+  touch();
   return attr;
 }
 
@@ -70,6 +72,7 @@ void Object::deleteAttribute(const std::string &name) {
     throw std::invalid_argument("Attribute not found");
   }
   attrMap_.erase(name);
+  touch();
 }
 
 void Object::addChildObject(Object &child) {
@@ -84,6 +87,7 @@ void Object::addChildObject(Object &child) {
   }
   childMap_.insert({child.getName(), &child});
   child.setParent(this);
+  touch();
 }
 
 Object* Object::removeChildObject(const std::string &name) {
@@ -99,6 +103,7 @@ Object* Object::removeChildObject(const std::string &name) {
   }
   childMap_.erase(name);
   child->setParent(nullptr);
+  touch();
   return child;
 }
 
@@ -131,6 +136,84 @@ nlohmann::json Object::dumpToJsonRecursive() const {
   return dump;
 }
 
+const std::string& Object::dumpToStringRecursive(bool refresh) const {
+  updateDump(refresh);
+  return dumpCache_;
+}
+
+uint64_t Object::dumpChangesSince(uint64_t       since,
+                                  nlohmann::json &changes,
+                                  bool           refresh) const {
+  uint64_t version = updateDump(refresh);
+  if (since > version) {
+    since = 0;
+  }
+  collectChanges(since, changes);
+  return version;
+}
+
+nlohmann::json Object::dumpSelf() const {
+  nlohmann::json dump = Object::dump();
+  dump["childObjectCount"] = getChildCount();
+  return dump;
+}
+
+uint64_t Object::getSelfVersion() const {
+  uint64_t version = version_;
+  for (auto &it : attrMap_) {
+    version = std::max(version, it.second->getVersion());
+  }
+  return version;
+}
+
+uint64_t Object::updateDump(bool refresh) const {
+  if (refresh) {
+    refreshAttrValues();
+  }
+  uint64_t version = getSelfVersion();
+  for (auto &it : childMap_) {
+    version = std::max(version, it.second->updateDump(refresh));
+  }
+  if (version == dumpVersion_) {
+    return version;
+  }
+
+  VLOG(1) << "Serializing object \"" << name_ << "\" into json";
+  std::string str = dumpSelf().dump();
+  if (!childMap_.empty()) {
+    // reopen the object to append the serialized children
+    str.pop_back();
+    str += ",\"childObjects\":[";
+    for (auto cit = childMap_.begin(); cit != childMap_.end(); cit++) {
+      if (cit != childMap_.begin()) {
+        str += ',';
+      }
+      str += cit->second->dumpCache_;
+    }
+    str += "]}";
+  }
+  dumpCache_ = std::move(str);
+  dumpVersion_ = version;
+  return version;
+}
+
+void Object::collectChanges(uint64_t since, nlohmann::json &changes) const {
+  if (dumpVersion_ <= since) {
+    return; // nothing changed in the subtree
+  }
+  if (getSelfVersion() > since) {
+    nlohmann::json dump = dumpSelf();
+    dump["objectPath"] = getObjectPath();
+    for (auto cit = childMap_.begin(); cit != childMap_.end(); cit++) {
+      dump["childObjectNames"].push_back(cit->first);
+    }
+    changes.push_back(dump);
+  }
+  for (auto &it : childMap_) {
+    it.second->collectChanges(since, changes);
+  }
+}
+
 nlohmann::json Object::dump() const {
   nlohmann::json dump;
   dump["objectName"] = name_;
@@ -18,6 +18,7 @@
 
 #pragma once
 #include <string>
+#include <cstdint>
 #include <system_error>
 #include <memory>
 #include <nlohmann/json.hpp>
@@ -46,6 +47,12 @@ class Object {
     AttrMap     attrMap_;
     Object*     parent_{nullptr};   // pointer to the parent object
     ChildMap    childMap_;
+    uint64_t    version_;           // generation of the last change to the
+                                    // object itself, not its attributes
+
+    // serialized dump of the subtree, valid for generation dumpVersion_
+    mutable std::string dumpCache_;
+    mutable uint64_t    dumpVersion_{0};
 
   public:
     /**
@@ -57,6 +64,7 @@ class Object {
     Object(const std::string &name, Object* parent = nullptr) {
       name_ = name;
       parent_ = parent;
+      version_ = Attribute::nextVersion();
       LOG(INFO) << "Creating Object \"" << name << "\"";
       if (parent_ != nullptr) {
         parent_->addChildObject(*this);
@@ -214,6 +222,38 @@ class Object {
      */
     virtual nlohmann::json dumpToJsonRecursive() const;
 
+    /**
+     * Dump the object and its child objects recursively into a json
+     * string with the entries of dumpToJsonRecursive(). The string of
+     * every subtree is kept, and only subtrees with a change since the
+     * previous dump are serialized again.
+     *
+     * @param refresh read the attribute values again first; this may do
+     *        hardware I/O, so it is off by default and the last values
+     *        read are dumped
+     * @return json string; valid until the next dump of the object
+     */
+    const std::string& dumpToStringRecursive(bool refresh = false) const;
+
+    /**
+     * Collect the objects of the subtree which changed after generation
+     * since. Each changed object is dumped as in dumpToJson(), plus its
+     * objectPath; a removed child shows as a change of its parent.
+     *
+     * @param since generation seen by the caller; 0 for all objects. A
+     *        generation above the current one, e.g. from before the
+     *        clock was set back and the process restarted, also gets
+     *        all objects
+     * @param changes json array the changed objects are appended to
+     * @param refresh read the attribute values again first, as in
+     *        dumpToStringRecursive()
+     * @return current generation of the subtree, to pass as since
+     *         the next time
+     */
+    uint64_t dumpChangesSince(uint64_t       since,
+                              nlohmann::json &changes,
+                              bool           refresh = false) const;
+
     /**
      * Get object path from root.
      *
@@ -225,8 +265,52 @@ class Object {
 
     void setParent(Object* parent) {
       parent_ = parent;
+      touch();
     }
 
+    /**
+     * Mark the object itself as changed, e.g. when its attributes or
+     * children are added or removed.
+     */
+    void touch() {
+      version_ = Attribute::nextVersion();
+    }
+
+    /**
+     * Bring attribute values up to date before a dump asked to refresh.
+     * Does nothing here; objects whose values come from hardware
+     * override it.
+     */
+    virtual void refreshAttrValues() const {}
+
+    /**
+     * Dump the object info without its child objects, as serialized in
+     * dumpToStringRecursive(). Derived classes add their own entries.
+     *
+     * @return nlohmann json object with the entries of dump() plus
+     *         childObjectCount
+     */
+    virtual nlohmann::json dumpSelf() const;
+
+    /**
+     * Generation of the last change to the object or its attributes.
+     */
+    uint64_t getSelfVersion() const;
+
+    /**
+     * Serialize again the parts of the subtree which changed.
+     *
+     * @param refresh call refreshAttrValues() on every object first
+     * @return current generation of the subtree
+     */
+    uint64_t updateDump(bool refresh) const;
+
+    /**
+     * Helper of dumpChangesSince() working on the generations of the last
+     * updateDump().
+     */
+    void collectChanges(uint64_t since, nlohmann::json &changes) const;
+
     /**
      * Get attribute of the given name and ensure it exists.
      *
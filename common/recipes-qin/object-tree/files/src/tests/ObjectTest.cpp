@@ -20,6 +20,7 @@
 #include <string>
 #include <stdexcept>
 #include <system_error>
+#include <time.h>
 #include <nlohmann/json.hpp>
 #include <glog/logging.h>
 #include <gtest/gtest.h>
@@ -159,6 +160,76 @@ TEST_F(ObjectTest, DumpToJson) {
   std::cout << obj_->dumpToJsonRecursive().dump(2) << std::endl;
 }
 
+TEST_F(ObjectTest, DumpToStringRecursive) {
+  Object child("child", obj_);
+  obj_->addAttribute("1_input");
+  child.addAttribute("1_max")->setValue("80000");
+
+  const std::string dump = obj_->dumpToStringRecursive();
+  EXPECT_EQ(nlohmann::json::parse(dump), obj_->dumpToJsonRecursive());
+  EXPECT_EQ(obj_->dumpToStringRecursive(), dump);
+
+  // a change is picked up, an equal value is not a change
+  child.getAttribute("1_max")->setValue("81000");
+  EXPECT_NE(obj_->dumpToStringRecursive(), dump);
+  EXPECT_EQ(nlohmann::json::parse(obj_->dumpToStringRecursive()),
+            obj_->dumpToJsonRecursive());
+  const std::string dump2 = obj_->dumpToStringRecursive();
+  child.getAttribute("1_max")->setValue("81000");
+  EXPECT_EQ(obj_->dumpToStringRecursive(), dump2);
+
+  obj_->removeChildObject("child");
+  EXPECT_EQ(nlohmann::json::parse(obj_->dumpToStringRecursive()),
+            obj_->dumpToJsonRecursive());
+}
+
+TEST_F(ObjectTest, DumpChangesSince) {
+  Object child1("child1", obj_);
+  Object child2("child2", obj_);
+  child1.addAttribute("1_input");
+  child2.addAttribute("1_input");
+
+  nlohmann::json changes = nlohmann::json::array();
+  uint64_t version = obj_->dumpChangesSince(0, changes);
+  EXPECT_EQ(changes.size(), 3u);
+
+  changes = nlohmann::json::array();
+  EXPECT_EQ(obj_->dumpChangesSince(version, changes), version);
+  EXPECT_EQ(changes.size(), 0u);
+
+  child2.getAttribute("1_input")->setValue("42000");
+  changes = nlohmann::json::array();
+  uint64_t version2 = obj_->dumpChangesSince(version, changes);
+  EXPECT_GT(version2, version);
+  ASSERT_EQ(changes.size(), 1u);
+  const std::string &path = changes[0]["objectPath"];
+  EXPECT_STREQ(path.c_str(), "/root/child2");
+
+  // removing a child is a change of the parent
+  obj_->removeChildObject("child1");
+  changes = nlohmann::json::array();
+  obj_->dumpChangesSince(version2, changes);
+  ASSERT_EQ(changes.size(), 1u);
+  EXPECT_EQ(changes[0]["childObjectCount"], 1);
+}
+
+TEST_F(ObjectTest, DumpChangesSinceRestart) {
+  Object child1("child1", obj_);
+  child1.addAttribute("1_input");
+
+  // generations continue from the wall clock, not from 0
+  struct timespec ts;
+  clock_gettime(CLOCK_REALTIME, &ts);
+  nlohmann::json changes = nlohmann::json::array();
+  uint64_t version = obj_->dumpChangesSince(0, changes);
+  EXPECT_GT(version, (uint64_t)(ts.tv_sec - 3600) * 1000000);
+
+  // a version the process never handed out gets the whole tree
+  changes = nlohmann::json::array();
+  EXPECT_EQ(obj_->dumpChangesSince(version + 1000000, changes), version);
+  EXPECT_EQ(changes.size(), 2u);
+}
+
 int main(int argc, char **argv) {
   ::testing::InitGoogleTest(&argc, argv);
   ::google::InitGoogleLogging(argv[0]);
@@ -18,6 +18,8 @@
 
 #pragma once
 #include <string>
+#include <vector>
+#include <system_error>
 #include <nlohmann/json.hpp>
 #include <object-tree/Object.h>
 #include "SensorAttribute.h"
@@ -43,6 +45,29 @@ class SensorApi {
     virtual const std::string readValue(const Object          &object,
                                         const SensorAttribute &attr) const = 0;
 
+    /**
+     * Reads the values of attrs of object in one pass and stores them in
+     * the attributes. An attribute which fails to be read keeps its
+     * previous value. Reads them one by one with readValue here; derived
+     * classes may batch the access.
+     *
+     * @param object of Attributes to be read
+     * @param attrs to be read
+     * @return number of attributes which failed to be read
+     */
+    virtual int readValues(const Object                        &object,
+                           const std::vector<SensorAttribute*> &attrs) {
+      int failed = 0;
+      for (SensorAttribute* attr : attrs) {
+        try {
+          attr->setValue(readValue(object, *attr));
+        } catch (const std::system_error &e) {
+          failed++;
+        }
+      }
+      return failed;
+    }
+
     /**
      * Writes value to the path specified by object and attr.
      * It's dummy here. The derived class should implement this function.
@@ -59,6 +84,8 @@ class SensorApi {
      * Dump the sensor api info into json format.
      */
     virtual nlohmann::json dumpToJson() const = 0;
+
+    virtual ~SensorApi() {}
 };
 } // namespace qin
 } // namespace openbmc
@@ -30,18 +30,29 @@ namespace qin {
 class SensorAttribute : public Attribute {
   private:
     std::string addr_{""}; // address to be accessed through SensorApi
+    unsigned int ttl_{0};  // ms a value read stays valid; 0 to always read
 
   public:
     using Attribute::Attribute; // inherit constructor
 
     void setAddr(const std::string &addr) {
       addr_ = addr;
+      touch();
     }
 
     const std::string& getAddr() const {
       return addr_;
     }
 
+    void setTtl(unsigned int ttl) {
+      ttl_ = ttl;
+      touch();
+    }
+
+    unsigned int getTtl() const {
+      return ttl_;
+    }
+
     /**
      * Setting addr_ to an non-empty string will make the sensor attribute
      * accessible through SensorApi.
@@ -62,11 +73,13 @@ class SensorAttribute : public Attribute {
      *
      *         addr: string corresponding to addr_
      *         isAccessible: bool corresponding to isAccessible
+     *         ttl: unsigned int corresponding to ttl_
      */
     nlohmann::json dumpToJson() const override {
       nlohmann::json dump = Attribute::dumpToJson();
       dump["addr"] = addr_;
       dump["isAccessible"] = isAccessible();
+      dump["ttl"] = ttl_;
       return dump;
     }
 };
@@ -17,10 +17,12 @@
  */
 
 #include <string>
+#include <vector>
 #include <system_error>
 #include <glog/logging.h>
 #include <object-tree/Attribute.h>
 #include "SensorDevice.h"
+#include "SensorObject.h"
 #include "SensorApi.h"
 #include "SensorAttribute.h"
 
@@ -42,17 +44,50 @@ SensorAttribute* SensorDevice::addAttribute(const std::string &name) {
 
 const std::string& SensorDevice::readAttrValue(const Object    &object,
                                                SensorAttribute &attr) const {
-  LOG(INFO) << "SensorDevice \"" << name_ << "\" reading Attribute " << "\""
+  VLOG(1) << "SensorDevice \"" << name_ << "\" reading Attribute " << "\""
     << attr.getName() << "\" value of Object \"" << object.getName() << "\"";
   DCHECK(attr.isReadable()) << "SensorAttribute \"" << attr.getName()
     << "\" is not readable";
-  attr.setValue(sensorApi_.get()->readValue(object, attr));
+  if (attr.isAccessible()) {
+    attr.setValue(sensorApi_.get()->readValue(object, attr));
+  }
   return attr.getValue();
 }
 
+int SensorDevice::readAttrValues(const Object &object) const {
+  std::vector<SensorAttribute*> attrs;
+  attrs.reserve(object.getAttrCount());
+  for (const auto &it : object.getAttrMap()) {
+    SensorAttribute* attr = static_cast<SensorAttribute*>(it.second.get());
+    if (attr->isReadable() && attr->isAccessible()) {
+      attrs.push_back(attr);
+    }
+  }
+  if (attrs.empty()) {
+    return 0;
+  }
+  int failed = sensorApi_.get()->readValues(object, attrs);
+  if (failed > 0) {
+    LOG(WARNING) << "SensorDevice \"" << name_ << "\" failed reading "
+      << failed << " Attributes of Object \"" << object.getName() << "\"";
+  }
+  return failed;
+}
+
+int SensorDevice::readAllAttrValues() const {
+  int failed = readAttrValues(*this);
+  for (const auto &it : childMap_) {
+    // child SensorDevices read through their own sensorApi_
+    if (dynamic_cast<SensorObject*>(it.second) != nullptr) {
+      failed += readAttrValues(*it.second);
+    }
+  }
+  return failed;
+}
+
 const std::string& SensorDevice::readAttrValue(
                                    const std::string &name) const {
-  LOG(INFO) << "Reading the value of Attribute \"" << name << "\"";
+  VLOG(1) << "Reading the value of Attribute \"" << name << "\"";
   SensorAttribute* attr =
       static_cast<SensorAttribute*>(getReadableAttribute(name));
   return readAttrValue(*this, *attr);
@@ -88,6 +88,25 @@ class SensorDevice : public Object {
     const std::string& readAttrValue(const Object    &object,
                                      SensorAttribute &attr) const;
 
+    /**
+     * Read the values of all readable and accessible SensorAttributes of
+     * object through sensorApi_ in one batch. object is this device or
+     * one of its SensorObject children. Attributes which fail to be read
+     * keep their previous value.
+     *
+     * @param object whose attributes are to be read
+     * @return number of attributes which failed to be read
+     */
+    int readAttrValues(const Object &object) const;
+
+    /**
+     * Read the values of the attributes of this device and of all its
+     * SensorObject children, one batch per object.
+     *
+     * @return number of attributes which failed to be read
+     */
+    int readAllAttrValues() const;
+
     /**
      * Read the value of Attribute name with type through sensorApi_.
      *
@@ -125,28 +144,30 @@ class SensorDevice : public Object {
     /**
      * Dump the sensor object info into json format. It calls the
      * Object::dumpToJson() but adds the access method and changes
-     * the objectType to "SensorApi".
+     * the objectType to "SensorApi". The attribute values are the last
+     * ones read; call readAttrValues() first for fresh ones.
      *
      * @return nlohmann::json object with entries specified in
      *         Object::dumpToJson() plus the "access" entry for SensorApi.
      */
     nlohmann::json dumpToJson() const override {
-      LOG(INFO) << "Dumping SensorDevice into json";
+      VLOG(1) << "Dumping SensorDevice into json";
       nlohmann::json dump = Object::dumpToJson();
       addDumpInfo(dump);
       return dump;
     }
 
     /**
-     * Dump the sensor object info iteratively into json format. It calls the
-     * Object::dumpToJsonIterative() but adds the access method and changes
-     * the objectType to "SensorApi".
+     * Dump the sensor object info iteratively into json format. It calls
+     * the Object::dumpToJsonIterative() but adds the access method and
+     * changes the objectType to "SensorApi". The attribute values are the
+     * last ones read; call readAllAttrValues() first for fresh ones.
      *
      * @return nlohmann::json object with entries specified in
      *         Object::dumpToJson() plus the "access" entry for SensorApi.
      */
     nlohmann::json dumpToJsonRecursive() const override {
-      LOG(INFO) << "Dumping SensorDevice recursively into json";
+      VLOG(1) << "Dumping SensorDevice recursively into json";
       nlohmann::json dump = Object::dumpToJsonRecursive();
       addDumpInfo(dump);
       return dump;
@@ -154,6 +175,20 @@ class SensorDevice : public Object {
 
   protected:
 
+    /**
+     * Refresh the values of the device's own attributes in one batch
+     * before a dump asked to refresh.
+     */
+    void refreshAttrValues() const override {
+      readAttrValues(*this);
+    }
+
+    nlohmann::json dumpSelf() const override {
+      nlohmann::json dump = Object::dumpSelf();
+      addDumpInfo(dump);
+      return dump;
+    }
+
     /**
      * A helper function to add the object type and access entries to dump.
      *
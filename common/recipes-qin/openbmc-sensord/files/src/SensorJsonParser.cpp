@@ -283,6 +283,10 @@ void SensorJsonParser::parseSensorAttribute(const nlohmann::json &attributes,
         << addr << "\"";
       (static_cast<SensorAttribute*>(attr))->setAddr(addr);
     }
+    if (attribute.find("ttl") != attribute.end()) {
+      unsigned int ttl = attribute.at("ttl");
+      (static_cast<SensorAttribute*>(attr))->setTtl(ttl);
+    }
     if (attribute.find("value") != attribute.end()) {
       const std::string &value = attribute.at("value");
       writeAttrValue(*attr, object, value);
@@ -41,7 +41,7 @@ SensorAttribute* SensorObject::addAttribute(const std::string &name) {
 
 const std::string& SensorObject::readAttrValue(const std::string &name)
     const {
-  LOG(INFO) << "Reading the value of Attribute \n" << name << "\"";
+  VLOG(1) << "Reading the value of Attribute \"" << name << "\"";
   SensorAttribute* attr =
       static_cast<SensorAttribute*>(getReadableAttribute(name));
   return static_cast<SensorDevice*>(parent_)->readAttrValue(*this, *attr);
@@ -108,6 +108,22 @@ class SensorObject : public Object {
 
   protected:
 
+    /**
+     * Refresh the attribute values in one batch through the parent
+     * SensorDevice before a dump asked to refresh.
+     */
+    void refreshAttrValues() const override {
+      if (parent_ != nullptr) {
+        static_cast<SensorDevice*>(parent_)->readAttrValues(*this);
+      }
+    }
+
+    nlohmann::json dumpSelf() const override {
+      nlohmann::json dump = Object::dumpSelf();
+      addDumpInfo(dump);
+      return dump;
+    }
+
     /**
      * A helper function to add the object type entry to dump.
      *
@@ -17,6 +17,8 @@
  */
 
 #include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
 #include <string>
 #include <string.h>
 #include <system_error>
@@ -30,21 +32,80 @@
 namespace openbmc {
 namespace qin {
 
+// sysfs attributes are at most a page
+static const size_t kSysfsMaxRead = 4096;
+
+SensorSysfsApi::~SensorSysfsApi() {
+  for (auto &it : files_) {
+    if (it.second.fd >= 0) {
+      close(it.second.fd);
+    }
+  }
+}
+
+const std::string& SensorSysfsApi::readFile(const SensorAttribute &attr)
+    const {
+  SysfsFile &file = files_[attr.getAddr()];
+  auto now = std::chrono::steady_clock::now();
+
+  if (file.valid && attr.getTtl() > 0 &&
+      now - file.readAt < std::chrono::milliseconds(attr.getTtl())) {
+    return file.value;
+  }
+
+  char buf[kSysfsMaxRead];
+  ssize_t len;
+  // a file kept open goes stale if its device is unbound; reopen it once
+  for (int retry = 0; ; retry++) {
+    if (file.fd < 0) {
+      std::string path = fsPath_ + std::string("/") + attr.getAddr();
+      file.fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+      if (file.fd < 0) {
+        int err = errno;
+        LOG(ERROR) << "Path " << path << " cannot be opened";
+        throw std::system_error(err, std::system_category(), strerror(err));
+      }
+    }
+    if ((len = pread(file.fd, buf, sizeof(buf) - 1, 0)) >= 0) {
+      break;
+    }
+    int err = errno;
+    close(file.fd);
+    file.fd = -1;
+    file.valid = false;
+    if (retry > 0) {
+      LOG(ERROR) << "Path " << fsPath_ << "/" << attr.getAddr()
+        << " cannot be read";
+      throw std::system_error(err, std::system_category(), strerror(err));
+    }
+  }
+
+  const char* eol = static_cast<const char*>(memchr(buf, '\n', len));
+  file.value.assign(buf, eol != nullptr ? eol - buf : len);
+  file.valid = true;
+  file.readAt = now;
+  return file.value;
+}
+
 const std::string SensorSysfsApi::readValue(const Object          &object,
                                             const SensorAttribute &attr)
     const {
-  std::string path = fsPath_ + std::string("/") + attr.getAddr();
-  std::fstream fs;
-  LOG(INFO) << "Reading value from path " << path;
-  fs.open(path, std::fstream::in);
-  if (!fs.is_open()) {
-    LOG(ERROR) << "Path " << path << " cannot be opened";
-    throw std::system_error(errno, std::system_category(), strerror(errno));
+  std::lock_guard<std::mutex> lock(mutex_);
+  return readFile(attr);
+}
+
+int SensorSysfsApi::readValues(const Object                        &object,
+                               const std::vector<SensorAttribute*> &attrs) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  int failed = 0;
+  for (SensorAttribute* attr : attrs) {
+    try {
+      attr->setValue(readFile(*attr));
+    } catch (const std::system_error &e) {
+      failed++;
+    }
   }
-  std::string str;
-  std::getline(fs, str);
-  fs.close();
-  return str;
+  return failed;
 }
 
 void SensorSysfsApi::writeValue(const Object          &object,
@@ -52,7 +113,7 @@ void SensorSysfsApi::writeValue(const Object          &object,
                                 const std::string     &value) {
   std::string path = fsPath_ + std::string("/") + attr.getAddr();
   std::fstream fs;
-  LOG(INFO) << "Writing value " << value <<" to path " << path;
+  VLOG(1) << "Writing value " << value <<" to path " << path;
   fs.open(path, std::fstream::out);
   if (!fs.is_open()) {
     LOG(ERROR) << "Path " << path << " cannot be opened";
@@ -60,6 +121,13 @@ void SensorSysfsApi::writeValue(const Object          &object,
   }
   fs << value;
   fs.close();
+
+  // the next read has to see the value written
+  std::lock_guard<std::mutex> lock(mutex_);
+  auto it = files_.find(attr.getAddr());
+  if (it != files_.end()) {
+    it->second.valid = false;
+  }
 }
 
 } // namespace qin
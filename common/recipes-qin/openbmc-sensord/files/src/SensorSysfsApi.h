@@ -18,6 +18,10 @@
 
 #pragma once
 #include <string>
+#include <vector>
+#include <chrono>
+#include <mutex>
+#include <unordered_map>
 #include <stdexcept>
 #include <fstream>
 #include <glog/logging.h>
@@ -31,16 +35,47 @@ namespace qin {
 /**
  * Sensor API for reading and writing value of the attribute from the
  * SensorObject path.
+ *
+ * The file of an attribute is opened on its first read and kept open;
+ * later reads pread() it again from offset 0, which makes hwmon drivers
+ * report a fresh value. A value may be reused for the ttl of its
+ * attribute before the file is read again.
  */
 class SensorSysfsApi : public SensorApi {
   private:
+    // an opened attribute file and the last value read from it
+    struct SysfsFile {
+      int                                   fd{-1};
+      bool                                  valid{false};
+      std::string                           value;
+      std::chrono::steady_clock::time_point readAt;
+    };
+
     std::string fsPath_;
+    // map from attribute addr to its file
+    mutable std::unordered_map<std::string, SysfsFile> files_;
+    mutable std::mutex mutex_;
+
+    /**
+     * Reads the first line of the attribute file unless the cached value
+     * is still within the ttl of attr. Must be called with mutex_ held.
+     *
+     * @param attr of the value to be read
+     * @throw std::system_error if the file cannot be opened or read
+     * @return value read
+     */
+    const std::string& readFile(const SensorAttribute &attr) const;
 
   public:
     SensorSysfsApi(const std::string &fsPath) {
       fsPath_ = fsPath;
     }
 
+    /**
+     * Closes the attribute files kept open.
+     */
+    ~SensorSysfsApi();
+
     const std::string& getFsPath() const {
       return fsPath_;
     }
@@ -52,12 +87,23 @@ class SensorSysfsApi : public SensorApi {
      *
      * @param object of Attribute to be read
      * @param attr of the value to be read
-     * @throw errno if the file cannot be opened
+     * @throw errno if the file cannot be opened or read
      * @return value read
      */
     const std::string readValue(const Object          &object,
                                 const SensorAttribute &attr) const override;
 
+    /**
+     * Reads the values of attrs under one lock through the files kept
+     * open. Attributes which fail keep their previous value.
+     *
+     * @param object of Attributes to be read
+     * @param attrs to be read
+     * @return number of attributes which failed to be read
+     */
+    int readValues(const Object                        &object,
+                   const std::vector<SensorAttribute*> &attrs) override;
+
     /**
      * Writes value to the path specified by object and attr. The path
      * will be constructed from fsPath_ and addr in attribute.
@@ -20,6 +20,9 @@
 #include <system_error>
 #include <stdexcept>
 #include <memory>
+#include <fstream>
+#include <stdlib.h>
+#include <unistd.h>
 #include <gtest/gtest.h>
 #include <glog/logging.h>
 #include <gio/gio.h>
@@ -113,6 +116,88 @@ TEST_F(ReadWriteTest, Dump) {
   EXPECT_STREQ(api.c_str(), "sysfs");
 }
 
+class SysfsReadTest : public ::testing::Test {
+  protected:
+    virtual void SetUp() {
+      char dir[] = "/tmp/sensor-sysfs-XXXXXX";
+      ASSERT_TRUE(mkdtemp(dir) != nullptr);
+      dir_ = dir;
+      writeFile("temp1_input", "42000\n");
+      writeFile("temp1_max", "80000\n");
+      std::unique_ptr<SensorSysfsApi> uSysfsApi(new SensorSysfsApi(dir_));
+      sDevice_ = new SensorDevice("sensor1", std::move(uSysfsApi));
+      sObject_ = new SensorObject("temp", sDevice_);
+      sObject_->addAttribute("1_input")->setAddr("temp1_input");
+      SensorAttribute* attrMax = sObject_->addAttribute("1_max");
+      attrMax->setAddr("temp1_max");
+      attrMax->setModes(Attribute::RW);
+      attrMax->setTtl(60000);
+    }
+
+    virtual void TearDown() {
+      delete sObject_;
+      delete sDevice_;
+      unlink((dir_ + "/temp1_input").c_str());
+      unlink((dir_ + "/temp1_max").c_str());
+      rmdir(dir_.c_str());
+    }
+
+    void writeFile(const std::string &name, const std::string &value) {
+      std::ofstream ofs(dir_ + "/" + name);
+      ofs << value;
+    }
+
+    std::string dir_;
+    SensorDevice* sDevice_;
+    SensorObject* sObject_;
+};
+
+TEST_F(SysfsReadTest, BatchRead) {
+  EXPECT_EQ(sDevice_->readAllAttrValues(), 0);
+  EXPECT_STREQ(sObject_->getAttribute("1_input")->getValue().c_str(), "42000");
+  EXPECT_STREQ(sObject_->getAttribute("1_max")->getValue().c_str(), "80000");
+
+  // a missing file fails alone
+  sObject_->addAttribute("2_input")->setAddr("temp2_input");
+  EXPECT_EQ(sDevice_->readAllAttrValues(), 1);
+  EXPECT_THROW(sObject_->readAttrValue("2_input"), std::system_error);
+}
+
+TEST_F(SysfsReadTest, Reread) {
+  ASSERT_NO_THROW(sObject_->readAttrValue("1_input"));
+  ASSERT_NO_THROW(sObject_->readAttrValue("1_max"));
+  writeFile("temp1_input", "43000\n");
+  writeFile("temp1_max", "1\n");
+
+  // the kept file is read again; 1_max is reused within its ttl
+  EXPECT_STREQ(sObject_->readAttrValue("1_input").c_str(), "43000");
+  EXPECT_STREQ(sObject_->readAttrValue("1_max").c_str(), "80000");
+
+  // writing drops the reused value
+  ASSERT_NO_THROW(sObject_->writeAttrValue("1_max", "90000"));
+  EXPECT_STREQ(sObject_->readAttrValue("1_max").c_str(), "90000");
+}
+
+TEST_F(SysfsReadTest, DumpDoesNotRead) {
+  ASSERT_EQ(sDevice_->readAllAttrValues(), 0);
+  writeFile("temp1_input", "44000\n");
+
+  // dumps show the last values read unless asked to refresh
+  nlohmann::json dump = sDevice_->dumpToJsonRecursive();
+  for (auto &attr : dump["childObjects"][0]["attributes"]) {
+    if (attr["name"] == "1_input") {
+      const std::string &value = attr["value"];
+      EXPECT_STREQ(value.c_str(), "42000");
+    }
+  }
+  nlohmann::json tree = nlohmann::json::parse(sDevice_->dumpToStringRecursive());
+  EXPECT_EQ(tree, dump);
+  EXPECT_STREQ(sObject_->getAttribute("1_input")->getValue().c_str(), "42000");
+
+  sDevice_->dumpToStringRecursive(true);
+  EXPECT_STREQ(sObject_->getAttribute("1_input")->getValue().c_str(), "44000");
+}
+
 int main (int argc, char* argv[]) {
   ::testing::InitGoogleTest(&argc, argv);
   ::google::InitGoogleLogging(argv[0]);
@@ -3,6 +3,7 @@
 from subprocess import *
 from node import node
 from pal import *
+from kv import kv_get, FPERSIST, KeyOperationFailure
 
 class healthNode(node):
     def __init__(self, name = None, info = None, actions = None):
@@ -24,16 +25,15 @@ class healthNode(node):
         result = "NA"
         # Enclosure health LED status (GOOD/BAD)
         if (name == "FBTTN"):
-            dpb_hlth = Popen('cat /mnt/data/kv_store/dpb_sensor_health', \
-                                shell=True, stdout=PIPE).stdout.read().decode()
-            iom_hlth = Popen('cat /mnt/data/kv_store/iom_sensor_health', \
-                                shell=True, stdout=PIPE).stdout.read().decode()
-            nic_hlth = Popen('cat /mnt/data/kv_store/nic_sensor_health', \
-                                shell=True, stdout=PIPE).stdout.read().decode()
-            scc_hlth = Popen('cat /mnt/data/kv_store/scc_sensor_health', \
-                                shell=True, stdout=PIPE).stdout.read().decode()
-            slot1_hlth = Popen('cat /mnt/data/kv_store/slot1_sensor_health', \
-                                shell=True, stdout=PIPE).stdout.read().decode()
+            try:
+                dpb_hlth = kv_get('dpb_sensor_health', FPERSIST)
+                iom_hlth = kv_get('iom_sensor_health', FPERSIST)
+                nic_hlth = kv_get('nic_sensor_health', FPERSIST)
+                scc_hlth = kv_get('scc_sensor_health', FPERSIST)
+                slot1_hlth = kv_get('slot1_sensor_health', FPERSIST)
+            except KeyOperationFailure:
+                # A missing key reads as not good, as the empty file did
+                dpb_hlth = iom_hlth = nic_hlth = scc_hlth = slot1_hlth = ""
 
             if ((dpb_hlth == "1")&(iom_hlth == "1")&(nic_hlth == "1")&(scc_hlth == "1")&(slot1_hlth == "1")):
                 result = "Good"
@@ -3,6 +3,7 @@
 from subprocess import *
 from node import node
 from pal import *
+from kv import kv_get, FPERSIST, KeyOperationFailure
 
 class identifyNode(node):
     def __init__(self, name, info = None, actions = None):
@@ -19,9 +20,10 @@ class identifyNode(node):
 
     def getInformation(self, param={}):
         identify_status=""
-        data = Popen('cat /mnt/data/kv_store/identify_slot1', \
-                            shell=True, stdout=PIPE).stdout.read().decode()
-        identify_status = data.strip('\n')
+        try:
+            identify_status = kv_get('identify_slot1', FPERSIST)
+        except KeyOperationFailure:
+            pass
         info = {
                 "Status of identify LED": identify_status
         }
@@ -2,6 +2,7 @@
 
 from node import node
 from pal import *
+from kv import kv_get, FPERSIST, KeyOperationFailure
 
 class pebNode(node):
     def __init__(self, name = None, info = None, actions = None):
@@ -28,9 +29,10 @@ class pebNode(node):
         else:
             status = "Unknown"
 
-        data = Popen('cat /mnt/data/kv_store/system_identify', \
-                            shell=True, stdout=PIPE).stdout.read().decode()
-        identify_status = data.strip('\n')
+        try:
+            identify_status = kv_get('system_identify', FPERSIST)
+        except KeyOperationFailure:
+            identify_status = ""
 
         info = {
                 "Description": name + " PCIe Expansion Board",
@@ -48,7 +48,7 @@ fi
 # Set crashdump timestamp
 sys_runtime=$(awk '{print $1}' /proc/uptime)
 sys_runtime=$(printf "%0.f" $sys_runtime)
-echo $((sys_runtime+630)) > /tmp/cache_store/fru${SLOT_NUM}_crashdump
+kv set fru${SLOT_NUM}_crashdump $((sys_runtime+630))
 
 DUMP_SCRIPT="/usr/local/bin/dump.sh"
 CRASHDUMP_FILE="/mnt/data/crashdump_$SLOT_NAME"
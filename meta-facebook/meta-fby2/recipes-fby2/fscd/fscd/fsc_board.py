@@ -21,6 +21,7 @@ from fsc_util import Logger
 from ctypes import *
 from subprocess import Popen, PIPE
 from re import match
+from kv import kv_get, FPERSIST
 
 lpal_hndl = CDLL("libpal.so")
 
@@ -169,14 +170,12 @@ def sensor_valid_check(board, sname, check_name, attribute):
                             server_type = lpal_hndl.pal_get_server_type(slot_id)
                             if int(server_type) == 1:         #RC Server
                                 # check DIMM present
-                                with open("/mnt/data/kv_store/sys_config/"+fru_map[board]['name']+loc_map_rc[sname[9:10]], "rb") as f:
-                                    dimm_sts = f.read(1)
+                                dimm_sts = kv_get("sys_config/"+fru_map[board]['name']+loc_map_rc[sname[9:10]], FPERSIST, binary=True)
                                 if dimm_sts[0] != 1:
                                     return 0
                             else:   
                                 # check DIMM present
-                                with open("/mnt/data/kv_store/sys_config/"+fru_map[board]['name']+loc_map[sname[8:10]], "rb") as f:
-                                    dimm_sts = f.read(1)
+                                dimm_sts = kv_get("sys_config/"+fru_map[board]['name']+loc_map[sname[8:10]], FPERSIST, binary=True)
                                 if dimm_sts[0] != 1:
                                     return 0
                         return 1
@@ -52,8 +52,8 @@
 #define HOTSERVICE_FILE "/tmp/slot%d_reinit"
 #define HSLOT_PID  "/tmp/slot%u_reinit.pid"
 #define PWR_UTL_LOCK "/var/run/power-util_%d.lock"
-#define POST_FLAG_FILE "/tmp/cache_store/slot%d_post_flag"
-#define SYS_CONFIG_FILE "/mnt/data/kv_store/sys_config/fru%d_*"
+#define POST_FLAG_KEY "slot%d_post_flag"
+#define SYS_CONFIG_KEY "sys_config/fru%d_"
 
 #define DEBUG_ME_EJECTOR_LOG 0 // Enable log "GPIO_SLOTX_EJECTOR_LATCH_DETECT_N is 1 and SLOT_12v is ON" before mechanism issue is fixed
 
@@ -446,8 +446,8 @@ hsvc_event_handler(void *ptr) {
   uint8_t status;
   char vpath[80] = {0};
   char hspath[80] = {0};
-  char postpath[80] = {0};
-  char sys_config_path[80] = {0};
+  char post_flag_key[MAX_KEY_LEN] = {0};
+  char sys_config_key[MAX_KEY_LEN] = {0};
   char cmd[128] = {0};
   char slotrcpath[80] = {0};
   char hslotpid[80] = {0};
@@ -504,17 +504,13 @@ hsvc_event_handler(void *ptr) {
           }
         }
 
-        // Remove post flag file when board has been removed
-        sprintf(postpath, POST_FLAG_FILE, hsvc_info->slot_id);
-        memset(cmd, 0, sizeof(cmd));
-        sprintf(cmd,"rm %s",postpath);
-        system(cmd);
+        // Remove post flag when board has been removed
+        sprintf(post_flag_key, POST_FLAG_KEY, hsvc_info->slot_id);
+        kv_del(post_flag_key, 0);
 
-        // Remove DIMM and CPU related file when board has been removed
-        sprintf(sys_config_path, SYS_CONFIG_FILE, hsvc_info->slot_id);
-        memset(cmd, 0, sizeof(cmd));
-        sprintf(cmd,"rm %s",sys_config_path);
-        system(cmd);
+        // Remove DIMM and CPU related keys when board has been removed
+        sprintf(sys_config_key, SYS_CONFIG_KEY, hsvc_info->slot_id);
+        kv_del(sys_config_key, KV_FPERSIST | KV_FPREFIX);
 
         // Create file for 12V-on re-init
         sprintf(hspath, HOTSERVICE_FILE, hsvc_info->slot_id);
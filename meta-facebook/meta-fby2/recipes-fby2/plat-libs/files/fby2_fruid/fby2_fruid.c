@@ -21,9 +21,10 @@
 #include <stdlib.h>
 #include <stdint.h>
 #include <syslog.h>
+#include <openbmc/kv.h>
 #include "fby2_fruid.h"
 
-#define NIC_FW_VER_PATH "/tmp/cache_store/nic_fw_ver"
+#define NIC_FW_VER_KEY "nic_fw_ver"
 
 static int
 plat_get_ipmb_bus_id(uint8_t slot_id) {
@@ -52,19 +53,14 @@ plat_get_ipmb_bus_id(uint8_t slot_id) {
 
 uint32_t
 fby2_get_nic_mfgid(void) {
-  FILE *fp;
-  uint8_t buf[16];
+  uint8_t buf[MAX_VALUE_LEN] = {0};
+  size_t len = 0;
 
-  fp = fopen(NIC_FW_VER_PATH, "rb");
-  if (!fp) {
+  if (kv_get(NIC_FW_VER_KEY, (char *)buf, &len, 0) || len < 36) {
     return MFG_UNKNOWN;
   }
 
-  fseek(fp, 32 , SEEK_SET);
-  fread(buf, 1, 4, fp);
-  fclose(fp);
-
-  return ((buf[3]<<24)|(buf[2]<<16)|(buf[1]<<8)|buf[0]);
+  return ((buf[35]<<24)|(buf[34]<<16)|(buf[33]<<8)|buf[32]);
 }
 
 /* Populate char path[] with the path to the fru's fruid binary dump */
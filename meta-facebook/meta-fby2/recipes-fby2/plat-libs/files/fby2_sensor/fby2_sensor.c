@@ -31,6 +31,7 @@
 #include <unistd.h>
 #include <time.h>
 #include <openbmc/obmc-i2c.h>
+#include <openbmc/kv.h>
 #include "fby2_sensor.h"
 #include <openbmc/nvme-mi.h>
 
@@ -98,7 +99,7 @@
 #define TOTAL_M2_CH_ON_GP 6
 #define MAX_POS_READING_MARGIN 127
 
-#define SYS_CONFIG_PATH "/mnt/data/kv_store/sys_config/"
+#define SYS_CONFIG_KEY "sys_config/"
 
 static float ml_hsc_r_sense = ML_ADM1278_R_SENSE;
 
@@ -480,11 +481,11 @@ enum ina_register {
 };
 
 rc_dimm_location_info rc_dimm_location_list[] = {
-  // {dimm_location_file, dimm_sensor_number}
-  {SYS_CONFIG_PATH "fru%u_dimm0_location", BIC_RC_SENSOR_SOC_DIMMB_TEMP},
-  {SYS_CONFIG_PATH "fru%u_dimm1_location", BIC_RC_SENSOR_SOC_DIMMA_TEMP},
-  {SYS_CONFIG_PATH "fru%u_dimm2_location", BIC_RC_SENSOR_SOC_DIMMC_TEMP},
-  {SYS_CONFIG_PATH "fru%u_dimm3_location", BIC_RC_SENSOR_SOC_DIMMD_TEMP},
+  // {dimm_location_key, dimm_sensor_number}
+  {SYS_CONFIG_KEY "fru%u_dimm0_location", BIC_RC_SENSOR_SOC_DIMMB_TEMP},
+  {SYS_CONFIG_KEY "fru%u_dimm1_location", BIC_RC_SENSOR_SOC_DIMMA_TEMP},
+  {SYS_CONFIG_KEY "fru%u_dimm2_location", BIC_RC_SENSOR_SOC_DIMMC_TEMP},
+  {SYS_CONFIG_KEY "fru%u_dimm3_location", BIC_RC_SENSOR_SOC_DIMMD_TEMP},
 };
 
 static sensor_info_t g_sinfo[MAX_NUM_FRUS][MAX_SENSOR_NUM] = {0};
@@ -974,33 +975,24 @@ read_nic_temp(const char *device, uint8_t addr, float *value) {
 static int
 rc_dimm_present_check(uint8_t fru, int index, uint8_t sensor_num) {
 
-  int fd;
-  char path[64] = {0};
-  uint8_t dimm_present_status;
-  int dimm_present_data_size = 1;
-
-  sprintf(path, rc_dimm_location_list[index].dimm_location_file, fru);
+  char key[MAX_KEY_LEN] = {0};
+  char value[MAX_VALUE_LEN] = {0};
+  size_t len = 0;
 
-  fd = open(path, O_RDONLY);
-  if (fd < 0) {
-    return -1;     //DIMM location file doesn't exist
-  }
+  sprintf(key, (char *)rc_dimm_location_list[index].dimm_location_key, fru);
 
-  if (read(fd, &dimm_present_status, dimm_present_data_size) != dimm_present_data_size) {
-    close(fd);
-    return -1;
+  if (kv_get(key, value, &len, KV_FPERSIST) || len < 1) {
+    return -1;     //DIMM location key doesn't exist
   }
 
-  switch(dimm_present_status) {
+  switch((uint8_t)value[0]) {
     case 0x01:     //DIMM present
       break;
     case 0xFF:     //DIMM not present
     default:
-      close(fd);
       return -1;
   }
 
-  close(fd);
   return 0;
 }
 
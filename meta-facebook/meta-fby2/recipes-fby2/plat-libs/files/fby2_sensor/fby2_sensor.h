@@ -46,7 +46,7 @@ typedef struct _sensor_info_t {
 } sensor_info_t;
 
 typedef struct {
-  int8_t *dimm_location_file;
+  int8_t *dimm_location_key;
   uint8_t dimm_sensor_num;
 } rc_dimm_location_info;
 
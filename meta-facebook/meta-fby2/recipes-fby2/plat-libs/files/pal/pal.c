@@ -3010,6 +3010,28 @@ pal_get_fru_sdr_path(uint8_t fru, char *path) {
   return fby2_sensor_sdr_path(fru, path);
 }
 
+/* Slot sensors are read through the slot's BIC over IPMB, which may take
+ * hundreds of ms or time out while the BIC is busy. Every slot gets a
+ * sensord worker of its own; the SPB and NIC sensors are local I2C reads
+ * and share group 0. */
+int
+pal_get_sensor_poll_group(uint8_t fru, uint8_t sensor_num, uint8_t *group) {
+
+  switch(fru) {
+    case FRU_SLOT1:
+    case FRU_SLOT2:
+    case FRU_SLOT3:
+    case FRU_SLOT4:
+      *group = fru;
+      break;
+    default:
+      *group = 0;
+      break;
+  }
+
+  return 0;
+}
+
 int
 pal_get_fru_sensor_list(uint8_t fru, uint8_t **sensor_list, int *cnt) {
 
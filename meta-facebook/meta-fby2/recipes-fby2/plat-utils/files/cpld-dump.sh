@@ -50,7 +50,7 @@ fi
 # Set cplddump timestamp
 sys_runtime=$(awk '{print $1}' /proc/uptime)
 sys_runtime=$(printf "%0.f" $sys_runtime)
-echo $((sys_runtime+630)) > /tmp/cache_store/fru${SLOT_NUM}_cplddump
+kv set fru${SLOT_NUM}_cplddump $((sys_runtime+630))
 
 LOG_MSG_PREFIX=""
 
@@ -29,9 +29,10 @@
 #include <facebook/bic.h>
 #include <openbmc/pal.h>
 #include <openbmc/ipmi.h>
+#include <openbmc/kv.h>
 
 #define NCSI_DATA_PAYLOAD 64
-#define NIC_FW_VER_PATH "/tmp/cache_store/nic_fw_ver"
+#define NIC_FW_VER_KEY "nic_fw_ver"
 
 #define MAX_NUM_OPTIONS 6
 enum {
@@ -235,17 +236,11 @@ print_nic_version(uint8_t slot_id) {
   char vendor[32]={0};
   uint8_t buf[NCSI_DATA_PAYLOAD]={0};
   uint32_t nic_mfg_id=0;
-  FILE *file = NULL;
   bool is_unknown_mfg_id = true;
   int current_nic;
 
-  file = fopen(NIC_FW_VER_PATH, "rb");
-  if ( NULL != file ) {
-    fread(buf, sizeof(uint8_t), NCSI_DATA_PAYLOAD, file);
-    fclose(file);
-  }
-  else {
-    syslog(LOG_WARNING, "[%s]Cannot open the file at %s",__func__, NIC_FW_VER_PATH);
+  if (kv_get(NIC_FW_VER_KEY, (char *)buf, NULL, 0)) {
+    syslog(LOG_WARNING, "[%s]Cannot get the key %s",__func__, NIC_FW_VER_KEY);
   }
 
   //get the manufcture id
@@ -143,7 +143,7 @@ case $OPTION in
       # Remove Service for new device/server
       # Sensor
       sv stop sensord
-      rm -rf /tmp/cache_store/$SLOT*
+      kv del "$SLOT" prefix
       set_sysconfig $SLOT_NUM $SLOT_BUS
 
       # GPIO
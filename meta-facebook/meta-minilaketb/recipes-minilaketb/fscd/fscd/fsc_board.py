@@ -21,6 +21,7 @@ from fsc_util import Logger
 from ctypes import *
 from subprocess import Popen, PIPE
 from re import match
+from kv import kv_get, FPERSIST
 
 lpal_hndl = CDLL("libpal.so")
 
@@ -94,8 +95,7 @@ def sensor_valid_check(board, sname, check_name, attribute):
             if pwr_sts[0] == "1":
                 if match(r'soc_dimm', sname) != None:
                     # check DIMM present
-                    with open("/mnt/data/kv_store/sys_config/"+fru_map[board]['name']+loc_map[sname[8:10]], "rb") as f:
-                        dimm_sts = f.read(1)
+                    dimm_sts = kv_get("sys_config/"+fru_map[board]['name']+loc_map[sname[8:10]], FPERSIST, binary=True)
                     if dimm_sts[0] != 1:
                         return 0
                 return 1
@@ -29,7 +29,6 @@
 
 PATH=/sbin:/bin:/usr/sbin:/usr/bin:/usr/local/bin
 
-KEYDIR=/mnt/data/kv_store
 DEF_PWR_ON=1
 TO_PWR_ON=
 
@@ -38,12 +37,11 @@ check_por_config()
 
   TO_PWR_ON=-1
 
-  # Check if the file/key doesn't exist
-  if [ ! -f "${KEYDIR}/slot${1}_por_cfg" ]; then
+  # Check if the key doesn't exist
+  POR=`kv get slot${1}_por_cfg persistent`
+  if [ -z "$POR" ]; then
     TO_PWR_ON=$DEF_PWR_ON
   else
-    POR=`cat ${KEYDIR}/slot${1}_por_cfg`
-
     # Case ON
     if [ $POR == "on" ]; then
       TO_PWR_ON=1;
@@ -55,11 +53,11 @@ check_por_config()
     # Case LPS
     elif [ $POR == "lps" ]; then
 
-      # Check if the file/key doesn't exist
-      if [ ! -f "${KEYDIR}/pwr_server${1}_last_state" ]; then
+      # Check if the key doesn't exist
+      LS=`kv get pwr_server${1}_last_state persistent`
+      if [ -z "$LS" ]; then
         TO_PWR_ON=$DEF_PWR_ON
       else
-        LS=`cat ${KEYDIR}/pwr_server${1}_last_state`
         if [ $LS == "on" ]; then
           TO_PWR_ON=1;
         elif [ $LS == "off" ]; then
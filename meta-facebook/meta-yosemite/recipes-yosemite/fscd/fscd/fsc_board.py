@@ -21,6 +21,7 @@ from fsc_util import Logger
 from ctypes import *
 from subprocess import Popen, PIPE
 from re import match
+from kv import kv_get, FPERSIST
 
 
 fru_map = {
@@ -103,8 +104,7 @@ def sensor_valid_check(board, sname, check_name, attribute):
             if match(r'ON', result[1]) != None:
                 if match(r'soc_dimm', sname) != None:
                     # check DIMM present
-                    with open("/mnt/data/kv_store/sys_config/"+fru_map[board]['name']+loc_map[sname[8:10]], "rb") as f:
-                        dimm_sts = f.read(1)
+                    dimm_sts = kv_get("sys_config/"+fru_map[board]['name']+loc_map[sname[8:10]], FPERSIST, binary=True)
                     if dimm_sts[0] == 0x3f:
                         return 0
                 return 1